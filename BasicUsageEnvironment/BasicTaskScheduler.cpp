@@ -25,6 +25,16 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #include <sys/select.h>
 #include <unix.h>
 #endif
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#define USE_EVENTFD_FOR_WAKEUP 1
+#define USE_TIMERFD 1
+#elif !defined(__WIN32__) && !defined(_WIN32) && !defined(VXWORKS)
+#include <fcntl.h>
+#define USE_PIPE_FOR_WAKEUP 1
+#endif
 
 ////////// BasicTaskScheduler //////////
 
@@ -33,23 +43,91 @@ BasicTaskScheduler* BasicTaskScheduler::createNew(unsigned maxSchedulerGranulari
 }
 
 BasicTaskScheduler::BasicTaskScheduler(unsigned maxSchedulerGranularity)
-  : fMaxSchedulerGranularity(maxSchedulerGranularity), fMaxNumSockets(0) {
+  : fMaxSchedulerGranularity(maxSchedulerGranularity), fMaxNumSockets(0),
+    fWakeUpReadFd(-1), fWakeUpWriteFd(-1), fTimerFd(-1), fTimerDeadline(0) {
   FD_ZERO(&fReadSet);
   FD_ZERO(&fWriteSet);
   FD_ZERO(&fExceptionSet);
 
-  if (maxSchedulerGranularity > 0) schedulerTickTask(); // ensures that we handle events frequently
+  // Create a descriptor that "wakeUpEventLoop()" can make readable (from any thread), so that 'triggered events' get
+  // handled promptly, rather than only when "select()" next times out:
+#if defined(USE_EVENTFD_FOR_WAKEUP)
+  fWakeUpReadFd = fWakeUpWriteFd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+#elif defined(USE_PIPE_FOR_WAKEUP)
+  int pipeFds[2];
+  if (pipe(pipeFds) == 0) {
+    for (unsigned i = 0; i < 2; ++i) {
+      fcntl(pipeFds[i], F_SETFL, fcntl(pipeFds[i], F_GETFL, 0)|O_NONBLOCK);
+      fcntl(pipeFds[i], F_SETFD, FD_CLOEXEC);
+    }
+    fWakeUpReadFd = pipeFds[0]; fWakeUpWriteFd = pipeFds[1];
+  }
+#endif
+  if (fWakeUpReadFd >= 0) {
+    setBackgroundHandling(fWakeUpReadFd, SOCKET_READABLE, wakeUpHandler, this);
+  }
+
+#if defined(USE_TIMERFD)
+  fTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+  if (fTimerFd >= 0) {
+    setBackgroundHandling(fTimerFd, SOCKET_READABLE, timerHandler, this);
+  }
+#endif
+
+  // Note that we no longer schedule a periodic 'tick' task.  Instead, "SingleStep()" limits how long it waits in "select()"
+  // - but only if this is needed (see "BasicUsageEnvironment.hh").
 }
 
 BasicTaskScheduler::~BasicTaskScheduler() {
+  if (fWakeUpReadFd >= 0) {
+    setBackgroundHandling(fWakeUpReadFd, 0, NULL, NULL);
+#if defined(USE_EVENTFD_FOR_WAKEUP) || defined(USE_PIPE_FOR_WAKEUP)
+    close(fWakeUpReadFd);
+    if (fWakeUpWriteFd != fWakeUpReadFd) close(fWakeUpWriteFd);
+#endif
+  }
+  if (fTimerFd >= 0) {
+    setBackgroundHandling(fTimerFd, 0, NULL, NULL);
+#if defined(USE_TIMERFD)
+    close(fTimerFd);
+#endif
+  }
 }
 
-void BasicTaskScheduler::schedulerTickTask(void* clientData) {
-  ((BasicTaskScheduler*)clientData)->schedulerTickTask();
+void BasicTaskScheduler::wakeUpEventLoop() {
+  // Note: This may be called from an external thread.
+#if defined(USE_EVENTFD_FOR_WAKEUP)
+  u_int64_t one = 1;
+  if (write(fWakeUpWriteFd, &one, sizeof one) < 0) {} // (if this fails, it's because the counter is already nonzero)
+#elif defined(USE_PIPE_FOR_WAKEUP)
+  char one = 1;
+  if (write(fWakeUpWriteFd, &one, sizeof one) < 0) {} // (if this fails, it's because the pipe is already full)
+#endif
 }
 
-void BasicTaskScheduler::schedulerTickTask() {
-  scheduleDelayedTask(fMaxSchedulerGranularity, schedulerTickTask, this);
+void BasicTaskScheduler::wakeUpHandler(void* clientData, int /*mask*/) {
+  ((BasicTaskScheduler*)clientData)->wakeUpHandler1();
+}
+
+void BasicTaskScheduler::wakeUpHandler1() {
+  // Drain the wakeup descriptor.  (Any triggered events themselves get handled at the end of "SingleStep()".)
+#if defined(USE_EVENTFD_FOR_WAKEUP) || defined(USE_PIPE_FOR_WAKEUP)
+  u_int64_t buf[8];
+  while (read(fWakeUpReadFd, buf, sizeof buf) > 0) {}
+#endif
+}
+
+void BasicTaskScheduler::timerHandler(void* clientData, int /*mask*/) {
+  ((BasicTaskScheduler*)clientData)->timerHandler1();
+}
+
+void BasicTaskScheduler::timerHandler1() {
+  // Drain the timer descriptor.  (The delayed task that's now due gets handled at the end of "SingleStep()".)
+#if defined(USE_TIMERFD)
+  u_int64_t numExpirations;
+  if (read(fTimerFd, &numExpirations, sizeof numExpirations) < 0) {} // (if this fails, it's because we've already drained it)
+#endif
+  fTimerDeadline = 0;
 }
 
 #ifndef MILLION
@@ -71,6 +149,12 @@ void BasicTaskScheduler::SingleStep(unsigned maxDelayTime) {
   if (tv_timeToDelay.tv_sec > MAX_TV_SEC) {
     tv_timeToDelay.tv_sec = MAX_TV_SEC;
   }
+  // If we're watching a "watchVariable" (which might get changed from another thread), or if we can't otherwise be woken up
+  // promptly for a 'triggered event', then don't wait longer than "fMaxSchedulerGranularity":
+  if (fMaxSchedulerGranularity > 0 && (fNumWatchVariables > 0 || fWakeUpReadFd < 0)
+      && (maxDelayTime == 0 || maxDelayTime > fMaxSchedulerGranularity)) {
+    maxDelayTime = fMaxSchedulerGranularity;
+  }
   // Also check our "maxDelayTime" parameter (if it's > 0):
   if (maxDelayTime > 0 &&
       (tv_timeToDelay.tv_sec > (long)maxDelayTime/MILLION ||
@@ -79,6 +163,31 @@ void BasicTaskScheduler::SingleStep(unsigned maxDelayTime) {
     tv_timeToDelay.tv_sec = maxDelayTime/MILLION;
     tv_timeToDelay.tv_usec = maxDelayTime%MILLION;
   }
+  // But if any triggered events are already awaiting handling, then don't wait at all:
+  if (fTriggersAwaitingHandling != 0) {
+    tv_timeToDelay.tv_sec = tv_timeToDelay.tv_usec = 0;
+  }
+#if defined(USE_TIMERFD)
+  if (fTimerFd >= 0 && (tv_timeToDelay.tv_sec > 0 || tv_timeToDelay.tv_usec > 0) && tv_timeToDelay.tv_sec < MAX_TV_SEC) {
+    // Have our "timerfd" wake us up when the delay has passed.  (We still give "select()" the same timeout, but the "timerfd"
+    // - which has no 'timer slack' - will usually wake us up first.)
+    struct timespec timeNow;
+    clock_gettime(CLOCK_MONOTONIC, &timeNow);
+    int64_t const deadline = (timeNow.tv_sec + tv_timeToDelay.tv_sec)*(int64_t)1000000000
+      + timeNow.tv_nsec + tv_timeToDelay.tv_usec*1000;
+
+    // To avoid a system call each time, we reset the timer only if the deadline has changed (allowing for the fact that
+    // our delay queue counts in microseconds):
+    int64_t const ALLOWED_ERROR = 2000; // ns
+    if (deadline < fTimerDeadline - ALLOWED_ERROR || deadline > fTimerDeadline + ALLOWED_ERROR) {
+      struct itimerspec timerSpec;
+      timerSpec.it_interval.tv_sec = timerSpec.it_interval.tv_nsec = 0;
+      timerSpec.it_value.tv_sec = deadline/1000000000;
+      timerSpec.it_value.tv_nsec = deadline%1000000000;
+      if (timerfd_settime(fTimerFd, TFD_TIMER_ABSTIME, &timerSpec, NULL) == 0) fTimerDeadline = deadline;
+    }
+  }
+#endif
 
   int selectResult = select(fMaxNumSockets, &readSet, &writeSet, &exceptionSet, &tv_timeToDelay);
   if (selectResult < 0) {
@@ -172,7 +281,7 @@ void BasicTaskScheduler::SingleStep(unsigned maxDelayTime) {
   if (fTriggersAwaitingHandling != 0) {
     if (fTriggersAwaitingHandling == fLastUsedTriggerMask) {
       // Common-case optimization for a single event trigger:
-      fTriggersAwaitingHandling = 0;
+      clearTriggersAwaitingHandling(fLastUsedTriggerMask);
       if (fTriggeredEventHandlers[fLastUsedTriggerNum] != NULL) {
 	(*fTriggeredEventHandlers[fLastUsedTriggerNum])(fTriggeredEventClientDatas[fLastUsedTriggerNum]);
       }
@@ -187,7 +296,7 @@ void BasicTaskScheduler::SingleStep(unsigned maxDelayTime) {
 	if (mask == 0) mask = 0x80000000;
 
 	if ((fTriggersAwaitingHandling&mask) != 0) {
-	  fTriggersAwaitingHandling &=~ mask;
+	  clearTriggersAwaitingHandling(mask);
 	  if (fTriggeredEventHandlers[i] != NULL) {
 	    (*fTriggeredEventHandlers[i])(fTriggeredEventClientDatas[i]);
 	  }
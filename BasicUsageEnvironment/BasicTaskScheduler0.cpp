@@ -41,10 +41,47 @@ private:
 };
 
 
+////////// Atomic operations on "fTriggersAwaitingHandling" //////////
+// (These are needed because "triggerEvent()" - unlike our other member functions - may be called from an external thread.)
+
+#if defined(__GNUC__)
+#define ATOMIC_FETCH_AND_OR(ptr, mask) __sync_fetch_and_or((ptr), (mask))
+#define ATOMIC_FETCH_AND_AND(ptr, mask) __sync_fetch_and_and((ptr), (mask))
+#elif defined(__WIN32__) || defined(_WIN32)
+static EventTriggerId atomicFetchAndOr(EventTriggerId* ptr, EventTriggerId mask) {
+  LONG oldValue;
+  do {
+    oldValue = *(LONG volatile*)ptr;
+  } while (InterlockedCompareExchange((LONG volatile*)ptr, oldValue|(LONG)mask, oldValue) != oldValue);
+  return (EventTriggerId)oldValue;
+}
+static EventTriggerId atomicFetchAndAnd(EventTriggerId* ptr, EventTriggerId mask) {
+  LONG oldValue;
+  do {
+    oldValue = *(LONG volatile*)ptr;
+  } while (InterlockedCompareExchange((LONG volatile*)ptr, oldValue&(LONG)mask, oldValue) != oldValue);
+  return (EventTriggerId)oldValue;
+}
+#define ATOMIC_FETCH_AND_OR(ptr, mask) atomicFetchAndOr((ptr), (mask))
+#define ATOMIC_FETCH_AND_AND(ptr, mask) atomicFetchAndAnd((ptr), (mask))
+#else
+// We don't know how to do atomic operations on this system, so fall back to ordinary (non-atomic) ones:
+static EventTriggerId fetchAndOr(EventTriggerId* ptr, EventTriggerId mask) {
+  EventTriggerId oldValue = *ptr; *ptr |= mask; return oldValue;
+}
+static EventTriggerId fetchAndAnd(EventTriggerId* ptr, EventTriggerId mask) {
+  EventTriggerId oldValue = *ptr; *ptr &= mask; return oldValue;
+}
+#define ATOMIC_FETCH_AND_OR(ptr, mask) fetchAndOr((ptr), (mask))
+#define ATOMIC_FETCH_AND_AND(ptr, mask) fetchAndAnd((ptr), (mask))
+#endif
+
+
 ////////// BasicTaskScheduler0 //////////
 
 BasicTaskScheduler0::BasicTaskScheduler0()
-  : fLastHandledSocketNum(-1), fTriggersAwaitingHandling(0), fLastUsedTriggerMask(1), fLastUsedTriggerNum(MAX_NUM_EVENT_TRIGGERS-1) {
+  : fLastHandledSocketNum(-1), fTriggersAwaitingHandling(0), fLastUsedTriggerMask(1), fLastUsedTriggerNum(MAX_NUM_EVENT_TRIGGERS-1),
+    fNumWatchVariables(0) {
   fHandlers = new HandlerSet;
   for (unsigned i = 0; i < MAX_NUM_EVENT_TRIGGERS; ++i) {
     fTriggeredEventHandlers[i] = NULL;
@@ -74,11 +111,17 @@ void BasicTaskScheduler0::unscheduleDelayedTask(TaskToken& prevTask) {
 }
 
 void BasicTaskScheduler0::doEventLoop(char* watchVariable) {
+  // Note that we're watching a variable (which might get changed from another thread), so that "SingleStep()" knows not to
+  // wait too long:
+  if (watchVariable != NULL) ++fNumWatchVariables;
+
   // Repeatedly loop, handling readble sockets and timed events:
   while (1) {
     if (watchVariable != NULL && *watchVariable != 0) break;
     SingleStep();
   }
+
+  if (watchVariable != NULL) --fNumWatchVariables;
 }
 
 EventTriggerId BasicTaskScheduler0::createEventTrigger(TaskFunc* eventHandlerProc) {
@@ -107,7 +150,7 @@ EventTriggerId BasicTaskScheduler0::createEventTrigger(TaskFunc* eventHandlerPro
 }
 
 void BasicTaskScheduler0::deleteEventTrigger(EventTriggerId eventTriggerId) {
-  fTriggersAwaitingHandling &=~ eventTriggerId;
+  clearTriggersAwaitingHandling(eventTriggerId);
 
   if (eventTriggerId == fLastUsedTriggerMask) { // common-case optimization:
     fTriggeredEventHandlers[fLastUsedTriggerNum] = NULL;
@@ -139,7 +182,19 @@ void BasicTaskScheduler0::triggerEvent(EventTriggerId eventTriggerId, void* clie
   // Then, note this event as being ready to be handled.
   // (Note that because this function (unlike others in the library) can be called from an external thread, we do this last, to
   //  reduce the risk of a race condition.)
-  fTriggersAwaitingHandling |= eventTriggerId;
+  // If no other events were already awaiting handling, then the event loop might be blocked (e.g., in "select()"), so wake it up.
+  // (Otherwise, it will see the new event when it handles the earlier one(s).)
+  if (ATOMIC_FETCH_AND_OR(&fTriggersAwaitingHandling, eventTriggerId) == 0) {
+    wakeUpEventLoop();
+  }
+}
+
+void BasicTaskScheduler0::wakeUpEventLoop() {
+  // By default, we do nothing.  (The event loop will see the new event whenever it next returns from waiting.)
+}
+
+void BasicTaskScheduler0::clearTriggersAwaitingHandling(EventTriggerId eventTriggerIds) {
+  ATOMIC_FETCH_AND_AND(&fTriggersAwaitingHandling, ~eventTriggerIds);
 }
 
 
@@ -20,9 +20,23 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 
 #include "DelayQueue.hh"
 #include "GroupsockHelper.hh"
+#include <time.h>
 
 static const int MILLION = 1000000;
 
+// The clock that we use to measure delays.  Where possible, this is a 'monotonic' clock, so that changes to the
+// system's 'wall clock' time (e.g., by NTP) don't affect when our delayed tasks get handled:
+#if defined(CLOCK_MONOTONIC) && !defined(__WIN32__) && !defined(_WIN32)
+static EventTime delayClockNow() {
+  struct timespec tsNow;
+  clock_gettime(CLOCK_MONOTONIC, &tsNow);
+
+  return EventTime(tsNow.tv_sec, tsNow.tv_nsec/1000);
+}
+#else
+#define delayClockNow TimeNow
+#endif
+
 ///// Timeval /////
 
 int Timeval::operator>=(const Timeval& arg2) const {
@@ -112,7 +126,7 @@ void DelayQueueEntry::handleTimeout() {
 
 DelayQueue::DelayQueue()
   : DelayQueueEntry(ETERNITY) {
-  fLastSyncTime = TimeNow();
+  fLastSyncTime = delayClockNow();
 }
 
 DelayQueue::~DelayQueue() {
@@ -200,7 +214,7 @@ DelayQueueEntry* DelayQueue::findEntryByToken(intptr_t tokenToFind) {
 
 void DelayQueue::synchronize() {
   // First, figure out how much time has elapsed since the last sync:
-  EventTime timeNow = TimeNow();
+  EventTime timeNow = delayClockNow();
   if (timeNow < fLastSyncTime) {
     // The system clock has apparently gone back in time; reset our sync time and return:
     fLastSyncTime  = timeNow;
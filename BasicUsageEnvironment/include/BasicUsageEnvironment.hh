@@ -48,21 +48,29 @@ class BasicTaskScheduler: public BasicTaskScheduler0 {
 public:
   static BasicTaskScheduler* createNew(unsigned maxSchedulerGranularity = 10000/*microseconds*/);
     // "maxSchedulerGranularity" (default value: 10 ms) specifies the maximum time that we wait (in "select()") before
-    // returning to the event loop to handle non-socket or non-timer-based events, such as 'triggered events'.
+    // returning to the event loop to handle non-socket or non-timer-based events, such as a change to "doEventLoop()"'s
+    // "watchVariable" (made from another thread).
     // You can change this is you wish (but only if you know what you're doing!), or set it to 0, to specify no such maximum time.
-    // (You should set it to 0 only if you know that you will not be using 'event triggers'.)
+    // On systems where we can create a 'wakeup' descriptor (an "eventfd" on Linux; a pipe on other Unix systems),
+    // 'triggered events' are handled promptly regardless, so we apply this maximum only while "doEventLoop()" is
+    // watching a "watchVariable".  Otherwise, we never wake up unless there's something to do.
+    // On other systems (e.g., Windows), 'triggered events' too are handled only after "select()" returns, so we always
+    // apply this maximum - and you should set it to 0 only if you know that you will not be using 'event triggers'.
   virtual ~BasicTaskScheduler();
 
 protected:
   BasicTaskScheduler(unsigned maxSchedulerGranularity);
       // called only by "createNew()"
 
-  static void schedulerTickTask(void* clientData);
-  void schedulerTickTask();
+  static void wakeUpHandler(void* clientData, int mask);
+  void wakeUpHandler1();
+  static void timerHandler(void* clientData, int mask);
+  void timerHandler1();
 
 protected:
   // Redefined virtual functions:
   virtual void SingleStep(unsigned maxDelayTime);
+  virtual void wakeUpEventLoop();
 
   virtual void setBackgroundHandling(int socketNum, int conditionSet, BackgroundHandlerProc* handlerProc, void* clientData);
   virtual void moveSocketHandling(int oldSocketNum, int newSocketNum);
@@ -75,6 +83,14 @@ protected:
   fd_set fReadSet;
   fd_set fWriteSet;
   fd_set fExceptionSet;
+
+  // To implement "wakeUpEventLoop()":
+  int fWakeUpReadFd, fWakeUpWriteFd; // (the same descriptor, if it's an "eventfd"); -1 if not supported
+
+  // To wake up (from "select()") precisely when the next delayed task is due.  (This is a "timerfd", on Linux.  Unlike
+  // "select()"'s own timeout, it is not subject to 'timer slack'.)
+  int fTimerFd; // -1 if not supported
+  int64_t fTimerDeadline; // when "fTimerFd" is set to expire (in nanoseconds, on the monotonic clock); 0 if it's not set
 };
 
 #endif
@@ -95,6 +95,14 @@ public:
 protected:
   BasicTaskScheduler0();
 
+  virtual void wakeUpEventLoop();
+      // Called (possibly from an external thread) by "triggerEvent()", when an event is triggered while no other events
+      // are awaiting handling.  Subclasses that may be blocked (e.g., in "select()") should redefine this to return
+      // to the event loop promptly.  (The default implementation does nothing.)
+  void clearTriggersAwaitingHandling(EventTriggerId eventTriggerIds);
+      // Atomically removes "eventTriggerIds" from "fTriggersAwaitingHandling".  (Subclasses' "SingleStep()" implementations
+      // should use this, rather than changing "fTriggersAwaitingHandling" directly.)
+
 protected:
   // To implement delayed operations:
   DelayQueue fDelayQueue;
@@ -108,6 +116,8 @@ protected:
   TaskFunc* fTriggeredEventHandlers[MAX_NUM_EVENT_TRIGGERS];
   void* fTriggeredEventClientDatas[MAX_NUM_EVENT_TRIGGERS];
   unsigned fLastUsedTriggerNum; // in the range [0,MAX_NUM_EVENT_TRIGGERS)
+
+  unsigned fNumWatchVariables; // the number of (nested) "doEventLoop()" calls that are watching a "watchVariable"
 };
 
 #endif
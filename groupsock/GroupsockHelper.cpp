@@ -49,12 +49,23 @@ NoReuse::~NoReuse() {
   reclaimGroupsockPriv(fEnv);
 }
 
+ReusePortForTCP::ReusePortForTCP(UsageEnvironment& env)
+  : fEnv(env) {
+  groupsockPriv(fEnv)->reusePortForTCPFlag = 1;
+}
+
+ReusePortForTCP::~ReusePortForTCP() {
+  groupsockPriv(fEnv)->reusePortForTCPFlag = 0;
+  reclaimGroupsockPriv(fEnv);
+}
+
 
 _groupsockPriv* groupsockPriv(UsageEnvironment& env) {
   if (env.groupsockPriv == NULL) { // We need to create it
     _groupsockPriv* result = new _groupsockPriv;
     result->socketTable = NULL;
     result->reuseFlag = 1; // default value => allow reuse of socket numbers
+    result->reusePortForTCPFlag = 0; // default value
     env.groupsockPriv = result;
   }
   return (_groupsockPriv*)(env.groupsockPriv);
@@ -62,7 +73,8 @@ _groupsockPriv* groupsockPriv(UsageEnvironment& env) {
 
 void reclaimGroupsockPriv(UsageEnvironment& env) {
   _groupsockPriv* priv = (_groupsockPriv*)(env.groupsockPriv);
-  if (priv->socketTable == NULL && priv->reuseFlag == 1/*default value*/) {
+  if (priv->socketTable == NULL && priv->reuseFlag == 1/*default value*/
+      && priv->reusePortForTCPFlag == 0/*default value*/) {
     // We can delete the structure (to save space); it will get created again, if needed:
     delete priv;
     env.groupsockPriv = NULL;
@@ -208,6 +220,7 @@ int setupStreamSocket(UsageEnvironment& env,
   }
 
   int reuseFlag = groupsockPriv(env)->reuseFlag;
+  int reusePortFlag = groupsockPriv(env)->reusePortForTCPFlag;
   reclaimGroupsockPriv(env);
   if (setsockopt(newSocket, SOL_SOCKET, SO_REUSEADDR,
 		 (const char*)&reuseFlag, sizeof reuseFlag) < 0) {
@@ -217,21 +230,24 @@ int setupStreamSocket(UsageEnvironment& env,
   }
 
   // SO_REUSEPORT doesn't really make sense for TCP sockets, so we
-  // normally don't set them.  However, if you really want to do this
-  // #define REUSE_FOR_TCP
+  // normally don't set them (unless we're within the scope of a
+  // "ReusePortForTCP" object).  However, if you really want to do this
+  // always, #define REUSE_FOR_TCP
 #ifdef REUSE_FOR_TCP
+  reusePortFlag = reuseFlag;
+#endif
 #if defined(__WIN32__) || defined(_WIN32)
   // Windoze doesn't properly handle SO_REUSEPORT
 #else
 #ifdef SO_REUSEPORT
-  if (setsockopt(newSocket, SOL_SOCKET, SO_REUSEPORT,
-		 (const char*)&reuseFlag, sizeof reuseFlag) < 0) {
+  if (reusePortFlag
+      && setsockopt(newSocket, SOL_SOCKET, SO_REUSEPORT,
+		    (const char*)&reusePortFlag, sizeof reusePortFlag) < 0) {
     socketErr(env, "setsockopt(SO_REUSEPORT) error: ");
     closeSocket(newSocket);
     return -1;
   }
 #endif
-#endif
 #endif
 
   // Note: Windoze requires binding, even if the port number is 0
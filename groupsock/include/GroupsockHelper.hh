@@ -116,12 +116,30 @@ private:
   UsageEnvironment& fEnv;
 };
 
+// Normally, we don't set SO_REUSEPORT on TCP sockets.  However, if you want a TCP socket's port number to be shared
+// by other processes (each binding its own socket to the same port - e.g., so that the kernel can spread incoming
+// connections over several server processes), then enclose the socket creation code with:
+//          {
+//            ReusePortForTCP dummy(env);
+//            ...
+//          }
+// (This works only on OSs - such as Linux - that support SO_REUSEPORT for TCP, and each process must do the same.)
+class ReusePortForTCP {
+public:
+  ReusePortForTCP(UsageEnvironment& env);
+  ~ReusePortForTCP();
+
+private:
+  UsageEnvironment& fEnv;
+};
+
 
 // Define the "UsageEnvironment"-specific "groupsockPriv" structure:
 
 struct _groupsockPriv { // There should be only one of these allocated
   HashTable* socketTable;
   int reuseFlag;
+  int reusePortForTCPFlag;
 };
 _groupsockPriv* groupsockPriv(UsageEnvironment& env); // allocates it if necessary
 void reclaimGroupsockPriv(UsageEnvironment& env);
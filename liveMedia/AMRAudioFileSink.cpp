@@ -99,3 +99,7 @@ void AMRAudioFileSink::afterGettingFrame(unsigned frameSize,
   // Call the parent class to complete the normal file write with the input data:
   FileSink::afterGettingFrame(frameSize, numTruncatedBytes, presentationTime);
 }
+
+void AMRAudioFileSink::segmentHasBegun() {
+  fHaveWrittenHeader = False; // so that each segment begins with the AMR header
+}
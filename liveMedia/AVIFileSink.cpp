@@ -130,10 +130,11 @@ AVIFileSink::AVIFileSink(UsageEnvironment& env,
     fIndexRecordsHead(NULL), fIndexRecordsTail(NULL), fNumIndexRecords(0),
     fBufferSize(bufferSize), fPacketLossCompensate(packetLossCompensate),
     fAreCurrentlyBeingPlayed(False), fNumSubsessions(0), fNumBytesWritten(0),
-    fHaveCompletedOutputFile(False),
+    fHaveCompletedOutputFile(False), fWriter(NULL),
     fMovieWidth(movieWidth), fMovieHeight(movieHeight), fMovieFPS(movieFPS) {
   fOutFid = OpenOutputFile(env, outputFileName);
   if (fOutFid == NULL) return;
+  fWriter = new BufferedFileWriter(env, fOutFid);
 
   // Set up I/O state for each input subsession:
   MediaSubsessionIterator iter(fInputSession);
@@ -196,6 +197,7 @@ AVIFileSink::~AVIFileSink() {
   }
 
   // Finally, close our output file:
+  delete fWriter; // writes any remaining data
   CloseOutputFile(fOutFid);
 }
 
@@ -545,7 +547,7 @@ void AVISubsessionIOState::useFrame(SubsessionBuffer& buffer) {
   } else {
     fOurSink.fNumBytesWritten += fOurSink.addWord(frameSize);
   }
-  fwrite(frameSource, 1, frameSize, fOurSink.fOutFid);
+  fOurSink.fWriter->write(frameSource, frameSize);
   fOurSink.fNumBytesWritten += frameSize;
   // Pad to an even length:
   if (frameSize%2 != 0) fOurSink.fNumBytesWritten += fOurSink.addByte(0);
@@ -592,17 +594,9 @@ unsigned AVIFileSink::add4ByteString(char const* str) {
 }
 
 void AVIFileSink::setWord(unsigned filePosn, unsigned size) {
-  do {
-    if (SeekFile64(fOutFid, filePosn, SEEK_SET) < 0) break;
-    addWord(size);
-    if (SeekFile64(fOutFid, 0, SEEK_END) < 0) break; // go back to where we were
-
-    return;
-  } while (0);
-
-  // One of the SeekFile64()s failed, probable because we're not a seekable file
-  envir() << "AVIFileSink::setWord(): SeekFile64 failed (err "
-	  << envir().getErrno() << ")\n";
+  unsigned char word[4];
+  word[0] = size; word[1] = size>>8; word[2] = size>>16; word[3] = size>>24; // little-endian order
+  fWriter->patch(filePosn, word, 4);
 }
 
 // Methods for writing particular file headers.  Note the following macros:
@@ -610,7 +604,7 @@ void AVIFileSink::setWord(unsigned filePosn, unsigned size) {
 #define addFileHeader(tag,name) \
     unsigned AVIFileSink::addFileHeader_##name() { \
         add4ByteString("" #tag ""); \
-        unsigned headerSizePosn = (unsigned)TellFile64(fOutFid); addWord(0); \
+        unsigned headerSizePosn = (unsigned)fWriter->position(); addWord(0); \
         add4ByteString("" #name ""); \
         unsigned ignoredSize = 8;/*don't include size of tag or size fields*/ \
         unsigned size = 12
@@ -618,7 +612,7 @@ void AVIFileSink::setWord(unsigned filePosn, unsigned size) {
 #define addFileHeader1(name) \
     unsigned AVIFileSink::addFileHeader_##name() { \
         add4ByteString("" #name ""); \
-        unsigned headerSizePosn = (unsigned)TellFile64(fOutFid); addWord(0); \
+        unsigned headerSizePosn = (unsigned)fWriter->position(); addWord(0); \
         unsigned ignoredSize = 8;/*don't include size of name or size fields*/ \
         unsigned size = 8
 
@@ -675,11 +669,11 @@ addFileHeaderEnd;
 addFileHeader1(avih);
     unsigned usecPerFrame = fMovieFPS == 0 ? 0 : 1000000/fMovieFPS;
     size += addWord(usecPerFrame); // dwMicroSecPerFrame
-    fAVIHMaxBytesPerSecondPosition = (unsigned)TellFile64(fOutFid);
+    fAVIHMaxBytesPerSecondPosition = (unsigned)fWriter->position();
     size += addWord(0); // dwMaxBytesPerSec (fill in later)
     size += addWord(0); // dwPaddingGranularity
     size += addWord(AVIF_TRUSTCKTYPE|AVIF_HASINDEX|AVIF_ISINTERLEAVED); // dwFlags
-    fAVIHFrameCountPosition = (unsigned)TellFile64(fOutFid);
+    fAVIHFrameCountPosition = (unsigned)fWriter->position();
     size += addWord(0); // dwTotalFrames (fill in later)
     size += addWord(0); // dwInitialFrame
     size += addWord(fNumSubsessions); // dwStreams
@@ -707,7 +701,7 @@ addFileHeader1(strh);
     size += addWord(fCurrentIOState->fAVIScale); // dwScale
     size += addWord(fCurrentIOState->fAVIRate); // dwRate
     size += addWord(0); // dwStart
-    fCurrentIOState->fSTRHFrameCountPosition = (unsigned)TellFile64(fOutFid);
+    fCurrentIOState->fSTRHFrameCountPosition = (unsigned)fWriter->position();
     size += addWord(0); // dwLength (fill in later)
     size += addWord(fBufferSize); // dwSuggestedBufferSize
     size += addWord((unsigned)-1); // dwQuality
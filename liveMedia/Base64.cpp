@@ -19,22 +19,37 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 // implementation
 
 #include "Base64.hh"
-#include <strDup.hh>
 #include <string.h>
 
-static char base64DecodeTable[256];
-
-static void initBase64DecodeTable() {
-  int i;
-  for (i = 0; i < 256; ++i) base64DecodeTable[i] = (char)0x80;
-      // default value: invalid
-
-  for (i = 'A'; i <= 'Z'; ++i) base64DecodeTable[i] = 0 + (i - 'A');
-  for (i = 'a'; i <= 'z'; ++i) base64DecodeTable[i] = 26 + (i - 'a');
-  for (i = '0'; i <= '9'; ++i) base64DecodeTable[i] = 52 + (i - '0');
-  base64DecodeTable[(unsigned char)'+'] = 62;
-  base64DecodeTable[(unsigned char)'/'] = 63;
-  base64DecodeTable[(unsigned char)'='] = 0;
+// Values in our decoding table (besides 0-63):
+#define BAD 0x80 // an invalid character
+#define WS 0x81 // whitespace: space, tab, CR, NL
+#define PAD 0x82 // '='
+
+static unsigned char const base64DecodeTable[256] = {
+  BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD, WS, WS,BAD,BAD, WS,BAD,BAD,
+  BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,
+   WS,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD, 62,BAD,BAD,BAD, 63,
+   52, 53, 54, 55, 56, 57, 58, 59, 60, 61,BAD,BAD,BAD,PAD,BAD,BAD,
+  BAD,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+   15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,BAD,BAD,BAD,BAD,BAD,
+  BAD, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+   41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,BAD,BAD,BAD,BAD,BAD,
+  BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,
+  BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,
+  BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,
+  BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,
+  BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,
+  BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,
+  BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,
+  BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD,BAD
+};
+
+// Decodes one group of 4 chars (that have already been looked up in "base64DecodeTable", and are each 0-63), into 3 bytes:
+static inline void decodeGroup(unsigned char const v[4], unsigned char* out) {
+  out[0] = (v[0]<<2) | (v[1]>>4);
+  out[1] = (v[1]<<4) | (v[2]>>2);
+  out[2] = (v[2]<<6) | v[3];
 }
 
 unsigned char* base64Decode(char const* in, unsigned& resultSize,
@@ -46,42 +61,83 @@ unsigned char* base64Decode(char const* in, unsigned& resultSize,
 unsigned char* base64Decode(char const* in, unsigned inSize,
 			    unsigned& resultSize,
 			    Boolean trimTrailingZeros) {
-  static Boolean haveInitializedBase64DecodeTable = False;
-  if (!haveInitializedBase64DecodeTable) {
-    initBase64DecodeTable();
-    haveInitializedBase64DecodeTable = True;
-  }
-
-  unsigned char* out = (unsigned char*)strDupSize(in); // ensures we have enough space
-  int k = 0;
-  int paddingCount = 0;
-  int const jMax = inSize - 3;
+  unsigned const numGroups = inSize/4;
      // in case "inSize" is not a multiple of 4 (although it should be)
-  for (int j = 0; j < jMax; j += 4) {
-    char inTmp[4], outTmp[4];
-    for (int i = 0; i < 4; ++i) {
-      inTmp[i] = in[i+j];
-      if (inTmp[i] == '=') ++paddingCount;
-      outTmp[i] = base64DecodeTable[(unsigned char)inTmp[i]];
-      if ((outTmp[i]&0x80) != 0) outTmp[i] = 0; // this happens only if there was an invalid character; pretend that it was 'A'
+  unsigned char* result = new unsigned char[3*numGroups + 1/*in case numGroups == 0*/];
+  unsigned char const* from = (unsigned char const*)in;
+  unsigned char* to = result;
+  int paddingCount = 0;
+  for (unsigned j = 0; j < numGroups; ++j, from += 4, to += 3) {
+    unsigned char v[4];
+    v[0] = base64DecodeTable[from[0]]; v[1] = base64DecodeTable[from[1]];
+    v[2] = base64DecodeTable[from[2]]; v[3] = base64DecodeTable[from[3]];
+    if (((v[0]|v[1]|v[2]|v[3])&0x80) != 0) {
+      // Unusual case: We have padding, or an invalid char:
+      for (unsigned i = 0; i < 4; ++i) {
+	if (v[i] == PAD) ++paddingCount;
+	if ((v[i]&0x80) != 0) v[i] = 0; // pretend that it was 'A'
+      }
     }
-
-    out[k++] = (outTmp[0]<<2) | (outTmp[1]>>4);
-    out[k++] = (outTmp[1]<<4) | (outTmp[2]>>2);
-    out[k++] = (outTmp[2]<<6) | outTmp[3];
+    decodeGroup(v, to);
   }
 
+  int k = to - result;
   if (trimTrailingZeros) {
-    while (paddingCount > 0 && k > 0 && out[k-1] == '\0') { --k; --paddingCount; }
+    while (paddingCount > 0 && k > 0 && result[k-1] == '\0') { --k; --paddingCount; }
   }
   resultSize = k;
-  unsigned char* result = new unsigned char[resultSize];
-  memmove(result, out, resultSize);
-  delete[] out;
 
   return result;
 }
 
+unsigned base64DecodeInPlace(unsigned char* data, unsigned dataSize, unsigned& numUndecodedChars) {
+  unsigned char const* from = data;
+  unsigned char const* const end = &data[dataSize];
+  unsigned char* to = data; // Note: This never overtakes "from", because each group of 4 chars produces at most 3 bytes
+  unsigned char group[4]; // the chars - still undecoded - of the group that we're collecting
+  unsigned char groupValues[4];
+  unsigned numInGroup = 0;
+
+  while (1) {
+    if (numInGroup == 0) {
+      // The common case: Decode whole groups of 4 valid chars, without copying them:
+      while (end - from >= 4) {
+	unsigned char v[4];
+	v[0] = base64DecodeTable[from[0]]; v[1] = base64DecodeTable[from[1]];
+	v[2] = base64DecodeTable[from[2]]; v[3] = base64DecodeTable[from[3]];
+	if (((v[0]|v[1]|v[2]|v[3])&0x80) != 0) break; // we have whitespace, padding, or an invalid char
+
+	decodeGroup(v, to);
+	from += 4; to += 3;
+      }
+    }
+    if (from == end) break;
+
+    // Otherwise, handle the next char by itself:
+    unsigned char const c = *from++;
+    unsigned char const value = base64DecodeTable[c];
+    if (value == WS) continue;
+
+    group[numInGroup] = c;
+    groupValues[numInGroup] = (value&0x80) != 0 ? 0 : value; // an invalid char, or '=', is treated as if it were 'A'
+    if (++numInGroup == 4) {
+      // Output this group's bytes - except that a group ending with '=' or '==' produces only 2 or 1 bytes:
+      unsigned char out[3];
+      decodeGroup(groupValues, out);
+      unsigned numBytes = group[3] != '=' ? 3 : group[2] != '=' ? 2 : 1;
+      for (unsigned i = 0; i < numBytes; ++i) *to++ = out[i];
+      numInGroup = 0;
+    }
+  }
+
+  // Leave any chars of an incomplete group (undecoded) after the decoded bytes:
+  unsigned const numDecodedBytes = to - data;
+  for (unsigned i = 0; i < numInGroup; ++i) *to++ = group[i];
+  numUndecodedChars = numInGroup;
+
+  return numDecodedBytes;
+}
+
 static const char base64Char[] =
 "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
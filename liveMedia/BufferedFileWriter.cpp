@@ -0,0 +1,227 @@
+/**********
+This library is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the
+Free Software Foundation; either version 2.1 of the License, or (at your
+option) any later version. (See <http://www.gnu.org/copyleft/lesser.html>.)
+
+This library is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this library; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+**********/
+// "liveMedia"
+// Copyright (c) 1996-2014 Live Networks, Inc.  All rights reserved.
+// A 'write-behind' buffer for output files, used by our file sinks.
+// Implementation
+
+#include "BufferedFileWriter.hh"
+#include "InputFile.hh"
+#include <string.h>
+
+BufferedFileWriter::BufferedFileWriter(UsageEnvironment& env, FILE* fid,
+				       unsigned blockSize, unsigned maxBacklogSize, unsigned maxFlushDelayMS)
+  : fEnv(env), fFid(fid), fBlockSize(blockSize < 2 ? 2 : blockSize), fMaxBacklogSize(maxBacklogSize),
+    fMaxFlushDelayMS(maxFlushDelayMS), fHead(NULL), fTail(NULL), fFreeBlocks(NULL), fPatches(NULL),
+    fNumBufferedBytes(0), fFlushTask(NULL), fFlushTaskIsImmediate(False), fHasFailed(False),
+    fNumBytesWritten(0), fNumWriteCalls(0), fNumBacklogStalls(0), fMaxBacklog(0), fNumDeferredPatches(0) {
+  fFileSize = fid == NULL ? -1 : TellFile64(fid);
+  if (fFileSize < 0) fFileSize = 0; // e.g., if "fid" is a pipe
+}
+
+BufferedFileWriter::~BufferedFileWriter() {
+  flush();
+  fEnv.taskScheduler().unscheduleDelayedTask(fFlushTask);
+
+  while (fHead != NULL) {
+    Block* block = fHead; fHead = block->next;
+    delete[] block->data; delete block;
+  }
+  while (fFreeBlocks != NULL) {
+    Block* block = fFreeBlocks; fFreeBlocks = block->next;
+    delete[] block->data; delete block;
+  }
+  while (fPatches != NULL) {
+    Patch* patch = fPatches; fPatches = patch->next;
+    delete[] patch->data; delete patch;
+  }
+}
+
+void BufferedFileWriter::write(unsigned char const* data, unsigned dataSize) {
+  while (dataSize > 0) {
+    if (fTail == NULL || fTail->size == fBlockSize) addBlock();
+
+    unsigned numBytesToCopy = fBlockSize - fTail->size;
+    if (numBytesToCopy > dataSize) numBytesToCopy = dataSize;
+    memmove(&fTail->data[fTail->size], data, numBytesToCopy);
+    fTail->size += numBytesToCopy;
+    fFileSize += numBytesToCopy;
+    fNumBufferedBytes += numBytesToCopy;
+
+    data += numBytesToCopy;
+    dataSize -= numBytesToCopy;
+  }
+
+  if (fNumBufferedBytes > fMaxBacklog) fMaxBacklog = fNumBufferedBytes;
+  scheduleFlush();
+}
+
+void BufferedFileWriter::patch(int64_t filePosn, unsigned char const* data, unsigned dataSize) {
+  // Any data before "firstBufferedPosn" has already been written to the file:
+  int64_t const firstBufferedPosn = fHead == NULL ? fFileSize : fHead->filePosn + fHead->numWritten;
+  if (filePosn < firstBufferedPosn) {
+    unsigned numBytesToDefer = dataSize;
+    if (filePosn + numBytesToDefer > firstBufferedPosn) numBytesToDefer = (unsigned)(firstBufferedPosn - filePosn);
+    addDeferredPatch(filePosn, data, numBytesToDefer);
+
+    filePosn += numBytesToDefer;
+    data += numBytesToDefer;
+    dataSize -= numBytesToDefer;
+  }
+
+  // Change the rest of the data in memory:
+  for (Block* block = fHead; block != NULL && dataSize > 0; block = block->next) {
+    int64_t const blockEnd = block->filePosn + block->size;
+    if (filePosn >= blockEnd) continue;
+
+    unsigned const offsetInBlock = (unsigned)(filePosn - block->filePosn);
+    unsigned numBytesToCopy = block->size - offsetInBlock;
+    if (numBytesToCopy > dataSize) numBytesToCopy = dataSize;
+    memmove(&block->data[offsetInBlock], data, numBytesToCopy);
+
+    filePosn += numBytesToCopy;
+    data += numBytesToCopy;
+    dataSize -= numBytesToCopy;
+  }
+  // (Any remaining data lies beyond the end of the file, and is ignored.)
+}
+
+Boolean BufferedFileWriter::flush() {
+  while (fHead != NULL && fNumBufferedBytes > 0) writeHeadBlock();
+
+  // Then make any deferred changes to the data that we wrote earlier:
+  while (fPatches != NULL) {
+    Patch* patch = fPatches; fPatches = patch->next;
+
+    if (!fHasFailed) {
+      if (fFid == NULL || SeekFile64(fFid, patch->filePosn, SEEK_SET) < 0
+	  || fwrite(patch->data, 1, patch->size, fFid) != patch->size
+	  || SeekFile64(fFid, 0, SEEK_END) < 0) {
+	// Probably because we're not a seekable file:
+	fEnv << "BufferedFileWriter::flush(): Failed to update earlier data (err " << fEnv.getErrno() << ")\n";
+	fHasFailed = True;
+      }
+    }
+    delete[] patch->data; delete patch;
+  }
+
+  if (fFid != NULL && fflush(fFid) == EOF) fHasFailed = True;
+  return !fHasFailed;
+}
+
+void BufferedFileWriter::addBlock() {
+  if (fNumBufferedBytes >= fMaxBacklogSize && fHead != NULL) {
+    // Too much data is waiting to be written, so write (at least) the oldest block now:
+    ++fNumBacklogStalls;
+    writeHeadBlock();
+  }
+
+  Block* block = fFreeBlocks;
+  if (block != NULL) {
+    fFreeBlocks = block->next;
+  } else {
+    block = new Block;
+    block->data = new unsigned char[fBlockSize];
+  }
+  block->next = NULL;
+  block->filePosn = fFileSize;
+  block->size = block->numWritten = 0;
+
+  if (fTail == NULL) {
+    fHead = fTail = block;
+  } else {
+    fTail->next = block;
+    fTail = block;
+  }
+}
+
+void BufferedFileWriter::writeHeadBlock() {
+  Block* block = fHead;
+  unsigned const numBytesToWrite = block->size - block->numWritten;
+
+  if (numBytesToWrite > 0) {
+    if (!fHasFailed) {
+      ++fNumWriteCalls;
+      if (fFid == NULL || fwrite(&block->data[block->numWritten], 1, numBytesToWrite, fFid) != numBytesToWrite) {
+	fHasFailed = True;
+      } else {
+	fNumBytesWritten += numBytesToWrite;
+      }
+    }
+    block->numWritten = block->size;
+    fNumBufferedBytes -= numBytesToWrite;
+  }
+
+  if (block->size == fBlockSize || block != fTail) {
+    // This block is done; move it to our free list:
+    fHead = block->next;
+    if (fHead == NULL) fTail = NULL;
+    block->next = fFreeBlocks;
+    fFreeBlocks = block;
+  }
+}
+
+void BufferedFileWriter::scheduleFlush() {
+  if (fNumBufferedBytes == 0) return;
+
+  // Write full blocks as soon as possible (i.e., on the next pass through the event loop), but wait a while before writing
+  // a partially-filled block, in case more data arrives for it:
+  Boolean const haveFullBlock = fHead != fTail || fHead->size == fBlockSize;
+  if (fFlushTask == NULL) {
+    fFlushTaskIsImmediate = haveFullBlock;
+    fFlushTask = fEnv.taskScheduler().scheduleDelayedTask(haveFullBlock ? 0 : fMaxFlushDelayMS*1000,
+							  (TaskFunc*)flushTask, this);
+  } else if (haveFullBlock && !fFlushTaskIsImmediate) {
+    fFlushTaskIsImmediate = True;
+    fEnv.taskScheduler().rescheduleDelayedTask(fFlushTask, 0, (TaskFunc*)flushTask, this);
+  }
+}
+
+void BufferedFileWriter::flushTask(void* clientData) {
+  ((BufferedFileWriter*)clientData)->flushTask1();
+}
+
+void BufferedFileWriter::flushTask1() {
+  fFlushTask = NULL;
+
+  // Write one block (which might be partially-filled, if that's all we have), then reschedule ourself if needed:
+  if (fHead != NULL) writeHeadBlock();
+  if (fFid != NULL && (fHead == NULL || fHead == fTail)) fflush(fFid);
+  scheduleFlush();
+}
+
+void BufferedFileWriter::addDeferredPatch(int64_t filePosn, unsigned char const* data, unsigned dataSize) {
+  // If we already have a deferred change to the same data, then just replace it:
+  for (Patch* patch = fPatches; patch != NULL; patch = patch->next) {
+    if (patch->filePosn == filePosn && patch->size == dataSize) {
+      memmove(patch->data, data, dataSize);
+      return;
+    }
+  }
+
+  Patch* patch = new Patch;
+  patch->filePosn = filePosn;
+  patch->size = dataSize;
+  patch->data = new unsigned char[dataSize];
+  memmove(patch->data, data, dataSize);
+
+  // Add it to the end of our list, so that changes are made in the order that they were requested:
+  patch->next = NULL;
+  Patch** ptr = &fPatches;
+  while (*ptr != NULL) ptr = &(*ptr)->next;
+  *ptr = patch;
+  ++fNumDeferredPatches;
+}
@@ -146,6 +146,8 @@ void DeviceSource::deliverFrame() {
 // (Note, however, that "triggerEvent()" cannot be called with the same 'event trigger id' from different threads.
 // Also, if you want to have multiple device threads, each one using a different 'event trigger id', then you will need
 // to make "eventTriggerId" a non-static member variable of "DeviceSource".)
+// (Alternatively, if your device's thread(s) produce complete frames, then you can instead just "pushFrame()" them into a
+//  "FrameQueueSource", which does all of this for you.)
 void signalNewFrameData() {
   TaskScheduler* ourScheduler = NULL; //%%% TO BE WRITTEN %%%
   DeviceSource* ourDevice  = NULL; //%%% TO BE WRITTEN %%%
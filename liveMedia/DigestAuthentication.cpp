@@ -88,6 +88,27 @@ void Authenticator::setUsernameAndPassword(char const* username,
   assignUsernameAndPassword(username, password, passwordIsMD5);
 }
 
+static void computeHA2AndResponse(char const* ha1, char const* nonce,
+				  char const* cmd, char const* url, unsigned urlSize, char* resultResponse) {
+  unsigned ha1Size = strlen(ha1);
+  if (ha1Size > 32) ha1Size = 32;
+
+  MD5Context ha2Ctx;
+  ha2Ctx.addData(cmd, strlen(cmd));
+  ha2Ctx.addData(":", 1);
+  ha2Ctx.addData(url, urlSize);
+  char ha2Buf[33];
+  ha2Ctx.end(ha2Buf);
+
+  MD5Context responseCtx;
+  responseCtx.addData(ha1, ha1Size);
+  responseCtx.addData(":", 1);
+  responseCtx.addData(nonce, strlen(nonce));
+  responseCtx.addData(":", 1);
+  responseCtx.addData(ha2Buf, 32);
+  responseCtx.end(resultResponse);
+}
+
 char const* Authenticator::computeDigestResponse(char const* cmd,
 						 char const* url) const {
   // The "response" field is computed as:
@@ -99,31 +120,37 @@ char const* Authenticator::computeDigestResponse(char const* cmd,
     strncpy(ha1Buf, password(), 32);
     ha1Buf[32] = '\0'; // just in case
   } else {
-    unsigned const ha1DataLen = strlen(username()) + 1
-      + strlen(realm()) + 1 + strlen(password());
-    unsigned char* ha1Data = new unsigned char[ha1DataLen+1];
-    sprintf((char*)ha1Data, "%s:%s:%s", username(), realm(), password());
-    our_MD5Data(ha1Data, ha1DataLen, ha1Buf);
-    delete[] ha1Data;
+    computeHA1(username(), realm(), password(), ha1Buf);
   }
 
-  unsigned const ha2DataLen = strlen(cmd) + 1 + strlen(url);
-  unsigned char* ha2Data = new unsigned char[ha2DataLen+1];
-  sprintf((char*)ha2Data, "%s:%s", cmd, url);
-  char ha2Buf[33];
-  our_MD5Data(ha2Data, ha2DataLen, ha2Buf);
-  delete[] ha2Data;
-
-  unsigned const digestDataLen
-    = 32 + 1 + strlen(nonce()) + 1 + 32;
-  unsigned char* digestData = new unsigned char[digestDataLen+1];
-  sprintf((char*)digestData, "%s:%s:%s",
-          ha1Buf, nonce(), ha2Buf);
-  char const* result = our_MD5Data(digestData, digestDataLen, NULL);
-  delete[] digestData;
+  char* result = new char[33];
+  computeHA2AndResponse(ha1Buf, nonce(), cmd, url, strlen(url), result);
   return result;
 }
 
+void Authenticator::computeHA1(char const* username, char const* realm, char const* password, char* resultHA1) {
+  MD5Context ctx;
+  ctx.addData(username, strlen(username));
+  ctx.addData(":", 1);
+  ctx.addData(realm, strlen(realm));
+  ctx.addData(":", 1);
+  ctx.addData(password, strlen(password));
+  ctx.end(resultHA1);
+}
+
+Boolean Authenticator::responseIsValid(char const* ha1, char const* nonce, char const* cmd,
+				       char const* url, unsigned urlSize, char const* response, unsigned responseSize) {
+  if (responseSize != 32) return False;
+
+  char ourResponse[33];
+  computeHA2AndResponse(ha1, nonce, cmd, url, urlSize, ourResponse);
+
+  // Compare every char, so that the time taken doesn't reveal how much of "response" was correct:
+  unsigned char diff = 0;
+  for (unsigned i = 0; i < 32; ++i) diff |= (unsigned char)(ourResponse[i] ^ response[i]);
+  return diff == 0;
+}
+
 void Authenticator::reclaimDigestResponse(char const* responseStr) const {
   delete[](char*)responseStr;
 }
@@ -30,8 +30,16 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 
 FileSink::FileSink(UsageEnvironment& env, FILE* fid, unsigned bufferSize,
 		   char const* perFrameFileNamePrefix)
-  : MediaSink(env), fOutFid(fid), fBufferSize(bufferSize), fSamePresentationTimeCounter(0) {
+  : MediaSink(env), fOutFid(fid), fWriter(NULL), fBufferSize(bufferSize), fSamePresentationTimeCounter(0),
+    fSegmentDuration(0), fMaxSegmentSize(0), fIndexFid(NULL), fSegmentFileName(NULL), fSegmentElapsedTime(0.0),
+    fNumSegmentFiles(0), fNextOutFid(NULL), fNextSegmentFileTask(NULL),
+    fOldWriter(NULL), fOldOutFid(NULL), fOldSegmentFileTask(NULL) {
   fBuffer = new unsigned char[bufferSize];
+  if (fid != NULL) {
+    // Write our file in large blocks, from the event loop.  (But if we're writing to 'stdout' - e.g., a pipe to a player -
+    // then don't hold back partially-filled blocks.)
+    fWriter = new BufferedFileWriter(env, fid, 256*1024, 16*1024*1024, fid == stdout ? 0 : 500);
+  }
   if (perFrameFileNamePrefix != NULL) {
     fPerFrameFileNamePrefix = strDup(perFrameFileNamePrefix);
     fPerFrameFileNameBuffer = new char[strlen(perFrameFileNamePrefix) + 100];
@@ -43,9 +51,25 @@ FileSink::FileSink(UsageEnvironment& env, FILE* fid, unsigned bufferSize,
 }
 
 FileSink::~FileSink() {
+  if (isSegmenting()) {
+    if (fOutFid != NULL) endSegment();
+    closeOldSegmentFile();
+    envir().taskScheduler().unscheduleDelayedTask(fNextSegmentFileTask);
+    if (fNextOutFid != NULL) {
+      // We opened a file for a segment that never began, so remove it:
+      fclose(fNextOutFid);
+      char* fileName = segmentFileName(fNumSegmentFiles-1);
+      remove(fileName);
+      delete[] fileName;
+    }
+    fclose(fIndexFid);
+  }
+  delete[] fSegmentFileName;
+
   delete[] fPerFrameFileNameBuffer;
   delete[] fPerFrameFileNamePrefix;
   delete[] fBuffer;
+  delete fWriter; // writes any remaining data
   if (fOutFid != NULL) fclose(fOutFid);
 }
 
@@ -71,6 +95,38 @@ FileSink* FileSink::createNew(UsageEnvironment& env, char const* fileName,
   return NULL;
 }
 
+Boolean FileSink::setSegmentation(unsigned segmentDuration, unsigned maxSegmentSize) {
+  if (fPerFrameFileNameBuffer == NULL) {
+    envir().setResultMsg("FileSink::setSegmentation(): The sink was not created with \"oneFilePerFrame\" == True");
+    return False;
+  }
+  if (segmentDuration == 0 && maxSegmentSize == 0) {
+    envir().setResultMsg("FileSink::setSegmentation(): Neither a segment duration nor a maximum segment size was given");
+    return False;
+  }
+
+  char* indexFileName = new char[strlen(fPerFrameFileNamePrefix) + 10];
+  sprintf(indexFileName, "%s.index", fPerFrameFileNamePrefix);
+  fIndexFid = OpenOutputFile(envir(), indexFileName);
+  delete[] indexFileName;
+  if (fIndexFid == NULL) return False;
+
+  // From now on, we no longer write each frame to a separate file:
+  delete[] fPerFrameFileNameBuffer; fPerFrameFileNameBuffer = NULL;
+  fSegmentDuration = segmentDuration;
+  fMaxSegmentSize = maxSegmentSize;
+
+  openNextSegmentFile(); // ready for the first frame
+  return True;
+}
+
+Boolean FileSink::frameCanBeginSegment(unsigned char const* /*frame*/, unsigned /*frameSize*/) {
+  return True;
+}
+
+void FileSink::segmentHasBegun() {
+}
+
 Boolean FileSink::continuePlaying() {
   if (fSource == NULL) return False;
 
@@ -86,6 +142,10 @@ void FileSink::afterGettingFrame(void* clientData, unsigned frameSize,
 				 struct timeval presentationTime,
 				 unsigned /*durationInMicroseconds*/) {
   FileSink* sink = (FileSink*)clientData;
+  if (sink->isSegmenting()) {
+    // Decide (before any subclass adds data for this frame) whether this frame begins a new segment:
+    sink->checkForNewSegment(frameSize, presentationTime);
+  }
   sink->afterGettingFrame(frameSize, numTruncatedBytes, presentationTime);
 }
 
@@ -120,7 +180,11 @@ void FileSink::addData(unsigned char const* data, unsigned dataSize,
   if (!packetIsLost)
 #endif
   if (fOutFid != NULL && data != NULL) {
-    fwrite(data, 1, dataSize, fOutFid);
+    if (fWriter != NULL) {
+      fWriter->write(data, dataSize);
+    } else {
+      fwrite(data, 1, dataSize, fOutFid); // we're writing a separate file for each frame
+    }
   }
 }
 
@@ -135,7 +199,7 @@ void FileSink::afterGettingFrame(unsigned frameSize,
   }
   addData(fBuffer, frameSize, presentationTime);
 
-  if (fOutFid == NULL || fflush(fOutFid) == EOF) {
+  if (fOutFid == NULL || (fWriter != NULL ? fWriter->hasFailed() : fflush(fOutFid) == EOF)) {
     // The output file has closed.  Handle this the same way as if the input source had closed:
     if (fSource != NULL) fSource->stopGettingFrames();
     onSourceClosure();
@@ -149,3 +213,96 @@ void FileSink::afterGettingFrame(unsigned frameSize,
   // Then try getting the next frame:
   continuePlaying();
 }
+
+char* FileSink::segmentFileName(unsigned segmentNumber) const {
+  char* fileName = new char[strlen(fPerFrameFileNamePrefix) + 20];
+  sprintf(fileName, "%s-%05u", fPerFrameFileNamePrefix, segmentNumber);
+  return fileName;
+}
+
+void FileSink::checkForNewSegment(unsigned frameSize, struct timeval presentationTime) {
+  if (fOutFid == NULL) {
+    // This is our first frame:
+    beginSegment(presentationTime);
+    return;
+  }
+
+  // Update the segment's duration.  (We ignore presentation times that go backwards - e.g., when RTCP synchronization
+  // begins - so that these don't affect the duration.)
+  double deltaTime = (presentationTime.tv_sec - fLastPresentationTime.tv_sec)
+    + (presentationTime.tv_usec - fLastPresentationTime.tv_usec)/1000000.0;
+  if (deltaTime > 0.0) fSegmentElapsedTime += deltaTime;
+  fLastPresentationTime = presentationTime;
+
+  // We normally begin a new segment only at a frame that can begin one (e.g., a key frame), but if we've waited too long
+  // for such a frame, we begin a new segment anyway:
+  int64_t const newSegmentSize = fWriter->position() + frameSize;
+  Boolean limitReached
+    = (fSegmentDuration > 0 && fSegmentElapsedTime >= fSegmentDuration - 0.01/*allow for rounding*/)
+    || (fMaxSegmentSize > 0 && newSegmentSize > fMaxSegmentSize);
+  if (!limitReached) return;
+
+  Boolean mustBeginNewSegment
+    = (fSegmentDuration > 0 && fSegmentElapsedTime >= 3*fSegmentDuration)
+    || (fMaxSegmentSize > 0 && newSegmentSize > 2*(int64_t)fMaxSegmentSize);
+  if (mustBeginNewSegment || frameCanBeginSegment(fBuffer, frameSize)) {
+    endSegment();
+    beginSegment(presentationTime);
+  }
+}
+
+void FileSink::beginSegment(struct timeval presentationTime) {
+  if (fNextOutFid == NULL) openNextSegmentFile(); // if it wasn't opened ahead of time
+  fOutFid = fNextOutFid; fNextOutFid = NULL;
+  delete[] fSegmentFileName; fSegmentFileName = segmentFileName(fNumSegmentFiles-1);
+  if (fOutFid == NULL) return; // we couldn't open the file; this will cause us to stop
+
+  fWriter = new BufferedFileWriter(envir(), fOutFid);
+  fSegmentStartTime = fLastPresentationTime = presentationTime;
+  fSegmentElapsedTime = 0.0;
+
+  // Open the file for the next segment now (but after we've handled the current frame):
+  envir().taskScheduler().unscheduleDelayedTask(fNextSegmentFileTask);
+  fNextSegmentFileTask = envir().taskScheduler().scheduleDelayedTask(0, (TaskFunc*)openNextSegmentFileTask, this);
+
+  segmentHasBegun();
+}
+
+void FileSink::endSegment() {
+  fprintf(fIndexFid, "%s %lu.%06lu %.3f %lu\n", fSegmentFileName,
+	  (unsigned long)fSegmentStartTime.tv_sec, (unsigned long)fSegmentStartTime.tv_usec, fSegmentElapsedTime,
+	  (unsigned long)fWriter->position());
+  fflush(fIndexFid);
+
+  // Close the segment's file later, so that we don't delay the current frame:
+  closeOldSegmentFile(); // if it's still around
+  fOldWriter = fWriter; fWriter = NULL;
+  fOldOutFid = fOutFid; fOutFid = NULL;
+  fOldSegmentFileTask = envir().taskScheduler().scheduleDelayedTask(0, (TaskFunc*)closeOldSegmentFileTask, this);
+}
+
+void FileSink::openNextSegmentFileTask(void* clientData) {
+  FileSink* sink = (FileSink*)clientData;
+  sink->fNextSegmentFileTask = NULL;
+  sink->openNextSegmentFile();
+}
+
+void FileSink::openNextSegmentFile() {
+  if (fNextOutFid != NULL) return; // already open
+
+  char* fileName = segmentFileName(fNumSegmentFiles++);
+  fNextOutFid = OpenOutputFile(envir(), fileName);
+  delete[] fileName;
+}
+
+void FileSink::closeOldSegmentFileTask(void* clientData) {
+  FileSink* sink = (FileSink*)clientData;
+  sink->fOldSegmentFileTask = NULL;
+  sink->closeOldSegmentFile();
+}
+
+void FileSink::closeOldSegmentFile() {
+  envir().taskScheduler().unscheduleDelayedTask(fOldSegmentFileTask);
+  delete fOldWriter; fOldWriter = NULL; // writes any remaining data
+  if (fOldOutFid != NULL) { fclose(fOldOutFid); fOldOutFid = NULL; }
+}
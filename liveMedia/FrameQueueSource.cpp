@@ -0,0 +1,303 @@
+/**********
+This library is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the
+Free Software Foundation; either version 2.1 of the License, or (at your
+option) any later version. (See <http://www.gnu.org/copyleft/lesser.html>.)
+
+This library is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this library; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+**********/
+// "liveMedia"
+// Copyright (c) 1996-2014 Live Networks, Inc.  All rights reserved.
+// A source that delivers frames that are 'pushed' into it - from any thread - e.g., by an encoder or capture thread.
+// Implementation
+
+#include "FrameQueueSource.hh"
+#include <string.h>
+
+////////// Atomic operations //////////
+// (used for the data that's shared between "pushFrame()" (called from any thread) and the event loop)
+
+#if defined(__GNUC__)
+#define ATOMIC_COMPARE_AND_SWAP_POINTER(ptr, oldValue, newValue) __sync_bool_compare_and_swap((ptr), (oldValue), (newValue))
+#define ATOMIC_COMPARE_AND_SWAP_UNSIGNED(ptr, oldValue, newValue) __sync_bool_compare_and_swap((ptr), (oldValue), (newValue))
+#define ATOMIC_INCREMENT(ptr) __sync_add_and_fetch((ptr), 1)
+#define ATOMIC_DECREMENT(ptr) __sync_sub_and_fetch((ptr), 1)
+#elif defined(__WIN32__) || defined(_WIN32)
+#define ATOMIC_COMPARE_AND_SWAP_POINTER(ptr, oldValue, newValue) \
+  (InterlockedCompareExchangePointer((PVOID volatile*)(ptr), (newValue), (oldValue)) == (PVOID)(oldValue))
+#define ATOMIC_COMPARE_AND_SWAP_UNSIGNED(ptr, oldValue, newValue) \
+  (InterlockedCompareExchange((LONG volatile*)(ptr), (LONG)(newValue), (LONG)(oldValue)) == (LONG)(oldValue))
+#define ATOMIC_INCREMENT(ptr) (unsigned)InterlockedIncrement((LONG volatile*)(ptr))
+#define ATOMIC_DECREMENT(ptr) (unsigned)InterlockedDecrement((LONG volatile*)(ptr))
+#else
+// We don't know how to do atomic operations on this system, so fall back to ordinary (non-atomic) ones.
+// (In this case, "pushFrame()" must be called only from the event loop's thread.)
+#define ATOMIC_COMPARE_AND_SWAP_POINTER(ptr, oldValue, newValue) (*(ptr) == (oldValue) ? (*(ptr) = (newValue), True) : False)
+#define ATOMIC_COMPARE_AND_SWAP_UNSIGNED(ptr, oldValue, newValue) (*(ptr) == (oldValue) ? (*(ptr) = (newValue), True) : False)
+#define ATOMIC_INCREMENT(ptr) (++*(ptr))
+#define ATOMIC_DECREMENT(ptr) (--*(ptr))
+#endif
+
+// Atomically removes - and returns - all entries from a lock-free stack:
+template <class T> static T* takeAll(T* volatile& head) {
+  T* result;
+  do {
+    result = head;
+  } while (result != NULL && !ATOMIC_COMPARE_AND_SWAP_POINTER(&head, result, (T*)NULL));
+  return result;
+}
+
+
+////////// FrameQueueReadyList //////////
+
+// All "FrameQueueSource"s (in the same environment) share a single 'event trigger' (so that there's no limit on their
+// number).  When a frame is pushed into a source, the source is added to a (lock-free) list of 'ready' sources, and - if
+// this list was empty - the event is triggered.  The event handler then delivers frames from each 'ready' source.
+
+class FrameQueueReadyList {
+public:
+  static FrameQueueReadyList* ourList(UsageEnvironment& env);
+      // returns NULL if we couldn't create an 'event trigger'
+  void release(); // called by each source that called "ourList()"
+
+  void noteReady(FrameQueueSource* source); // may be called from any thread
+  void removeSource(FrameQueueSource* source); // called (from the event loop) when "source" is being deleted
+
+private:
+  FrameQueueReadyList(UsageEnvironment& env, EventTriggerId triggerId);
+  ~FrameQueueReadyList();
+
+  void takeReadySources();
+  static void handleReadySources(void* clientData);
+  void handleReadySources1();
+
+private:
+  UsageEnvironment& fEnv;
+  EventTriggerId fTriggerId;
+  unsigned fReferenceCount;
+  FrameQueueSource* volatile fReadySources; // a lock-free stack, pushed from any thread
+  FrameQueueSource* fPendingSources; // ready sources (oldest first) that we've taken from "fReadySources", but not yet handled
+};
+
+FrameQueueReadyList* FrameQueueReadyList::ourList(UsageEnvironment& env) {
+  _Tables* ourTables = _Tables::getOurTables(env);
+  if (ourTables->frameQueueReadyList == NULL) {
+    EventTriggerId triggerId = env.taskScheduler().createEventTrigger(handleReadySources);
+    if (triggerId == 0) {
+      ourTables->reclaimIfPossible();
+      return NULL;
+    }
+    ourTables->frameQueueReadyList = new FrameQueueReadyList(env, triggerId);
+  }
+
+  FrameQueueReadyList* list = (FrameQueueReadyList*)(ourTables->frameQueueReadyList);
+  ++list->fReferenceCount;
+  return list;
+}
+
+void FrameQueueReadyList::release() {
+  if (--fReferenceCount > 0) return;
+
+  _Tables* ourTables = _Tables::getOurTables(fEnv);
+  ourTables->frameQueueReadyList = NULL;
+  ourTables->reclaimIfPossible();
+  delete this;
+}
+
+FrameQueueReadyList::FrameQueueReadyList(UsageEnvironment& env, EventTriggerId triggerId)
+  : fEnv(env), fTriggerId(triggerId), fReferenceCount(0), fReadySources(NULL), fPendingSources(NULL) {
+}
+
+FrameQueueReadyList::~FrameQueueReadyList() {
+  fEnv.taskScheduler().deleteEventTrigger(fTriggerId);
+}
+
+void FrameQueueReadyList::noteReady(FrameQueueSource* source) {
+  // Add "source" to our list - unless it's already there (or about to be):
+  if (!ATOMIC_COMPARE_AND_SWAP_UNSIGNED(&source->fIsReady, 0U, 1U)) return;
+
+  FrameQueueSource* oldHead;
+  do {
+    oldHead = fReadySources;
+    source->fNextReady = oldHead;
+  } while (!ATOMIC_COMPARE_AND_SWAP_POINTER(&fReadySources, oldHead, source));
+
+  // If the list had been empty, then our event handler hasn't yet been triggered for it.
+  // (Note that it's OK to call "triggerEvent()" from several threads at once here, because the "clientData" is always the same.)
+  if (oldHead == NULL) fEnv.taskScheduler().triggerEvent(fTriggerId, this);
+}
+
+void FrameQueueReadyList::removeSource(FrameQueueSource* source) {
+  // Because "source" might be in "fReadySources" (a lock-free stack, from which we can't remove a single entry), we first move
+  // all of its entries to "fPendingSources":
+  takeReadySources();
+
+  for (FrameQueueSource** ptr = &fPendingSources; *ptr != NULL; ptr = &(*ptr)->fNextReady) {
+    if (*ptr == source) {
+      *ptr = source->fNextReady;
+      break;
+    }
+  }
+
+  // If other sources remain pending, then make sure that they get handled:
+  if (fPendingSources != NULL) fEnv.taskScheduler().triggerEvent(fTriggerId, this);
+}
+
+void FrameQueueReadyList::takeReadySources() {
+  FrameQueueSource* newSources = takeAll(fReadySources);
+  if (newSources == NULL) return;
+
+  // "newSources" is in reverse order (most recently ready first), so reverse it, then append it to "fPendingSources":
+  FrameQueueSource* reversed = NULL;
+  while (newSources != NULL) {
+    FrameQueueSource* source = newSources;
+    newSources = source->fNextReady;
+    source->fNextReady = reversed;
+    reversed = source;
+  }
+
+  FrameQueueSource** ptr = &fPendingSources;
+  while (*ptr != NULL) ptr = &(*ptr)->fNextReady;
+  *ptr = reversed;
+}
+
+void FrameQueueReadyList::handleReadySources(void* clientData) {
+  ((FrameQueueReadyList*)clientData)->handleReadySources1();
+}
+
+void FrameQueueReadyList::handleReadySources1() {
+  ++fReferenceCount; // in case the last of our sources gets closed while we're handling it
+
+  takeReadySources();
+  while (fPendingSources != NULL) {
+    FrameQueueSource* source = fPendingSources;
+    fPendingSources = source->fNextReady;
+    source->fNextReady = NULL;
+
+    // Clear the source's 'ready' flag before checking its queue, so that any frame that's pushed after this will make it
+    // 'ready' again:
+    ATOMIC_COMPARE_AND_SWAP_UNSIGNED(&source->fIsReady, 1U, 0U);
+    source->deliverFrame(); // Note: This might close sources (which then remove themselves from "fPendingSources")
+  }
+
+  release();
+}
+
+
+////////// FrameQueueSource //////////
+
+struct FrameQueueSource::QueuedFrame {
+  QueuedFrame* next;
+  unsigned frameSize;
+  struct timeval presentationTime;
+  unsigned durationInMicroseconds;
+
+  unsigned char* data() { return (unsigned char*)(this + 1); } // the frame data follows us, in the same allocation
+};
+
+FrameQueueSource* FrameQueueSource::createNew(UsageEnvironment& env, unsigned maxNumQueuedFrames) {
+  FrameQueueReadyList* readyList = FrameQueueReadyList::ourList(env);
+  if (readyList == NULL) {
+    env.setResultMsg("FrameQueueSource::createNew(): Failed to create an 'event trigger'");
+    return NULL;
+  }
+
+  return new FrameQueueSource(env, readyList, maxNumQueuedFrames);
+}
+
+FrameQueueSource::FrameQueueSource(UsageEnvironment& env, FrameQueueReadyList* readyList, unsigned maxNumQueuedFrames)
+  : FramedSource(env), fReadyList(readyList), fMaxNumQueuedFrames(maxNumQueuedFrames),
+    fIncomingFrames(NULL), fNumQueuedFrames(0), fNumDroppedFrames(0), fIsReady(0), fNextReady(NULL),
+    fOutgoingFrames(NULL) {
+}
+
+FrameQueueSource::~FrameQueueSource() {
+  fReadyList->removeSource(this);
+  fReadyList->release();
+
+  // Delete any frames that were never delivered:
+  QueuedFrame* frames[2] = { fOutgoingFrames, takeAll(fIncomingFrames) };
+  for (unsigned i = 0; i < 2; ++i) {
+    while (frames[i] != NULL) {
+      QueuedFrame* frame = frames[i];
+      frames[i] = frame->next;
+      delete[] (unsigned char*)frame;
+    }
+  }
+}
+
+Boolean FrameQueueSource::pushFrame(unsigned char const* frame, unsigned frameSize,
+				    struct timeval const& presentationTime, unsigned durationInMicroseconds) {
+  // Note: This function may be called from any thread.
+  if (ATOMIC_INCREMENT(&fNumQueuedFrames) > fMaxNumQueuedFrames) {
+    // Our queue is full, so drop this frame:
+    ATOMIC_DECREMENT(&fNumQueuedFrames);
+    ATOMIC_INCREMENT(&fNumDroppedFrames);
+    return False;
+  }
+
+  QueuedFrame* queuedFrame = (QueuedFrame*)(new unsigned char[sizeof (QueuedFrame) + frameSize]);
+  queuedFrame->frameSize = frameSize;
+  queuedFrame->presentationTime = presentationTime;
+  queuedFrame->durationInMicroseconds = durationInMicroseconds;
+  memmove(queuedFrame->data(), frame, frameSize);
+
+  QueuedFrame* oldHead;
+  do {
+    oldHead = fIncomingFrames;
+    queuedFrame->next = oldHead;
+  } while (!ATOMIC_COMPARE_AND_SWAP_POINTER(&fIncomingFrames, oldHead, queuedFrame));
+
+  fReadyList->noteReady(this);
+  return True;
+}
+
+void FrameQueueSource::doGetNextFrame() {
+  // Deliver a frame now, if we have one.  Otherwise, "deliverFrame()" will be called (from the event loop) once a frame
+  // gets pushed:
+  deliverFrame();
+}
+
+void FrameQueueSource::deliverFrame() {
+  if (!isCurrentlyAwaitingData()) return; // we're not ready for the data yet
+
+  if (fOutgoingFrames == NULL) {
+    // Take any newly-pushed frames (which are in reverse order):
+    QueuedFrame* newFrames = takeAll(fIncomingFrames);
+    while (newFrames != NULL) {
+      QueuedFrame* frame = newFrames;
+      newFrames = frame->next;
+      frame->next = fOutgoingFrames;
+      fOutgoingFrames = frame;
+    }
+    if (fOutgoingFrames == NULL) return; // no frame is available yet
+  }
+
+  QueuedFrame* frame = fOutgoingFrames;
+  fOutgoingFrames = frame->next;
+
+  // Deliver the frame:
+  if (frame->frameSize > fMaxSize) {
+    fFrameSize = fMaxSize;
+    fNumTruncatedBytes = frame->frameSize - fMaxSize;
+  } else {
+    fFrameSize = frame->frameSize;
+    fNumTruncatedBytes = 0;
+  }
+  memmove(fTo, frame->data(), fFrameSize);
+  fPresentationTime = frame->presentationTime;
+  fDurationInMicroseconds = frame->durationInMicroseconds;
+
+  delete[] (unsigned char*)frame;
+  ATOMIC_DECREMENT(&fNumQueuedFrames);
+
+  // After delivering the data, inform the reader that it is now available:
+  FramedSource::afterGetting(this);
+}
@@ -0,0 +1,200 @@
+/**********
+This library is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the
+Free Software Foundation; either version 2.1 of the License, or (at your
+option) any later version. (See <http://www.gnu.org/copyleft/lesser.html>.)
+
+This library is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this library; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+**********/
+// "liveMedia"
+// Copyright (c) 1996-2014 Live Networks, Inc.  All rights reserved.
+// A cache of the video frames since (and including) the most recent key frame ("GOP cache").
+// Implementation
+
+#include "GOPCache.hh"
+#include <string.h>
+
+enum { GOP_CACHE_H264, GOP_CACHE_H265, GOP_CACHE_MPEG4 };
+
+GOPCache* GOPCache::createNew(char const* codecName, unsigned maxCacheSize) {
+  if (codecName == NULL) return NULL;
+
+  int codecType;
+  if (strcmp(codecName, "H264") == 0) {
+    codecType = GOP_CACHE_H264;
+  } else if (strcmp(codecName, "H265") == 0) {
+    codecType = GOP_CACHE_H265;
+  } else if (strcmp(codecName, "MP4V-ES") == 0) {
+    codecType = GOP_CACHE_MPEG4;
+  } else {
+    return NULL;
+  }
+
+  return new GOPCache(codecType, maxCacheSize);
+}
+
+GOPCache::GOPCache(int codecType, unsigned maxCacheSize)
+  : fCodecType(codecType), fMaxCacheSize(maxCacheSize),
+    fBuffer(NULL), fBufferSize(0), fNumBytesUsed(0),
+    fFrames(NULL), fNumFrames(0), fMaxNumFrames(0), fNumPresentationTimes(0),
+    fGeneration(0), fPrevFrameWasKeyFrame(False), fIsCaching(False) {
+}
+
+GOPCache::~GOPCache() {
+  delete[] fBuffer;
+  delete[] fFrames;
+}
+
+Boolean GOPCache::addFrame(unsigned char const* frame, unsigned frameSize, struct timeval presentationTime) {
+  Boolean beginsGOP = False;
+  if (!isNeutralFrame(frame, frameSize)) { // neutral frames (e.g., SEI or access unit delimiters) are just cached, if we're caching
+    Boolean isKey = isKeyFrame(frame, frameSize);
+    beginsGOP = isKey && !fPrevFrameWasKeyFrame;
+    if (beginsGOP) {
+      // This frame begins a new GOP (perhaps preceded by parameter sets), so discard the old one, and start caching again:
+      reset();
+      fIsCaching = True;
+    }
+    fPrevFrameWasKeyFrame = isKey;
+  }
+  if (!fIsCaching) return beginsGOP;
+
+  if (fNumBytesUsed + frameSize > fMaxCacheSize) {
+    // This GOP is too large for us to cache.  Stop caching, until the next key frame:
+    reset();
+    return beginsGOP;
+  }
+
+  // Make sure that we have enough space for the new frame (and its record):
+  if (fNumBytesUsed + frameSize > fBufferSize) {
+    unsigned newBufferSize = fBufferSize == 0 ? 100000 : 2*fBufferSize;
+    if (newBufferSize < fNumBytesUsed + frameSize) newBufferSize = fNumBytesUsed + frameSize;
+    if (newBufferSize > fMaxCacheSize) newBufferSize = fMaxCacheSize;
+
+    unsigned char* newBuffer = new unsigned char[newBufferSize];
+    memmove(newBuffer, fBuffer, fNumBytesUsed);
+    delete[] fBuffer; fBuffer = newBuffer;
+    fBufferSize = newBufferSize;
+  }
+  if (fNumFrames == fMaxNumFrames) {
+    unsigned newMaxNumFrames = fMaxNumFrames == 0 ? 64 : 2*fMaxNumFrames;
+
+    CachedFrame* newFrames = new CachedFrame[newMaxNumFrames];
+    for (unsigned i = 0; i < fNumFrames; ++i) newFrames[i] = fFrames[i];
+    delete[] fFrames; fFrames = newFrames;
+    fMaxNumFrames = newMaxNumFrames;
+  }
+
+  if (fNumFrames == 0
+      || presentationTime.tv_sec != fFrames[fNumFrames-1].presentationTime.tv_sec
+      || presentationTime.tv_usec != fFrames[fNumFrames-1].presentationTime.tv_usec) {
+    ++fNumPresentationTimes;
+  }
+
+  CachedFrame& f = fFrames[fNumFrames++];
+  f.offset = fNumBytesUsed;
+  f.size = frameSize;
+  f.presentationTime = presentationTime;
+  f.presentationTimeIndex = fNumPresentationTimes - 1;
+
+  memmove(&fBuffer[fNumBytesUsed], frame, frameSize);
+  fNumBytesUsed += frameSize;
+  return beginsGOP;
+}
+
+void GOPCache::reset() {
+  if (fNumFrames > 0) ++fGeneration;
+  fNumFrames = 0;
+  fNumBytesUsed = 0;
+  fNumPresentationTimes = 0;
+  fIsCaching = False;
+}
+
+unsigned GOPCache::getFrame(unsigned index, unsigned char* to, unsigned maxSize, unsigned& numTruncatedBytes,
+			    struct timeval& presentationTime, unsigned& durationInMicroseconds) const {
+  if (index >= fNumFrames) { // shouldn't happen
+    numTruncatedBytes = durationInMicroseconds = 0;
+    return 0;
+  }
+  CachedFrame const& f = fFrames[index];
+
+  unsigned frameSize = f.size;
+  if (frameSize > maxSize) {
+    numTruncatedBytes = frameSize - maxSize;
+    frameSize = maxSize;
+  } else {
+    numTruncatedBytes = 0;
+  }
+  memmove(to, &fBuffer[f.offset], frameSize);
+
+  // Rewrite the presentation time, counting back from the most recently cached frame:
+  unsigned adjustment = (fNumPresentationTimes - 1 - f.presentationTimeIndex)*GOP_CACHE_BURST_FRAME_INTERVAL;
+  presentationTime = fFrames[fNumFrames-1].presentationTime;
+  presentationTime.tv_sec -= adjustment/1000000;
+  if ((unsigned)presentationTime.tv_usec < adjustment%1000000) {
+    presentationTime.tv_usec += 1000000;
+    --presentationTime.tv_sec;
+  }
+  presentationTime.tv_usec -= adjustment%1000000;
+
+  // Frames that share a presentation time with the next cached frame are delivered immediately:
+  durationInMicroseconds = index+1 < fNumFrames && fFrames[index+1].presentationTimeIndex == f.presentationTimeIndex
+    ? 0 : GOP_CACHE_BURST_FRAME_INTERVAL;
+
+  return frameSize;
+}
+
+Boolean GOPCache::isKeyFrame(unsigned char const* frame, unsigned frameSize) const {
+  if (fCodecType == GOP_CACHE_MPEG4) {
+    // Look at each start code in the frame, up until the first VOP.  Configuration headers
+    // (Visual Object Sequence, Visual Object, Video Object Layer, or Group of VOP) count as part of a key frame:
+    for (unsigned i = 0; i + 4 < frameSize; ++i) {
+      if (frame[i] != 0 || frame[i+1] != 0 || frame[i+2] != 1) continue;
+
+      u_int8_t startCode = frame[i+3];
+      if (startCode == 0xB6) { // VOP; check "vop_coding_type" (0 means I-VOP):
+	return (frame[i+4]>>6) == 0;
+      } else if (startCode == 0xB0 || startCode == 0xB3 || startCode == 0xB5 || startCode <= 0x2F) {
+	return True;
+      }
+    }
+    return False;
+  }
+
+  int nal_unit_type = nalUnitType(frame, frameSize);
+  if (fCodecType == GOP_CACHE_H264) {
+    return nal_unit_type == 5/*IDR*/ || nal_unit_type == 7/*SPS*/ || nal_unit_type == 8/*PPS*/;
+  } else { // H.265
+    return (nal_unit_type >= 16 && nal_unit_type <= 21)/*IRAP*/ || (nal_unit_type >= 32 && nal_unit_type <= 34)/*VPS,SPS,PPS*/;
+  }
+}
+
+Boolean GOPCache::isNeutralFrame(unsigned char const* frame, unsigned frameSize) const {
+  // Frames that may appear either within a GOP or just before its key frame - and so neither begin a GOP, nor
+  // separate a key frame from its parameter sets:
+  if (fCodecType == GOP_CACHE_MPEG4) return False;
+
+  int nal_unit_type = nalUnitType(frame, frameSize);
+  if (fCodecType == GOP_CACHE_H264) {
+    return nal_unit_type == 6/*SEI*/ || nal_unit_type == 9/*AUD*/;
+  } else { // H.265
+    return nal_unit_type == 35/*AUD*/ || nal_unit_type == 39/*prefix SEI*/ || nal_unit_type == 40/*suffix SEI*/;
+  }
+}
+
+int GOPCache::nalUnitType(unsigned char const* frame, unsigned frameSize) const {
+  // H.264 or H.265: Skip over any start code, then look at the NAL unit type:
+  unsigned i = 0;
+  while (i < frameSize && i < 3 && frame[i] == 0) ++i;
+  if (i >= 2 && i < frameSize && frame[i] == 1) ++i; else i = 0;
+  if (i >= frameSize) return -1;
+
+  return fCodecType == GOP_CACHE_H264 ? (frame[i]&0x1F) : ((frame[i]&0x7E)>>1);
+}
@@ -33,70 +33,17 @@ H264VideoFileServerMediaSubsession::createNew(UsageEnvironment& env,
 
 H264VideoFileServerMediaSubsession::H264VideoFileServerMediaSubsession(UsageEnvironment& env,
 								       char const* fileName, Boolean reuseFirstSource)
-  : FileServerMediaSubsession(env, fileName, reuseFirstSource),
-    fAuxSDPLine(NULL), fDoneFlag(0), fDummyRTPSink(NULL) {
+  : FileServerMediaSubsession(env, fileName, reuseFirstSource) {
 }
 
 H264VideoFileServerMediaSubsession::~H264VideoFileServerMediaSubsession() {
-  delete[] fAuxSDPLine;
 }
 
-static void afterPlayingDummy(void* clientData) {
-  H264VideoFileServerMediaSubsession* subsess = (H264VideoFileServerMediaSubsession*)clientData;
-  subsess->afterPlayingDummy1();
-}
-
-void H264VideoFileServerMediaSubsession::afterPlayingDummy1() {
-  // Unschedule any pending 'checking' task:
-  envir().taskScheduler().unscheduleDelayedTask(nextTask());
-  // Signal the event loop that we're done:
-  setDoneFlag();
-}
-
-static void checkForAuxSDPLine(void* clientData) {
-  H264VideoFileServerMediaSubsession* subsess = (H264VideoFileServerMediaSubsession*)clientData;
-  subsess->checkForAuxSDPLine1();
-}
-
-void H264VideoFileServerMediaSubsession::checkForAuxSDPLine1() {
-  char const* dasl;
-
-  if (fAuxSDPLine != NULL) {
-    // Signal the event loop that we're done:
-    setDoneFlag();
-  } else if (fDummyRTPSink != NULL && (dasl = fDummyRTPSink->auxSDPLine()) != NULL) {
-    fAuxSDPLine = strDup(dasl);
-    fDummyRTPSink = NULL;
-
-    // Signal the event loop that we're done:
-    setDoneFlag();
-  } else {
-    // try again after a brief delay:
-    int uSecsToDelay = 100000; // 100 ms
-    nextTask() = envir().taskScheduler().scheduleDelayedTask(uSecsToDelay,
-			      (TaskFunc*)checkForAuxSDPLine, this);
-  }
-}
-
-char const* H264VideoFileServerMediaSubsession::getAuxSDPLine(RTPSink* rtpSink, FramedSource* inputSource) {
-  if (fAuxSDPLine != NULL) return fAuxSDPLine; // it's already been set up (for a previous client)
-
-  if (fDummyRTPSink == NULL) { // we're not already setting it up for another, concurrent stream
-    // Note: For H264 video files, the 'config' information ("profile-level-id" and "sprop-parameter-sets") isn't known
-    // until we start reading the file.  This means that "rtpSink"s "auxSDPLine()" will be NULL initially,
-    // and we need to start reading data from our file until this changes.
-    fDummyRTPSink = rtpSink;
-
-    // Start reading the file:
-    fDummyRTPSink->startPlaying(*inputSource, afterPlayingDummy, this);
-
-    // Check whether the sink's 'auxSDPLine()' is ready:
-    checkForAuxSDPLine(this);
-  }
-
-  envir().taskScheduler().doEventLoop(&fDoneFlag);
-
-  return fAuxSDPLine;
+Boolean H264VideoFileServerMediaSubsession::sdpLinesNeedStreamData() {
+  // Note: For H264 video files, the 'config' information ("profile-level-id" and "sprop-parameter-sets") isn't known
+  // until we start reading the file.  This means that our "RTPSink"s "auxSDPLine()" will be NULL initially,
+  // and we need to start reading data from our file until this changes.
+  return True;
 }
 
 FramedSource* H264VideoFileServerMediaSubsession::createNewStreamSource(unsigned /*clientSessionId*/, unsigned& estBitrate) {
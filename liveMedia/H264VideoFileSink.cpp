@@ -57,3 +57,10 @@ H264VideoFileSink::createNew(UsageEnvironment& env, char const* fileName,
 
   return NULL;
 }
+
+Boolean H264VideoFileSink::frameCanBeginSegment(unsigned char const* frame, unsigned frameSize) {
+  // Begin a new segment only at an IDR picture, or a SPS:
+  if (frameSize == 0) return False;
+  u_int8_t const nal_unit_type = frame[0]&0x1F;
+  return nal_unit_type == 5/*IDR*/ || nal_unit_type == 7/*SPS*/;
+}
@@ -63,3 +63,8 @@ void H264or5VideoFileSink::afterGettingFrame(unsigned frameSize, unsigned numTru
   // Call the parent class to complete the normal file write with the input data:
   FileSink::afterGettingFrame(frameSize, numTruncatedBytes, presentationTime);
 }
+
+void H264or5VideoFileSink::segmentHasBegun() {
+  // Each segment must be playable by itself, so begin it with our "sprop parameter sets" NAL units (if any):
+  fHaveWrittenFirstFrame = False;
+}
@@ -33,71 +33,18 @@ H265VideoFileServerMediaSubsession::createNew(UsageEnvironment& env,
 
 H265VideoFileServerMediaSubsession::H265VideoFileServerMediaSubsession(UsageEnvironment& env,
 								       char const* fileName, Boolean reuseFirstSource)
-  : FileServerMediaSubsession(env, fileName, reuseFirstSource),
-    fAuxSDPLine(NULL), fDoneFlag(0), fDummyRTPSink(NULL) {
+  : FileServerMediaSubsession(env, fileName, reuseFirstSource) {
 }
 
 H265VideoFileServerMediaSubsession::~H265VideoFileServerMediaSubsession() {
-  delete[] fAuxSDPLine;
 }
 
-static void afterPlayingDummy(void* clientData) {
-  H265VideoFileServerMediaSubsession* subsess = (H265VideoFileServerMediaSubsession*)clientData;
-  subsess->afterPlayingDummy1();
-}
-
-void H265VideoFileServerMediaSubsession::afterPlayingDummy1() {
-  // Unschedule any pending 'checking' task:
-  envir().taskScheduler().unscheduleDelayedTask(nextTask());
-  // Signal the event loop that we're done:
-  setDoneFlag();
-}
-
-static void checkForAuxSDPLine(void* clientData) {
-  H265VideoFileServerMediaSubsession* subsess = (H265VideoFileServerMediaSubsession*)clientData;
-  subsess->checkForAuxSDPLine1();
-}
-
-void H265VideoFileServerMediaSubsession::checkForAuxSDPLine1() {
-  char const* dasl;
-
-  if (fAuxSDPLine != NULL) {
-    // Signal the event loop that we're done:
-    setDoneFlag();
-  } else if (fDummyRTPSink != NULL && (dasl = fDummyRTPSink->auxSDPLine()) != NULL) {
-    fAuxSDPLine = strDup(dasl);
-    fDummyRTPSink = NULL;
-
-    // Signal the event loop that we're done:
-    setDoneFlag();
-  } else {
-    // try again after a brief delay:
-    int uSecsToDelay = 100000; // 100 ms
-    nextTask() = envir().taskScheduler().scheduleDelayedTask(uSecsToDelay,
-			      (TaskFunc*)checkForAuxSDPLine, this);
-  }
-}
-
-char const* H265VideoFileServerMediaSubsession::getAuxSDPLine(RTPSink* rtpSink, FramedSource* inputSource) {
-  if (fAuxSDPLine != NULL) return fAuxSDPLine; // it's already been set up (for a previous client)
-
-  if (fDummyRTPSink == NULL) { // we're not already setting it up for another, concurrent stream
-    // Note: For H265 video files, the 'config' information (used for several payload-format
-    // specific parameters in the SDP description) isn't known until we start reading the file.
-    // This means that "rtpSink"s "auxSDPLine()" will be NULL initially,
-    // and we need to start reading data from our file until this changes.
-    fDummyRTPSink = rtpSink;
-
-    // Start reading the file:
-    fDummyRTPSink->startPlaying(*inputSource, afterPlayingDummy, this);
-
-    // Check whether the sink's 'auxSDPLine()' is ready:
-    checkForAuxSDPLine(this);
-  }
-
-  envir().taskScheduler().doEventLoop(&fDoneFlag);
-
-  return fAuxSDPLine;
+Boolean H265VideoFileServerMediaSubsession::sdpLinesNeedStreamData() {
+  // Note: For H265 video files, the 'config' information (used for several payload-format
+  // specific parameters in the SDP description) isn't known until we start reading the file.
+  // This means that our "RTPSink"s "auxSDPLine()" will be NULL initially,
+  // and we need to start reading data from our file until this changes.
+  return True;
 }
 
 FramedSource* H265VideoFileServerMediaSubsession::createNewStreamSource(unsigned /*clientSessionId*/, unsigned& estBitrate) {
@@ -61,3 +61,10 @@ H265VideoFileSink::createNew(UsageEnvironment& env, char const* fileName,
 
   return NULL;
 }
+
+Boolean H265VideoFileSink::frameCanBeginSegment(unsigned char const* frame, unsigned frameSize) {
+  // Begin a new segment only at an IRAP picture, or a VPS or SPS:
+  if (frameSize == 0) return False;
+  u_int8_t const nal_unit_type = (frame[0]&0x7E)>>1;
+  return (nal_unit_type >= 16 && nal_unit_type <= 21)/*IRAP*/ || nal_unit_type == 32/*VPS*/ || nal_unit_type == 33/*SPS*/;
+}
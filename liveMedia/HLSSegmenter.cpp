@@ -0,0 +1,485 @@
+/**********
+This library is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the
+Free Software Foundation; either version 2.1 of the License, or (at your
+option) any later version. (See <http://www.gnu.org/copyleft/lesser.html>.)
+
+This library is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this library; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+**********/
+// "liveMedia"
+// Copyright (c) 1996-2014 Live Networks, Inc.  All rights reserved.
+// A sink that segments a live "ServerMediaSession" into in-memory Transport Stream segments,
+// described by a sliding-window playlist (for Apple's "HTTP Live Streaming" protocol).
+// Implementation
+
+#include "HLSSegmenter.hh"
+#include "MPEG2TransportStreamFromESSource.hh"
+#include "FramedFilter.hh"
+#include "GroupsockHelper.hh" // for "gettimeofday()" and "our_random32()"
+
+#define TRANSPORT_PACKET_SIZE 188
+#define HLS_INITIAL_BUFFER_SIZE 500000
+#define HLS_MIN_READ_SIZE 100000 // the free space that we leave in our buffer before each read
+#define HLS_FORCED_CUT_FACTOR 3 // if we see no PAT for this many target durations, we cut the segment anyway
+
+////////// HLSESInput //////////
+
+// An internal filter that we put in front of each Elementary Stream source before handing it to our multiplexor.
+// It (optionally) prepends a 4-byte 'start code' to each H.264 or H.265 NAL unit (because the multiplexor
+// expects a byte stream), and - unlike other filters - does *not* close its input source when it's closed,
+// because that source belongs to the "ServerMediaSubsession", and gets reclaimed by "deleteStream()".
+
+class HLSESInput: public FramedFilter {
+public:
+  HLSESInput(UsageEnvironment& env, FramedSource* inputSource, Boolean insertStartCodes)
+    : FramedFilter(env, inputSource), fInsertStartCodes(insertStartCodes) {
+  }
+  virtual ~HLSESInput() {
+    detachInputSource();
+  }
+
+private: // redefined virtual functions:
+  virtual void doGetNextFrame();
+
+private:
+  static void afterGettingFrame(void* clientData, unsigned frameSize,
+				unsigned numTruncatedBytes,
+				struct timeval presentationTime,
+				unsigned durationInMicroseconds);
+
+private:
+  Boolean fInsertStartCodes;
+};
+
+void HLSESInput::doGetNextFrame() {
+  unsigned const startCodeSize = fInsertStartCodes ? 4 : 0;
+  if (fMaxSize <= startCodeSize) {
+    // There's no room in the client's buffer even for the start code (this shouldn't happen):
+    fFrameSize = 0;
+    fNumTruncatedBytes = 0;
+    handleClosure(this);
+    return;
+  }
+
+  if (fInsertStartCodes) {
+    fTo[0] = fTo[1] = fTo[2] = 0; fTo[3] = 1;
+  }
+  fInputSource->getNextFrame(fTo + startCodeSize, fMaxSize - startCodeSize,
+			     afterGettingFrame, this,
+			     FramedSource::handleClosure, this);
+}
+
+void HLSESInput::afterGettingFrame(void* clientData, unsigned frameSize,
+				   unsigned numTruncatedBytes,
+				   struct timeval presentationTime,
+				   unsigned durationInMicroseconds) {
+  HLSESInput* source = (HLSESInput*)clientData;
+  source->fFrameSize = frameSize + (source->fInsertStartCodes ? 4 : 0);
+  source->fNumTruncatedBytes = numTruncatedBytes;
+  source->fPresentationTime = presentationTime;
+  source->fDurationInMicroseconds = durationInMicroseconds;
+  FramedSource::afterGetting(source);
+}
+
+
+// Returns the RTP payload format name (e.g., "H264") from a subsession's SDP lines:
+static Boolean getCodecNameFromSDPLines(char const* sdpLines, char* codecName, unsigned codecNameMaxSize) {
+  if (sdpLines == NULL) return False;
+
+  char const* rtpmap = strstr(sdpLines, "a=rtpmap:");
+  if (rtpmap != NULL) {
+    // "a=rtpmap:<payload-type> <name>/<frequency>..."
+    char const* name = strchr(rtpmap, ' ');
+    if (name == NULL) return False;
+    ++name;
+    unsigned i;
+    for (i = 0; i < codecNameMaxSize-1 && name[i] != '/' && name[i] != '\r' && name[i] != '\n' && name[i] != '\0'; ++i) {
+      codecName[i] = name[i];
+    }
+    codecName[i] = '\0';
+    return True;
+  }
+
+  // There's no "a=rtpmap:" line, so the stream must be using a static payload type:
+  unsigned payloadType;
+  char const* mLine = strstr(sdpLines, "m=");
+  if (mLine == NULL || sscanf(mLine, "m=%*s %*u RTP/AVP %u", &payloadType) != 1) return False;
+  char const* staticCodecName
+    = payloadType == 14 ? "MPA" : payloadType == 32 ? "MPV" : payloadType == 33 ? "MP2T" : "";
+  strncpy(codecName, staticCodecName, codecNameMaxSize);
+  codecName[codecNameMaxSize-1] = '\0';
+  return True;
+}
+
+
+////////// HLSSegment //////////
+
+HLSSegment::HLSSegment(unsigned sequenceNumber, u_int8_t* data, unsigned size, double duration)
+  : fNext(NULL), fSequenceNumber(sequenceNumber), fData(data), fSize(size), fDuration(duration),
+    fReferenceCount(1) {
+}
+
+HLSSegment::~HLSSegment() {
+  delete[] fData;
+}
+
+void HLSSegment::decrementReferenceCount() {
+  if (fReferenceCount > 0) --fReferenceCount;
+  if (fReferenceCount == 0) delete this;
+}
+
+
+////////// HLSSegmenter //////////
+
+HLSSegmenter* HLSSegmenter::createNew(UsageEnvironment& env, ServerMediaSession& session,
+				      char const* segmentURLPrefix,
+				      unsigned targetSegmentDuration, unsigned numSegmentsInPlaylist) {
+  if (targetSegmentDuration == 0) targetSegmentDuration = 1;
+  if (numSegmentsInPlaylist < 3) numSegmentsInPlaylist = 3; // the minimum that HLS clients expect of a live playlist
+
+  HLSSegmenter* segmenter
+    = new HLSSegmenter(env, session, segmentURLPrefix, targetSegmentDuration, numSegmentsInPlaylist);
+  if (!segmenter->setUpInputSource()) {
+    Medium::close(segmenter);
+    return NULL;
+  }
+
+  return segmenter;
+}
+
+HLSSegmenter::HLSSegmenter(UsageEnvironment& env, ServerMediaSession& session, char const* segmentURLPrefix,
+			   unsigned targetSegmentDuration, unsigned numSegmentsInPlaylist)
+  : MediaSink(env),
+    fOurSession(session), fSegmentURLPrefix(strDup(segmentURLPrefix)),
+    fTargetSegmentDuration(targetSegmentDuration), fNumSegmentsInPlaylist(numSegmentsInPlaylist),
+    fClientSessionId((u_int32_t)our_random32()), fNumStreams(0), fStreams(NULL), fMultiplexor(NULL),
+    fHaveEnded(False), fLastAccessTime(0),
+    fBufferSize(HLS_INITIAL_BUFFER_SIZE), fBufferBytesUsed(0), fNextPacketOffsetToCheck(0), fHaveSeenPAT(False),
+    fMediaTime(0.0), fMediaClockBase(0.0), fLastPresentationTime(0.0), fSegmentStartMediaTime(0.0),
+    fFirstSegment(NULL), fLastSegment(NULL), fNumSegments(0), fNextSequenceNumber(0),
+    fPlaylist(NULL), fPlaylistSize(0) {
+  fBuffer = new u_int8_t[fBufferSize];
+  fOurSession.incrementReferenceCount();
+  noteAccess();
+  generatePlaylist();
+}
+
+HLSSegmenter::~HLSSegmenter() {
+  stopPlaying();
+
+  // Close our multiplexor (if any) before the subsessions' stream sources, because it reads from them:
+  Medium::close(fMultiplexor);
+  for (unsigned i = 0; i < fNumStreams; ++i) {
+    fStreams[i].subsession->deleteStream(fClientSessionId, fStreams[i].streamToken);
+  }
+  delete[] fStreams;
+
+  // Release our window of segments.  (Any segment that's still being sent to a client will remain until it's done.)
+  while (fFirstSegment != NULL) {
+    HLSSegment* segment = fFirstSegment;
+    fFirstSegment = segment->fNext;
+    segment->decrementReferenceCount();
+  }
+
+  delete[] fPlaylist;
+  delete[] fBuffer;
+  delete[] fSegmentURLPrefix;
+  fOurSession.decrementReferenceCount();
+}
+
+Boolean HLSSegmenter::setUpInputSource() {
+  ServerMediaSubsessionIterator iter(fOurSession);
+  ServerMediaSubsession* subsession;
+  unsigned numSubsessions = 0;
+  while ((subsession = iter.next()) != NULL) ++numSubsessions;
+  if (numSubsessions == 0) return False;
+  fStreams = new struct streamState[numSubsessions];
+
+  FramedSource* transportStreamSource = NULL;
+  MPEG2TransportStreamFromESSource* multiplexor = NULL;
+  iter.reset();
+  while ((subsession = iter.next()) != NULL) {
+    // Call "getStreamParameters()" to create the stream's source.  (Because we're not actually streaming via RTP/RTCP, most
+    // of the parameters to the call are dummy.)
+    Port clientRTPPort(0), clientRTCPPort(0), serverRTPPort(0), serverRTCPPort(0);
+    netAddressBits destinationAddress = 0;
+    u_int8_t destinationTTL = 0;
+    Boolean isMulticast = False;
+    void* streamToken = NULL;
+    subsession->getStreamParameters(fClientSessionId, 0, clientRTPPort,clientRTCPPort, -1,0,0, destinationAddress,destinationTTL, isMulticast, serverRTPPort,serverRTCPPort, streamToken);
+    fStreams[fNumStreams].subsession = subsession;
+    fStreams[fNumStreams].streamToken = streamToken;
+    ++fNumStreams;
+
+    FramedSource* source = subsession->getStreamSource(streamToken);
+    if (source == NULL) continue;
+
+    // Use the stream's RTP payload format name to figure out how (or whether) it can be put in a Transport Stream:
+    char codecName[100];
+    if (!getCodecNameFromSDPLines(subsession->sdpLines(), codecName, sizeof codecName)) continue;
+    if (strcmp(codecName, "MP2T") == 0) {
+      // The stream is already a Transport Stream; we use it as is (and ignore any other subsessions):
+      if (transportStreamSource == NULL) transportStreamSource = source;
+      continue;
+    }
+
+    Boolean isVideo = True, insertStartCodes = False;
+    int mpegVersion;
+    if (strcmp(codecName, "H264") == 0) {
+      mpegVersion = 5; insertStartCodes = True;
+    } else if (strcmp(codecName, "H265") == 0) {
+      mpegVersion = 6; insertStartCodes = True;
+    } else if (strcmp(codecName, "MP4V-ES") == 0) {
+      mpegVersion = 4;
+    } else if (strcmp(codecName, "MPV") == 0) {
+      mpegVersion = 2;
+    } else if (strcmp(codecName, "MPA") == 0) {
+      mpegVersion = 1; isVideo = False;
+    } else {
+      envir() << "HLSSegmenter: Ignoring \"" << fOurSession.streamName() << "\"'s \"" << codecName
+	      << "\" subsession, which can't be carried in a Transport Stream\n";
+      continue;
+    }
+
+    if (multiplexor == NULL) multiplexor = MPEG2TransportStreamFromESSource::createNew(envir());
+    FramedSource* esSource = new HLSESInput(envir(), source, insertStartCodes);
+    if (isVideo) {
+      multiplexor->addNewVideoSource(esSource, mpegVersion);
+    } else {
+      multiplexor->addNewAudioSource(esSource, mpegVersion);
+    }
+  }
+
+  if (transportStreamSource != NULL) {
+    Medium::close(multiplexor); multiplexor = NULL;
+  } else {
+    transportStreamSource = multiplexor;
+  }
+  if (transportStreamSource == NULL) return False;
+
+  fMultiplexor = multiplexor;
+  return startPlaying(*transportStreamSource, NULL, NULL);
+}
+
+void HLSSegmenter::noteAccess() {
+  struct timeval timeNow;
+  gettimeofday(&timeNow, NULL);
+  fLastAccessTime = timeNow.tv_sec;
+}
+
+char const* HLSSegmenter::playlist(unsigned& playlistSize) {
+  noteAccess();
+
+  playlistSize = fPlaylistSize;
+  return fPlaylist;
+}
+
+HLSSegment* HLSSegmenter::lookupSegment(unsigned sequenceNumber) {
+  noteAccess();
+
+  for (HLSSegment* segment = fFirstSegment; segment != NULL; segment = segment->fNext) {
+    if (segment->fSequenceNumber == sequenceNumber) return segment;
+  }
+  return NULL;
+}
+
+Boolean HLSSegmenter::continuePlaying() {
+  if (fSource == NULL) return False;
+
+  ensureBufferSpace();
+  fSource->getNextFrame(&fBuffer[fBufferBytesUsed], fBufferSize - fBufferBytesUsed,
+			afterGettingFrame, this,
+			ourOnSourceClosure, this);
+  return True;
+}
+
+void HLSSegmenter::afterGettingFrame(void* clientData, unsigned frameSize,
+				     unsigned numTruncatedBytes,
+				     struct timeval presentationTime,
+				     unsigned durationInMicroseconds) {
+  HLSSegmenter* segmenter = (HLSSegmenter*)clientData;
+  segmenter->afterGettingFrame(frameSize, numTruncatedBytes, presentationTime, durationInMicroseconds);
+}
+
+void HLSSegmenter::afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes,
+				     struct timeval presentationTime, unsigned durationInMicroseconds) {
+  if (numTruncatedBytes > 0) {
+    envir() << "HLSSegmenter::afterGettingFrame(): The input frame data was too large for our buffer.  "
+	    << numTruncatedBytes
+	    << " bytes of trailing data was dropped!  Correct this by increasing the definition of \"HLS_MIN_READ_SIZE\" in \"HLSSegmenter.cpp\".\n";
+  }
+
+  // Advance our 'media clock' by the frame's duration if the source gave us one (as a Transport Stream framer does);
+  // otherwise by the change in presentation time.  (We ignore backwards or large forwards jumps in presentation time
+  // - e.g., when a live stream's presentation times first become RTCP-synchronized - because these aren't real.)
+  struct timeval timeNow;
+  gettimeofday(&timeNow, NULL);
+  if (presentationTime.tv_sec == 0 && presentationTime.tv_usec == 0) presentationTime = timeNow; // no presentation time
+  double pt = presentationTime.tv_sec + presentationTime.tv_usec/1000000.0;
+  double now = timeNow.tv_sec + timeNow.tv_usec/1000000.0;
+  if (fMediaClockBase == 0.0) {
+    fMediaClockBase = now;
+  } else if (durationInMicroseconds == 0) {
+    double ptDelta = pt - fLastPresentationTime;
+    if (ptDelta > 0.0 && ptDelta < HLS_FORCED_CUT_FACTOR*fTargetSegmentDuration) fMediaTime += ptDelta;
+  }
+  fMediaTime += durationInMicroseconds/1000000.0;
+  fLastPresentationTime = pt;
+
+  // Look at each Transport Stream packet whose (4-byte) header we now have, but haven't yet checked.  (This includes
+  // a packet that began in an earlier read, if its header was split across reads.)
+  fBufferBytesUsed += frameSize;
+  unsigned i = fNextPacketOffsetToCheck;
+  for (; i + 4 <= fBufferBytesUsed; i += TRANSPORT_PACKET_SIZE) {
+    u_int8_t const* pkt = &fBuffer[i];
+    Boolean isPAT = pkt[0] == 0x47 && (pkt[1]&0x40) != 0/*payload_unit_start_indicator*/
+      && (pkt[1]&0x1F) == 0 && pkt[2] == 0/*PID 0*/;
+
+    if (!fHaveSeenPAT) {
+      // Each segment must be independently decodable, so discard anything that precedes the first PAT:
+      if (!isPAT) continue;
+      memmove(fBuffer, pkt, fBufferBytesUsed - i);
+      fBufferBytesUsed -= i; i = 0;
+      fHaveSeenPAT = True;
+      fSegmentStartMediaTime = fMediaTime;
+      continue;
+    }
+
+    if (i == 0) continue;
+    double segmentDuration = fMediaTime - fSegmentStartMediaTime;
+    if ((isPAT && segmentDuration >= fTargetSegmentDuration)
+	|| segmentDuration >= HLS_FORCED_CUT_FACTOR*fTargetSegmentDuration) {
+      completeCurrentSegment(i);
+      i = 0; // the remaining data has been moved to the start of the new segment's buffer
+    }
+  }
+  if (!fHaveSeenPAT) {
+    // Discard the data that we've checked, but keep any trailing packet whose header we don't yet have in full.
+    // (If the last packet that we checked isn't yet complete, "i" points beyond our data, into the data still to come.)
+    unsigned numBytesToDiscard = i < fBufferBytesUsed ? i : fBufferBytesUsed;
+    memmove(fBuffer, &fBuffer[numBytesToDiscard], fBufferBytesUsed - numBytesToDiscard);
+    fBufferBytesUsed -= numBytesToDiscard; i -= numBytesToDiscard;
+  }
+  fNextPacketOffsetToCheck = i;
+
+  // A live source delivers data in real time, but a (unbounded) file source delivers it as fast as we ask for it.
+  // So, if we've got ahead of real time, delay before reading more:
+  double secondsAhead = fMediaTime - (now - fMediaClockBase);
+  if (secondsAhead < -1.0) {
+    fMediaClockBase = now - fMediaTime; // we've fallen behind (e.g., because the source stalled); don't try to catch up
+  } else if (secondsAhead > 0.1) {
+    nextTask() = envir().taskScheduler().scheduleDelayedTask((int64_t)(secondsAhead*1000000),
+							     (TaskFunc*)continuePlayingTask, this);
+    return;
+  }
+
+  continuePlaying();
+}
+
+void HLSSegmenter::continuePlayingTask(void* clientData) {
+  HLSSegmenter* segmenter = (HLSSegmenter*)clientData;
+  segmenter->nextTask() = NULL;
+  segmenter->continuePlaying();
+}
+
+void HLSSegmenter::ourOnSourceClosure(void* clientData) {
+  HLSSegmenter* segmenter = (HLSSegmenter*)clientData;
+  segmenter->ourOnSourceClosure();
+}
+
+void HLSSegmenter::ourOnSourceClosure() {
+  // The input stream has ended.  Complete the final segment (if any), and remember that we've ended:
+  if (fHaveSeenPAT && fBufferBytesUsed >= TRANSPORT_PACKET_SIZE) {
+    completeCurrentSegment(fBufferBytesUsed - fBufferBytesUsed%TRANSPORT_PACKET_SIZE);
+  }
+  fHaveEnded = True;
+
+  onSourceClosure();
+}
+
+void HLSSegmenter::ensureBufferSpace() {
+  if (fBufferSize - fBufferBytesUsed >= HLS_MIN_READ_SIZE) return;
+
+  unsigned newBufferSize = 2*fBufferSize;
+  u_int8_t* newBuffer = new u_int8_t[newBufferSize];
+  memmove(newBuffer, fBuffer, fBufferBytesUsed);
+  delete[] fBuffer;
+  fBuffer = newBuffer;
+  fBufferSize = newBufferSize;
+}
+
+void HLSSegmenter::completeCurrentSegment(unsigned segmentSize) {
+  double duration = fMediaTime - fSegmentStartMediaTime;
+  fSegmentStartMediaTime = fMediaTime;
+
+  // Hand our current buffer to the new segment, and move any remaining data into a new buffer
+  // (of the same size, because the next segment is likely to be similar in size to this one):
+  u_int8_t* newBuffer = new u_int8_t[fBufferSize];
+  unsigned numRemainingBytes = fBufferBytesUsed - segmentSize;
+  memmove(newBuffer, &fBuffer[segmentSize], numRemainingBytes);
+  HLSSegment* segment = new HLSSegment(fNextSequenceNumber++, fBuffer, segmentSize, duration);
+  fBuffer = newBuffer;
+  fBufferBytesUsed = numRemainingBytes;
+
+  // Add the new segment to the end of our window, removing the oldest segment(s) if the window is now too large:
+  if (fLastSegment == NULL) {
+    fFirstSegment = segment;
+  } else {
+    fLastSegment->fNext = segment;
+  }
+  fLastSegment = segment;
+  ++fNumSegments;
+
+  while (fNumSegments > fNumSegmentsInPlaylist) {
+    HLSSegment* oldestSegment = fFirstSegment;
+    fFirstSegment = oldestSegment->fNext;
+    oldestSegment->fNext = NULL;
+    --fNumSegments;
+    oldestSegment->decrementReferenceCount();
+  }
+
+  generatePlaylist();
+}
+
+void HLSSegmenter::generatePlaylist() {
+  // The target duration must be at least as large as each segment's (rounded) duration:
+  unsigned targetDuration = fTargetSegmentDuration;
+  HLSSegment* segment;
+  for (segment = fFirstSegment; segment != NULL; segment = segment->fNext) {
+    unsigned roundedDuration = (unsigned)(segment->fDuration + 0.5);
+    if (roundedDuration > targetDuration) targetDuration = roundedDuration;
+  }
+
+  unsigned const maxIntLen = 10; // >= the maximum possible strlen() of an integer in the playlist
+  char const* const playlistPrefixFmt =
+    "#EXTM3U\r\n"
+    "#EXT-X-VERSION:3\r\n"
+    "#EXT-X-TARGETDURATION:%u\r\n"
+    "#EXT-X-MEDIA-SEQUENCE:%u\r\n";
+  char const* const playlistMediaFileSpecFmt =
+    "#EXTINF:%.3f,\r\n"
+    "%s%u\r\n";
+  unsigned const playlistMediaFileSpecFmt_maxLen
+    = strlen(playlistMediaFileSpecFmt) + 2*maxIntLen + strlen(fSegmentURLPrefix);
+  unsigned const playlistMaxSize
+    = strlen(playlistPrefixFmt) + 2*maxIntLen + fNumSegments*playlistMediaFileSpecFmt_maxLen + 1;
+
+  delete[] fPlaylist;
+  fPlaylist = new char[playlistMaxSize];
+  char* s = fPlaylist;
+  sprintf(s, playlistPrefixFmt, targetDuration, fFirstSegment == NULL ? fNextSequenceNumber : fFirstSegment->fSequenceNumber);
+  s += strlen(s);
+
+  for (segment = fFirstSegment; segment != NULL; segment = segment->fNext) {
+    sprintf(s, playlistMediaFileSpecFmt, segment->fDuration, fSegmentURLPrefix, segment->fSequenceNumber);
+    s += strlen(s);
+  }
+  fPlaylistSize = s - fPlaylist;
+}
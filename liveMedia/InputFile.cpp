@@ -70,6 +70,19 @@ u_int64_t GetFileSize(char const* fileName, FILE* fid) {
   return fileSize;
 }
 
+time_t GetFileModificationTime(char const* fileName) {
+  time_t modificationTime = 0; // by default
+
+#if !defined(_WIN32_WCE)
+  struct stat sb;
+  if (fileName != NULL && stat(fileName, &sb) == 0) {
+    modificationTime = sb.st_mtime;
+  }
+#endif
+
+  return modificationTime;
+}
+
 int64_t SeekFile64(FILE *fid, int64_t offset, int whence) {
   if (fid == NULL) return -1;
 
@@ -130,8 +130,10 @@ MPEG2IFrameIndexFromTransportStream
     fInputTransportPacketCounter((unsigned)-1), fClosureNumber(0), fLastContinuityCounter(~0),
     fFirstPCR(0.0), fLastPCR(0.0), fHaveSeenFirstPCR(False),
     fPMT_PID(0x10), fVideo_PID(0xE0), // default values
+    fHaveSeenVideoStream(False),
+    fIndexFromTransportPacketNumber(0), fIndexToTransportPacketNumber(0), fCurrentFrameTransportPacketNumber(0),
     fParseBufferSize(PARSE_BUFFER_SIZE),
-    fParseBufferFrameStart(0), fParseBufferParseEnd(4), fParseBufferDataEnd(0),
+    fParseBufferFrameStart(0), fParseBufferParseEnd(4), fParseBufferDataEnd(0), fNumInitialBadBytes(0),
     fHeadIndexRecord(NULL), fTailIndexRecord(NULL) {
   fParseBuffer = new unsigned char[fParseBufferSize];
 }
@@ -141,6 +143,40 @@ MPEG2IFrameIndexFromTransportStream::~MPEG2IFrameIndexFromTransportStream() {
   delete[] fParseBuffer;
 }
 
+void MPEG2IFrameIndexFromTransportStream
+::setInputRange(unsigned long firstTransportPacketNumber,
+		unsigned long indexFromTransportPacketNumber, unsigned long indexToTransportPacketNumber) {
+  fInputTransportPacketCounter = firstTransportPacketNumber - 1; // because it gets incremented before each packet
+  fIndexFromTransportPacketNumber = indexFromTransportPacketNumber;
+  fIndexToTransportPacketNumber = indexToTransportPacketNumber;
+}
+
+#define TRANSPORT_SYNC_BYTE 0x47
+
+Boolean MPEG2IFrameIndexFromTransportStream::primeFromTransportPackets(unsigned char* packets, unsigned numPackets) {
+  for (unsigned i = 0; i < numPackets && !(fHaveSeenVideoStream && fHaveSeenFirstPCR); ++i) {
+    unsigned char* pkt = &packets[i*TRANSPORT_PACKET_SIZE];
+    if (pkt[0] != TRANSPORT_SYNC_BYTE) break;
+
+    u_int8_t adaptation_field_control = (pkt[3]&0x30)>>4;
+    u_int8_t totalHeaderSize = adaptation_field_control == 1 ? 4 : 5 + pkt[4];
+    if (totalHeaderSize >= TRANSPORT_PACKET_SIZE) continue;
+
+    analyzePCR(pkt, totalHeaderSize);
+    u_int16_t PID = ((pkt[1]&0x1F)<<8) | pkt[2];
+    if (PID == PAT_PID) {
+      analyzePAT(&pkt[totalHeaderSize], TRANSPORT_PACKET_SIZE-totalHeaderSize);
+    } else if (PID == fPMT_PID) {
+      if (analyzePMT(&pkt[totalHeaderSize], TRANSPORT_PACKET_SIZE-totalHeaderSize)) fHaveSeenVideoStream = True;
+    }
+  }
+
+  // The data that we'll later read doesn't follow on from these packets, so don't compare its PCRs with theirs:
+  fLastPCR = fFirstPCR;
+
+  return fHaveSeenVideoStream && fHaveSeenFirstPCR;
+}
+
 void MPEG2IFrameIndexFromTransportStream::doGetNextFrame() {
   // Begin by trying to deliver an index record (for an already-parsed frame)
   // to the client:
@@ -181,8 +217,6 @@ void MPEG2IFrameIndexFromTransportStream
 			     presentationTime, durationInMicroseconds);
 }
 
-#define TRANSPORT_SYNC_BYTE 0x47
-
 void MPEG2IFrameIndexFromTransportStream
 ::afterGettingFrame1(unsigned frameSize,
 		     unsigned numTruncatedBytes,
@@ -210,36 +244,14 @@ void MPEG2IFrameIndexFromTransportStream
   }
 
   // Check for a PCR:
-  if (totalHeaderSize > 5 && (fInputBuffer[5]&0x10) != 0) {
-    // There's a PCR:
-    u_int32_t pcrBaseHigh
-      = (fInputBuffer[6]<<24)|(fInputBuffer[7]<<16)
-      |(fInputBuffer[8]<<8)|fInputBuffer[9];
-    float pcr = pcrBaseHigh/45000.0f;
-    if ((fInputBuffer[10]&0x80) != 0) pcr += 1/90000.0f; // add in low-bit (if set)
-    unsigned short pcrExt = ((fInputBuffer[10]&0x01)<<8) | fInputBuffer[11];
-    pcr += pcrExt/27000000.0f;
-
-    if (!fHaveSeenFirstPCR) {
-      fFirstPCR = pcr;
-      fHaveSeenFirstPCR = True;
-    } else if (pcr < fLastPCR) {
-      // The PCR timestamp has gone backwards.  Display a warning about this
-      // (because it indicates buggy Transport Stream data), and compensate for it.
-      envir() << "\nWarning: At about " << fLastPCR-fFirstPCR
-	      << " seconds into the file, the PCR timestamp decreased - from "
-	      << fLastPCR << " to " << pcr << "\n";
-      fFirstPCR -= (fLastPCR - pcr);
-    }
-    fLastPCR = pcr;
-  }
+  analyzePCR(fInputBuffer, totalHeaderSize);
 
   // Get the PID from the packet, and check for special tables: the PAT and PMT:
   u_int16_t PID = ((fInputBuffer[1]&0x1F)<<8) | fInputBuffer[2];
   if (PID == PAT_PID) {
     analyzePAT(&fInputBuffer[totalHeaderSize], TRANSPORT_PACKET_SIZE-totalHeaderSize);
   } else if (PID == fPMT_PID) {
-    analyzePMT(&fInputBuffer[totalHeaderSize], TRANSPORT_PACKET_SIZE-totalHeaderSize);
+    if (analyzePMT(&fInputBuffer[totalHeaderSize], TRANSPORT_PACKET_SIZE-totalHeaderSize)) fHaveSeenVideoStream = True;
   }
 
   // Ignore transport packets for non-video programs,
@@ -313,6 +325,33 @@ void MPEG2IFrameIndexFromTransportStream::handleInputClosure1() {
   }
 }
 
+void MPEG2IFrameIndexFromTransportStream
+::analyzePCR(unsigned char* pkt, u_int8_t totalHeaderSize) {
+  if (totalHeaderSize > 5 && (pkt[5]&0x10) != 0) {
+    // There's a PCR:
+    u_int32_t pcrBaseHigh
+      = (pkt[6]<<24)|(pkt[7]<<16)
+      |(pkt[8]<<8)|pkt[9];
+    float pcr = pcrBaseHigh/45000.0f;
+    if ((pkt[10]&0x80) != 0) pcr += 1/90000.0f; // add in low-bit (if set)
+    unsigned short pcrExt = ((pkt[10]&0x01)<<8) | pkt[11];
+    pcr += pcrExt/27000000.0f;
+
+    if (!fHaveSeenFirstPCR) {
+      fFirstPCR = pcr;
+      fHaveSeenFirstPCR = True;
+    } else if (pcr < fLastPCR) {
+      // The PCR timestamp has gone backwards.  Display a warning about this
+      // (because it indicates buggy Transport Stream data), and compensate for it.
+      envir() << "\nWarning: At about " << fLastPCR-fFirstPCR
+	      << " seconds into the file, the PCR timestamp decreased - from "
+	      << fLastPCR << " to " << pcr << "\n";
+      fFirstPCR -= (fLastPCR - pcr);
+    }
+    fLastPCR = pcr;
+  }
+}
+
 void MPEG2IFrameIndexFromTransportStream
 ::analyzePAT(unsigned char* pkt, unsigned size) {
   // Get the PMT_PID:
@@ -327,7 +366,7 @@ void MPEG2IFrameIndexFromTransportStream
   }
 }
 
-void MPEG2IFrameIndexFromTransportStream
+Boolean MPEG2IFrameIndexFromTransportStream
 ::analyzePMT(unsigned char* pkt, unsigned size) {
   // Scan the "elementary_PID"s in the map, until we see the first video stream.
 
@@ -336,10 +375,10 @@ void MPEG2IFrameIndexFromTransportStream
   if ((unsigned)(4+section_length) < size) size = (4+section_length);
 
   // Then, skip any descriptors following the "program_info_length":
-  if (size < 22) return; // not enough data
+  if (size < 22) return False; // not enough data
   unsigned program_info_length = ((pkt[11]&0x0F)<<8) | pkt[12];
   pkt += 13; size -= 13;
-  if (size < program_info_length) return; // not enough data
+  if (size < program_info_length) return False; // not enough data
   pkt += program_info_length; size -= program_info_length;
 
   // Look at each ("stream_type","elementary_PID") pair, looking for a video stream:
@@ -351,14 +390,16 @@ void MPEG2IFrameIndexFromTransportStream
       if (stream_type == 0x1B) fIsH264 = True;
       else if (stream_type == 0x24) fIsH265 = True;
       fVideo_PID = elementary_PID;
-      return;
+      return True;
     }
 
     u_int16_t ES_info_length = ((pkt[3]&0x0F)<<8) | pkt[4];
     pkt += 5; size -= 5;
-    if (size < ES_info_length) return; // not enough data
+    if (size < ES_info_length) return False; // not enough data
     pkt += ES_info_length; size -= ES_info_length;
   }
+
+  return False;
 }
 
 Boolean MPEG2IFrameIndexFromTransportStream::deliverIndexRecord() {
@@ -384,6 +425,20 @@ Boolean MPEG2IFrameIndexFromTransportStream::deliverIndexRecord() {
     return deliverIndexRecord();
   }
 
+  // If we've been asked to index only part of the file, check whether this record's frame lies within it:
+  if ((head->recordType()&0x80) != 0) fCurrentFrameTransportPacketNumber = head->transportPacketNumber();
+  if (fIndexToTransportPacketNumber > 0 && fCurrentFrameTransportPacketNumber >= fIndexToTransportPacketNumber) {
+    // We've indexed all of the frames that we were asked for:
+    delete head;
+    handleClosure();
+    return True;
+  }
+  if (fCurrentFrameTransportPacketNumber < fIndexFromTransportPacketNumber) {
+    // This frame began before the part of the file that we're indexing; don't deliver it:
+    delete head;
+    return deliverIndexRecord();
+  }
+
   // Deliver data from the head record:
 #ifdef DEBUG
   envir() << "delivering: " << *head << "\n";
@@ -429,7 +484,6 @@ Boolean MPEG2IFrameIndexFromTransportStream::parseFrame() {
 
   // Inspect the frame's initial 4-byte code, to make sure it starts with a system code:
   if (fParseBufferDataEnd-fParseBufferFrameStart < 4) return False; // not enough data
-  unsigned numInitialBadBytes = 0;
   unsigned char const* p = &fParseBuffer[fParseBufferFrameStart];
   if (!(p[0] == 0 && p[1] == 0 && p[2] == 1)) {
     // There's no system code at the beginning.  Parse until we find one:
@@ -440,7 +494,8 @@ Boolean MPEG2IFrameIndexFromTransportStream::parseFrame() {
     unsigned char nextCode;
     if (!parseToNextCode(nextCode)) return False;
 
-    numInitialBadBytes = fParseBufferParseEnd - fParseBufferFrameStart;
+    fNumInitialBadBytes = fParseBufferParseEnd - fParseBufferFrameStart;
+        // (We remember this, in case we don't yet have all of the following frame's data)
     fParseBufferFrameStart = fParseBufferParseEnd;
     fParseBufferParseEnd += 4; // skip over the code that we just saw
     p = &fParseBuffer[fParseBufferFrameStart];
@@ -553,6 +608,8 @@ Boolean MPEG2IFrameIndexFromTransportStream::parseFrame() {
 
   // There is now a parsed 'frame', from "fParseBufferFrameStart"
   // to "fParseBufferParseEnd". Tag the corresponding index records to note this:
+  unsigned numInitialBadBytes = fNumInitialBadBytes;
+  fNumInitialBadBytes = 0;
   unsigned frameSize = fParseBufferParseEnd - fParseBufferFrameStart + numInitialBadBytes;
 #ifdef DEBUG
   envir() << "parsed " << recordTypeStr[curRecordType] << "; length "
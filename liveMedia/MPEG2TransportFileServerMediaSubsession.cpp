@@ -21,6 +21,7 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 
 #include "MPEG2TransportFileServerMediaSubsession.hh"
 #include "SimpleRTPSink.hh"
+#include "InputFile.hh"
 
 MPEG2TransportFileServerMediaSubsession*
 MPEG2TransportFileServerMediaSubsession::createNew(UsageEnvironment& env,
@@ -214,6 +215,40 @@ float MPEG2TransportFileServerMediaSubsession::duration() const {
   return fDuration;
 }
 
+Boolean MPEG2TransportFileServerMediaSubsession
+::getFileByteRange(double seekNPT, double streamDuration,
+		   char const*& fileName, u_int64_t& startByte, u_int64_t& numBytes) {
+  fileName = NULL;
+  startByte = numBytes = 0;
+  if (fIndexFile == NULL || fDuration <= 0.0 || streamDuration <= 0.0) return False; // we can't map times to bytes
+
+  // Use the index file to find the Transport packets that span the requested range (in the same way that
+  // "ClientTrickPlayState::updateStateFromNPT()" does, when streaming in normal - i.e., non trick play - mode):
+  unsigned long fromTSPacketNum, toTSPacketNum, ixRecordNum;
+  float fromNPT = (float)seekNPT;
+  fIndexFile->lookupTSPacketNumFromNPT(fromNPT, fromTSPacketNum, ixRecordNum);
+
+  u_int64_t const fileSize = GetFileSize(fFileName, NULL);
+  u_int64_t endByte;
+  if (seekNPT + streamDuration + 1.0 > fDuration) {
+    // The range reaches the end of the stream (HTTP Live Streaming playlists omit any final fraction of a second),
+    // so include all remaining data - including any that follows the last indexed packet:
+    endByte = fileSize;
+  } else {
+    float toNPT = (float)(seekNPT + streamDuration);
+    fIndexFile->lookupTSPacketNumFromNPT(toNPT, toTSPacketNum, ixRecordNum);
+    endByte = (u_int64_t)toTSPacketNum*TRANSPORT_PACKET_SIZE;
+    if (endByte > fileSize) endByte = fileSize;
+  }
+
+  startByte = (u_int64_t)fromTSPacketNum*TRANSPORT_PACKET_SIZE;
+  if (endByte <= startByte) return False;
+
+  fileName = fFileName;
+  numBytes = endByte - startByte;
+  return True;
+}
+
 ClientTrickPlayState* MPEG2TransportFileServerMediaSubsession
 ::lookupClient(unsigned clientSessionId) {
   return (ClientTrickPlayState*)(fClientSessionHashTable->Lookup((char const*)clientSessionId));
@@ -306,6 +341,7 @@ void ClientTrickPlayState::updateStateOnScaleChange() {
     // And generate a Transport Stream from this:
     fTrickPlaySource = MPEG2TransportStreamFromESSource::createNew(env);
     fTrickPlaySource->addNewVideoSource(fTrickModeFilter, fIndexFile->mpegVersion());
+    fTrickPlaySource->setMaxPacketsPerDelivery(TRANSPORT_PACKETS_PER_NETWORK_PACKET); // like our regular (1x) source
 
     fFramer->changeInputSource(fTrickPlaySource);
   } else {
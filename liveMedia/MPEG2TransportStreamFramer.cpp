@@ -24,6 +24,7 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #include <GroupsockHelper.hh> // for "gettimeofday()"
 
 #define TRANSPORT_PACKET_SIZE 188
+#define NUM_PIDS 0x2000 // PIDs are 13 bits
 
 ////////// Definitions of constants that control the behavior of this code /////////
 
@@ -76,18 +77,20 @@ MPEG2TransportStreamFramer
     fTSPacketCount(0), fTSPacketDurationEstimate(0.0), fTSPCRCount(0),
     fLimitNumTSPacketsToStream(False), fNumTSPacketsToStream(0),
     fLimitTSPacketsToStreamByPCR(False), fPCRLimit(0.0) {
-  fPIDStatusTable = HashTable::create(ONE_WORD_HASH_KEYS);
+  // We use a flat array (rather than a hash table) for looking up a PID's status, because it's cheaper to
+  // index, and there are only 2^13 possible PIDs:
+  fPIDStatusTable = new PIDStatus*[NUM_PIDS];
+  for (unsigned pid = 0; pid < NUM_PIDS; ++pid) fPIDStatusTable[pid] = NULL;
 }
 
 MPEG2TransportStreamFramer::~MPEG2TransportStreamFramer() {
   clearPIDStatusTable();
-  delete fPIDStatusTable;
+  delete[] fPIDStatusTable;
 }
 
 void MPEG2TransportStreamFramer::clearPIDStatusTable() {
-  PIDStatus* pidStatus;
-  while ((pidStatus = (PIDStatus*)fPIDStatusTable->RemoveNext()) != NULL) {
-    delete pidStatus;
+  for (unsigned pid = 0; pid < NUM_PIDS; ++pid) {
+    delete fPIDStatusTable[pid]; fPIDStatusTable[pid] = NULL;
   }
 }
 
@@ -173,12 +176,28 @@ void MPEG2TransportStreamFramer::afterGettingFrame1(unsigned frameSize,
   fPresentationTime = presentationTime;
 
   // Scan through the TS packets that we read, and update our estimate of
-  // the duration of each packet:
-  struct timeval tvNow;
-  gettimeofday(&tvNow, NULL);
-  double timeNow = tvNow.tv_sec + tvNow.tv_usec/1000000.0;
-  for (unsigned i = 0; i < numTSPackets; ++i) {
-    if (!updateTSPacketDurationEstimate(&fTo[i*TRANSPORT_PACKET_SIZE], timeNow)) {
+  // the duration of each packet.  Only those packets that contain a PCR need
+  // any more than a quick look at their header:
+  double timeNow = 0.0;
+  unsigned char* pkt = fTo;
+  for (unsigned i = 0; i < numTSPackets; ++i, pkt += TRANSPORT_PACKET_SIZE) {
+    // Sanity check: Make sure we start with the sync byte:
+    if (pkt[0] != TRANSPORT_SYNC_BYTE) {
+      envir() << "Missing sync byte!\n";
+      continue;
+    }
+    ++fTSPacketCount;
+
+    // Check for an adaptation_field (i.e., "adaptation_field_control" is 2 or 3)
+    // that's non-empty, and has "PCR_flag" set:
+    if ((pkt[3]&0x20) == 0 || pkt[4] == 0 || (pkt[5]&0x10) == 0) continue;
+
+    if (timeNow == 0.0) {
+      struct timeval tvNow;
+      gettimeofday(&tvNow, NULL);
+      timeNow = tvNow.tv_sec + tvNow.tv_usec/1000000.0;
+    }
+    if (!updateTSPacketDurationEstimate(pkt, timeNow)) {
       // We hit a preset limit (based on PCR) within the stream.  Handle this as if the input source has closed:
       handleClosure();
       return;
@@ -193,25 +212,7 @@ void MPEG2TransportStreamFramer::afterGettingFrame1(unsigned frameSize,
 }
 
 Boolean MPEG2TransportStreamFramer::updateTSPacketDurationEstimate(unsigned char* pkt, double timeNow) {
-  // Sanity check: Make sure we start with the sync byte:
-  if (pkt[0] != TRANSPORT_SYNC_BYTE) {
-    envir() << "Missing sync byte!\n";
-    return True;
-  }
-
-  ++fTSPacketCount;
-
-  // If this packet doesn't contain a PCR, then we're not interested in it:
-  u_int8_t const adaptation_field_control = (pkt[3]&0x30)>>4;
-  if (adaptation_field_control != 2 && adaptation_field_control != 3) return True;
-      // there's no adaptation_field
-
-  u_int8_t const adaptation_field_length = pkt[4];
-  if (adaptation_field_length == 0) return True;
-
   u_int8_t const discontinuity_indicator = pkt[5]&0x80;
-  u_int8_t const pcrFlag = pkt[5]&0x10;
-  if (pcrFlag == 0) return True; // no PCR
 
   // There's a PCR.  Get it, and the PID:
   ++fTSPCRCount;
@@ -230,12 +231,12 @@ Boolean MPEG2TransportStreamFramer::updateTSPacketDurationEstimate(unsigned char
   unsigned pid = ((pkt[1]&0x1F)<<8) | pkt[2];
 
   // Check whether we already have a record of a PCR for this PID:
-  PIDStatus* pidStatus = (PIDStatus*)(fPIDStatusTable->Lookup((char*)pid));
+  PIDStatus* pidStatus = fPIDStatusTable[pid];
 
   if (pidStatus == NULL) {
     // We're seeing this PID's PCR for the first time:
     pidStatus = new PIDStatus(clock, timeNow);
-    fPIDStatusTable->Add((char*)pid, pidStatus);
+    fPIDStatusTable[pid] = pidStatus;
 #ifdef DEBUG_PCR
     fprintf(stderr, "PID 0x%x, FIRST PCR 0x%08x+%d:%03x == %f @ %f, pkt #%lu\n", pid, pcrBaseHigh, pkt[10]>>7, pcrExt, clock, timeNow, fTSPacketCount);
 #endif
@@ -104,6 +104,9 @@ MPEG2TransportStreamFromESSource::~MPEG2TransportStreamFromESSource() {
 }
 
 void MPEG2TransportStreamFromESSource::doStopGettingFrames() {
+  // Cancel any pending delivery of a Transport Stream packet:
+  MPEG2TransportStreamMultiplexor::doStopGettingFrames();
+
   // Stop each input source:
   for (InputESSourceRecord* sourceRec = fInputSources; sourceRec != NULL;
        sourceRec = sourceRec->next()) {
@@ -0,0 +1,344 @@
+/**********
+This library is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the
+Free Software Foundation; either version 2.1 of the License, or (at your
+option) any later version. (See <http://www.gnu.org/copyleft/lesser.html>.)
+
+This library is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this library; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+**********/
+// "liveMedia"
+// Copyright (c) 1996-2014 Live Networks, Inc.  All rights reserved.
+// A class that generates (or extends) the index file for a MPEG-2 Transport Stream file - either as a whole,
+// in separately-indexed pieces (that can later be merged), or incrementally, as the Transport Stream file grows.
+// Implementation
+
+#include "MPEG2TransportStreamIndexer.hh"
+#include "ByteStreamFileSource.hh"
+#include "InputFile.hh"
+#include "OutputFile.hh"
+#if defined(__WIN32__) || defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// When we index a range that doesn't begin at the start of the file, we begin reading this many Transport packets
+// earlier, so that - by the start of the range - our parsing state (and PCR) is the same as if we'd read the whole file:
+#define NUM_LEAD_IN_TRANSPORT_PACKETS 20000
+
+// The maximum number of Transport packets (at the start of the file) that we'll read to find the video stream and PCR:
+#define MAX_NUM_PRIMING_TRANSPORT_PACKETS 20000
+
+// Index records store PCRs as 24 bits (integer part; little endian) + 8 bits (fractional part).  We handle them here
+// as a single 32-bit value (i.e., in units of 1/256 seconds):
+static u_int32_t getRecordPCR(unsigned char const* record) {
+  return (record[5]<<24) | (record[4]<<16) | (record[3]<<8) | record[6];
+}
+
+static void setRecordPCR(unsigned char* record, u_int32_t pcr) {
+  record[3] = (unsigned char)(pcr>>8);
+  record[4] = (unsigned char)(pcr>>16);
+  record[5] = (unsigned char)(pcr>>24);
+  record[6] = (unsigned char)(pcr);
+}
+
+static void adjustRecordPCR(unsigned char* record, u_int32_t& lastPCR, u_int32_t& pcrAdjustment) {
+  // Ensure that PCRs never decrease - even across the boundary between two separately-indexed parts of the file - by
+  // compensating (in the same way as "MPEG2IFrameIndexFromTransportStream" does, within each part):
+  u_int32_t pcr = getRecordPCR(record) + pcrAdjustment;
+  if (pcr < lastPCR) {
+    pcrAdjustment += lastPCR - pcr;
+    pcr = lastPCR;
+  }
+  setRecordPCR(record, pcr);
+  lastPCR = pcr;
+}
+
+static unsigned long recordTransportPacketNumber(unsigned char const* record) {
+  return record[7] | (record[8]<<8) | (record[9]<<16) | ((unsigned long)record[10]<<24);
+}
+
+static Boolean readRecord(FILE* fid, unsigned long recordNum, unsigned char* record) {
+  return SeekFile64(fid, (int64_t)recordNum*INDEX_RECORD_SIZE, SEEK_SET) >= 0
+    && fread(record, 1, INDEX_RECORD_SIZE, fid) == INDEX_RECORD_SIZE;
+}
+
+static void truncateFile(FILE* fid, u_int64_t fileSize) {
+  fflush(fid);
+#if defined(__WIN32__) || defined(_WIN32)
+  _chsize(_fileno(fid), (long)fileSize);
+#else
+  if (ftruncate(fileno(fid), (off_t)fileSize) < 0) {} // ignore any error; the file will just have trailing junk
+#endif
+}
+
+MPEG2TransportStreamIndexer*
+MPEG2TransportStreamIndexer::createNew(UsageEnvironment& env, char const* transportStreamFileName,
+				       char const* indexFileName) {
+  // Check that the Transport Stream file exists:
+  FILE* fid = OpenInputFile(env, transportStreamFileName);
+  if (fid == NULL) return NULL;
+  CloseInputFile(fid);
+
+  return new MPEG2TransportStreamIndexer(env, transportStreamFileName, indexFileName);
+}
+
+MPEG2TransportStreamIndexer
+::MPEG2TransportStreamIndexer(UsageEnvironment& env, char const* transportStreamFileName, char const* indexFileName)
+  : MediaSink(env),
+    fTransportStreamFileName(strDup(transportStreamFileName)), fIndexFid(NULL), fIndexer(NULL),
+    fNumIndexRecords(0), fLastPCR(0), fPCRAdjustment(0),
+    fUserAfterFunc(NULL), fUserAfterClientData(NULL),
+    fFollowFileGrowth(False), fPollIntervalMS(1000), fNumTransportPacketsIndexed(0), fPollTask(NULL) {
+  if (indexFileName == NULL) {
+    fIndexFileName = new char[strlen(transportStreamFileName) + 2];
+    sprintf(fIndexFileName, "%sx", transportStreamFileName);
+  } else {
+    fIndexFileName = strDup(indexFileName);
+  }
+}
+
+MPEG2TransportStreamIndexer::~MPEG2TransportStreamIndexer() {
+  envir().taskScheduler().unscheduleDelayedTask(fPollTask);
+  stopPlaying();
+  Medium::close(fIndexer);
+  if (fIndexFid != NULL) CloseOutputFile(fIndexFid);
+
+  delete[] fIndexFileName;
+  delete[] fTransportStreamFileName;
+}
+
+Boolean MPEG2TransportStreamIndexer
+::indexFile(afterPlayingFunc* afterFunc, void* afterClientData,
+	    unsigned long fromTransportPacketNumber, unsigned long toTransportPacketNumber) {
+  if (fIndexFid != NULL) {
+    envir().setResultMsg("This index file is already being written");
+    return False;
+  }
+  fIndexFid = OpenOutputFile(envir(), fIndexFileName);
+  if (fIndexFid == NULL) return False;
+
+  fUserAfterFunc = afterFunc;
+  fUserAfterClientData = afterClientData;
+  fFollowFileGrowth = False;
+  fNumIndexRecords = 0;
+  fLastPCR = fPCRAdjustment = 0;
+
+  return startIndexing(fromTransportPacketNumber, toTransportPacketNumber);
+}
+
+Boolean MPEG2TransportStreamIndexer
+::resumeIndexing(afterPlayingFunc* afterFunc, void* afterClientData, Boolean followFileGrowth, unsigned pollIntervalMS) {
+  if (fIndexFid != NULL) {
+    envir().setResultMsg("This index file is already being written");
+    return False;
+  }
+  // Open the existing index file for updating (or create it, if it doesn't yet exist):
+  fIndexFid = fopen(fIndexFileName, "r+b");
+  if (fIndexFid == NULL) fIndexFid = fopen(fIndexFileName, "w+b");
+  if (fIndexFid == NULL) {
+    envir().setResultMsg("unable to open index file \"", fIndexFileName, "\"");
+    return False;
+  }
+
+  fUserAfterFunc = afterFunc;
+  fUserAfterClientData = afterClientData;
+  fFollowFileGrowth = followFileGrowth;
+  fPollIntervalMS = pollIntervalMS;
+
+  unsigned long fromTransportPacketNumber;
+  findResumptionPoint(fromTransportPacketNumber);
+  return startIndexing(fromTransportPacketNumber, 0);
+}
+
+Boolean MPEG2TransportStreamIndexer
+::mergeIndexFiles(UsageEnvironment& env, char const* outputIndexFileName,
+		  char const* const* inputIndexFileNames, unsigned numInputIndexFiles) {
+  FILE* outFid = OpenOutputFile(env, outputIndexFileName);
+  if (outFid == NULL) return False;
+
+  Boolean success = True;
+  u_int32_t lastPCR = 0, pcrAdjustment = 0;
+  unsigned char record[INDEX_RECORD_SIZE];
+  for (unsigned i = 0; i < numInputIndexFiles; ++i) {
+    FILE* inFid = OpenInputFile(env, inputIndexFileNames[i]);
+    if (inFid == NULL) {
+      success = False;
+      break;
+    }
+
+    while (fread(record, 1, INDEX_RECORD_SIZE, inFid) == INDEX_RECORD_SIZE) {
+      adjustRecordPCR(record, lastPCR, pcrAdjustment);
+      if (fwrite(record, 1, INDEX_RECORD_SIZE, outFid) != INDEX_RECORD_SIZE) {
+	env.setResultErrMsg("failed to write index file: ");
+	success = False;
+	break;
+      }
+    }
+    CloseInputFile(inFid);
+    if (!success) break;
+  }
+
+  CloseOutputFile(outFid);
+  return success;
+}
+
+unsigned long MPEG2TransportStreamIndexer::numTransportPackets() const {
+  return (unsigned long)(GetFileSize(fTransportStreamFileName, NULL)/TRANSPORT_PACKET_SIZE);
+}
+
+Boolean MPEG2TransportStreamIndexer::continuePlaying() {
+  if (fSource == NULL) return False;
+
+  fSource->getNextFrame(fRecord, sizeof fRecord, afterGettingFrame, this, onSourceClosure, this);
+  return True;
+}
+
+Boolean MPEG2TransportStreamIndexer
+::startIndexing(unsigned long fromTransportPacketNumber, unsigned long toTransportPacketNumber) {
+  ByteStreamFileSource* fileSource
+    = ByteStreamFileSource::createNew(envir(), fTransportStreamFileName, TRANSPORT_PACKET_SIZE);
+  if (fileSource == NULL) return False;
+  fIndexer = MPEG2IFrameIndexFromTransportStream::createNew(envir(), fileSource);
+
+  unsigned long firstTransportPacketNumber = fromTransportPacketNumber > NUM_LEAD_IN_TRANSPORT_PACKETS
+    ? fromTransportPacketNumber - NUM_LEAD_IN_TRANSPORT_PACKETS : 0;
+  if (firstTransportPacketNumber > 0) {
+    // We're not starting at the beginning of the file, so first find out - from there - what our indexer needs to know:
+    if (!primeIndexer()) {
+      envir() << "MPEG2TransportStreamIndexer: Warning: Failed to find the video stream at the start of \""
+	      << fTransportStreamFileName << "\"\n";
+    }
+    fileSource->seekToByteAbsolute((u_int64_t)firstTransportPacketNumber*TRANSPORT_PACKET_SIZE);
+  }
+  fIndexer->setInputRange(firstTransportPacketNumber, fromTransportPacketNumber, toTransportPacketNumber);
+
+  SeekFile64(fIndexFid, (int64_t)fNumIndexRecords*INDEX_RECORD_SIZE, SEEK_SET);
+  return startPlaying(*fIndexer, afterIndexing, this);
+}
+
+void MPEG2TransportStreamIndexer::findResumptionPoint(unsigned long& fromTransportPacketNumber) {
+  fromTransportPacketNumber = 0;
+  fNumIndexRecords = 0;
+  fLastPCR = fPCRAdjustment = 0;
+
+  // The last frame in the index file might be incomplete (because the Transport Stream file might have been still
+  // being written when it was indexed), so we re-index from the start of that frame.  Look for its first record:
+  SeekFile64(fIndexFid, 0, SEEK_END);
+  int64_t indexFileSize = TellFile64(fIndexFid);
+  if (indexFileSize <= 0) return;
+
+  unsigned char record[INDEX_RECORD_SIZE];
+  record[0] = 0;
+  unsigned long recordNum = (unsigned long)(indexFileSize/INDEX_RECORD_SIZE);
+  while (recordNum > 0) {
+    if (!readRecord(fIndexFid, --recordNum, record)) return;
+    if ((record[0]&0x80) != 0) break; // the first record of a frame
+  }
+  if ((record[0]&0x80) == 0) return; // no complete frame; re-index from the start
+  fromTransportPacketNumber = recordTransportPacketNumber(record);
+
+  // Other frames might also have begun in the same Transport packet; we'll re-index these too:
+  fNumIndexRecords = recordNum;
+  while (recordNum > 0 && readRecord(fIndexFid, --recordNum, record)
+	 && recordTransportPacketNumber(record) == fromTransportPacketNumber) {
+    if ((record[0]&0x80) != 0) fNumIndexRecords = recordNum;
+  }
+
+  // New records' PCRs must not be less than that of the last record that we keep:
+  if (fNumIndexRecords > 0 && readRecord(fIndexFid, fNumIndexRecords-1, record)) fLastPCR = getRecordPCR(record);
+}
+
+Boolean MPEG2TransportStreamIndexer::primeIndexer() {
+  FILE* fid = OpenInputFile(envir(), fTransportStreamFileName);
+  if (fid == NULL) return False;
+
+  unsigned const numPacketsPerRead = 100;
+  unsigned char* packets = new unsigned char[numPacketsPerRead*TRANSPORT_PACKET_SIZE];
+  Boolean success = False;
+  for (unsigned numPacketsRead = 0; !success && numPacketsRead < MAX_NUM_PRIMING_TRANSPORT_PACKETS; ) {
+    unsigned numPackets = fread(packets, TRANSPORT_PACKET_SIZE, numPacketsPerRead, fid);
+    if (numPackets == 0) break;
+
+    success = fIndexer->primeFromTransportPackets(packets, numPackets);
+    numPacketsRead += numPackets;
+  }
+
+  delete[] packets;
+  CloseInputFile(fid);
+  return success;
+}
+
+void MPEG2TransportStreamIndexer
+::afterGettingFrame(void* clientData, unsigned frameSize, unsigned /*numTruncatedBytes*/,
+		    struct timeval /*presentationTime*/, unsigned /*durationInMicroseconds*/) {
+  MPEG2TransportStreamIndexer* indexer = (MPEG2TransportStreamIndexer*)clientData;
+  indexer->afterGettingFrame(frameSize);
+}
+
+void MPEG2TransportStreamIndexer::afterGettingFrame(unsigned frameSize) {
+  if (frameSize == INDEX_RECORD_SIZE) {
+    adjustRecordPCR(fRecord, fLastPCR, fPCRAdjustment);
+    if (fwrite(fRecord, 1, INDEX_RECORD_SIZE, fIndexFid) == INDEX_RECORD_SIZE) ++fNumIndexRecords;
+  }
+
+  // Then try getting the next index record:
+  continuePlaying();
+}
+
+void MPEG2TransportStreamIndexer::afterIndexing(void* clientData) {
+  // Our indexer's input has ended.  Because we're being called from within the indexer, clean up later:
+  MPEG2TransportStreamIndexer* indexer = (MPEG2TransportStreamIndexer*)clientData;
+  indexer->nextTask() = indexer->envir().taskScheduler().scheduleDelayedTask(0, afterIndexingTask, indexer);
+}
+
+void MPEG2TransportStreamIndexer::afterIndexingTask(void* clientData) {
+  MPEG2TransportStreamIndexer* indexer = (MPEG2TransportStreamIndexer*)clientData;
+  indexer->nextTask() = NULL;
+  indexer->afterIndexing1();
+}
+
+void MPEG2TransportStreamIndexer::afterIndexing1() {
+  stopPlaying();
+  Medium::close(fIndexer);
+  fIndexer = NULL;
+
+  // Discard anything in the index file beyond the records that we've written (e.g., the records for an incomplete final
+  // frame that we've just re-indexed):
+  truncateFile(fIndexFid, (u_int64_t)fNumIndexRecords*INDEX_RECORD_SIZE);
+  fNumTransportPacketsIndexed = numTransportPackets();
+
+  if (fFollowFileGrowth) {
+    fPollTask = envir().taskScheduler().scheduleDelayedTask(fPollIntervalMS*1000, pollForFileGrowth, this);
+    return;
+  }
+
+  CloseOutputFile(fIndexFid);
+  fIndexFid = NULL;
+  if (fUserAfterFunc != NULL) (*fUserAfterFunc)(fUserAfterClientData);
+}
+
+void MPEG2TransportStreamIndexer::pollForFileGrowth(void* clientData) {
+  MPEG2TransportStreamIndexer* indexer = (MPEG2TransportStreamIndexer*)clientData;
+  indexer->pollForFileGrowth1();
+}
+
+void MPEG2TransportStreamIndexer::pollForFileGrowth1() {
+  fPollTask = NULL;
+
+  if (numTransportPackets() > fNumTransportPacketsIndexed) {
+    // The Transport Stream file has grown.  Index the new data (starting from our last, possibly incomplete, frame):
+    unsigned long fromTransportPacketNumber;
+    findResumptionPoint(fromTransportPacketNumber);
+    if (startIndexing(fromTransportPacketNumber, 0)) return;
+  }
+
+  fPollTask = envir().taskScheduler().scheduleDelayedTask(fPollIntervalMS*1000, pollForFileGrowth, this);
+}
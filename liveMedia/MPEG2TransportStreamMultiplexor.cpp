@@ -32,7 +32,7 @@ MPEG2TransportStreamMultiplexor
 ::MPEG2TransportStreamMultiplexor(UsageEnvironment& env)
   : FramedSource(env),
     fHaveVideoStreams(True/*by default*/),
-    fOutgoingPacketCounter(0), fProgramMapVersion(0),
+    fOutgoingPacketCounter(0), fNumDeliveries(0), fMaxPacketsPerDelivery(0), fProgramMapVersion(0),
     fPreviousInputProgramMapVersion(0xFF), fCurrentInputProgramMapVersion(0xFF),
     fPCR_PID(0), fCurrentPID(0),
     fInputBuffer(NULL), fInputBufferSize(0), fInputBufferBytesUsed(0),
@@ -54,36 +54,47 @@ void MPEG2TransportStreamMultiplexor::doGetNextFrame() {
     return;
   }
 
-  do {
-    // Periodically return a Program Association Table packet instead:
-    if (fOutgoingPacketCounter++ % PAT_PERIOD == 0) {
-      deliverPATPacket();
-      break;
+  // Fill the client's buffer with as many Transport packets as will fit (up to "fMaxPacketsPerDelivery", if set), from the
+  // data that we currently have:
+  fFrameSize = 0;
+  if (fMaxSize < TRANSPORT_PACKET_SIZE) {
+    fNumTruncatedBytes = TRANSPORT_PACKET_SIZE; // the client hasn't given us enough space; deliver nothing
+  } else {
+    unsigned maxFrameSize = fMaxSize;
+    if (fMaxPacketsPerDelivery > 0 && fMaxPacketsPerDelivery*TRANSPORT_PACKET_SIZE < maxFrameSize) {
+      maxFrameSize = fMaxPacketsPerDelivery*TRANSPORT_PACKET_SIZE;
     }
+    do {
+      // Periodically return a Program Association Table packet instead:
+      if (fOutgoingPacketCounter++ % PAT_PERIOD == 0) {
+	deliverPATPacket();
+	continue;
+      }
 
-    // Periodically (or when we see a new PID) return a Program Map Table instead:
-    Boolean programMapHasChanged = fPIDState[fCurrentPID].counter == 0
-      || fCurrentInputProgramMapVersion != fPreviousInputProgramMapVersion;
-    if (fOutgoingPacketCounter % PMT_PERIOD == 0 || programMapHasChanged) {
-      if (programMapHasChanged) { // reset values for next time:
-	fPIDState[fCurrentPID].counter = 1;
-	fPreviousInputProgramMapVersion = fCurrentInputProgramMapVersion;
+      // Periodically (or when we see a new PID) return a Program Map Table instead:
+      Boolean programMapHasChanged = fPIDState[fCurrentPID].counter == 0
+	|| fCurrentInputProgramMapVersion != fPreviousInputProgramMapVersion;
+      if (fOutgoingPacketCounter % PMT_PERIOD == 0 || programMapHasChanged) {
+	if (programMapHasChanged) { // reset values for next time:
+	  fPIDState[fCurrentPID].counter = 1;
+	  fPreviousInputProgramMapVersion = fCurrentInputProgramMapVersion;
+	}
+	deliverPMTPacket(programMapHasChanged);
+	continue;
       }
-      deliverPMTPacket(programMapHasChanged);
-      break;
-    }
 
-    // Normal case: Deliver (or continue delivering) the recently-read data:
-    deliverDataToClient(fCurrentPID, fInputBuffer, fInputBufferSize,
-			fInputBufferBytesUsed);
-  } while (0);
+      // Normal case: Deliver (or continue delivering) the recently-read data:
+      deliverDataToClient(fCurrentPID, fInputBuffer, fInputBufferSize,
+			  fInputBufferBytesUsed);
+    } while (fInputBufferBytesUsed < fInputBufferSize && maxFrameSize - fFrameSize >= TRANSPORT_PACKET_SIZE);
+  }
 
   // NEED TO SET fPresentationTime, durationInMicroseconds #####
   // Complete the delivery to the client:
-  if ((fOutgoingPacketCounter%10) == 0) {
+  if ((++fNumDeliveries%10) == 0) {
     // To avoid excessive recursion (and stack overflow) caused by excessively large input frames,
     // occasionally return to the event loop to do this:
-    envir().taskScheduler().scheduleDelayedTask(0, (TaskFunc*)FramedSource::afterGetting, this);
+    nextTask() = envir().taskScheduler().scheduleDelayedTask(0, (TaskFunc*)FramedSource::afterGetting, this);
   } else {
     afterGetting(this);
   }
@@ -145,93 +156,89 @@ void MPEG2TransportStreamMultiplexor
 void MPEG2TransportStreamMultiplexor
 ::deliverDataToClient(u_int8_t pid, unsigned char* buffer, unsigned bufferSize,
 		      unsigned& startPositionInBuffer) {
-  // Construct a new Transport packet, and deliver it to the client:
-  if (fMaxSize < TRANSPORT_PACKET_SIZE) {
-    fFrameSize = 0; // the client hasn't given us enough space; deliver nothing
-    fNumTruncatedBytes = TRANSPORT_PACKET_SIZE;
-  } else {
-    fFrameSize = TRANSPORT_PACKET_SIZE;
-    Boolean willAddPCR = pid == fPCR_PID && startPositionInBuffer == 0
-      && !(fPCR.highBit == 0 && fPCR.remainingBits == 0 && fPCR.extension == 0);
-    unsigned const numBytesAvailable = bufferSize - startPositionInBuffer;
-    unsigned numHeaderBytes = 4; // by default
-    unsigned numPCRBytes = 0; // by default
-    unsigned numPaddingBytes = 0; // by default
-    unsigned numDataBytes;
-    u_int8_t adaptation_field_control;
-    if (willAddPCR) {
-      adaptation_field_control = 0x30;
-      numHeaderBytes += 2; // for the "adaptation_field_length" and flags
-      numPCRBytes = 6;
-      if (numBytesAvailable >= TRANSPORT_PACKET_SIZE - numHeaderBytes - numPCRBytes) {
-	numDataBytes = TRANSPORT_PACKET_SIZE - numHeaderBytes - numPCRBytes;
-      } else {
-	numDataBytes = numBytesAvailable;
-	numPaddingBytes
-	  = TRANSPORT_PACKET_SIZE - numHeaderBytes - numPCRBytes - numDataBytes;
-      }
-    } else if (numBytesAvailable >= TRANSPORT_PACKET_SIZE - numHeaderBytes) {
-      // This is the common case
-      adaptation_field_control = 0x10;
-      numDataBytes = TRANSPORT_PACKET_SIZE - numHeaderBytes;
+  // Construct a new Transport packet, and add it to the data that we're delivering to the client.
+  // (Our caller has checked that there's room for it.)
+  Boolean willAddPCR = pid == fPCR_PID && startPositionInBuffer == 0
+    && !(fPCR.highBit == 0 && fPCR.remainingBits == 0 && fPCR.extension == 0);
+  unsigned const numBytesAvailable = bufferSize - startPositionInBuffer;
+  unsigned numHeaderBytes = 4; // by default
+  unsigned numPCRBytes = 0; // by default
+  unsigned numPaddingBytes = 0; // by default
+  unsigned numDataBytes;
+  u_int8_t adaptation_field_control;
+  if (willAddPCR) {
+    adaptation_field_control = 0x30;
+    numHeaderBytes += 2; // for the "adaptation_field_length" and flags
+    numPCRBytes = 6;
+    if (numBytesAvailable >= TRANSPORT_PACKET_SIZE - numHeaderBytes - numPCRBytes) {
+      numDataBytes = TRANSPORT_PACKET_SIZE - numHeaderBytes - numPCRBytes;
     } else {
-      adaptation_field_control = 0x30;
-      ++numHeaderBytes; // for the "adaptation_field_length"
-      // ASSERT: numBytesAvailable <= TRANSPORT_PACKET_SIZE - numHeaderBytes
       numDataBytes = numBytesAvailable;
-      if (numDataBytes < TRANSPORT_PACKET_SIZE - numHeaderBytes) {
-	++numHeaderBytes; // for the adaptation field flags
-	numPaddingBytes = TRANSPORT_PACKET_SIZE - numHeaderBytes - numDataBytes;
-      }
+      numPaddingBytes
+	= TRANSPORT_PACKET_SIZE - numHeaderBytes - numPCRBytes - numDataBytes;
     }
-    // ASSERT: numHeaderBytes+numPCRBytes+numPaddingBytes+numDataBytes
-    //         == TRANSPORT_PACKET_SIZE
-
-    // Fill in the header of the Transport Stream packet:
-    unsigned char* header = fTo;
-    *header++ = 0x47; // sync_byte
-    *header++ = (startPositionInBuffer == 0) ? 0x40 : 0x00;
-      // transport_error_indicator, payload_unit_start_indicator, transport_priority,
-      // first 5 bits of PID
-    *header++ = pid;
-      // last 8 bits of PID
-    unsigned& continuity_counter = fPIDState[pid].counter; // alias
-    *header++ = adaptation_field_control|(continuity_counter&0x0F);
-      // transport_scrambling_control, adaptation_field_control, continuity_counter
-    ++continuity_counter;
-    if (adaptation_field_control == 0x30) {
-      // Add an adaptation field:
-      u_int8_t adaptation_field_length
-	= (numHeaderBytes == 5) ? 0 : 1 + numPCRBytes + numPaddingBytes;
-      *header++ = adaptation_field_length;
-      if (numHeaderBytes > 5) {
-	u_int8_t flags = willAddPCR ? 0x10 : 0x00;
-	if (fIsFirstAdaptationField) {
-	  flags |= 0x80; // discontinuity_indicator
-	  fIsFirstAdaptationField = False;
-	}
-	*header++ = flags;
-	if (willAddPCR) {
-	  u_int32_t pcrHigh32Bits = (fPCR.highBit<<31) | (fPCR.remainingBits>>1);
-	  u_int8_t pcrLowBit = fPCR.remainingBits&1;
-	  u_int8_t extHighBit = (fPCR.extension&0x100)>>8;
-	  *header++ = pcrHigh32Bits>>24;
-	  *header++ = pcrHigh32Bits>>16;
-	  *header++ = pcrHigh32Bits>>8;
-	  *header++ = pcrHigh32Bits;
-	  *header++ = (pcrLowBit<<7)|0x7E|extHighBit;
-	  *header++ = (u_int8_t)fPCR.extension; // low 8 bits of extension
-	}
+  } else if (numBytesAvailable >= TRANSPORT_PACKET_SIZE - numHeaderBytes) {
+    // This is the common case
+    adaptation_field_control = 0x10;
+    numDataBytes = TRANSPORT_PACKET_SIZE - numHeaderBytes;
+  } else {
+    adaptation_field_control = 0x30;
+    ++numHeaderBytes; // for the "adaptation_field_length"
+    // ASSERT: numBytesAvailable <= TRANSPORT_PACKET_SIZE - numHeaderBytes
+    numDataBytes = numBytesAvailable;
+    if (numDataBytes < TRANSPORT_PACKET_SIZE - numHeaderBytes) {
+      ++numHeaderBytes; // for the adaptation field flags
+      numPaddingBytes = TRANSPORT_PACKET_SIZE - numHeaderBytes - numDataBytes;
+    }
+  }
+  // ASSERT: numHeaderBytes+numPCRBytes+numPaddingBytes+numDataBytes
+  //         == TRANSPORT_PACKET_SIZE
+
+  // Fill in the header of the Transport Stream packet:
+  unsigned char* header = &fTo[fFrameSize];
+  fFrameSize += TRANSPORT_PACKET_SIZE;
+  *header++ = 0x47; // sync_byte
+  *header++ = (startPositionInBuffer == 0) ? 0x40 : 0x00;
+    // transport_error_indicator, payload_unit_start_indicator, transport_priority,
+    // first 5 bits of PID
+  *header++ = pid;
+    // last 8 bits of PID
+  unsigned& continuity_counter = fPIDState[pid].counter; // alias
+  *header++ = adaptation_field_control|(continuity_counter&0x0F);
+    // transport_scrambling_control, adaptation_field_control, continuity_counter
+  ++continuity_counter;
+  if (adaptation_field_control == 0x30) {
+    // Add an adaptation field:
+    u_int8_t adaptation_field_length
+      = (numHeaderBytes == 5) ? 0 : 1 + numPCRBytes + numPaddingBytes;
+    *header++ = adaptation_field_length;
+    if (numHeaderBytes > 5) {
+      u_int8_t flags = willAddPCR ? 0x10 : 0x00;
+      if (fIsFirstAdaptationField) {
+	flags |= 0x80; // discontinuity_indicator
+	fIsFirstAdaptationField = False;
+      }
+      *header++ = flags;
+      if (willAddPCR) {
+	u_int32_t pcrHigh32Bits = (fPCR.highBit<<31) | (fPCR.remainingBits>>1);
+	u_int8_t pcrLowBit = fPCR.remainingBits&1;
+	u_int8_t extHighBit = (fPCR.extension&0x100)>>8;
+	*header++ = pcrHigh32Bits>>24;
+	*header++ = pcrHigh32Bits>>16;
+	*header++ = pcrHigh32Bits>>8;
+	*header++ = pcrHigh32Bits;
+	*header++ = (pcrLowBit<<7)|0x7E|extHighBit;
+	*header++ = (u_int8_t)fPCR.extension; // low 8 bits of extension
       }
     }
+  }
 
-    // Add any padding bytes:
-    for (unsigned i = 0; i < numPaddingBytes; ++i) *header++ = 0xFF;
+  // Add any padding bytes:
+  for (unsigned i = 0; i < numPaddingBytes; ++i) *header++ = 0xFF;
 
-    // Finally, add the data bytes:
-    memmove(header, &buffer[startPositionInBuffer], numDataBytes);
-    startPositionInBuffer += numDataBytes;
-  }
+  // Finally, add the data bytes:
+  memmove(header, &buffer[startPositionInBuffer], numDataBytes);
+  startPositionInBuffer += numDataBytes;
 }
 
 #define PAT_PID 0
@@ -239,11 +246,10 @@ void MPEG2TransportStreamMultiplexor
 #define OUR_PROGRAM_MAP_PID 0x30
 
 void MPEG2TransportStreamMultiplexor::deliverPATPacket() {
-  // First, create a new buffer for the PAT packet:
+  // First, fill in the PAT packet's payload:
   unsigned const patSize = TRANSPORT_PACKET_SIZE - 4; // allow for the 4-byte header
-  unsigned char* patBuffer = new unsigned char[patSize];
+  unsigned char patBuffer[patSize];
 
-  // and fill it in:
   unsigned char* pat = patBuffer;
   *pat++ = 0; // pointer_field
   *pat++ = 0; // table_id
@@ -267,19 +273,15 @@ void MPEG2TransportStreamMultiplexor::deliverPATPacket() {
   // Deliver the packet:
   unsigned startPosition = 0;
   deliverDataToClient(PAT_PID, patBuffer, patSize, startPosition);
-
-  // Finally, remove the new buffer:
-  delete[] patBuffer;
 }
 
 void MPEG2TransportStreamMultiplexor::deliverPMTPacket(Boolean hasChanged) {
   if (hasChanged) ++fProgramMapVersion;
 
-  // First, create a new buffer for the PMT packet:
+  // First, fill in the PMT packet's payload:
   unsigned const pmtSize = TRANSPORT_PACKET_SIZE - 4; // allow for the 4-byte header
-  unsigned char* pmtBuffer = new unsigned char[pmtSize];
+  unsigned char pmtBuffer[pmtSize];
 
-  // and fill it in:
   unsigned char* pmt = pmtBuffer;
   *pmt++ = 0; // pointer_field
   *pmt++ = 2; // table_id
@@ -317,9 +319,6 @@ void MPEG2TransportStreamMultiplexor::deliverPMTPacket(Boolean hasChanged) {
   // Deliver the packet:
   unsigned startPosition = 0;
   deliverDataToClient(OUR_PROGRAM_MAP_PID, pmtBuffer, pmtSize, startPosition);
-
-  // Finally, remove the new buffer:
-  delete[] pmtBuffer;
 }
 
 void MPEG2TransportStreamMultiplexor::setProgramStreamMap(unsigned frameSize) {
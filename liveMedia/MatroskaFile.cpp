@@ -32,6 +32,7 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #include <VP8VideoRTPSink.hh>
 #include <TheoraVideoRTPSink.hh>
 #include <T140TextRTPSink.hh>
+#include "InputFile.hh"
 
 ////////// CuePoint definition //////////
 
@@ -94,6 +95,58 @@ private:
 };
 
 
+////////// MatroskaMetadata and MatroskaMetadataCache definitions //////////
+
+// The result of parsing a Matroska file's headers and 'Cues'.  This is shared - via a per-environment cache - by all
+// "MatroskaFile"s for the same file, as long as the file's size and modification time remain unchanged:
+class MatroskaMetadata {
+public:
+  MatroskaMetadata(char const* fileName, u_int64_t fileSize, time_t modificationTime);
+  virtual ~MatroskaMetadata(); // also deletes "trackTable" and "cuePoints"
+
+  Boolean isCurrent() const; // True iff the file hasn't changed since it was parsed
+
+  char* fileName;
+  u_int64_t fileSize;
+  time_t modificationTime;
+
+  unsigned timecodeScale;
+  float segmentDuration;
+  u_int64_t segmentDataOffset, clusterOffset, cuesOffset;
+  MatroskaTrackTable* trackTable;
+  CuePoint* cuePoints;
+
+  unsigned referenceCount; // the number of "MatroskaFile"s that are using us
+  Boolean isInCache;
+};
+
+class MatroskaMetadataCache {
+public:
+  static MatroskaMetadata* lookup(UsageEnvironment& env, char const* fileName);
+      // Returns (a new reference to) the metadata for the named file, or NULL if none is cached (or it's out of date)
+  static Boolean add(UsageEnvironment& env, MatroskaMetadata* metadata);
+      // If successful, the cache holds "metadata" (with one reference, for the caller)
+  static void release(UsageEnvironment& env, MatroskaMetadata* metadata);
+  static void flush(UsageEnvironment& env);
+
+private:
+  MatroskaMetadataCache();
+  virtual ~MatroskaMetadataCache();
+
+  static MatroskaMetadataCache* ourCache(UsageEnvironment& env, Boolean createIfNotPresent);
+  void remove(MatroskaMetadata* metadata);
+  void removeUnusedEntries(unsigned maxNumToKeep);
+  void reclaimIfPossible(UsageEnvironment& env);
+
+private:
+  HashTable* fTable; // indexed by file name
+  unsigned fNumUnusedEntries;
+};
+
+// The maximum number of cached entries for files that are not currently open:
+#define MATROSKA_METADATA_CACHE_MAX_UNUSED_ENTRIES 1000
+
+
 
 ////////// MatroskaFile implementation //////////
 
@@ -109,10 +162,27 @@ MatroskaFile::MatroskaFile(UsageEnvironment& env, char const* fileName, onCreati
     fFileName(strDup(fileName)), fOnCreation(onCreation), fOnCreationClientData(onCreationClientData),
     fPreferredLanguage(strDup(preferredLanguage)),
     fTimecodeScale(1000000), fSegmentDuration(0.0), fSegmentDataOffset(0), fClusterOffset(0), fCuesOffset(0), fCuePoints(NULL),
-    fChosenVideoTrackNumber(0), fChosenAudioTrackNumber(0), fChosenSubtitleTrackNumber(0) {
-  fTrackTable = new MatroskaTrackTable;
+    fChosenVideoTrackNumber(0), fChosenAudioTrackNumber(0), fChosenSubtitleTrackNumber(0),
+    fParserForInitialization(NULL), fMetadata(NULL), fCreationTask(NULL) {
   fDemuxesTable = HashTable::create(ONE_WORD_HASH_KEYS);
 
+  fMetadata = MatroskaMetadataCache::lookup(envir(), fileName);
+  if (fMetadata != NULL) {
+    // We've already parsed this file, so use the result of that:
+    fTimecodeScale = fMetadata->timecodeScale;
+    fSegmentDuration = fMetadata->segmentDuration;
+    fSegmentDataOffset = fMetadata->segmentDataOffset;
+    fClusterOffset = fMetadata->clusterOffset;
+    fCuesOffset = fMetadata->cuesOffset;
+    fTrackTable = fMetadata->trackTable;
+    fCuePoints = fMetadata->cuePoints;
+
+    // We still signal our creation from the event loop, as usual:
+    fCreationTask = envir().taskScheduler().scheduleDelayedTask(0, (TaskFunc*)handleEndOfTrackHeaderParsing, this);
+    return;
+  }
+
+  fTrackTable = new MatroskaTrackTable;
   FramedSource* inputSource = ByteStreamFileSource::createNew(envir(), fileName);
   if (inputSource == NULL) {
     // The specified input file does not exist!
@@ -125,8 +195,8 @@ MatroskaFile::MatroskaFile(UsageEnvironment& env, char const* fileName, onCreati
 }
 
 MatroskaFile::~MatroskaFile() {
+  envir().taskScheduler().unscheduleDelayedTask(fCreationTask);
   delete fParserForInitialization;
-  delete fCuePoints;
 
   // Delete any outstanding "MatroskaDemux"s, and the table for them:
   MatroskaDemux* demux;
@@ -134,7 +204,13 @@ MatroskaFile::~MatroskaFile() {
     delete demux;
   }
   delete fDemuxesTable;
-  delete fTrackTable;
+
+  if (fMetadata != NULL) {
+    MatroskaMetadataCache::release(envir(), fMetadata); // this owns our track table and cue points
+  } else {
+    delete fTrackTable;
+    delete fCuePoints;
+  }
 
   delete[] (char*)fPreferredLanguage;
   delete[] (char*)fFileName;
@@ -151,7 +227,12 @@ public:
   unsigned choiceFlags;
 };
 
+void MatroskaFile::flushMetadataCache(UsageEnvironment& env) {
+  MatroskaMetadataCache::flush(env);
+}
+
 void MatroskaFile::handleEndOfTrackHeaderParsing() {
+  fCreationTask = NULL;
   // Having parsed all of our track headers, iterate through the tracks to figure out which ones should be played.
   // The Matroska 'specification' is rather imprecise about this (as usual).  However, we use the following algorithm:
   // - Use one (but no more) enabled track of each type (video, audio, subtitle).  (Ignore all tracks that are not 'enabled'.)
@@ -215,12 +296,37 @@ void MatroskaFile::handleEndOfTrackHeaderParsing() {
 #endif
 
   // Delete our parser, because it's done its job now:
-  delete fParserForInitialization; fParserForInitialization = NULL;
+  if (fParserForInitialization != NULL) {
+    delete fParserForInitialization; fParserForInitialization = NULL;
+
+    // Cache the result of the parsing, for any later "MatroskaFile"s for the same file:
+    if (numTracks > 0) addToMetadataCache();
+  }
 
   // Finally, signal our caller that we've been created and initialized:
   if (fOnCreation != NULL) (*fOnCreation)(this, fOnCreationClientData);
 }
 
+void MatroskaFile::addToMetadataCache() {
+  MatroskaMetadata* metadata
+    = new MatroskaMetadata(fFileName, GetFileSize(fFileName, NULL), GetFileModificationTime(fFileName));
+  metadata->timecodeScale = fTimecodeScale;
+  metadata->segmentDuration = fSegmentDuration;
+  metadata->segmentDataOffset = fSegmentDataOffset;
+  metadata->clusterOffset = fClusterOffset;
+  metadata->cuesOffset = fCuesOffset;
+  metadata->trackTable = fTrackTable;
+  metadata->cuePoints = fCuePoints;
+
+  if (MatroskaMetadataCache::add(envir(), metadata)) {
+    fMetadata = metadata; // it now owns our track table and cue points
+  } else {
+    // (Another "MatroskaFile" for the same file got cached first.)  We keep our own track table and cue points:
+    metadata->trackTable = NULL; metadata->cuePoints = NULL;
+    delete metadata;
+  }
+}
+
 MatroskaTrack* MatroskaFile::lookup(unsigned trackNumber) const {
   return fTrackTable->lookup(trackNumber);
 }
@@ -692,6 +798,141 @@ MatroskaTrack* MatroskaTrackTable::Iterator::next() {
 }
 
 
+////////// MatroskaMetadata and MatroskaMetadataCache implementation //////////
+
+MatroskaMetadata::MatroskaMetadata(char const* fileName, u_int64_t fileSize, time_t modificationTime)
+  : fileName(strDup(fileName)), fileSize(fileSize), modificationTime(modificationTime),
+    timecodeScale(1000000), segmentDuration(0.0), segmentDataOffset(0), clusterOffset(0), cuesOffset(0),
+    trackTable(NULL), cuePoints(NULL), referenceCount(0), isInCache(False) {
+}
+
+MatroskaMetadata::~MatroskaMetadata() {
+  delete cuePoints;
+  delete trackTable;
+  delete[] fileName;
+}
+
+Boolean MatroskaMetadata::isCurrent() const {
+  return GetFileSize(fileName, NULL) == fileSize && GetFileModificationTime(fileName) == modificationTime;
+}
+
+MatroskaMetadataCache::MatroskaMetadataCache()
+  : fTable(HashTable::create(STRING_HASH_KEYS)), fNumUnusedEntries(0) {
+}
+
+MatroskaMetadataCache::~MatroskaMetadataCache() {
+  delete fTable;
+}
+
+MatroskaMetadataCache* MatroskaMetadataCache::ourCache(UsageEnvironment& env, Boolean createIfNotPresent) {
+  _Tables* ourTables = _Tables::getOurTables(env, createIfNotPresent);
+  if (ourTables == NULL) return NULL;
+
+  if (ourTables->matroskaMetadataCache == NULL && createIfNotPresent) {
+    ourTables->matroskaMetadataCache = new MatroskaMetadataCache;
+  }
+  return (MatroskaMetadataCache*)(ourTables->matroskaMetadataCache);
+}
+
+MatroskaMetadata* MatroskaMetadataCache::lookup(UsageEnvironment& env, char const* fileName) {
+  MatroskaMetadataCache* cache = ourCache(env, False);
+  if (cache == NULL) return NULL;
+
+  MatroskaMetadata* metadata = (MatroskaMetadata*)(cache->fTable->Lookup(fileName));
+  if (metadata == NULL) return NULL;
+
+  if (!metadata->isCurrent()) {
+    // The file has changed since we parsed it, so our cached metadata is no longer valid:
+    cache->remove(metadata);
+    cache->reclaimIfPossible(env);
+    return NULL;
+  }
+
+  if (metadata->referenceCount++ == 0) --cache->fNumUnusedEntries;
+  return metadata;
+}
+
+Boolean MatroskaMetadataCache::add(UsageEnvironment& env, MatroskaMetadata* metadata) {
+  MatroskaMetadataCache* cache = ourCache(env, True);
+
+  MatroskaMetadata* existingMetadata = (MatroskaMetadata*)(cache->fTable->Lookup(metadata->fileName));
+  if (existingMetadata != NULL) {
+    if (existingMetadata->isCurrent()) return False;
+    cache->remove(existingMetadata);
+  }
+
+  cache->fTable->Add(metadata->fileName, metadata);
+  metadata->isInCache = True;
+  metadata->referenceCount = 1;
+  return True;
+}
+
+void MatroskaMetadataCache::release(UsageEnvironment& env, MatroskaMetadata* metadata) {
+  if (--metadata->referenceCount > 0) return;
+
+  if (!metadata->isInCache) {
+    // This metadata was removed from the cache (because its file changed) while it was still being used:
+    delete metadata;
+    return;
+  }
+
+  // Keep the metadata in the cache (in case the file gets opened again), unless we already have too many unused entries:
+  MatroskaMetadataCache* cache = ourCache(env, False);
+  if (cache == NULL) return; // shouldn't happen
+  ++cache->fNumUnusedEntries;
+  cache->removeUnusedEntries(MATROSKA_METADATA_CACHE_MAX_UNUSED_ENTRIES);
+}
+
+void MatroskaMetadataCache::flush(UsageEnvironment& env) {
+  MatroskaMetadataCache* cache = ourCache(env, False);
+  if (cache == NULL) return;
+
+  cache->removeUnusedEntries(0);
+  cache->reclaimIfPossible(env);
+}
+
+void MatroskaMetadataCache::remove(MatroskaMetadata* metadata) {
+  fTable->Remove(metadata->fileName);
+  metadata->isInCache = False;
+  if (metadata->referenceCount == 0) {
+    --fNumUnusedEntries;
+    delete metadata;
+  }
+  // Otherwise, the metadata gets deleted when its last user releases it
+}
+
+void MatroskaMetadataCache::removeUnusedEntries(unsigned maxNumToKeep) {
+  while (fNumUnusedEntries > maxNumToKeep) {
+    // Find an unused entry, and remove it.  (We don't bother to keep track of which unused entry is the oldest.)
+    MatroskaMetadata* unusedMetadata = NULL;
+    HashTable::Iterator* iter = HashTable::Iterator::create(*fTable);
+    MatroskaMetadata* metadata;
+    char const* key;
+    while ((metadata = (MatroskaMetadata*)(iter->next(key))) != NULL) {
+      if (metadata->referenceCount == 0) {
+	unusedMetadata = metadata;
+	break;
+      }
+    }
+    delete iter;
+
+    if (unusedMetadata == NULL) break; // shouldn't happen
+    remove(unusedMetadata);
+  }
+}
+
+void MatroskaMetadataCache::reclaimIfPossible(UsageEnvironment& env) {
+  if (fTable->numEntries() > 0) return;
+
+  _Tables* ourTables = _Tables::getOurTables(env, False);
+  if (ourTables != NULL) {
+    ourTables->matroskaMetadataCache = NULL;
+    ourTables->reclaimIfPossible();
+  }
+  delete this;
+}
+
+
 ////////// MatroskaTrack implementation //////////
 
 MatroskaTrack::MatroskaTrack()
@@ -31,7 +31,7 @@ MatroskaFileParser::MatroskaFileParser(MatroskaFile& ourFile, FramedSource* inpu
     fOnEndFunc(onEndFunc), fOnEndClientData(onEndClientData),
     fOurDemux(ourDemux),
     fCurOffsetInFile(0), fSavedCurOffsetInFile(0), fLimitOffsetInFile(0),
-    fNumHeaderBytesToSkip(0), fClusterTimecode(0), fBlockTimecode(0),
+    fNumHeaderBytesToSkip(0), fScanBaseOffset(0), fClusterTimecode(0), fBlockTimecode(0),
     fFrameSizesWithinBlock(NULL),
     fPresentationTimeOffset(0.0) {
   if (ourDemux == NULL) {
@@ -130,11 +130,22 @@ Boolean MatroskaFileParser::parse() {
 	    seekToFilePosition(fOurFile.fCuesOffset);
 	    fCurrentParseState = PARSING_CUES;
 	    areDone = False;
+	  } else if (areDone && startScanningClusters(True)) {
+	    // There are no 'Cues' in the file, so build our own (from the 'Cluster' headers) before finishing:
+	    areDone = False;
 	  }
 	  break;
 	}
         case PARSING_CUES: {
 	  areDone = parseCues();
+	  if (areDone && fOurFile.fCuePoints == NULL && startScanningClusters(False)) {
+	    // The 'Cues' were missing or empty, so build our own (from the 'Cluster' headers) before finishing:
+	    areDone = False;
+	  }
+	  break;
+	}
+        case SCANNING_CLUSTERS: {
+	  areDone = scanClusters();
 	  break;
 	}
         case LOOKING_FOR_CLUSTER: {
@@ -852,6 +863,99 @@ Boolean MatroskaFileParser::parseCues() {
   return True; // we're done parsing Cues
 }
 
+Boolean MatroskaFileParser::startScanningClusters(Boolean curOffsetIsFromStartOfFile) {
+  // We can scan only a (seekable) file of known size:
+  ByteStreamFileSource* fileSource = (ByteStreamFileSource*)fInputSource; // we know it's a "ByteStreamFileSource"
+  if (fileSource == NULL || fileSource->fileSize() == 0) return False;
+
+  if (fOurFile.fClusterOffset > 0) {
+    // Start at the first 'Cluster' (whose location was reported in the 'Seek Head'):
+    seekToFilePosition(fOurFile.fClusterOffset);
+    fScanBaseOffset = fOurFile.fClusterOffset;
+  } else if (curOffsetIsFromStartOfFile) {
+    // Continue scanning from where we are now:
+    fScanBaseOffset = 0;
+  } else {
+    return False; // we don't know where we are in the file
+  }
+
+#ifdef DEBUG
+  fprintf(stderr, "scanning Clusters, from file position %llu\n", fScanBaseOffset + fCurOffsetInFile);
+#endif
+  fLimitOffsetInFile = 0;
+  fCurrentParseState = SCANNING_CLUSTERS;
+  return True;
+}
+
+Boolean MatroskaFileParser::scanClusters() {
+  // Read each 'Cluster' header - and its 'Timecode' - and record its position as a cue point.  We seek over each
+  // 'Cluster's data, so only a small part of the file gets read.
+  ByteStreamFileSource* fileSource = (ByteStreamFileSource*)fInputSource;
+  EBMLId id;
+  EBMLDataSize size;
+  while (fScanBaseOffset + fCurOffsetInFile < fileSource->fileSize()) {
+    setParseState();
+    if (!parseEBMLIdAndSize(id, size)) return True; // we can't parse the file, so stop scanning
+    u_int64_t const dataOffset = fScanBaseOffset + fCurOffsetInFile; // of the data within this header
+    u_int64_t const dataSize = size.val();
+    if (dataSize == ((u_int64_t)1<<(7*size.len)) - 1) {
+      // This header has 'unknown' size.  Unless it's the 'Segment', we can't skip over it, so stop scanning:
+      if (id == MATROSKA_ID_SEGMENT) continue;
+      return True;
+    }
+#ifdef DEBUG
+    fprintf(stderr, "MatroskaFileParser::scanClusters(): Parsed id 0x%s (%s), size: %lld\n", id.hexString(), id.stringName(), size.val());
+#endif
+
+    switch (id.val()) {
+      case MATROSKA_ID_SEGMENT: { // 'Segment' header: enter this
+	break;
+      }
+      case MATROSKA_ID_CLUSTER: { // 'Cluster' header: look for its 'Timecode' (normally the first header within it)
+	u_int64_t const clusterOffsetInFile = dataOffset - id.len - size.len;
+	while (fScanBaseOffset + fCurOffsetInFile < dataOffset + dataSize) {
+	  if (!parseEBMLIdAndSize(id, size)) break;
+	  if (id == MATROSKA_ID_TIMECODE) {
+	    unsigned timecode;
+	    if (parseEBMLVal_unsigned(size, timecode)) {
+	      fOurFile.addCuePoint(timecode*(fOurFile.fTimecodeScale/1000000000.0), clusterOffsetInFile, 1);
+	    }
+	    break;
+	  }
+	  if (size.val() > 100) break; // the 'Timecode' wasn't near the start of the 'Cluster', so give up on it
+	  skipBytes((unsigned)size.val()); // e.g., a 'CRC-32' or 'Void'
+	  fCurOffsetInFile += size.val();
+	}
+
+	// Then seek to the end of the 'Cluster':
+	fScanBaseOffset = dataOffset + dataSize;
+	seekToFilePosition(fScanBaseOffset);
+	break;
+      }
+      default: { // Skip over this header.  (If it's large, then seek over it instead.)
+	if (dataSize < bankSize()/2) {
+	  skipBytes((unsigned)dataSize);
+	  fCurOffsetInFile += dataSize;
+	} else {
+	  fScanBaseOffset = dataOffset + dataSize;
+	  seekToFilePosition(fScanBaseOffset);
+	}
+	break;
+      }
+    }
+  }
+
+#if defined(DEBUG) || defined(DEBUG_CUES)
+  fprintf(stderr, "done scanning Clusters\n");
+#endif
+#ifdef DEBUG_CUES
+  fprintf(stderr, "Cue Point tree: ");
+  fOurFile.printCuePoints(stderr);
+  fprintf(stderr, "\n");
+#endif
+  return True; // we're done scanning
+}
+
 typedef enum { NoLacing, XiphLacing, FixedSizeLacing, EBMLLacing } MatroskaLacingType;
 
 void MatroskaFileParser::parseBlock() {
@@ -1111,22 +1215,19 @@ void MatroskaFileParser::deliverFrameBytes() {
     MatroskaDemuxedTrack* demuxedTrack = fOurDemux->lookupDemuxedTrack(fBlockTrackNumber);
     if (demuxedTrack == NULL) break; // shouldn't happen
 
-    unsigned const BANK_SIZE = bankSize();
+    // Copy (or skip) the frame's bytes as they arrive in the parser's bank, rather than waiting until the whole frame
+    // (or BANK_SIZE bytes of it) is in the bank:
     while (fCurFrameNumBytesToGet > 0) {
-      // Hack: We can get no more than BANK_SIZE bytes at a time:
-      unsigned numBytesToGet = fCurFrameNumBytesToGet > BANK_SIZE ? BANK_SIZE : fCurFrameNumBytesToGet;
-      getBytes(fCurFrameTo, numBytesToGet);
-      fCurFrameTo += numBytesToGet;
-      fCurFrameNumBytesToGet -= numBytesToGet;
-      fCurOffsetWithinFrame += numBytesToGet;
+      unsigned numBytesGotten = getAvailableBytes(fCurFrameTo, fCurFrameNumBytesToGet);
+      fCurFrameTo += numBytesGotten;
+      fCurFrameNumBytesToGet -= numBytesGotten;
+      fCurOffsetWithinFrame += numBytesGotten;
       setParseState();
     }
     while (fCurFrameNumBytesToSkip > 0) {
-      // Hack: We can skip no more than BANK_SIZE bytes at a time:
-      unsigned numBytesToSkip = fCurFrameNumBytesToSkip > BANK_SIZE ? BANK_SIZE : fCurFrameNumBytesToSkip;
-      skipBytes(numBytesToSkip);
-      fCurFrameNumBytesToSkip -= numBytesToSkip;
-      fCurOffsetWithinFrame += numBytesToSkip;
+      unsigned numBytesSkipped = skipAvailableBytes(fCurFrameNumBytesToSkip);
+      fCurFrameNumBytesToSkip -= numBytesSkipped;
+      fCurOffsetWithinFrame += numBytesSkipped;
       setParseState();
     }
 #ifdef DEBUG
@@ -36,6 +36,7 @@ enum MatroskaParseState {
   LOOKING_FOR_TRACKS,
   PARSING_TRACK,
   PARSING_CUES,
+  SCANNING_CLUSTERS,
   LOOKING_FOR_CLUSTER,
   LOOKING_FOR_BLOCK,
   PARSING_BLOCK,
@@ -65,6 +66,8 @@ private:
   void lookForNextTrack();
   Boolean parseTrack();
   Boolean parseCues();
+  Boolean startScanningClusters(Boolean curOffsetIsFromStartOfFile);
+  Boolean scanClusters();
 
   void lookForNextBlock();
   void parseBlock();
@@ -110,6 +113,9 @@ private:
   // For parsing 'Seek ID's:
   EBMLId fLastSeekId;
 
+  // For building our own index of 'Cluster's (used as cue points), if the file has no 'Cues':
+  u_int64_t fScanBaseOffset; // the file offset that corresponds to "fCurOffsetInFile" == 0
+
   // Parameters of the most recently-parsed 'Cluster':
   unsigned fClusterTimecode;
 
@@ -603,7 +603,7 @@ MediaSubsession::MediaSubsession(MediaSession& parent)
     fAttributeTable(HashTable::create(STRING_HASH_KEYS)),
     fRTPSocket(NULL), fRTCPSocket(NULL),
     fRTPSource(NULL), fRTCPInstance(NULL), fReadSource(NULL),
-    fReceiveRawMP3ADUs(False), fReceiveRawJPEGFrames(False),
+    fReceiveRawMP3ADUs(False), fReceiveRawJPEGFrames(False), fReceiveRawRTPPayloads(False),
     fSessionId(NULL) {
   rtpInfo.seqNum = 0; rtpInfo.timestamp = 0; rtpInfo.infoIsNew = False;
 
@@ -1163,7 +1163,11 @@ Boolean MediaSubsession::createSourceObjects(int useSpecialRTPoffset) {
       // (Also, add more fmts that can be implemented by SimpleRTPSource#####)
       Boolean createSimpleRTPSource = False; // by default; can be changed below
       Boolean doNormalMBitRule = False; // default behavior if "createSimpleRTPSource" is True
-      if (strcmp(fCodecName, "QCELP") == 0) { // QCELP audio
+      if (fReceiveRawRTPPayloads) {
+	// Special case (used when proxying): Receive each RTP packet's payload - including any special headers - 'as is':
+	createSimpleRTPSource = True;
+	useSpecialRTPoffset = 0;
+      } else if (strcmp(fCodecName, "QCELP") == 0) { // QCELP audio
 	fReadSource =
 	  QCELPAudioRTPSource::createNew(env(), fRTPSocket, fRTPSource,
 					 fRTPPayloadFormat,
@@ -22,6 +22,51 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #include "MultiFramedRTPSink.hh"
 #include "GroupsockHelper.hh"
 
+////////// FrameLatencyHistogram //////////
+
+void FrameLatencyHistogram::reset() {
+  for (unsigned i = 0; i < NUM_BUCKETS; ++i) fCounts[i] = 0;
+  fNumSamples = fMin = fMax = 0;
+  fTotal = 0;
+}
+
+void FrameLatencyHistogram::addSample(unsigned latencyInMicroseconds) {
+  unsigned bucket = 0;
+  while (bucket < NUM_BUCKETS-1 && latencyInMicroseconds >= bucketLimit(bucket)) ++bucket;
+  ++fCounts[bucket];
+
+  if (fNumSamples == 0 || latencyInMicroseconds < fMin) fMin = latencyInMicroseconds;
+  if (latencyInMicroseconds > fMax) fMax = latencyInMicroseconds;
+  fTotal += latencyInMicroseconds;
+  ++fNumSamples;
+}
+
+unsigned FrameLatencyHistogram::percentileLimit(unsigned percentile) const {
+  if (fNumSamples == 0) return 0;
+
+  u_int64_t const numSamplesNeeded = ((u_int64_t)fNumSamples*percentile + 99)/100;
+  u_int64_t numSamplesSoFar = 0;
+  for (unsigned i = 0; i < NUM_BUCKETS-1; ++i) {
+    numSamplesSoFar += fCounts[i];
+    if (numSamplesSoFar >= numSamplesNeeded) return bucketLimit(i);
+  }
+  return fMax; // the last bucket has no upper limit
+}
+
+void FrameLatencyHistogram::print(UsageEnvironment& env) const {
+  env << fNumSamples << " frames; latency (us): min " << fMin << ", mean " << meanLatency() << ", max " << fMax
+      << "; 50% < " << percentileLimit(50) << ", 99% < " << percentileLimit(99) << "\n";
+  for (unsigned i = 0; i < NUM_BUCKETS; ++i) {
+    if (fCounts[i] == 0) continue;
+    if (i < NUM_BUCKETS-1) {
+      env << "\t< " << bucketLimit(i) << " us:\t" << fCounts[i] << "\n";
+    } else {
+      env << "\t>= " << bucketLimit(i-1) << " us:\t" << fCounts[i] << "\n";
+    }
+  }
+}
+
+
 ////////// MultiFramedRTPSink //////////
 
 void MultiFramedRTPSink::setPacketSizes(unsigned preferredPacketSize,
@@ -43,7 +88,10 @@ MultiFramedRTPSink::MultiFramedRTPSink(UsageEnvironment& env,
   : RTPSink(env, rtpGS, rtpPayloadType, rtpTimestampFrequency,
 	    rtpPayloadFormatName, numChannels),
     fOutBuf(NULL), fCurFragmentationOffset(0), fPreviousFrameEndedFragmentation(False),
-    fOnSendErrorFunc(NULL), fOnSendErrorData(NULL) {
+    fOnSendErrorFunc(NULL), fOnSendErrorData(NULL),
+    fLowLatencyMode(False), fMaxFrameLatencyUS(0), fNumPacketsSentImmediately(0), fPacketEndsFrame(False),
+    fDroppingFramesForLatency(False), fNumFramesDroppedForLatency(0) {
+  fLastCheckedPresentationTime.tv_sec = fLastCheckedPresentationTime.tv_usec = 0;
   setPacketSizes(1000, 1448);
       // Default max packet size (1500, minus allowance for IP, UDP, UMTP headers)
       // (Also, make it a multiple of 4 bytes, just in case that matters.)
@@ -53,6 +101,12 @@ MultiFramedRTPSink::~MultiFramedRTPSink() {
   delete fOutBuf;
 }
 
+void MultiFramedRTPSink::setLowLatencyMode(Boolean lowLatencyMode, unsigned maxFrameLatencyMS) {
+  fLowLatencyMode = lowLatencyMode;
+  fMaxFrameLatencyUS = lowLatencyMode ? maxFrameLatencyMS*1000 : 0;
+  fDroppingFramesForLatency = False;
+}
+
 void MultiFramedRTPSink
 ::doSpecialFrameHandling(unsigned /*fragmentationOffset*/,
 			 unsigned char* /*frameStart*/,
@@ -101,6 +155,14 @@ void MultiFramedRTPSink::setMarkerBit() {
   fOutBuf->insertWord(rtpHdr, 0);
 }
 
+void MultiFramedRTPSink::setSequenceNumber(u_int16_t seqNo) {
+  fSeqNo = seqNo;
+
+  unsigned rtpHdr = fOutBuf->extractWord(0);
+  rtpHdr = (rtpHdr&0xFFFF0000)|fSeqNo;
+  fOutBuf->insertWord(rtpHdr, 0);
+}
+
 void MultiFramedRTPSink::setTimestamp(struct timeval framePresentationTime) {
   // First, convert the presentation time to a 32-bit RTP timestamp:
   fCurrentTimestamp = convertToRTPTimestamp(framePresentationTime);
@@ -188,6 +250,7 @@ void MultiFramedRTPSink::buildAndSendPacket(Boolean isFirstPacket) {
   fTotalFrameSpecificHeaderSizes = 0;
   fNoFramesLeft = False;
   fNumFramesUsedSoFar = 0;
+  fPacketEndsFrame = False;
   packFrame();
 }
 
@@ -223,10 +286,34 @@ void MultiFramedRTPSink
 		    struct timeval presentationTime,
 		    unsigned durationInMicroseconds) {
   MultiFramedRTPSink* sink = (MultiFramedRTPSink*)clientData;
+  if (sink->fMaxFrameLatencyUS > 0 && sink->frameIsTooLate(presentationTime)) {
+    // Drop this frame, by reading the next one into the same place.  We do this from the event loop, rather than
+    // recursively, because a source that delivers frames synchronously may have many stale frames for us to drop:
+    ++sink->fNumFramesDroppedForLatency;
+    sink->nextTask() = sink->envir().taskScheduler().scheduleDelayedTask(0, (TaskFunc*)getNextFrameInstead, sink);
+    return;
+  }
+
   sink->afterGettingFrame1(numBytesRead, numTruncatedBytes,
 			   presentationTime, durationInMicroseconds);
 }
 
+Boolean MultiFramedRTPSink::frameIsTooLate(struct timeval const& presentationTime) {
+  // We decide once for each presentation time, so that all parts of the same (e.g.) access unit get the same treatment:
+  if (presentationTime.tv_sec != fLastCheckedPresentationTime.tv_sec
+      || presentationTime.tv_usec != fLastCheckedPresentationTime.tv_usec) {
+    fLastCheckedPresentationTime = presentationTime;
+
+    struct timeval timeNow;
+    gettimeofday(&timeNow, NULL);
+    int64_t const latencyUS
+      = (int64_t)(timeNow.tv_sec - presentationTime.tv_sec)*1000000 + (timeNow.tv_usec - presentationTime.tv_usec);
+    fDroppingFramesForLatency = latencyUS > (int64_t)fMaxFrameLatencyUS;
+  }
+
+  return fDroppingFramesForLatency;
+}
+
 void MultiFramedRTPSink
 ::afterGettingFrame1(unsigned frameSize, unsigned numTruncatedBytes,
 		     struct timeval presentationTime,
@@ -318,6 +405,9 @@ void MultiFramedRTPSink
     // However, if this frame has overflow data remaining, then don't
     // count its duration yet.
     if (overflowBytes == 0) {
+      fPacketEndsFrame = True;
+      fEndingFramePresentationTime = presentationTime;
+
       fNextSendTime.tv_usec += durationInMicroseconds;
       fNextSendTime.tv_sec += fNextSendTime.tv_usec/1000000;
       fNextSendTime.tv_usec %= 1000000;
@@ -370,6 +460,15 @@ void MultiFramedRTPSink::sendPacketIfNecessary() {
       - rtpHeaderSize - fSpecialHeaderSize - fTotalFrameSpecificHeaderSizes;
 
     ++fSeqNo; // for next time
+
+    if (fLowLatencyMode && fPacketEndsFrame) {
+      // Record the latency of the frame that ended in this packet:
+      struct timeval timeNow;
+      gettimeofday(&timeNow, NULL);
+      int64_t const latencyUS = (int64_t)(timeNow.tv_sec - fEndingFramePresentationTime.tv_sec)*1000000
+	+ (timeNow.tv_usec - fEndingFramePresentationTime.tv_usec);
+      if (latencyUS >= 0 && latencyUS <= 0xFFFFFFFF) fFrameLatencyHistogram.addSample((unsigned)latencyUS);
+    }
   }
 
   if (fOutBuf->haveOverflowData()
@@ -391,7 +490,14 @@ void MultiFramedRTPSink::sendPacketIfNecessary() {
   if (fNoFramesLeft) {
     // We're done:
     onSourceClosure();
+  } else if (fLowLatencyMode && ++fNumPacketsSentImmediately < 64) {
+    // Build (and send) the next packet now, rather than waiting until "fNextSendTime".
+    // (But every so often, we instead return to the event loop (below), to limit our recursion, and to let other events
+    //  get handled while we send a large frame.)
+    buildAndSendPacket(False);
   } else {
+    fNumPacketsSentImmediately = 0;
+
     // We have more frames left to send.  Figure out when the next frame
     // is due to start playing, then make sure that we wait this long before
     // sending the next packet.
@@ -402,6 +508,7 @@ void MultiFramedRTPSink::sendPacketIfNecessary() {
     if (uSecondsToGo < 0 || secsDiff < 0) { // sanity check: Make sure that the time-to-delay is non-negative:
       uSecondsToGo = 0;
     }
+    if (fLowLatencyMode) uSecondsToGo = 0; // we're returning to the event loop only briefly
 
     // Delay this amount of time:
     nextTask() = envir().taskScheduler().scheduleDelayedTask(uSecondsToGo, (TaskFunc*)sendNext, this);
@@ -414,6 +521,15 @@ void MultiFramedRTPSink::sendNext(void* firstArg) {
   sink->buildAndSendPacket(False);
 }
 
+// The following is called (from the event loop) after we've dropped a frame that was too late:
+void MultiFramedRTPSink::getNextFrameInstead(void* firstArg) {
+  MultiFramedRTPSink* sink = (MultiFramedRTPSink*)firstArg;
+  if (sink->fSource == NULL) return;
+
+  sink->fSource->getNextFrame(sink->fOutBuf->curPtr(), sink->fOutBuf->totalBytesAvailable(),
+			      afterGettingFrame, sink, ourHandleClosure, sink);
+}
+
 void MultiFramedRTPSink::ourHandleClosure(void* clientData) {
   MultiFramedRTPSink* sink = (MultiFramedRTPSink*)clientData;
   // There are no frames left, but we may have a partially built packet
@@ -40,7 +40,7 @@ OggFileParser::OggFileParser(OggFile& ourFile, FramedSource* inputSource,
     fOurFile(ourFile), fInputSource(inputSource),
     fOnEndFunc(onEndFunc), fOnEndClientData(onEndClientData),
     fOurDemux(ourDemux), fNumUnfulfilledTracks(0),
-    fPacketSizeTable(NULL), fCurrentTrackNumber(0), fSavedPacket(NULL) {
+    fPacketSizeTable(NULL), fCurrentTrackNumber(0), fNumPacketBytesConsumed(0), fSavedPacket(NULL) {
   if (ourDemux == NULL) {
     // Initialization
     fCurrentParseState = PARSING_START_OF_FILE;
@@ -853,7 +853,19 @@ Boolean OggFileParser::deliverPacketWithinPage() {
 #endif
   unsigned numBytesDelivered
     = packetSize < demuxedTrack->maxSize() ? packetSize : demuxedTrack->maxSize();
-  getBytes(demuxedTrack->to(), numBytesDelivered);
+
+  // Copy the packet's bytes as they arrive in the parser's bank (rather than waiting until the whole packet is in the bank),
+  // then skip over any bytes that don't fit in the reader's buffer:
+  while (fNumPacketBytesConsumed < packetSize) {
+    if (fNumPacketBytesConsumed < numBytesDelivered) {
+      fNumPacketBytesConsumed += getAvailableBytes(&demuxedTrack->to()[fNumPacketBytesConsumed],
+						   numBytesDelivered - fNumPacketBytesConsumed);
+    } else {
+      fNumPacketBytesConsumed += skipAvailableBytes(packetSize - fNumPacketBytesConsumed);
+    }
+    saveParserState();
+  }
+  fNumPacketBytesConsumed = 0; // for next time
   u_int8_t firstByte = numBytesDelivered > 0 ? demuxedTrack->to()[0] : 0x00;
   u_int8_t secondByte = numBytesDelivered > 1 ? demuxedTrack->to()[1] : 0x00;
   demuxedTrack->to() += numBytesDelivered;
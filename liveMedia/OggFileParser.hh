@@ -85,6 +85,7 @@ private:
   unsigned fNumUnfulfilledTracks;
   PacketSizeTable* fPacketSizeTable;
   u_int32_t fCurrentTrackNumber;
+  unsigned fNumPacketBytesConsumed; // of the packet that's currently being delivered
   u_int8_t* fSavedPacket; // used to temporarily save a copy of a 'packet' from a page
 };
 
@@ -22,18 +22,56 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #include "OnDemandServerMediaSubsession.hh"
 #include <GroupsockHelper.hh>
 
+// A class that's used to implement "prepareSDPLines()" (and "sdpLines()") for subsessions whose SDP lines become known only
+// after some data has been streamed (see "sdpLinesNeedStreamData()").  It streams from a dummy source, within the event loop,
+// until the sink's "auxSDPLine()" is known (or the source ends), then sets the subsession's SDP lines, and calls any waiters.
+// Only one of these exists at a time (per subsession), no matter how many clients are waiting.
+class SDPLinesPreparer {
+public:
+  static SDPLinesPreparer* createNew(OnDemandServerMediaSubsession& master);
+      // returns NULL if a source could not be created (e.g., if the file does not exist)
+
+  void addWaiter(ServerMediaSubsession::sdpLinesReadyFunc* readyFunc, void* readyClientData);
+  void removeWaiter(void* readyClientData);
+
+  virtual ~SDPLinesPreparer();
+
+private:
+  SDPLinesPreparer(OnDemandServerMediaSubsession& master, FramedSource* inputSource, unsigned estBitrate);
+
+  static void afterPlaying(void* clientData);
+  static void checkForAuxSDPLine(void* clientData);
+  void checkForAuxSDPLine1();
+
+private:
+  OnDemandServerMediaSubsession& fMaster;
+  FramedSource* fInputSource;
+  Groupsock* fGroupsock;
+  RTPSink* fRTPSink;
+  unsigned fEstBitrate;
+  Boolean fSourceHasEnded;
+  TaskToken fCheckTask;
+  struct Waiter {
+    Waiter* next;
+    ServerMediaSubsession::sdpLinesReadyFunc* readyFunc;
+    void* readyClientData;
+  } * fWaiters;
+};
+
 OnDemandServerMediaSubsession
 ::OnDemandServerMediaSubsession(UsageEnvironment& env,
 				Boolean reuseFirstSource,
 				portNumBits initialPortNum)
   : ServerMediaSubsession(env),
-    fSDPLines(NULL), fReuseFirstSource(reuseFirstSource), fInitialPortNum(initialPortNum), fLastStreamToken(NULL) {
+    fSDPLines(NULL), fReuseFirstSource(reuseFirstSource), fInitialPortNum(initialPortNum), fLastStreamToken(NULL),
+    fSDPLinesPreparer(NULL) {
   fDestinationsHashTable = HashTable::create(ONE_WORD_HASH_KEYS);
   gethostname(fCNAME, sizeof fCNAME);
   fCNAME[sizeof fCNAME-1] = '\0'; // just in case
 }
 
 OnDemandServerMediaSubsession::~OnDemandServerMediaSubsession() {
+  delete fSDPLinesPreparer; // Note: Any clients that were waiting for our SDP lines will not now get called back
   delete[] fSDPLines;
 
   // Clean out the destinations hash table:
@@ -46,9 +84,20 @@ OnDemandServerMediaSubsession::~OnDemandServerMediaSubsession() {
   delete fDestinationsHashTable;
 }
 
+static void setSDPLinesReadyFlag(void* clientData) {
+  *(char*)clientData = ~0;
+}
+
 char const*
 OnDemandServerMediaSubsession::sdpLines() {
-  if (fSDPLines == NULL) {
+  if (fSDPLines == NULL && sdpLinesNeedStreamData()) {
+    // Our SDP lines can be set only after we've streamed some data.  Do this (as we do in "prepareSDPLines()"), entering the
+    // event loop to wait for it to complete.  (Callers that don't want to wait like this should call "prepareSDPLines()" first.)
+    char sdpLinesAreReady = 0;
+    if (!prepareSDPLines(setSDPLinesReadyFlag, &sdpLinesAreReady)) {
+      envir().taskScheduler().doEventLoop(&sdpLinesAreReady);
+    }
+  } else if (fSDPLines == NULL) {
     // We need to construct a set of SDP lines that describe this
     // subsession (as a unicast stream).  To do so, we first create
     // dummy (unused) source and "RTPSink" objects,
@@ -73,6 +122,27 @@ OnDemandServerMediaSubsession::sdpLines() {
   return fSDPLines;
 }
 
+Boolean OnDemandServerMediaSubsession
+::prepareSDPLines(sdpLinesReadyFunc* readyFunc, void* readyClientData) {
+  if (fSDPLines != NULL || !sdpLinesNeedStreamData()) return True; // "sdpLines()" won't have to wait
+
+  if (fSDPLinesPreparer == NULL) {
+    fSDPLinesPreparer = SDPLinesPreparer::createNew(*this);
+    if (fSDPLinesPreparer == NULL) return True; // we couldn't create a source, so "sdpLines()" will (immediately) return NULL
+  }
+  fSDPLinesPreparer->addWaiter(readyFunc, readyClientData);
+
+  return False;
+}
+
+void OnDemandServerMediaSubsession::cancelPrepareSDPLines(void* readyClientData) {
+  if (fSDPLinesPreparer != NULL) fSDPLinesPreparer->removeWaiter(readyClientData);
+}
+
+void OnDemandServerMediaSubsession::setSDPLines(char const* sdpLines) {
+  delete[] fSDPLines; fSDPLines = strDup(sdpLines);
+}
+
 void OnDemandServerMediaSubsession
 ::getStreamParameters(unsigned clientSessionId,
 		      netAddressBits clientAddress,
@@ -333,6 +403,11 @@ char const* OnDemandServerMediaSubsession
   return rtpSink == NULL ? NULL : rtpSink->auxSDPLine();
 }
 
+Boolean OnDemandServerMediaSubsession::sdpLinesNeedStreamData() {
+  // Default implementation:
+  return False;
+}
+
 void OnDemandServerMediaSubsession::seekStreamSource(FramedSource* /*inputSource*/,
 						     double& /*seekNPT*/, double /*streamDuration*/, u_int64_t& numBytes) {
   // Default implementation: Do nothing
@@ -547,3 +622,119 @@ void StreamState::reclaim() {
   delete fRTPgs; fRTPgs = NULL;
   delete fRTCPgs; fRTCPgs = NULL;
 }
+
+
+////////// SDPLinesPreparer implementation //////////
+
+SDPLinesPreparer* SDPLinesPreparer::createNew(OnDemandServerMediaSubsession& master) {
+  unsigned estBitrate;
+  FramedSource* inputSource = master.createNewStreamSource(0, estBitrate);
+  if (inputSource == NULL) return NULL;
+
+  SDPLinesPreparer* preparer = new SDPLinesPreparer(master, inputSource, estBitrate);
+  if (preparer->fRTPSink == NULL) {
+    delete preparer;
+    return NULL;
+  }
+
+  return preparer;
+}
+
+SDPLinesPreparer
+::SDPLinesPreparer(OnDemandServerMediaSubsession& master, FramedSource* inputSource, unsigned estBitrate)
+  : fMaster(master), fInputSource(inputSource), fEstBitrate(estBitrate), fSourceHasEnded(False), fCheckTask(NULL),
+    fWaiters(NULL) {
+  struct in_addr dummyAddr;
+  dummyAddr.s_addr = 0;
+  fGroupsock = new Groupsock(master.envir(), dummyAddr, 0, 0);
+  unsigned char rtpPayloadType = 96 + master.trackNumber()-1; // if dynamic
+  fRTPSink = master.createNewRTPSink(fGroupsock, rtpPayloadType, fInputSource);
+  if (fRTPSink == NULL) return;
+  if (fRTPSink->estimatedBitrate() > 0) fEstBitrate = fRTPSink->estimatedBitrate();
+
+  // Start reading the source, and check (after we've returned to the event loop) whether the sink's "auxSDPLine()" is ready:
+  fRTPSink->startPlaying(*fInputSource, afterPlaying, this);
+  if (fCheckTask == NULL) { // (it won't be NULL if the source already ended)
+    fCheckTask = master.envir().taskScheduler().scheduleDelayedTask(0, (TaskFunc*)checkForAuxSDPLine, this);
+  }
+}
+
+SDPLinesPreparer::~SDPLinesPreparer() {
+  fMaster.envir().taskScheduler().unscheduleDelayedTask(fCheckTask);
+
+  Medium::close(fRTPSink);
+  fMaster.closeStreamSource(fInputSource);
+  delete fGroupsock;
+
+  while (fWaiters != NULL) {
+    Waiter* waiter = fWaiters; fWaiters = waiter->next;
+    delete waiter;
+  }
+}
+
+void SDPLinesPreparer::addWaiter(ServerMediaSubsession::sdpLinesReadyFunc* readyFunc, void* readyClientData) {
+  // Don't add the same waiter more than once (e.g., if "prepareSDPLines()" got called again before we became ready):
+  for (Waiter* waiter = fWaiters; waiter != NULL; waiter = waiter->next) {
+    if (waiter->readyFunc == readyFunc && waiter->readyClientData == readyClientData) return;
+  }
+
+  // Add the new waiter to the end of our list, so that waiters get called in the order that they arrived:
+  Waiter* waiter = new Waiter;
+  waiter->next = NULL;
+  waiter->readyFunc = readyFunc;
+  waiter->readyClientData = readyClientData;
+  Waiter** ptr = &fWaiters;
+  while (*ptr != NULL) ptr = &(*ptr)->next;
+  *ptr = waiter;
+}
+
+void SDPLinesPreparer::removeWaiter(void* readyClientData) {
+  Waiter** ptr = &fWaiters;
+  while (*ptr != NULL) {
+    Waiter* waiter = *ptr;
+    if (waiter->readyClientData == readyClientData) {
+      *ptr = waiter->next;
+      delete waiter;
+    } else {
+      ptr = &waiter->next;
+    }
+  }
+}
+
+void SDPLinesPreparer::afterPlaying(void* clientData) {
+  SDPLinesPreparer* preparer = (SDPLinesPreparer*)clientData;
+
+  // The source ended before "auxSDPLine()" became known.  Finish up (using whatever we have) - but from the event loop,
+  // rather than from within the source's closure handler:
+  preparer->fSourceHasEnded = True;
+  preparer->fMaster.envir().taskScheduler().rescheduleDelayedTask(preparer->fCheckTask, 0,
+								   (TaskFunc*)checkForAuxSDPLine, preparer);
+}
+
+void SDPLinesPreparer::checkForAuxSDPLine(void* clientData) {
+  ((SDPLinesPreparer*)clientData)->checkForAuxSDPLine1();
+}
+
+void SDPLinesPreparer::checkForAuxSDPLine1() {
+  fCheckTask = NULL;
+
+  if (!fSourceHasEnded && fRTPSink->auxSDPLine() == NULL) {
+    // try again after a brief delay:
+    int uSecsToDelay = 100000; // 100 ms
+    fCheckTask = fMaster.envir().taskScheduler().scheduleDelayedTask(uSecsToDelay, (TaskFunc*)checkForAuxSDPLine, this);
+    return;
+  }
+
+  // We're done.  Set our master's SDP lines, then delete ourself (closing the dummy sink and source), before calling each waiter:
+  fMaster.setSDPLinesFromRTPSink(fRTPSink, fInputSource, fEstBitrate);
+  fMaster.fSDPLinesPreparer = NULL;
+
+  Waiter* waiters = fWaiters; fWaiters = NULL;
+  delete this;
+
+  while (waiters != NULL) {
+    Waiter* waiter = waiters; waiters = waiter->next;
+    (*waiter->readyFunc)(waiter->readyClientData);
+    delete waiter;
+  }
+}
@@ -31,11 +31,13 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 
 class ProxyServerMediaSubsession: public OnDemandServerMediaSubsession {
 public:
-  ProxyServerMediaSubsession(MediaSubsession& mediaSubsession);
+  ProxyServerMediaSubsession(MediaSubsession& mediaSubsession, unsigned gopCacheSize);
   virtual ~ProxyServerMediaSubsession();
 
   char const* codecName() const { return fClientMediaSubsession.codecName(); }
 
+  void deInitiateClientMediaSubsession();
+
 private: // redefined virtual functions
   virtual FramedSource* createNewStreamSource(unsigned clientSessionId,
                                               unsigned& estBitrate);
@@ -50,13 +52,235 @@ private:
 
   int verbosityLevel() const { return ((ProxyServerMediaSession*)fParentSession)->fVerbosityLevel; }
 
+  static Boolean canUseGOPCache(MediaSubsession& mediaSubsession, unsigned gopCacheSize);
+
 private:
   friend class ProxyRTSPClient;
   MediaSubsession& fClientMediaSubsession; // the 'client' media subsession object that corresponds to this 'server' media subsession
   ProxyServerMediaSubsession* fNext; // used when we're part of a queue
   Boolean fHaveSetupStream;
+  Boolean fRelaysRTPPayloadsDirectly; // if True, our input frames are the back-end stream's RTP payloads, received 'as is'
+  Boolean fBackEndPayloadsAreTooLargeToRelay; // set if we relayed a payload that was too large for our usual packets
+  unsigned fNumStreamSourceUsers; // the number of "createNewStreamSource()" calls not yet matched by "closeStreamSource()"
+  unsigned fGOPCacheSize; // if non-zero, each front-end client reads its own replica (via "fReplicator") of our input stream
+  PresentationTimeSubsessionNormalizer* fNormalizer;
+  StreamReplicator* fReplicator;
+  HashTable* fRTPSinksByReplica; // used (only if "fReplicator" != NULL) to find the "RTPSink" that was reading each replica
+};
+
+
+// A "SimpleRTPSink" subclass, used to relay - unchanged - the RTP payloads that were received from the back-end server
+// (one incoming RTP packet per frame).  The RTP 'M' bit, and any gaps in the incoming sequence numbers, are copied from the
+// incoming packets, and the back-end stream's "a=fmtp:" SDP line (if any) is reused, with our own RTP payload type.
+// Because fragmenting a payload would break its RTP payload format, our packets can hold any payload that the back-end
+// "RTPSource" can receive.  Normally, these are no larger than those of any other front-end "RTPSink", but if a back-end
+// payload turns out to be larger, it is still relayed (in a larger packet), and "PresentationTimeSubsessionNormalizer" notes
+// this, so that the stream's frames are reassembled (and repacketized) instead the next time that it is set up.
+
+#define RELAYED_RTP_PACKET_MAX_SIZE 20000 // the same as the largest packet that a "MultiFramedRTPSource" can receive
+
+class RTPPayloadRelaySink: public SimpleRTPSink {
+public:
+  static RTPPayloadRelaySink* createNew(UsageEnvironment& env, Groupsock* RTPgs, unsigned char rtpPayloadFormat,
+					MediaSubsession& inputSubsession) {
+    return new RTPPayloadRelaySink(env, RTPgs, rtpPayloadFormat, inputSubsession);
+  }
+
+  void noteIncomingPacket(Boolean markerBit, u_int16_t seqNum) {
+    // Called (by our "PresentationTimeSubsessionNormalizer") just before each incoming RTP payload is delivered to us:
+    if (markerBit) setMBitOnNextPacket();
+    fIncomingSeqNum = seqNum;
+  }
+
+  unsigned frontEndMaxPayloadSize() const { return fFrontEndMaxPacketSize - 12/*RTP header*/; }
+      // the largest payload that fits in the packets of any other front-end "RTPSink"
+
+protected:
+  RTPPayloadRelaySink(UsageEnvironment& env, Groupsock* RTPgs, unsigned char rtpPayloadFormat,
+		      MediaSubsession& inputSubsession);
+      // called only by createNew()
+  virtual ~RTPPayloadRelaySink();
+
+private: // redefined virtual functions
+  virtual void doSpecialFrameHandling(unsigned fragmentationOffset,
+                                      unsigned char* frameStart,
+                                      unsigned numBytesInFrame,
+                                      struct timeval framePresentationTime,
+                                      unsigned numRemainingBytes);
+  virtual char const* auxSDPLine();
+
+private:
+  char* fFmtpSDPLine;
+  Boolean fHaveSeenIncomingPacket;
+  u_int16_t fIncomingSeqNum, fSeqNumOffset;
+  unsigned fFrontEndMaxPacketSize;
+};
+
+
+// A 'timing wheel' (with one-second granularity), shared by all of the "ProxyRTSPClient"s in an environment, and used to
+// implement their timers.  Because we can be proxying many (thousands of) streams, this is much cheaper than having each
+// timer in the task scheduler's (sorted) delay queue.  It also lets us limit the rate at which "DESCRIBE" commands get sent
+// - to avoid overwhelming the back-end servers (and ourselves) if many streams need to be reestablished at the same time:
+
+#ifndef PROXY_MAX_DESCRIBES_PER_SECOND
+#define PROXY_MAX_DESCRIBES_PER_SECOND 50
+#endif
+#define PROXY_TIMER_WHEEL_SIZE 64 // one-second slots
+
+class ProxyTimerWheel {
+public:
+  static TaskToken schedule(UsageEnvironment& env, unsigned secondsToDelay, TaskFunc* proc, void* clientData,
+			    Boolean isRateLimited = False);
+      // If "isRateLimited" is True, then at most PROXY_MAX_DESCRIBES_PER_SECOND such timers are fired each second;
+      // any others are postponed until the next second.
+  static void unschedule(TaskToken& token);
+      // Note: A timer's "TaskToken" becomes invalid once the timer has fired, so it must be reset (to NULL) by the timer's "proc".
+
+private:
+  class Timer {
+  public:
+    Timer(ProxyTimerWheel& wheel, TaskFunc* proc, void* clientData, Boolean isRateLimited)
+      : fWheel(wheel), fNext(NULL), fPrevNextPtr(NULL), fNumRoundsRemaining(0),
+	fProc(proc), fClientData(clientData), fIsRateLimited(isRateLimited) {
+    }
+
+    void link(Timer*& head) {
+      fNext = head;
+      if (fNext != NULL) fNext->fPrevNextPtr = &fNext;
+      fPrevNextPtr = &head;
+      head = this;
+    }
+    void unlink() {
+      *fPrevNextPtr = fNext;
+      if (fNext != NULL) fNext->fPrevNextPtr = fPrevNextPtr;
+      fNext = NULL; fPrevNextPtr = NULL;
+    }
+
+    ProxyTimerWheel& fWheel;
+    Timer* fNext;
+    Timer** fPrevNextPtr;
+    unsigned fNumRoundsRemaining;
+    TaskFunc* fProc;
+    void* fClientData;
+    Boolean fIsRateLimited;
+  };
+
+  ProxyTimerWheel(UsageEnvironment& env);
+  ~ProxyTimerWheel();
+
+  static void tick(void* clientData);
+  void tick1();
+  void reclaimIfEmpty();
+
+private:
+  UsageEnvironment& fEnv;
+  Timer* fSlots[PROXY_TIMER_WHEEL_SIZE];
+  unsigned fCurrentSlot;
+  unsigned fNumTimers;
+  TaskToken fTickTask;
+  Boolean fIsTicking;
 };
 
+TaskToken ProxyTimerWheel::schedule(UsageEnvironment& env, unsigned secondsToDelay, TaskFunc* proc, void* clientData,
+				    Boolean isRateLimited) {
+  _Tables* ourTables = _Tables::getOurTables(env);
+  if (ourTables->proxyTimerWheel == NULL) ourTables->proxyTimerWheel = new ProxyTimerWheel(env);
+  ProxyTimerWheel* wheel = (ProxyTimerWheel*)(ourTables->proxyTimerWheel);
+
+  // A timer that's set for "secondsToDelay" seconds goes into the slot that far ahead of the current one, and fires after
+  // the wheel has gone around that slot the appropriate number of times.  (It therefore fires after between
+  // "secondsToDelay"-1 and "secondsToDelay" seconds.)
+  if (secondsToDelay == 0) secondsToDelay = 1;
+  Timer* timer = new Timer(*wheel, proc, clientData, isRateLimited);
+  timer->fNumRoundsRemaining = (secondsToDelay-1)/PROXY_TIMER_WHEEL_SIZE;
+  timer->link(wheel->fSlots[(wheel->fCurrentSlot + secondsToDelay)%PROXY_TIMER_WHEEL_SIZE]);
+  ++wheel->fNumTimers;
+
+  if (wheel->fTickTask == NULL && !wheel->fIsTicking) {
+    wheel->fTickTask = env.taskScheduler().scheduleDelayedTask(MILLION, tick, wheel);
+  }
+  return timer;
+}
+
+void ProxyTimerWheel::unschedule(TaskToken& token) {
+  Timer* timer = (Timer*)token;
+  if (timer == NULL) return;
+  token = NULL;
+
+  ProxyTimerWheel& wheel = timer->fWheel;
+  timer->unlink();
+  delete timer;
+  --wheel.fNumTimers;
+  wheel.reclaimIfEmpty();
+}
+
+ProxyTimerWheel::ProxyTimerWheel(UsageEnvironment& env)
+  : fEnv(env), fCurrentSlot(0), fNumTimers(0), fTickTask(NULL), fIsTicking(False) {
+  for (unsigned i = 0; i < PROXY_TIMER_WHEEL_SIZE; ++i) fSlots[i] = NULL;
+}
+
+ProxyTimerWheel::~ProxyTimerWheel() {
+  fEnv.taskScheduler().unscheduleDelayedTask(fTickTask);
+
+  _Tables* ourTables = _Tables::getOurTables(fEnv);
+  ourTables->proxyTimerWheel = NULL;
+  ourTables->reclaimIfPossible();
+}
+
+void ProxyTimerWheel::tick(void* clientData) {
+  ((ProxyTimerWheel*)clientData)->tick1();
+}
+
+void ProxyTimerWheel::tick1() {
+  fTickTask = NULL;
+  fIsTicking = True;
+
+  // Move to the next slot, and take (all of) its timers.  (We do this before handling any of them, because each timer's
+  // "proc" might schedule or unschedule other timers.)
+  fCurrentSlot = (fCurrentSlot+1)%PROXY_TIMER_WHEEL_SIZE;
+  Timer* timers = NULL;
+  if (fSlots[fCurrentSlot] != NULL) {
+    timers = fSlots[fCurrentSlot];
+    fSlots[fCurrentSlot] = NULL;
+    timers->fPrevNextPtr = &timers;
+  }
+
+  unsigned numRateLimitedTimersFired = 0;
+  Timer* timer;
+  while ((timer = timers) != NULL) {
+    timer->unlink();
+
+    if (timer->fNumRoundsRemaining > 0) {
+      // This timer doesn't fire until a later time around the wheel:
+      --timer->fNumRoundsRemaining;
+      timer->link(fSlots[fCurrentSlot]);
+    } else if (timer->fIsRateLimited && numRateLimitedTimersFired >= PROXY_MAX_DESCRIBES_PER_SECOND) {
+      // We've already fired enough of these timers during this second.  Postpone this one until the next second:
+      timer->link(fSlots[(fCurrentSlot+1)%PROXY_TIMER_WHEEL_SIZE]);
+    } else {
+      // Fire this timer:
+      if (timer->fIsRateLimited) ++numRateLimitedTimersFired;
+      TaskFunc* proc = timer->fProc;
+      void* clientData = timer->fClientData;
+      delete timer;
+      --fNumTimers;
+
+      (*proc)(clientData);
+    }
+  }
+
+  fIsTicking = False;
+  if (fNumTimers > 0) {
+    fTickTask = fEnv.taskScheduler().scheduleDelayedTask(MILLION, tick, this);
+  } else {
+    reclaimIfEmpty();
+  }
+}
+
+void ProxyTimerWheel::reclaimIfEmpty() {
+  if (fNumTimers == 0 && !fIsTicking) delete this;
+}
+
 
 ////////// ProxyServerMediaSession implementation //////////
 
@@ -78,9 +302,11 @@ ProxyServerMediaSession* ProxyServerMediaSession
 ::createNew(UsageEnvironment& env, RTSPServer* ourRTSPServer,
 	    char const* inputStreamURL, char const* streamName,
 	    char const* username, char const* password,
-	    portNumBits tunnelOverHTTPPortNum, int verbosityLevel, int socketNumToServer) {
+	    portNumBits tunnelOverHTTPPortNum, int verbosityLevel, int socketNumToServer,
+	    unsigned idleDisconnectSeconds) {
   return new ProxyServerMediaSession(env, ourRTSPServer, inputStreamURL, streamName, username, password,
-				     tunnelOverHTTPPortNum, verbosityLevel, socketNumToServer);
+				     tunnelOverHTTPPortNum, verbosityLevel, socketNumToServer,
+				     defaultCreateNewProxyRTSPClientFunc, idleDisconnectSeconds);
 }
 
 
@@ -90,10 +316,12 @@ ProxyServerMediaSession
 			  char const* username, char const* password,
 			  portNumBits tunnelOverHTTPPortNum, int verbosityLevel,
 			  int socketNumToServer,
-			  createNewProxyRTSPClientFunc* ourCreateNewProxyRTSPClientFunc)
+			  createNewProxyRTSPClientFunc* ourCreateNewProxyRTSPClientFunc,
+			  unsigned idleDisconnectSeconds)
   : ServerMediaSession(env, streamName, NULL, NULL, False, NULL),
     describeCompletedFlag(0), fOurRTSPServer(ourRTSPServer), fClientMediaSession(NULL),
-    fVerbosityLevel(verbosityLevel),
+    fVerbosityLevel(verbosityLevel), fIdleDisconnectSeconds(idleDisconnectSeconds), fRelayRTPPayloadsDirectly(True),
+    fGOPCacheSize(0),
     fPresentationTimeSessionNormalizer(new PresentationTimeSessionNormalizer(envir())),
     fCreateNewProxyRTSPClientFunc(ourCreateNewProxyRTSPClientFunc) {
   // Open a RTSP connection to the input stream, and send a "DESCRIBE" command.
@@ -103,7 +331,12 @@ ProxyServerMediaSession
 				       tunnelOverHTTPPortNum,
 				       verbosityLevel > 0 ? verbosityLevel-1 : verbosityLevel,
 				       socketNumToServer);
-  ProxyRTSPClient::sendDESCRIBE(fProxyRTSPClient);
+  if (fIdleDisconnectSeconds > 0) {
+    // We're in 'capacity mode'.  Stagger our initial "DESCRIBE" with those of other proxies, rather than sending it now:
+    fProxyRTSPClient->scheduleDESCRIBECommand(False);
+  } else {
+    ProxyRTSPClient::sendDESCRIBE(fProxyRTSPClient);
+  }
 }
 
 ProxyServerMediaSession::~ProxyServerMediaSession() {
@@ -124,6 +357,35 @@ char const* ProxyServerMediaSession::url() const {
   return fProxyRTSPClient == NULL ? NULL : fProxyRTSPClient->url();
 }
 
+ProxyServerMediaSession::BackEndState ProxyServerMediaSession::backEndState() const {
+  if (fClientMediaSession == NULL) {
+    // We don't (yet) have a SDP description for the back-end stream:
+    return fProxyRTSPClient != NULL && fProxyRTSPClient->fNumDESCRIBEFailures > 0
+      && fProxyRTSPClient->fDESCRIBECommandTask != NULL ? BACK_END_AWAITING_DESCRIBE_RETRY : BACK_END_DESCRIBING;
+  } else if (fProxyRTSPClient->fIsDisconnectedWhileIdle) {
+    return BACK_END_IDLE_DISCONNECTED;
+  } else if (fProxyRTSPClient->fLastCommandWasPLAY) {
+    return BACK_END_STREAMING;
+  } else {
+    return BACK_END_IDLE;
+  }
+}
+
+char const* ProxyServerMediaSession::backEndStateName(BackEndState state) {
+  switch (state) {
+    case BACK_END_DESCRIBING: return "describing";
+    case BACK_END_AWAITING_DESCRIBE_RETRY: return "awaiting DESCRIBE retry";
+    case BACK_END_IDLE: return "idle";
+    case BACK_END_IDLE_DISCONNECTED: return "idle (disconnected)";
+    case BACK_END_STREAMING: return "streaming";
+  }
+  return "unknown";
+}
+
+unsigned ProxyServerMediaSession::numBackEndDESCRIBEFailures() const {
+  return fProxyRTSPClient == NULL ? 0 : fProxyRTSPClient->fNumDESCRIBEFailures;
+}
+
 void ProxyServerMediaSession::continueAfterDESCRIBE(char const* sdpDescription) {
   describeCompletedFlag = 1;
 
@@ -135,7 +397,7 @@ void ProxyServerMediaSession::continueAfterDESCRIBE(char const* sdpDescription)
 
     MediaSubsessionIterator iter(*fClientMediaSession);
     for (MediaSubsession* mss = iter.next(); mss != NULL; mss = iter.next()) {
-      ServerMediaSubsession* smss = new ProxyServerMediaSubsession(*mss);
+      ServerMediaSubsession* smss = new ProxyServerMediaSubsession(*mss, fGOPCacheSize);
       addSubsession(smss);
       if (fVerbosityLevel > 0) {
 	envir() << *this << " added new \"ProxyServerMediaSubsession\" for "
@@ -174,9 +436,12 @@ static void continueAfterDESCRIBE(RTSPClient* rtspClient, int resultCode, char*
 }
 
 static void continueAfterSETUP(RTSPClient* rtspClient, int resultCode, char* resultString) {
-  if (resultCode == 0) {
-    ((ProxyRTSPClient*)rtspClient)->continueAfterSETUP();
-  }
+  ((ProxyRTSPClient*)rtspClient)->continueAfterSETUP(resultCode);
+  delete[] resultString;
+}
+
+static void continueAfterIdleTEARDOWN(RTSPClient* rtspClient, int /*resultCode*/, char* resultString) {
+  ((ProxyRTSPClient*)rtspClient)->continueAfterIdleTEARDOWN();
   delete[] resultString;
 }
 
@@ -210,9 +475,9 @@ ProxyRTSPClient::ProxyRTSPClient(ProxyServerMediaSession& ourServerMediaSession,
   : RTSPClient(ourServerMediaSession.envir(), rtspURL, verbosityLevel, "ProxyRTSPClient",
 	       tunnelOverHTTPPortNum == (portNumBits)(~0) ? 0 : tunnelOverHTTPPortNum, socketNumToServer),
     fOurServerMediaSession(ourServerMediaSession), fOurURL(strDup(rtspURL)), fStreamRTPOverTCP(tunnelOverHTTPPortNum != 0),
-    fSetupQueueHead(NULL), fSetupQueueTail(NULL), fNumSetupsDone(0), fNextDESCRIBEDelay(1),
-    fServerSupportsGetParameter(False), fLastCommandWasPLAY(False),
-    fLivenessCommandTask(NULL), fDESCRIBECommandTask(NULL), fSubsessionTimerTask(NULL) { 
+    fSetupQueueHead(NULL), fSetupQueueTail(NULL), fNumSetupsDone(0), fNextDESCRIBEDelay(1), fNumDESCRIBEFailures(0),
+    fServerSupportsGetParameter(False), fLastCommandWasPLAY(False), fIsDisconnectedWhileIdle(False),
+    fLivenessCommandTask(NULL), fDESCRIBECommandTask(NULL), fSubsessionTimerTask(NULL), fIdleDisconnectTask(NULL) { 
   if (username != NULL && password != NULL) {
     fOurAuthenticator = new Authenticator(username, password);
   } else {
@@ -221,14 +486,17 @@ ProxyRTSPClient::ProxyRTSPClient(ProxyServerMediaSession& ourServerMediaSession,
 }
 
 void ProxyRTSPClient::reset() {
-  envir().taskScheduler().unscheduleDelayedTask(fLivenessCommandTask); fLivenessCommandTask = NULL;
-  envir().taskScheduler().unscheduleDelayedTask(fDESCRIBECommandTask); fDESCRIBECommandTask = NULL;
+  ProxyTimerWheel::unschedule(fLivenessCommandTask);
+  ProxyTimerWheel::unschedule(fDESCRIBECommandTask);
   envir().taskScheduler().unscheduleDelayedTask(fSubsessionTimerTask); fSubsessionTimerTask = NULL;
+  ProxyTimerWheel::unschedule(fIdleDisconnectTask);
 
   fSetupQueueHead = fSetupQueueTail = NULL;
   fNumSetupsDone = 0;
   fNextDESCRIBEDelay = 1;
+  fNumDESCRIBEFailures = 0;
   fLastCommandWasPLAY = False;
+  fIsDisconnectedWhileIdle = False;
 
   RTSPClient::reset();
 }
@@ -242,6 +510,7 @@ ProxyRTSPClient::~ProxyRTSPClient() {
 
 void ProxyRTSPClient::continueAfterDESCRIBE(char const* sdpDescription) {
   if (sdpDescription != NULL) {
+    fNumDESCRIBEFailures = 0;
     fOurServerMediaSession.continueAfterDESCRIBE(sdpDescription);
 
     // Unlike most RTSP streams, there might be a long delay between this "DESCRIBE" command (to the downstream server) and the
@@ -250,9 +519,13 @@ void ProxyRTSPClient::continueAfterDESCRIBE(char const* sdpDescription) {
     // ("OPTIONS" or "GET_PARAMETER") commands.  (The usual RTCP liveness mechanism wouldn't work here, because RTCP packets
     // don't get sent until after the "PLAY" command.)
     scheduleLivenessCommand();
+
+    // In 'capacity mode', we don't keep the connection open until we have a client:
+    scheduleIdleDisconnect();
   } else {
     // The "DESCRIBE" command failed, most likely because the server or the stream is not yet running.
     // Reschedule another "DESCRIBE" command to take place later:
+    ++fNumDESCRIBEFailures;
     scheduleDESCRIBECommand();
   }
 }
@@ -278,7 +551,7 @@ void ProxyRTSPClient::continueAfterLivenessCommand(int resultCode, Boolean serve
     fOurServerMediaSession.resetDESCRIBEState();
 
     setBaseURL(fOurURL); // because we'll be sending an initial "DESCRIBE" all over again
-    sendDESCRIBE(this);
+    scheduleDESCRIBECommand(False); // staggered, in case many other back-end streams are being restored at the same time
     return;
   }
 
@@ -290,7 +563,15 @@ void ProxyRTSPClient::continueAfterLivenessCommand(int resultCode, Boolean serve
 
 #define SUBSESSION_TIMEOUT_SECONDS 10 // how many seconds to wait for the last track's "SETUP" to be done (note below)
 
-void ProxyRTSPClient::continueAfterSETUP() {
+void ProxyRTSPClient::continueAfterSETUP(int resultCode) {
+  if (resultCode != 0) {
+    // The "SETUP" failed.  In 'capacity mode' - where the "SETUP" might have been sent (after reconnecting) long after our
+    // "DESCRIBE" - this might be because the back-end stream has changed, so treat this as a 'liveness' failure (which
+    // will cause us to restart with a new "DESCRIBE"):
+    if (fOurServerMediaSession.fIdleDisconnectSeconds > 0) continueAfterLivenessCommand(resultCode, False);
+    return;
+  }
+
   if (fVerbosityLevel > 0) {
     envir() << *this << "::continueAfterSETUP(): head codec: " << fSetupQueueHead->fClientMediaSubsession.codecName()
 	    << "; numSubsessions " << fSetupQueueHead->fParentSession->numSubsessions() << "\n\tqueue:";
@@ -340,19 +621,21 @@ void ProxyRTSPClient::scheduleLivenessCommand() {
   }
 
   // Choose a random time from [delayMax/2,delayMax-1) seconds:
-  unsigned const us_1stPart = delayMax*500000;
-  unsigned uSecondsToDelay;
-  if (us_1stPart <= 1000000) {
-    uSecondsToDelay = us_1stPart;
+  unsigned const secondsToDelay_1stPart = delayMax/2;
+  unsigned secondsToDelay;
+  if (secondsToDelay_1stPart <= 1) {
+    secondsToDelay = 1;
   } else {
-    unsigned const us_2ndPart = us_1stPart-1000000;
-    uSecondsToDelay = us_1stPart + (us_2ndPart*our_random())%us_2ndPart;
+    unsigned const secondsToDelay_2ndPart = secondsToDelay_1stPart-1;
+    secondsToDelay = secondsToDelay_1stPart + our_random()%secondsToDelay_2ndPart;
   }
-  fLivenessCommandTask = envir().taskScheduler().scheduleDelayedTask(uSecondsToDelay, sendLivenessCommand, this);
+  ProxyTimerWheel::unschedule(fLivenessCommandTask);
+  fLivenessCommandTask = ProxyTimerWheel::schedule(envir(), secondsToDelay, sendLivenessCommand, this);
 }
 
 void ProxyRTSPClient::sendLivenessCommand(void* clientData) {
   ProxyRTSPClient* rtspClient = (ProxyRTSPClient*)clientData;
+  rtspClient->fLivenessCommandTask = NULL;
 
   // Note.  By default, we do not send "GET_PARAMETER" as our 'liveness notification' command, even if the server previously
   // indicated (in its response to our earlier "OPTIONS" command) that it supported "GET_PARAMETER".  This is because
@@ -370,25 +653,115 @@ void ProxyRTSPClient::sendLivenessCommand(void* clientData) {
 #endif
 }
 
-void ProxyRTSPClient::scheduleDESCRIBECommand() {
-  // Delay 1s, 2s, 4s, 8s ... 256s until sending the next "DESCRIBE".  Then, keep delaying a random time from [256..511] seconds:
+void ProxyRTSPClient::scheduleDESCRIBECommand(Boolean afterFailure) {
   unsigned secondsToDelay;
-  if (fNextDESCRIBEDelay <= 256) {
-    secondsToDelay = fNextDESCRIBEDelay;
-    fNextDESCRIBEDelay *= 2;
+  if (!afterFailure) {
+    // Send the "DESCRIBE" as soon as possible (but no more than PROXY_MAX_DESCRIBES_PER_SECOND "DESCRIBE"s get sent each second):
+    secondsToDelay = 0;
   } else {
-    secondsToDelay = 256 + (our_random()&0xFF); // [256..511] seconds
-  }
+    // Delay [1..2)s, [2..4)s, [4..8)s ... [256..512)s until sending the next "DESCRIBE".  Then, keep delaying a random time
+    // from [256..511] seconds.  (The randomness spreads out the retries of streams whose "DESCRIBE"s failed at the same time.)
+    if (fNextDESCRIBEDelay <= 256) {
+      secondsToDelay = fNextDESCRIBEDelay + our_random()%fNextDESCRIBEDelay;
+      fNextDESCRIBEDelay *= 2;
+    } else {
+      secondsToDelay = 256 + (our_random()&0xFF); // [256..511] seconds
+    }
 
-  if (fVerbosityLevel > 0) {
-    envir() << *this << ": RTSP \"DESCRIBE\" command failed; trying again in " << secondsToDelay << " seconds\n";
+    if (fVerbosityLevel > 0) {
+      envir() << *this << ": RTSP \"DESCRIBE\" command failed; trying again in " << secondsToDelay << " seconds\n";
+    }
   }
-  fDESCRIBECommandTask = envir().taskScheduler().scheduleDelayedTask(secondsToDelay*MILLION, sendDESCRIBE, this);
+  ProxyTimerWheel::unschedule(fDESCRIBECommandTask);
+  fDESCRIBECommandTask = ProxyTimerWheel::schedule(envir(), secondsToDelay, sendDESCRIBE, this, True/*rate-limited*/);
 }
 
 void ProxyRTSPClient::sendDESCRIBE(void* clientData) {
   ProxyRTSPClient* rtspClient = (ProxyRTSPClient*)clientData;
-  if (rtspClient != NULL) rtspClient->sendDescribeCommand(::continueAfterDESCRIBE, rtspClient->auth());
+  if (rtspClient != NULL) {
+    rtspClient->fDESCRIBECommandTask = NULL;
+    rtspClient->sendDescribeCommand(::continueAfterDESCRIBE, rtspClient->auth());
+  }
+}
+
+void ProxyRTSPClient::scheduleIdleDisconnect() {
+  if (fOurServerMediaSession.fIdleDisconnectSeconds == 0) return; // we're not in 'capacity mode'
+
+  ProxyTimerWheel::unschedule(fIdleDisconnectTask);
+  fIdleDisconnectTask
+    = ProxyTimerWheel::schedule(envir(), fOurServerMediaSession.fIdleDisconnectSeconds, idleDisconnect, this);
+}
+
+void ProxyRTSPClient::idleDisconnect(void* clientData) {
+  ProxyRTSPClient* rtspClient = (ProxyRTSPClient*)clientData;
+  rtspClient->fIdleDisconnectTask = NULL;
+  rtspClient->disconnectWhileIdle();
+}
+
+void ProxyRTSPClient::disconnectWhileIdle() {
+  // Check that none of our subsessions are still being used (e.g., by a client that's playing only some of the tracks):
+  ServerMediaSubsessionIterator iter(fOurServerMediaSession);
+  ProxyServerMediaSubsession* smss;
+  while ((smss = (ProxyServerMediaSubsession*)(iter.next())) != NULL) {
+    if (smss->fNumStreamSourceUsers > 0) return; // we'll get called again, once it's no longer being used
+  }
+
+  if (fVerbosityLevel > 0 && !fIsDisconnectedWhileIdle) {
+    envir() << *this << ": no clients for " << fOurServerMediaSession.fIdleDisconnectSeconds
+	    << " seconds; disconnecting from the back-end server\n";
+  }
+
+  // Close our subsessions' data sources (and their sockets); they'll get reopened when the next client arrives:
+  iter.reset();
+  while ((smss = (ProxyServerMediaSubsession*)(iter.next())) != NULL) {
+    smss->deInitiateClientMediaSubsession();
+  }
+  if (fIsDisconnectedWhileIdle) return; // we've already closed our connection
+
+  ProxyTimerWheel::unschedule(fLivenessCommandTask); // because we won't need 'liveness' commands while we're disconnected
+  envir().taskScheduler().unscheduleDelayedTask(fSubsessionTimerTask); fSubsessionTimerTask = NULL;
+  fSetupQueueHead = fSetupQueueTail = NULL;
+  fLastCommandWasPLAY = False;
+  fIsDisconnectedWhileIdle = True;
+
+  MediaSession* sess = fOurServerMediaSession.fClientMediaSession;
+  if (fNumSetupsDone > 0 && sess != NULL) {
+    // End the back-end session, and close the connection once it's done:
+    fNumSetupsDone = 0;
+    sendTeardownCommand(*sess, ::continueAfterIdleTEARDOWN, fOurAuthenticator);
+  } else {
+    closeConnectionWhileIdle();
+  }
+}
+
+void ProxyRTSPClient::continueAfterIdleTEARDOWN() {
+  if (fIsDisconnectedWhileIdle) closeConnectionWhileIdle(); // unless a new client arrived in the meantime
+}
+
+void ProxyRTSPClient::closeConnectionWhileIdle() {
+  // Close our connection to the server, but keep the base URL (that we got from the "DESCRIBE"), for use when we reconnect:
+  char* baseURL = strDup(url());
+  RTSPClient::reset();
+  setBaseURL(baseURL);
+  delete[] baseURL;
+}
+
+void ProxyRTSPClient::reconnectIfIdle() {
+  // Called when a new client arrives:
+  ProxyTimerWheel::unschedule(fIdleDisconnectTask);
+  if (!fIsDisconnectedWhileIdle) return;
+
+  if (fVerbosityLevel > 0) {
+    envir() << *this << ": reconnecting to the back-end server\n";
+  }
+  fIsDisconnectedWhileIdle = False;
+  if (socketNum() >= 0) {
+    // We're still waiting for a response to our "TEARDOWN".  Close the connection now, so that we start a new session:
+    closeConnectionWhileIdle();
+  }
+  // (Our next command - a "SETUP" - will open a new connection.)
+
+  scheduleLivenessCommand();
 }
 
 void ProxyRTSPClient::subsessionTimeout(void* clientData) {
@@ -405,9 +778,13 @@ void ProxyRTSPClient::handleSubsessionTimeout() {
 
 //////// "ProxyServerMediaSubsession" implementation //////////
 
-ProxyServerMediaSubsession::ProxyServerMediaSubsession(MediaSubsession& mediaSubsession)
-  : OnDemandServerMediaSubsession(mediaSubsession.parentSession().envir(), True/*reuseFirstSource*/),
-    fClientMediaSubsession(mediaSubsession), fNext(NULL), fHaveSetupStream(False) {
+ProxyServerMediaSubsession::ProxyServerMediaSubsession(MediaSubsession& mediaSubsession, unsigned gopCacheSize)
+  : OnDemandServerMediaSubsession(mediaSubsession.parentSession().envir(),
+				  !canUseGOPCache(mediaSubsession, gopCacheSize)/*reuseFirstSource*/),
+    fClientMediaSubsession(mediaSubsession), fNext(NULL), fHaveSetupStream(False), fRelaysRTPPayloadsDirectly(False),
+    fBackEndPayloadsAreTooLargeToRelay(False),
+    fNumStreamSourceUsers(0), fGOPCacheSize(canUseGOPCache(mediaSubsession, gopCacheSize) ? gopCacheSize : 0),
+    fNormalizer(NULL), fReplicator(NULL), fRTPSinksByReplica(HashTable::create(ONE_WORD_HASH_KEYS)) {
 }
 
 UsageEnvironment& operator<<(UsageEnvironment& env, const ProxyServerMediaSubsession& psmss) { // used for debugging
@@ -418,6 +795,36 @@ ProxyServerMediaSubsession::~ProxyServerMediaSubsession() {
   if (verbosityLevel() > 0) {
     envir() << *this << "::~ProxyServerMediaSubsession()\n";
   }
+
+  if (fReplicator != NULL) {
+    fReplicator->detachInputSource(); // because our input source is owned by "fClientMediaSubsession"
+    Medium::close(fReplicator);
+  }
+  delete fRTPSinksByReplica;
+}
+
+Boolean ProxyServerMediaSubsession::canUseGOPCache(MediaSubsession& mediaSubsession, unsigned gopCacheSize) {
+  // A GOP cache can be used only for codecs whose key frames "GOPCache" can recognize:
+  char const* const codecName = mediaSubsession.codecName();
+  return gopCacheSize > 0 && strcmp(mediaSubsession.protocolName(), "RTP") == 0
+    && (strcmp(codecName, "H264") == 0 || strcmp(codecName, "H265") == 0 || strcmp(codecName, "MP4V-ES") == 0);
+}
+
+void ProxyServerMediaSubsession::deInitiateClientMediaSubsession() {
+  // Close our input source (and its socket), and anything that we had built on top of it.  (This is done only when we have no
+  // front-end clients.)  It will get recreated by the next call to "createNewStreamSource()":
+  if (fReplicator != NULL) {
+    fReplicator->detachInputSource(); // because our input source is owned by "fClientMediaSubsession"
+    Medium::close(fReplicator); fReplicator = NULL;
+  }
+  if (fNormalizer != NULL && fNormalizer->numOversizePayloadsRelayed() > 0) {
+    // Some of the back-end stream's RTP payloads were too large for our usual front-end packets, so next time, reassemble
+    // its frames (so they can be repacketized) instead of relaying its payloads:
+    fBackEndPayloadsAreTooLargeToRelay = True;
+  }
+  fNormalizer = NULL;
+  fHaveSetupStream = False;
+  fClientMediaSubsession.deInitiate();
 }
 
 FramedSource* ProxyServerMediaSubsession::createNewStreamSource(unsigned clientSessionId, unsigned& estBitrate) {
@@ -429,8 +836,27 @@ FramedSource* ProxyServerMediaSubsession::createNewStreamSource(unsigned clientS
 
   // If we haven't yet created a data source from our 'media subsession' object, initiate() it to do so:
   if (fClientMediaSubsession.readSource() == NULL) {
+    char const* const codecName = fClientMediaSubsession.codecName();
+
+    // Check whether we can relay the back-end stream's RTP payloads directly, rather than reassembling (and later
+    // repacketizing) frames.  We always do this for JPEG/RTP (because we don't have a means of repacketizing JPEG frames),
+    // and - unless asked not to - for other codecs whose RTP payloads do not depend upon the surrounding RTP header:
+    // (We can't do this if we're using a GOP cache, because that needs complete frames.)
+    // Each relayed payload should fit in one of our usual (front-end) packets, so we don't relay payloads that we receive via
+    // RTP-over-TCP (because those packets aren't limited by the network's MTU), or those that were earlier found to be too large:
+    fRelaysRTPPayloadsDirectly = strcmp(fClientMediaSubsession.protocolName(), "RTP") == 0 && fGOPCacheSize == 0
+      && (strcmp(codecName, "JPEG") == 0 ||
+	  (sms->fRelayRTPPayloadsDirectly && !sms->fProxyRTSPClient->fStreamRTPOverTCP && !fBackEndPayloadsAreTooLargeToRelay &&
+	   (strcmp(codecName, "H264") == 0 ||
+	    strcmp(codecName, "H265") == 0 ||
+	    strcmp(codecName, "MP4V-ES") == 0 ||
+	    strcmp(codecName, "MPV") == 0 ||
+	    strcmp(codecName, "DV") == 0 ||
+	    strcmp(codecName, "VP8") == 0 ||
+	    strcmp(codecName, "MPEG4-GENERIC") == 0 ||
+	    strcmp(codecName, "MP4A-LATM") == 0)));
+    if (fRelaysRTPPayloadsDirectly) fClientMediaSubsession.receiveRawRTPPayloads(); // (Don't do this if we're transcoding.)
     fClientMediaSubsession.receiveRawMP3ADUs(); // hack for MPA-ROBUST streams
-    fClientMediaSubsession.receiveRawJPEGFrames(); // hack for proxying JPEG/RTP streams. (Don't do this if we're transcoding.)
     fClientMediaSubsession.initiate();
     if (verbosityLevel() > 0) {
       envir() << "\tInitiated: " << *this << "\n";
@@ -439,15 +865,21 @@ FramedSource* ProxyServerMediaSubsession::createNewStreamSource(unsigned clientS
     if (fClientMediaSubsession.readSource() != NULL) {
       // Add to the front of all data sources a filter that will 'normalize' their frames' presentation times,
       // before the frames get re-transmitted by our server:
-      char const* const codecName = fClientMediaSubsession.codecName();
-      FramedFilter* normalizerFilter = sms->fPresentationTimeSessionNormalizer
+      fNormalizer = sms->fPresentationTimeSessionNormalizer
 	->createNewPresentationTimeSubsessionNormalizer(fClientMediaSubsession.readSource(), fClientMediaSubsession.rtpSource(),
 							codecName);
-      fClientMediaSubsession.addFilter(normalizerFilter);
+      fClientMediaSubsession.addFilter(fNormalizer);
 
       // Some data sources require a 'framer' object to be added, before they can be fed into
-      // a "RTPSink".  Adjust for this now:
-      if (strcmp(codecName, "H264") == 0) {
+      // a "RTPSink".  Adjust for this now.  (This isn't needed if we're relaying RTP payloads directly.)
+      if (fRelaysRTPPayloadsDirectly) {
+	// No 'framer' is needed, because each frame is a complete RTP payload
+      } else if (fGOPCacheSize > 0) {
+	// Each front-end client will read from its own replica of the input stream, so that it can be given the cached GOP
+	// when it starts.  (Each replica will get its own 'framer', because "RTPSink"s check the type of their source.)
+	fReplicator = StreamReplicator::createNew(envir(), fClientMediaSubsession.readSource(), False);
+	fReplicator->useGOPCache(codecName, fGOPCacheSize);
+      } else if (strcmp(codecName, "H264") == 0) {
 	fClientMediaSubsession.addFilter(H264VideoStreamDiscreteFramer
 					 ::createNew(envir(), fClientMediaSubsession.readSource()));
       } else if (strcmp(codecName, "H265") == 0) {
@@ -476,6 +908,8 @@ FramedSource* ProxyServerMediaSubsession::createNewStreamSource(unsigned clientS
   ProxyRTSPClient* const proxyRTSPClient = sms->fProxyRTSPClient;
   if (clientSessionId != 0) {
     // We're being called as a result of implementing a RTSP "SETUP".
+    proxyRTSPClient->reconnectIfIdle(); // in case we're in 'capacity mode', and had disconnected from the back-end server
+
     if (!fHaveSetupStream) {
       // This is our first "SETUP".  Send RTSP "SETUP" and later "PLAY" commands to the proxied server, to start streaming:
       // (Before sending "SETUP", enqueue ourselves on the "RTSPClient"s 'SETUP queue', so we'll be able to get the correct
@@ -510,7 +944,22 @@ FramedSource* ProxyServerMediaSubsession::createNewStreamSource(unsigned clientS
 
   estBitrate = fClientMediaSubsession.bandwidth();
   if (estBitrate == 0) estBitrate = 50; // kbps, estimate
-  return fClientMediaSubsession.readSource();
+  if (fClientMediaSubsession.readSource() == NULL) return NULL;
+
+  ++fNumStreamSourceUsers;
+  if (fReplicator == NULL) return fClientMediaSubsession.readSource();
+
+  // Give this client its own replica of the input stream, followed by a 'framer'.  (If this client falls behind the others,
+  // it skips ahead to a key frame, rather than holding them up.)
+  FramedSource* replica = fReplicator->createStreamReplica(StreamReplicator::LAG_SKIPS_TO_KEY_FRAME);
+  char const* const codecName = fClientMediaSubsession.codecName();
+  if (strcmp(codecName, "H264") == 0) {
+    return H264VideoStreamDiscreteFramer::createNew(envir(), replica);
+  } else if (strcmp(codecName, "H265") == 0) {
+    return H265VideoStreamDiscreteFramer::createNew(envir(), replica);
+  } else { // "MP4V-ES"
+    return MPEG4VideoStreamDiscreteFramer::createNew(envir(), replica, True/* leave PTs unmodified*/);
+  }
 }
 
 void ProxyServerMediaSubsession::closeStreamSource(FramedSource* inputSource) {
@@ -518,9 +967,19 @@ void ProxyServerMediaSubsession::closeStreamSource(FramedSource* inputSource) {
     envir() << *this << "::closeStreamSource()\n";
   }
   // Because there's only one input source for this 'subsession' (regardless of how many downstream clients are proxying it),
-  // we don't close the input source here.  (Instead, we wait until *this* object gets deleted.)
-  // However, because (as evidenced by this function having been called) we no longer have any clients accessing the stream,
-  // then we "PAUSE" the downstream proxied stream, until a new client arrives:
+  // we don't close the input source here.  (Instead, we wait until *this* object gets deleted.)  If we're using a GOP cache,
+  // however, then "inputSource" is this client's own replica of the input source (plus 'framer'), so we close that:
+  if (fReplicator != NULL) {
+    fNormalizer->removeRTPSink((RTPSink*)(fRTPSinksByReplica->Lookup((char const*)inputSource)));
+    fRTPSinksByReplica->Remove((char const*)inputSource);
+    Medium::close(inputSource);
+  }
+
+  if (fNumStreamSourceUsers > 0) --fNumStreamSourceUsers;
+  if (fNumStreamSourceUsers > 0) return; // other front-end clients are still accessing the stream
+
+  // Because we no longer have any clients accessing the stream, we "PAUSE" the downstream proxied stream, until a new
+  // client arrives:
   if (fHaveSetupStream) {
     ProxyServerMediaSession* const sms = (ProxyServerMediaSession*)fParentSession;
     ProxyRTSPClient* const proxyRTSPClient = sms->fProxyRTSPClient;
@@ -529,6 +988,10 @@ void ProxyServerMediaSubsession::closeStreamSource(FramedSource* inputSource) {
       proxyRTSPClient->fLastCommandWasPLAY = False;
     }
   }
+
+  // In 'capacity mode', we also disconnect from the back-end server if no new client arrives soon:
+  ProxyServerMediaSession* const sms = (ProxyServerMediaSession*)fParentSession;
+  sms->fProxyRTSPClient->scheduleIdleDisconnect();
 }
 
 RTPSink* ProxyServerMediaSubsession
@@ -540,7 +1003,12 @@ RTPSink* ProxyServerMediaSubsession
   // Create (and return) the appropriate "RTPSink" object for our codec:
   RTPSink* newSink;
   char const* const codecName = fClientMediaSubsession.codecName();
-  if (strcmp(codecName, "AC3") == 0 || strcmp(codecName, "EAC3") == 0) {
+  if (fRelaysRTPPayloadsDirectly) {
+    unsigned char const inputPayloadFormat = fClientMediaSubsession.rtpPayloadFormat();
+    newSink = RTPPayloadRelaySink::createNew(envir(), rtpGroupsock,
+					     inputPayloadFormat < 96 ? inputPayloadFormat : rtpPayloadTypeIfDynamic,
+					     fClientMediaSubsession);
+  } else if (strcmp(codecName, "AC3") == 0 || strcmp(codecName, "EAC3") == 0) {
     newSink = AC3AudioRTPSink::createNew(envir(), rtpGroupsock, rtpPayloadTypeIfDynamic,
 					 fClientMediaSubsession.rtpTimestampFrequency()); 
 #if 0 // This code does not work; do *not* enable it:
@@ -570,9 +1038,6 @@ RTPSink* ProxyServerMediaSubsession
 					  fClientMediaSubsession.attrVal_unsigned("tier-flag"),
 					  fClientMediaSubsession.attrVal_unsigned("level-id"),
 					  fClientMediaSubsession.attrVal_str("interop-constraints"));
-  } else if (strcmp(codecName, "JPEG") == 0) {
-    newSink = SimpleRTPSink::createNew(envir(), rtpGroupsock, 26, 90000, "video", "JPEG",
-				       1/*numChannels*/, False/*allowMultipleFramesPerPacket*/, False/*doNormalMBitRule*/);
   } else if (strcmp(codecName, "MP4A-LATM") == 0) {
     newSink = MPEG4LATMAudioRTPSink::createNew(envir(), rtpGroupsock, rtpPayloadTypeIfDynamic,
 					       fClientMediaSubsession.rtpTimestampFrequency(),
@@ -645,18 +1110,13 @@ RTPSink* ProxyServerMediaSubsession
   newSink->enableRTCPReports() = False;
 
   // Also tell our "PresentationTimeSubsessionNormalizer" object about the "RTPSink", so it can enable RTCP "SR" reports later:
-  PresentationTimeSubsessionNormalizer* ssNormalizer;
-  if (strcmp(codecName, "H264") == 0 ||
-      strcmp(codecName, "H265") == 0 ||
-      strcmp(codecName, "MP4V-ES") == 0 ||
-      strcmp(codecName, "MPV") == 0 ||
-      strcmp(codecName, "DV") == 0) {
-    // There was a separate 'framer' object in front of the "PresentationTimeSubsessionNormalizer", so go back one object to get it:
-    ssNormalizer = (PresentationTimeSubsessionNormalizer*)(((FramedFilter*)inputSource)->inputSource());
+  if (fReplicator != NULL) {
+    // Our normalizer feeds several "RTPSink"s (one per front-end client):
+    fNormalizer->addRTPSink(newSink);
+    fRTPSinksByReplica->Add((char const*)inputSource, newSink);
   } else {
-    ssNormalizer = (PresentationTimeSubsessionNormalizer*)inputSource;
+    fNormalizer->setRTPSink(newSink, fRelaysRTPPayloadsDirectly);
   }
-  ssNormalizer->setRTPSink(newSink);
 
   return newSink;
 }
@@ -682,6 +1142,72 @@ void ProxyServerMediaSubsession::subsessionByeHandler() {
 }
 
 
+////////// RTPPayloadRelaySink implementation //////////
+
+RTPPayloadRelaySink::RTPPayloadRelaySink(UsageEnvironment& env, Groupsock* RTPgs, unsigned char rtpPayloadFormat,
+					 MediaSubsession& inputSubsession)
+  : SimpleRTPSink(env, RTPgs, rtpPayloadFormat, inputSubsession.rtpTimestampFrequency(),
+		  inputSubsession.mediumName(), inputSubsession.codecName(), inputSubsession.numChannels(),
+		  False/*only one payload per packet*/, False/*copy the 'M' bit instead*/),
+    fFmtpSDPLine(NULL), fHaveSeenIncomingPacket(False), fIncomingSeqNum(0), fSeqNumOffset(0),
+    fFrontEndMaxPacketSize(ourMaxPacketSize()) {
+  setPacketSizes(fFrontEndMaxPacketSize, RELAYED_RTP_PACKET_MAX_SIZE);
+
+  // Copy the back-end stream's "a=fmtp:" line (if any), replacing its RTP payload type with ours:
+  char const* sdpLine = inputSubsession.savedSDPLines();
+  while (sdpLine != NULL) {
+    if (strncmp(sdpLine, "a=fmtp:", 7) == 0) {
+      char const* fmtpParams = &sdpLine[7];
+      while (*fmtpParams != '\0' && *fmtpParams != ' ' && *fmtpParams != '\r' && *fmtpParams != '\n') ++fmtpParams; // skip payload type
+      while (*fmtpParams == ' ') ++fmtpParams;
+
+      unsigned paramsLen = 0;
+      while (fmtpParams[paramsLen] != '\0' && fmtpParams[paramsLen] != '\r' && fmtpParams[paramsLen] != '\n') ++paramsLen;
+      if (paramsLen > 0) {
+	fFmtpSDPLine = new char[7 + 3 + 1 + paramsLen + 2 + 1];
+	sprintf(fFmtpSDPLine, "a=fmtp:%d %.*s\r\n", rtpPayloadType(), (int)paramsLen, fmtpParams);
+      }
+      break;
+    }
+
+    sdpLine = strchr(sdpLine, '\n');
+    if (sdpLine != NULL) ++sdpLine;
+  }
+}
+
+RTPPayloadRelaySink::~RTPPayloadRelaySink() {
+  delete[] fFmtpSDPLine;
+}
+
+void RTPPayloadRelaySink::doSpecialFrameHandling(unsigned fragmentationOffset,
+						 unsigned char* frameStart,
+						 unsigned numBytesInFrame,
+						 struct timeval framePresentationTime,
+						 unsigned numRemainingBytes) {
+  // Our outgoing sequence numbers track the incoming ones (offset by a constant), so that any loss of incoming packets
+  // remains visible to our clients:
+  if (!fHaveSeenIncomingPacket) {
+    fSeqNumOffset = fSeqNo - fIncomingSeqNum;
+    fHaveSeenIncomingPacket = True;
+  }
+  u_int16_t const seqNo = fIncomingSeqNum + fSeqNumOffset;
+  if ((int16_t)(seqNo - fSeqNo) > 0) {
+    // Some incoming packets were lost, so skip over the corresponding outgoing sequence numbers:
+    setSequenceNumber(seqNo);
+  } else if (seqNo != fSeqNo) {
+    // We must never reuse a sequence number (e.g., if the incoming stream restarted), so change our offset instead:
+    fSeqNumOffset = fSeqNo - fIncomingSeqNum;
+  }
+
+  SimpleRTPSink::doSpecialFrameHandling(fragmentationOffset, frameStart, numBytesInFrame, framePresentationTime,
+					numRemainingBytes);
+}
+
+char const* RTPPayloadRelaySink::auxSDPLine() {
+  return fFmtpSDPLine;
+}
+
+
 ////////// PresentationTimeSessionNormalizer and PresentationTimeSubsessionNormalizer implementations //////////
 
 // PresentationTimeSessionNormalizer:
@@ -734,10 +1260,9 @@ void PresentationTimeSessionNormalizer::normalizePresentationTime(PresentationTi
     toPT.tv_usec = fromPT.tv_usec + fPTAdjustment.tv_usec + MILLION;
     while (toPT.tv_usec > MILLION) { ++toPT.tv_sec; toPT.tv_usec -= MILLION; }
 
-    // Because "ssNormalizer"s relayed presentation times are accurate from now on, enable RTCP "SR" reports for its "RTPSink":
-    RTPSink* const rtpSink = ssNormalizer->fRTPSink;
-    if (rtpSink != NULL) { // sanity check; should always be true
-      rtpSink->enableRTCPReports() = True;
+    // Because "ssNormalizer"s relayed presentation times are accurate from now on, enable RTCP "SR" reports for its "RTPSink"(s):
+    for (unsigned i = 0; i < ssNormalizer->fNumRTPSinks; ++i) {
+      ssNormalizer->fRTPSinks[i]->enableRTCPReports() = True;
     }
   }
 }
@@ -745,6 +1270,7 @@ void PresentationTimeSessionNormalizer::normalizePresentationTime(PresentationTi
 void PresentationTimeSessionNormalizer
 ::removePresentationTimeSubsessionNormalizer(PresentationTimeSubsessionNormalizer* ssNormalizer) {
   // Unlink "ssNormalizer" from the linked list (starting with "fSubsessionNormalizers"):
+  if (fMasterSSNormalizer == ssNormalizer) fMasterSSNormalizer = NULL;
   if (fSubsessionNormalizers == ssNormalizer) {
     fSubsessionNormalizers = fSubsessionNormalizers->fNext;
   } else {
@@ -760,11 +1286,33 @@ PresentationTimeSubsessionNormalizer
 ::PresentationTimeSubsessionNormalizer(PresentationTimeSessionNormalizer& parent, FramedSource* inputSource, RTPSource* rtpSource,
 				       char const* codecName, PresentationTimeSubsessionNormalizer* next)
   : FramedFilter(parent.envir(), inputSource),
-    fParent(parent), fRTPSource(rtpSource), fRTPSink(NULL), fCodecName(codecName), fNext(next) {
+    fParent(parent), fRTPSource(rtpSource), fRTPSinks(NULL), fNumRTPSinks(0), fMaxNumRTPSinks(0),
+    fRelaysRTPPayloadsDirectly(False), fNumOversizePayloadsRelayed(0), fCodecName(codecName), fNext(next) {
 }
 
 PresentationTimeSubsessionNormalizer::~PresentationTimeSubsessionNormalizer() {
   fParent.removePresentationTimeSubsessionNormalizer(this);
+  delete[] fRTPSinks;
+}
+
+void PresentationTimeSubsessionNormalizer::addRTPSink(RTPSink* rtpSink) {
+  if (fNumRTPSinks == fMaxNumRTPSinks) {
+    // Grow our array of "RTPSink"s:
+    fMaxNumRTPSinks = fMaxNumRTPSinks == 0 ? 1 : 2*fMaxNumRTPSinks;
+    RTPSink** newRTPSinks = new RTPSink*[fMaxNumRTPSinks];
+    for (unsigned i = 0; i < fNumRTPSinks; ++i) newRTPSinks[i] = fRTPSinks[i];
+    delete[] fRTPSinks; fRTPSinks = newRTPSinks;
+  }
+  fRTPSinks[fNumRTPSinks++] = rtpSink;
+}
+
+void PresentationTimeSubsessionNormalizer::removeRTPSink(RTPSink* rtpSink) {
+  for (unsigned i = 0; i < fNumRTPSinks; ++i) {
+    if (fRTPSinks[i] == rtpSink) {
+      fRTPSinks[i] = fRTPSinks[--fNumRTPSinks];
+      return;
+    }
+  }
 }
 
 void PresentationTimeSubsessionNormalizer::afterGettingFrame(void* clientData, unsigned frameSize,
@@ -786,9 +1334,17 @@ void PresentationTimeSubsessionNormalizer::afterGettingFrame(unsigned frameSize,
 
   fParent.normalizePresentationTime(this, fPresentationTime, presentationTime);
 
-  // Hack for JPEG/RTP proxying.  Because we're proxying JPEG by just copying the raw JPEG/RTP payloads, without interpreting them,
-  // we need to also 'copy' the RTP 'M' (marker) bit from the "RTPSource" to the "RTPSink":
-  if (fRTPSource->curPacketMarkerBit() && strcmp(fCodecName, "JPEG") == 0) ((SimpleRTPSink*)fRTPSink)->setMBitOnNextPacket();
+  // If we're relaying raw RTP payloads (e.g., for JPEG/RTP proxying), without interpreting them, then we need to also 'copy'
+  // the RTP 'M' (marker) bit - and any gap in the sequence numbers - from the "RTPSource" to the "RTPSink":
+  if (fRelaysRTPPayloadsDirectly && fNumRTPSinks > 0) {
+    RTPPayloadRelaySink* relaySink = (RTPPayloadRelaySink*)fRTPSinks[0];
+    if (frameSize > relaySink->frontEndMaxPayloadSize()) {
+      // This payload can't be fragmented, so the sink will relay it in a larger-than-usual packet.  Note this, so that the
+      // stream gets reassembled instead next time:
+      ++fNumOversizePayloadsRelayed;
+    }
+    relaySink->noteIncomingPacket(fRTPSource->curPacketMarkerBit(), fRTPSource->curPacketRTPSeqNum());
+  }
 
   // Complete delivery:
   FramedSource::afterGetting(this);
@@ -169,6 +169,29 @@ public:
   unsigned fNumChunks;
   SyncFrame *fHeadSyncFrame, *fTailSyncFrame;
 
+  // Used only for fragmented files: The samples (and data) for the current fragment:
+  struct FragmentRun {
+    unsigned numSamples, sampleSize, sampleDuration;
+    Boolean isSync;
+  };
+  FragmentRun* fFragmentRuns;
+  unsigned fNumFragmentRuns, fMaxNumFragmentRuns;
+  unsigned fNumFragmentSamples;
+  unsigned char* fFragmentData;
+  unsigned fFragmentDataSize, fMaxFragmentDataSize;
+  unsigned fFragmentSampleDataSize; // the part of "fFragmentData" that belongs to completed samples
+  u_int64_t fFragmentDecodeTime; // of the first sample in the current fragment (in track time units)
+  unsigned fFragmentSampleDuration, fFragmentSampleSize; // if the same for each sample in the fragment; otherwise 0
+  unsigned fMDATdataOffset; // where our data begins within the fragment's "mdat"
+  int64_t fTRUN_dataOffsetPosn;
+  Boolean fHavePendingSample; // a video sample that might still get more data
+  struct timeval fPendingSamplePresentationTime;
+  unsigned fPendingSampleSize;
+  Boolean fPendingSampleIsSync;
+
+  void completePendingSample(unsigned duration);
+  void resetFragment(); // called after the fragment has been written
+
   // Counters to be used in the hint track's 'udta'/'hinf' atom;
   struct hinf {
     Count64 trpy;
@@ -185,6 +208,9 @@ public:
 
 private:
   void useFrame(SubsessionBuffer& buffer);
+  void useFrameInFragment(SubsessionBuffer& buffer);
+  void addFragmentSamples(unsigned numSamples, unsigned sampleSize, unsigned sampleDuration, Boolean isSync);
+  void addFragmentData(unsigned char const* data, unsigned dataSize);
   void useFrameForHinting(unsigned frameSize,
 			  struct timeval presentationTime,
 			  unsigned startSampleNumber);
@@ -226,18 +252,22 @@ QuickTimeFileSink::QuickTimeFileSink(UsageEnvironment& env,
 				     Boolean packetLossCompensate,
 				     Boolean syncStreams,
 				     Boolean generateHintTracks,
-				     Boolean generateMP4Format)
+				     Boolean generateMP4Format,
+				     unsigned fragmentDuration)
   : Medium(env), fInputSession(inputSession),
     fBufferSize(bufferSize), fPacketLossCompensate(packetLossCompensate),
-    fSyncStreams(syncStreams), fGenerateMP4Format(generateMP4Format),
+    fSyncStreams(syncStreams), fGenerateMP4Format(generateMP4Format || fragmentDuration > 0),
     fAreCurrentlyBeingPlayed(False),
     fLargestRTPtimestampFrequency(0),
     fNumSubsessions(0), fNumSyncedSubsessions(0),
-    fHaveCompletedOutputFile(False),
+    fHaveCompletedOutputFile(False), fWriter(NULL),
+    fFragmentDuration(fragmentDuration), fFragmentsBeginWithKeyFrames(False),
+    fHaveWrittenInitialMetadata(False), fFragmentHasSamples(False), fFragmentSequenceNumber(0),
     fMovieWidth(movieWidth), fMovieHeight(movieHeight),
     fMovieFPS(movieFPS), fMaxTrackDurationM(0) {
   fOutFid = OpenOutputFile(env, outputFileName);
   if (fOutFid == NULL) return;
+  fWriter = new BufferedFileWriter(env, fOutFid);
 
   fNewestSyncTime.tv_sec = fNewestSyncTime.tv_usec = 0;
   fFirstDataTime.tv_sec = fFirstDataTime.tv_usec = (unsigned)(~0);
@@ -271,8 +301,11 @@ QuickTimeFileSink::QuickTimeFileSink(UsageEnvironment& env,
       continue;
     }
     subsession->miscPtr = (void*)ioState;
+    if (ioState->fQTMediaDataAtomCreator == &QuickTimeFileSink::addAtom_avc1) {
+      fFragmentsBeginWithKeyFrames = True; // if we're writing a fragmented file
+    }
 
-    if (generateHintTracks) {
+    if (generateHintTracks && fragmentDuration == 0) {
       // Also create a hint track for this track:
       SubsessionIOState* hintTrack
 	= new SubsessionIOState(*this, *subsession);
@@ -302,10 +335,13 @@ QuickTimeFileSink::QuickTimeFileSink(UsageEnvironment& env,
   gettimeofday(&fStartTime, NULL);
   fAppleCreationTime = fStartTime.tv_sec - 0x83dac000;
 
+  // A fragmented file gets its metadata at the start (written along with the first fragment), and no initial "mdat" atom:
+  if (fFragmentDuration > 0) return;
+
   // Begin by writing a "mdat" atom at the start of the file.
   // (Later, when we've finished copying data to the file, we'll come
   // back and fill in its size.)
-  fMDATposition = TellFile64(fOutFid);
+  fMDATposition = fWriter->position();
   addAtomHeader64("mdat");
   // add 64Bit offset
   fMDATposition += 8;
@@ -329,6 +365,7 @@ QuickTimeFileSink::~QuickTimeFileSink() {
   }
 
   // Finally, close our output file:
+  delete fWriter; // writes any remaining data
   CloseOutputFile(fOutFid);
 }
 
@@ -343,10 +380,11 @@ QuickTimeFileSink::createNew(UsageEnvironment& env,
 			     Boolean packetLossCompensate,
 			     Boolean syncStreams,
 			     Boolean generateHintTracks,
-			     Boolean generateMP4Format) {
+			     Boolean generateMP4Format,
+			     unsigned fragmentDuration) {
   QuickTimeFileSink* newSink = 
     new QuickTimeFileSink(env, inputSession, outputFileName, bufferSize, movieWidth, movieHeight, movieFPS,
-			  packetLossCompensate, syncStreams, generateHintTracks, generateMP4Format);
+			  packetLossCompensate, syncStreams, generateHintTracks, generateMP4Format, fragmentDuration);
   if (newSink == NULL || newSink->fOutFid == NULL) {
     Medium::close(newSink);
     return NULL;
@@ -475,9 +513,25 @@ static Boolean timevalGE(struct timeval const& tv1,
 void QuickTimeFileSink::completeOutputFile() {
   if (fHaveCompletedOutputFile || fOutFid == NULL) return;
 
+  if (fFragmentDuration > 0) {
+    // Complete any video samples that are still pending, and write our last fragment.  (Our metadata is already written.)
+    MediaSubsessionIterator iter(fInputSession);
+    MediaSubsession* subsession;
+    while ((subsession = iter.next()) != NULL) {
+      SubsessionIOState* ioState = (SubsessionIOState*)(subsession->miscPtr);
+      if (ioState == NULL || !ioState->fHavePendingSample) continue;
+
+      ioState->completePendingSample(ioState->fQTTimeUnitsPerSample);
+    }
+    writeFragment();
+
+    fHaveCompletedOutputFile = True;
+    return;
+  }
+
   // Begin by filling in the initial "mdat" atom with the current
   // file size:
-  int64_t curFileSize = TellFile64(fOutFid);
+  int64_t curFileSize = fWriter->position();
   setWord64(fMDATposition, (u_int64_t)curFileSize);
 
   // Then, note the time of the first received data:
@@ -521,6 +575,79 @@ void QuickTimeFileSink::completeOutputFile() {
   fHaveCompletedOutputFile = True;
 }
 
+void QuickTimeFileSink::noteNewSample(struct timeval const& presentationTime, Boolean canBeginFragment) {
+  if (fFragmentHasSamples) {
+    double const fragmentDurationSoFar = (presentationTime.tv_sec - fFragmentStartTime.tv_sec)
+      + (presentationTime.tv_usec - fFragmentStartTime.tv_usec)/1000000.0;
+    if (fragmentDurationSoFar >= 0.0) {
+      // End the current fragment if it's long enough (allowing for rounding in presentation times) - or (e.g., if we're not
+      // seeing key frames) if it's getting too long:
+      if ((canBeginFragment && fragmentDurationSoFar + 0.01 >= fFragmentDuration)
+	  || fragmentDurationSoFar >= 3.0*fFragmentDuration) {
+	writeFragment();
+      } else {
+	return;
+      }
+    }
+    // else the presentation times have jumped backwards (e.g., because of RTCP synchronization), so restart our timing
+  }
+
+  fFragmentHasSamples = True;
+  fFragmentStartTime = presentationTime;
+}
+
+void QuickTimeFileSink::writeFragment() {
+  MediaSubsessionIterator iter(fInputSession);
+  MediaSubsession* subsession;
+
+  if (!fHaveWrittenInitialMetadata) {
+    // Begin with the file's metadata: a "ftyp" atom, then a "moov" atom (describing each track, but with no samples):
+    while ((subsession = iter.next()) != NULL) {
+      SubsessionIOState* ioState = (SubsessionIOState*)(subsession->miscPtr);
+      if (ioState != NULL) ioState->setFinalQTstate();
+    }
+    addAtom_ftyp();
+    addAtom_moov();
+    fHaveWrittenInitialMetadata = True;
+  }
+
+  // Lay out each track's data within the fragment's "mdat" atom:
+  unsigned mdatDataSize = 0, numSamples = 0;
+  iter.reset();
+  while ((subsession = iter.next()) != NULL) {
+    SubsessionIOState* ioState = (SubsessionIOState*)(subsession->miscPtr);
+    if (ioState == NULL) continue;
+
+    ioState->fMDATdataOffset = mdatDataSize;
+    mdatDataSize += ioState->fFragmentSampleDataSize;
+    numSamples += ioState->fNumFragmentSamples;
+  }
+  fFragmentHasSamples = False;
+  if (numSamples == 0) return;
+
+  // Write a "moof" atom, then go back and fill in each track's data offset (relative to the start of the "moof"):
+  unsigned const moofSize = addAtom_moof();
+  iter.reset();
+  while ((subsession = iter.next()) != NULL) {
+    SubsessionIOState* ioState = (SubsessionIOState*)(subsession->miscPtr);
+    if (ioState == NULL || ioState->fNumFragmentSamples == 0) continue;
+
+    setWord(ioState->fTRUN_dataOffsetPosn, moofSize + 8 + ioState->fMDATdataOffset);
+  }
+
+  // Then write the "mdat" atom, containing each track's data:
+  addWord(8 + mdatDataSize);
+  add4ByteString("mdat");
+  iter.reset();
+  while ((subsession = iter.next()) != NULL) {
+    SubsessionIOState* ioState = (SubsessionIOState*)(subsession->miscPtr);
+    if (ioState == NULL) continue;
+
+    fWriter->write(ioState->fFragmentData, ioState->fFragmentSampleDataSize);
+    ioState->resetFragment();
+  }
+}
+
 
 ////////// SubsessionIOState, ChunkDescriptor implementation ///////////
 
@@ -532,7 +659,10 @@ SubsessionIOState::SubsessionIOState(QuickTimeFileSink& sink,
     fOurSink(sink), fOurSubsession(subsession),
     fLastPacketRTPSeqNum(0), fHaveBeenSynced(False), fQTTotNumSamples(0), 
     fHeadChunk(NULL), fTailChunk(NULL), fNumChunks(0),
-    fHeadSyncFrame(NULL), fTailSyncFrame(NULL) {
+    fHeadSyncFrame(NULL), fTailSyncFrame(NULL),
+    fFragmentRuns(NULL), fNumFragmentRuns(0), fMaxNumFragmentRuns(0), fNumFragmentSamples(0),
+    fFragmentData(NULL), fFragmentDataSize(0), fMaxFragmentDataSize(0), fFragmentSampleDataSize(0),
+    fFragmentDecodeTime(0), fHavePendingSample(False) {
   fTrackID = ++fCurrentTrackNumber;
 
   fBuffer = new SubsessionBuffer(fOurSink.fBufferSize);
@@ -549,6 +679,7 @@ SubsessionIOState::SubsessionIOState(QuickTimeFileSink& sink,
 
 SubsessionIOState::~SubsessionIOState() {
   delete fBuffer; delete fPrevBuffer;
+  delete[] fFragmentRuns; delete[] fFragmentData;
 
   // Delete the list of chunk descriptors:
   ChunkDescriptor* chunk = fHeadChunk;
@@ -785,10 +916,15 @@ void SubsessionIOState::afterGettingFrame(unsigned packetDataSize,
 }
 
 void SubsessionIOState::useFrame(SubsessionBuffer& buffer) {
+  if (fOurSink.fFragmentDuration > 0) {
+    useFrameInFragment(buffer);
+    return;
+  }
+
   unsigned char* const frameSource = buffer.dataStart();
   unsigned const frameSize = buffer.bytesInUse();
   struct timeval const& presentationTime = buffer.presentationTime();
-  int64_t const destFileOffset = TellFile64(fOurSink.fOutFid);
+  int64_t const destFileOffset = fOurSink.fWriter->position();
   unsigned sampleNumberOfFrameStart = fQTTotNumSamples + 1;
   Boolean avcHack = fQTMediaDataAtomCreator == &QuickTimeFileSink::addAtom_avc1;
 
@@ -841,7 +977,7 @@ void SubsessionIOState::useFrame(SubsessionBuffer& buffer) {
   if (avcHack) fOurSink.addWord(frameSize);
 
   // Write the data into the file:
-  fwrite(frameSource, 1, frameSize, fOurSink.fOutFid);
+  fOurSink.fWriter->write(frameSource, frameSize);
 
   // If we have a hint track, then write to it also:
   if (hasHintTrack()) {
@@ -902,7 +1038,7 @@ void SubsessionIOState::useFrameForHinting(unsigned frameSize,
       }
     }
 
-    int64_t const hintSampleDestFileOffset = TellFile64(fOurSink.fOutFid);
+    int64_t const hintSampleDestFileOffset = fOurSink.fWriter->position();
 
     unsigned const maxPacketSize = 1450;
     unsigned short numPTEntries
@@ -1087,6 +1223,119 @@ unsigned SubsessionIOState::useFrame1(unsigned sourceDataSize,
   return numSamples;
 }
 
+void SubsessionIOState::useFrameInFragment(SubsessionBuffer& buffer) {
+  unsigned char* const frameSource = buffer.dataStart();
+  unsigned const frameSize = buffer.bytesInUse();
+  struct timeval const& presentationTime = buffer.presentationTime();
+  Boolean const avcHack = fQTMediaDataAtomCreator == &QuickTimeFileSink::addAtom_avc1;
+
+  if (fQTcomponentSubtype == fourChar('v','i','d','e')) {
+    // A video sample is made up of all of the frames (e.g., H.264 NAL units) that have the same presentation time.
+    // We use the difference between successive samples' presentation times as the sample duration:
+    if (!fHavePendingSample
+	|| presentationTime.tv_sec != fPendingSamplePresentationTime.tv_sec
+	|| presentationTime.tv_usec != fPendingSamplePresentationTime.tv_usec) {
+      if (fHavePendingSample) {
+	struct timeval const& ppt = fPendingSamplePresentationTime; // abbrev
+	double duration = (presentationTime.tv_sec - ppt.tv_sec)
+	  + (presentationTime.tv_usec - ppt.tv_usec)/1000000.0;
+	unsigned sampleDuration = duration > 0.0 ? (unsigned)((2*duration*fQTTimeScale+1)/2) : 0; // round
+	if (sampleDuration == 0) sampleDuration = fQTTimeUnitsPerSample;
+	completePendingSample(sampleDuration);
+      }
+
+      // This frame begins a new sample - and possibly a new fragment.  For H.264, we begin fragments only at
+      // key frames (which we recognize by a SPS or IDR NAL unit).  (For other video codecs, we can't tell.)
+      u_int8_t const nal_unit_type = frameSize > 0 ? frameSource[0]&0x1F : 0;
+      Boolean const canBeginFragment = avcHack ? (nal_unit_type == 5 || nal_unit_type == 7) : !fOurSink.fFragmentsBeginWithKeyFrames;
+      fOurSink.noteNewSample(presentationTime, canBeginFragment);
+
+      fHavePendingSample = True;
+      fPendingSamplePresentationTime = presentationTime;
+      fPendingSampleSize = 0;
+      fPendingSampleIsSync = !avcHack;
+    }
+
+    if (avcHack) {
+      // H.264/AVC NAL units get a 4-byte size prefix:
+      if (frameSize > 0 && (frameSource[0]&0x1F) == 5) fPendingSampleIsSync = True;
+      unsigned char sizePrefix[4];
+      sizePrefix[0] = frameSize>>24; sizePrefix[1] = frameSize>>16; sizePrefix[2] = frameSize>>8; sizePrefix[3] = frameSize;
+      addFragmentData(sizePrefix, 4);
+      fPendingSampleSize += 4;
+    }
+    addFragmentData(frameSource, frameSize);
+    fPendingSampleSize += frameSize;
+  } else {
+    // Each frame is a complete sample (or - if frames have a fixed size - a set of samples):
+    fOurSink.noteNewSample(presentationTime, !fOurSink.fFragmentsBeginWithKeyFrames);
+
+    unsigned const frameDuration = fQTTimeUnitsPerSample*fQTSamplesPerFrame;
+    unsigned sampleSize = fQTBytesPerFrame;
+    if (sampleSize == 0) sampleSize = frameSize; // the entire packet data is assumed to be a frame
+
+    addFragmentData(frameSource, frameSize);
+    if (sampleSize > 0) addFragmentSamples(frameSize/sampleSize, sampleSize, frameDuration, True);
+    fFragmentSampleDataSize = fFragmentDataSize;
+  }
+}
+
+void SubsessionIOState::completePendingSample(unsigned duration) {
+  addFragmentSamples(1, fPendingSampleSize, duration, fPendingSampleIsSync);
+  fFragmentSampleDataSize += fPendingSampleSize;
+  fHavePendingSample = False;
+}
+
+void SubsessionIOState::addFragmentSamples(unsigned numSamples, unsigned sampleSize, unsigned sampleDuration,
+					   Boolean isSync) {
+  if (numSamples == 0) return;
+  fNumFragmentSamples += numSamples;
+
+  // Extend the most recent run of samples, if we can:
+  if (fNumFragmentRuns > 0) {
+    FragmentRun& run = fFragmentRuns[fNumFragmentRuns-1];
+    if (run.sampleSize == sampleSize && run.sampleDuration == sampleDuration && run.isSync == isSync) {
+      run.numSamples += numSamples;
+      return;
+    }
+  }
+
+  if (fNumFragmentRuns == fMaxNumFragmentRuns) {
+    fMaxNumFragmentRuns = fMaxNumFragmentRuns == 0 ? 100 : 2*fMaxNumFragmentRuns;
+    FragmentRun* newRuns = new FragmentRun[fMaxNumFragmentRuns];
+    for (unsigned i = 0; i < fNumFragmentRuns; ++i) newRuns[i] = fFragmentRuns[i];
+    delete[] fFragmentRuns; fFragmentRuns = newRuns;
+  }
+  FragmentRun& run = fFragmentRuns[fNumFragmentRuns++];
+  run.numSamples = numSamples;
+  run.sampleSize = sampleSize;
+  run.sampleDuration = sampleDuration;
+  run.isSync = isSync;
+}
+
+void SubsessionIOState::addFragmentData(unsigned char const* data, unsigned dataSize) {
+  if (fFragmentDataSize + dataSize > fMaxFragmentDataSize) {
+    fMaxFragmentDataSize = 2*(fFragmentDataSize + dataSize);
+    unsigned char* newData = new unsigned char[fMaxFragmentDataSize];
+    memmove(newData, fFragmentData, fFragmentDataSize);
+    delete[] fFragmentData; fFragmentData = newData;
+  }
+  memmove(&fFragmentData[fFragmentDataSize], data, dataSize);
+  fFragmentDataSize += dataSize;
+}
+
+void SubsessionIOState::resetFragment() {
+  for (unsigned i = 0; i < fNumFragmentRuns; ++i) {
+    fFragmentDecodeTime += fFragmentRuns[i].numSamples*fFragmentRuns[i].sampleDuration;
+  }
+  fNumFragmentRuns = fNumFragmentSamples = 0;
+
+  // Keep any data that belongs to a pending sample (for the next fragment):
+  fFragmentDataSize -= fFragmentSampleDataSize;
+  memmove(fFragmentData, &fFragmentData[fFragmentSampleDataSize], fFragmentDataSize);
+  fFragmentSampleDataSize = 0;
+}
+
 void SubsessionIOState::onSourceClosure() {
   fOurSourceIsActive = False;
   fOurSink.onSourceClosure1();
@@ -1267,38 +1516,22 @@ unsigned QuickTimeFileSink::addAtomHeader64(char const* atomName) {
 }
 
 void QuickTimeFileSink::setWord(int64_t filePosn, unsigned size) {
-  do {
-    if (SeekFile64(fOutFid, filePosn, SEEK_SET) < 0) break;
-    addWord(size);
-    if (SeekFile64(fOutFid, 0, SEEK_END) < 0) break; // go back to where we were
-
-    return;
-  } while (0);
-
-  // One of the SeekFile64()s failed, probable because we're not a seekable file
-  envir() << "QuickTimeFileSink::setWord(): SeekFile64 failed (err "
-	  << envir().getErrno() << ")\n";
+  unsigned char word[4];
+  word[0] = size>>24; word[1] = size>>16; word[2] = size>>8; word[3] = size;
+  fWriter->patch(filePosn, word, 4);
 }
 
 void QuickTimeFileSink::setWord64(int64_t filePosn, u_int64_t size) {
-  do {
-    if (SeekFile64(fOutFid, filePosn, SEEK_SET) < 0) break;
-    addWord64(size);
-    if (SeekFile64(fOutFid, 0, SEEK_END) < 0) break; // go back to where we were
-
-    return;
-  } while (0);
-
-  // One of the SeekFile64()s failed, probable because we're not a seekable file
-  envir() << "QuickTimeFileSink::setWord64(): SeekFile64 failed (err "
-	  << envir().getErrno() << ")\n";
+  unsigned char word[8];
+  for (unsigned i = 0; i < 8; ++i) word[i] = (unsigned char)(size>>(56-8*i));
+  fWriter->patch(filePosn, word, 8);
 }
 
 // Methods for writing particular atoms.  Note the following macros:
 
 #define addAtom(name) \
     unsigned QuickTimeFileSink::addAtom_##name() { \
-    int64_t initFilePosn = TellFile64(fOutFid); \
+    int64_t initFilePosn = fWriter->position(); \
     unsigned size = addAtomHeader("" #name "")
 
 #define addAtomEnd \
@@ -1311,6 +1544,9 @@ addAtom(ftyp);
   size += addWord(0x00000000);
   size += add4ByteString("mp42");
   size += add4ByteString("isom");
+  if (fFragmentDuration > 0) {
+    size += add4ByteString("iso5"); // for "default-base-is-moof" in "tfhd"
+  }
 addAtomEnd;
 
 addAtom(moov);
@@ -1353,6 +1589,10 @@ addAtom(moov);
       size += addAtom_trak();
     }
   }
+
+  if (fFragmentDuration > 0) {
+    size += addAtom_mvex();
+  }
 addAtomEnd;
 
 addAtom(mvhd);
@@ -1365,7 +1605,7 @@ addAtom(mvhd);
   size += addWord(movieTimeScale()); // Time scale
 
   unsigned const duration = fMaxTrackDurationM;
-  fMVHD_durationPosn = TellFile64(fOutFid);
+  fMVHD_durationPosn = fWriter->position();
   size += addWord(duration); // Duration
 
   size += addWord(0x00010000); // Preferred rate
@@ -1419,7 +1659,7 @@ addAtom(tkhd);
   size += addWord(0x00000000); // Reserved
 
   unsigned const duration = fCurrentIOState->fQTDurationM; // movie units
-  fCurrentIOState->fTKHD_durationPosn = TellFile64(fOutFid);
+  fCurrentIOState->fTKHD_durationPosn = fWriter->position();
   size += addWord(duration); // Duration
   size += addZeroWords(3); // Reserved+Layer+Alternate grp
   size += addWord(0x01000000); // Volume + Reserved
@@ -1458,7 +1698,7 @@ addAtom(elst);
 
   // Add a dummy "Number of entries" field
   // (and remember its position).  We'll fill this field in later:
-  int64_t numEntriesPosition = TellFile64(fOutFid);
+  int64_t numEntriesPosition = fWriter->position();
   size += addWord(0); // dummy for "Number of entries"
   unsigned numEdits = 0;
   unsigned totalDurationOfEdits = 0; // in movie time units
@@ -1617,7 +1857,7 @@ addAtom(gmin);
 addAtomEnd;
 
 unsigned QuickTimeFileSink::addAtom_hdlr2() {
-  int64_t initFilePosn = TellFile64(fOutFid);
+  int64_t initFilePosn = fWriter->position();
   unsigned size = addAtomHeader("hdlr");
   size += addWord(0x00000000); // Version + Flags
   size += add4ByteString("dhlr"); // Component type
@@ -1644,8 +1884,9 @@ addAtomEnd;
 addAtom(stbl);
   size += addAtom_stsd();
   size += addAtom_stts();
-  if (fCurrentIOState->fQTcomponentSubtype == fourChar('v','i','d','e')) {
-    size += addAtom_stss(); // only for video streams
+  if (fCurrentIOState->fQTcomponentSubtype == fourChar('v','i','d','e')
+      && fFragmentDuration == 0) {
+    size += addAtom_stss(); // only for video streams (and not fragmented files, where the samples are in "trun" atoms)
   }
   size += addAtom_stsc();
   size += addAtom_stsz();
@@ -1661,7 +1902,7 @@ addAtom(stsd);
 addAtomEnd;
 
 unsigned QuickTimeFileSink::addAtom_genericMedia() {
-  int64_t initFilePosn = TellFile64(fOutFid);
+  int64_t initFilePosn = fWriter->position();
 
   // Our source is assumed to be a "QuickTimeGenericRTPSource"
   // Use its "sdAtom" state for our contents:
@@ -1674,7 +1915,7 @@ unsigned QuickTimeFileSink::addAtom_genericMedia() {
 addAtomEnd;
 
 unsigned QuickTimeFileSink::addAtom_soundMediaGeneral() {
-  int64_t initFilePosn = TellFile64(fOutFid);
+  int64_t initFilePosn = fWriter->position();
   unsigned size = addAtomHeader(fCurrentIOState->fQTAudioDataType);
 
 // General sample description fields:
@@ -1698,7 +1939,7 @@ addAtomEnd;
 unsigned QuickTimeFileSink::addAtom_Qclp() {
   // The beginning of this atom looks just like a general Sound Media atom,
   // except with a version field of 1:
-  int64_t initFilePosn = TellFile64(fOutFid);
+  int64_t initFilePosn = fWriter->position();
   fCurrentIOState->fQTAudioDataType = "Qclp";
   fCurrentIOState->fQTSoundSampleVersion = 1;
   unsigned size = addAtom_soundMediaGeneral();
@@ -1754,7 +1995,7 @@ unsigned QuickTimeFileSink::addAtom_mp4a() {
   unsigned size = 0;
   // The beginning of this atom looks just like a general Sound Media atom,
   // except with a version field of 1:
-  int64_t initFilePosn = TellFile64(fOutFid);
+  int64_t initFilePosn = fWriter->position();
   fCurrentIOState->fQTAudioDataType = "mp4a";
 
   if (fGenerateMP4Format) {
@@ -1942,7 +2183,7 @@ addAtom(mp4v);
 addAtomEnd;
 
 unsigned QuickTimeFileSink::addAtom_rtp() {
-  int64_t initFilePosn = TellFile64(fOutFid);
+  int64_t initFilePosn = fWriter->position();
   unsigned size = addAtomHeader("rtp ");
 
   size += addWord(0x00000000); // Reserved (1st 4 bytes)
@@ -1962,7 +2203,7 @@ addAtom(stts); // Time-to-Sample
 
   // First, add a dummy "Number of entries" field
   // (and remember its position).  We'll fill this field in later:
-  int64_t numEntriesPosition = TellFile64(fOutFid);
+  int64_t numEntriesPosition = fWriter->position();
   size += addWord(0); // dummy for "Number of entries"
 
   // Then, run through the chunk descriptors, and enter the entries
@@ -1990,10 +2231,12 @@ addAtom(stts); // Time-to-Sample
     chunk = chunk->fNextChunk;
   }
 
-  // Then, write out the last entry:
-  ++numEntries;
-  size += addWord(numSamplesSoFar); // Sample count
-  size += addWord(prevSampleDuration); // Sample duration
+  // Then, write out the last entry (if any):
+  if (fCurrentIOState->fHeadChunk != NULL) {
+    ++numEntries;
+    size += addWord(numSamplesSoFar); // Sample count
+    size += addWord(prevSampleDuration); // Sample duration
+  }
 
   // Now go back and fill in the "Number of entries" field:
   setWord(numEntriesPosition, numEntries);
@@ -2004,7 +2247,7 @@ addAtom(stss); // Sync-Sample
 
   // First, add a dummy "Number of entries" field
   // (and remember its position).  We'll fill this field in later:
-  int64_t numEntriesPosition = TellFile64(fOutFid);
+  int64_t numEntriesPosition = fWriter->position();
   size += addWord(0); // dummy for "Number of entries"
 
   unsigned numEntries = 0, numSamplesSoFar = 0;
@@ -2050,7 +2293,7 @@ addAtom(stsc); // Sample-to-Chunk
 
   // First, add a dummy "Number of entries" field
   // (and remember its position).  We'll fill this field in later:
-  int64_t numEntriesPosition = TellFile64(fOutFid);
+  int64_t numEntriesPosition = fWriter->position();
   size += addWord(0); // dummy for "Number of entries"
 
   // Then, run through the chunk descriptors, and enter the entries
@@ -2154,6 +2397,111 @@ addAtom(co64); // Chunk Offset
   }
 addAtomEnd;
 
+addAtom(mvex);
+  MediaSubsessionIterator iter(fInputSession);
+  MediaSubsession* subsession;
+  while ((subsession = iter.next()) != NULL) {
+    fCurrentIOState = (SubsessionIOState*)(subsession->miscPtr);
+    if (fCurrentIOState == NULL) continue;
+
+    size += addAtom_trex();
+  }
+addAtomEnd;
+
+addAtom(trex);
+  size += addWord(0x00000000); // Version+flags
+  size += addWord(fCurrentIOState->fTrackID); // Track ID
+  size += addWord(0x00000001); // Default sample description index
+  size += addZeroWords(3); // Default sample duration+size+flags (we give these in each fragment instead)
+addAtomEnd;
+
+addAtom(moof);
+  size += addAtom_mfhd();
+
+  // Add a 'traf' atom for each track that has samples in this fragment:
+  MediaSubsessionIterator iter(fInputSession);
+  MediaSubsession* subsession;
+  while ((subsession = iter.next()) != NULL) {
+    fCurrentIOState = (SubsessionIOState*)(subsession->miscPtr);
+    if (fCurrentIOState == NULL || fCurrentIOState->fNumFragmentSamples == 0) continue;
+
+    size += addAtom_traf();
+  }
+addAtomEnd;
+
+addAtom(mfhd);
+  size += addWord(0x00000000); // Version+flags
+  size += addWord(++fFragmentSequenceNumber); // Sequence number
+addAtomEnd;
+
+addAtom(traf);
+  // Check whether all of this track's samples (in this fragment) have the same duration, and/or the same size.
+  // If so, we give this just once, in the 'tfhd' atom, rather than for each sample in the 'trun' atom:
+  SubsessionIOState* ioState = fCurrentIOState; // abbrev
+  ioState->fFragmentSampleDuration = ioState->fFragmentRuns[0].sampleDuration;
+  ioState->fFragmentSampleSize = ioState->fFragmentRuns[0].sampleSize;
+  for (unsigned i = 1; i < ioState->fNumFragmentRuns; ++i) {
+    if (ioState->fFragmentRuns[i].sampleDuration != ioState->fFragmentSampleDuration) ioState->fFragmentSampleDuration = 0;
+    if (ioState->fFragmentRuns[i].sampleSize != ioState->fFragmentSampleSize) ioState->fFragmentSampleSize = 0;
+  }
+
+  size += addAtom_tfhd();
+  size += addAtom_tfdt();
+  size += addAtom_trun();
+addAtomEnd;
+
+addAtom(tfhd);
+  Boolean const isVideo = fCurrentIOState->fQTcomponentSubtype == fourChar('v','i','d','e');
+  unsigned flags = 0x020000; // 'default-base-is-moof'
+  if (fCurrentIOState->fFragmentSampleDuration != 0) flags |= 0x000008; // 'default-sample-duration-present'
+  if (fCurrentIOState->fFragmentSampleSize != 0) flags |= 0x000010; // 'default-sample-size-present'
+  if (!isVideo) flags |= 0x000020; // 'default-sample-flags-present'
+  size += addWord(flags); // Version+flags
+  size += addWord(fCurrentIOState->fTrackID); // Track ID
+  if (fCurrentIOState->fFragmentSampleDuration != 0) {
+    size += addWord(fCurrentIOState->fFragmentSampleDuration); // Default sample duration
+  }
+  if (fCurrentIOState->fFragmentSampleSize != 0) {
+    size += addWord(fCurrentIOState->fFragmentSampleSize); // Default sample size
+  }
+  if (!isVideo) {
+    size += addWord(0x02000000); // Default sample flags: 'sample_depends_on' == 2 (i.e., each sample is a 'sync sample')
+  }
+addAtomEnd;
+
+addAtom(tfdt);
+  size += addWord(0x01000000); // Version (1) + flags
+  size += addWord64(fCurrentIOState->fFragmentDecodeTime); // Base media decode time
+addAtomEnd;
+
+addAtom(trun);
+  SubsessionIOState* ioState = fCurrentIOState; // abbrev
+  Boolean const isVideo = ioState->fQTcomponentSubtype == fourChar('v','i','d','e');
+  unsigned flags = 0x000001; // 'data-offset-present'
+  if (ioState->fFragmentSampleDuration == 0) flags |= 0x000100; // 'sample-duration-present'
+  if (ioState->fFragmentSampleSize == 0) flags |= 0x000200; // 'sample-size-present'
+  if (isVideo) flags |= 0x000400; // 'sample-flags-present'
+  size += addWord(flags); // Version+flags
+  size += addWord(ioState->fNumFragmentSamples); // Sample count
+
+  // Add a dummy "Data offset" field (and remember its position).  We'll fill this field in later:
+  ioState->fTRUN_dataOffsetPosn = fWriter->position();
+  size += addWord(0); // dummy for "Data offset"
+
+  for (unsigned i = 0; i < ioState->fNumFragmentRuns; ++i) {
+    SubsessionIOState::FragmentRun const& run = ioState->fFragmentRuns[i];
+    for (unsigned j = 0; j < run.numSamples; ++j) {
+      if (flags&0x000100) size += addWord(run.sampleDuration); // Sample duration
+      if (flags&0x000200) size += addWord(run.sampleSize); // Sample size
+      if (isVideo) {
+	// Sample flags: Either a 'sync sample' ('sample_depends_on' == 2), or not ('sample_depends_on' == 1,
+	// 'sample_is_non_sync_sample' == 1):
+	size += addWord(run.isSync ? 0x02000000 : 0x01010000);
+      }
+    }
+  }
+addAtomEnd;
+
 addAtom(udta);
   size += addAtom_name();
   size += addAtom_hnti();
@@ -2172,7 +2520,7 @@ addAtom(hnti);
 addAtomEnd;
 
 unsigned QuickTimeFileSink::addAtom_sdp() {
-  int64_t initFilePosn = TellFile64(fOutFid);
+  int64_t initFilePosn = fWriter->position();
   unsigned size = addAtomHeader("sdp ");
 
   // Add this subsession's SDP lines:
@@ -2312,6 +2660,6 @@ addAtomEnd;
 
 // A dummy atom (with name "????"):
 unsigned QuickTimeFileSink::addAtom_dummy() {
-    int64_t initFilePosn = TellFile64(fOutFid);
+    int64_t initFilePosn = fWriter->position();
     unsigned size = addAtomHeader("????");
 addAtomEnd;
@@ -24,6 +24,7 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #include "ProxyServerMediaSession.hh"
 #include "Base64.hh"
 #include <GroupsockHelper.hh>
+#include <time.h>
 
 ////////// RTSPServer implementation //////////
 
@@ -68,6 +69,16 @@ ServerMediaSession* RTSPServer::lookupServerMediaSession(char const* streamName)
   return (ServerMediaSession*)(fServerMediaSessions->Lookup(streamName));
 }
 
+void RTSPServer::lookupServerMediaSession(char const* streamName,
+					  lookupServerMediaSessionCompletionFunc* completionFunc, void* completionClientData) {
+  // Default implementation: Do a synchronous lookup, and return the result immediately:
+  (*completionFunc)(completionClientData, lookupServerMediaSession(streamName));
+}
+
+void RTSPServer::cancelLookupServerMediaSession(void* /*completionClientData*/) {
+  // Default implementation: do nothing (because "completionFunc" is always called immediately)
+}
+
 void RTSPServer::removeServerMediaSession(ServerMediaSession* serverMediaSession) {
   if (serverMediaSession == NULL) return;
   
@@ -86,15 +97,13 @@ void RTSPServer::removeServerMediaSession(char const* streamName) {
 void RTSPServer::closeAllClientSessionsForServerMediaSession(ServerMediaSession* serverMediaSession) {
   if (serverMediaSession == NULL) return;
   
-  HashTable::Iterator* iter = HashTable::Iterator::create(*fClientSessions);
+  // Delete each client session that uses "serverMediaSession".  (Each deletion removes the client session from this list.)
   RTSPServer::RTSPClientSession* clientSession;
-  char const* key; // dummy
-  while ((clientSession = (RTSPServer::RTSPClientSession*)(iter->next(key))) != NULL) {
-    if (clientSession->fOurServerMediaSession == serverMediaSession) {
-      delete clientSession;
-    }
+  while ((clientSession
+	  = (RTSPServer::RTSPClientSession*)(fClientSessionsForServerMediaSession->Lookup((char const*)serverMediaSession)))
+	 != NULL) {
+    delete clientSession;
   }
-  delete iter;
 }
 
 void RTSPServer::closeAllClientSessionsForServerMediaSession(char const* streamName) {
@@ -323,6 +332,13 @@ Boolean RTSPServer::specialClientUserAccessCheck(int /*clientSocket*/, struct so
   return True;
 }
 
+Boolean RTSPServer::handOffHTTPTunnelingPOST(int /*clientSocket*/, struct sockaddr_in const& /*clientAddr*/,
+					     unsigned char const* /*requestBytes*/, unsigned /*numRequestBytes*/,
+					     unsigned /*numHandOffs*/) {
+  // default implementation: There's no other server that we can hand off the connection to:
+  return False;
+}
+
 
 RTSPServer::RTSPServer(UsageEnvironment& env,
 		       int ourSocket, Port ourPort,
@@ -334,8 +350,10 @@ RTSPServer::RTSPServer(UsageEnvironment& env,
     fClientConnections(HashTable::create(ONE_WORD_HASH_KEYS)),
     fClientConnectionsForHTTPTunneling(NULL), // will get created if needed
     fClientSessions(HashTable::create(STRING_HASH_KEYS)),
+    fClientSessionsForServerMediaSession(HashTable::create(ONE_WORD_HASH_KEYS)),
     fPendingRegisterRequests(HashTable::create(ONE_WORD_HASH_KEYS)), fRegisterRequestCounter(0),
-    fAuthDB(authDatabase), fReclamationTestSeconds(reclamationTestSeconds) {
+    fAuthDB(authDatabase), fReclamationTestSeconds(reclamationTestSeconds),
+    fLivenessListHead(NULL), fLivenessListTail(NULL), fLivenessSweepTask(NULL), fNumReclaimedClientSessions(0) {
   ignoreSigPipeOnSocket(ourSocket); // so that clients on the same host that are killed don't also kill us
   
   // Arrange to handle connections from others:
@@ -357,6 +375,8 @@ RTSPServer::~RTSPServer() {
     delete clientSession;
   }
   delete fClientSessions;
+  delete fClientSessionsForServerMediaSession; // all content was already removed as a result of the loop above
+  envir().taskScheduler().unscheduleDelayedTask(fLivenessSweepTask);
   
   // Close all client connection objects:
   RTSPServer::RTSPClientConnection* connection;
@@ -423,6 +443,16 @@ void RTSPServer::incomingConnectionHandler(int serverSocket) {
   (void)createNewClientConnection(clientSocket, clientAddr);
 }
 
+void RTSPServer::adoptClientConnection(int clientSocket, struct sockaddr_in const& clientAddr,
+				       unsigned char const* requestBytes, unsigned numRequestBytes, unsigned numHandOffs) {
+  makeSocketNonBlocking(clientSocket);
+
+  // Create a new object for handling this connection, then have it handle the bytes that have already been read:
+  // (Note that it might get deleted as a result.)
+  RTSPClientConnection* clientConnection = createNewClientConnection(clientSocket, clientAddr);
+  clientConnection->handleHandedOffRequestBytes(requestBytes, numRequestBytes, numHandOffs);
+}
+
 
 ////////// RTSPServer::RTSPClientConnection implementation //////////
 
@@ -430,7 +460,8 @@ RTSPServer::RTSPClientConnection
 ::RTSPClientConnection(RTSPServer& ourServer, int clientSocket, struct sockaddr_in clientAddr)
   : fOurServer(ourServer), fIsActive(True),
     fClientInputSocket(clientSocket), fClientOutputSocket(clientSocket), fClientAddr(clientAddr),
-    fRecursionCount(0), fOurSessionCookie(NULL) {
+    fRecursionCount(0), fNumFailedAuthenticationsWithNonce(0), fOurSessionCookie(NULL), fNumHandOffs(0),
+    fDESCRIBEIsPending(False), fDESCRIBEResponseIsDeferred(False), fPendingDESCRIBECSeq(NULL), fPendingDESCRIBESession(NULL) {
   // Add ourself to our 'client connections' table:
   fOurServer.fClientConnections->Add((char const*)this, this);
   
@@ -443,6 +474,14 @@ RTSPServer::RTSPClientConnection
 RTSPServer::RTSPClientConnection::~RTSPClientConnection() {
   // Remove ourself from the server's 'client connections' hash table before we go:
   fOurServer.fClientConnections->Remove((char const*)this);
+
+  if (fDESCRIBEIsPending) {
+    // We're going away before we've responded to a "DESCRIBE", so make sure that we don't get called back:
+    fOurServer.cancelLookupServerMediaSession(this);
+    if (fPendingDESCRIBESession != NULL) fPendingDESCRIBESession->cancelPrepareSDPDescription(this);
+    releasePendingDESCRIBESession();
+  }
+  delete[] fPendingDESCRIBECSeq;
   
   if (fOurSessionCookie != NULL) {
     // We were being used for RTSP-over-HTTP tunneling. Also remove ourselves from the 'session cookie' hash table before we go:
@@ -492,65 +531,142 @@ void RTSPServer::RTSPClientConnection
 
 void RTSPServer::RTSPClientConnection
 ::handleCmd_DESCRIBE(char const* urlPreSuffix, char const* urlSuffix, char const* fullRequestStr) {
-  char* sdpDescription = NULL;
-  char* rtspURL = NULL;
-  do {
-    char urlTotalSuffix[RTSP_PARAM_STRING_MAX];
-    if (strlen(urlPreSuffix) + strlen(urlSuffix) + 2 > sizeof urlTotalSuffix) {
-      handleCmd_bad();
-      break;
-    }
-    urlTotalSuffix[0] = '\0';
-    if (urlPreSuffix[0] != '\0') {
-      strcat(urlTotalSuffix, urlPreSuffix);
-      strcat(urlTotalSuffix, "/");
-    }
-    strcat(urlTotalSuffix, urlSuffix);
-    
-    if (!authenticationOK("DESCRIBE", urlTotalSuffix, fullRequestStr)) break;
-    
-    // We should really check that the request contains an "Accept:" #####
-    // for "application/sdp", because that's what we're sending back #####
-    
-    // Begin by looking up the "ServerMediaSession" object for the specified "urlTotalSuffix":
-    ServerMediaSession* session = fOurServer.lookupServerMediaSession(urlTotalSuffix);
-    if (session == NULL) {
-      handleCmd_notFound();
-      break;
-    }
-    
-    // Then, assemble a SDP description for this session:
-    sdpDescription = session->generateSDPDescription();
-    if (sdpDescription == NULL) {
-      // This usually means that a file name that was specified for a
-      // "ServerMediaSubsession" does not exist.
-      setRTSPResponse("404 File Not Found, Or In Incorrect Format");
-      break;
-    }
-    unsigned sdpDescriptionSize = strlen(sdpDescription);
-    
-    // Also, generate our RTSP URL, for the "Content-Base:" header
-    // (which is necessary to ensure that the correct URL gets used in subsequent "SETUP" requests).
-    rtspURL = fOurServer.rtspURL(session, fClientInputSocket);
-    
-    snprintf((char*)fResponseBuffer, sizeof fResponseBuffer,
-	     "RTSP/1.0 200 OK\r\nCSeq: %s\r\n"
-	     "%s"
-	     "Content-Base: %s/\r\n"
-	     "Content-Type: application/sdp\r\n"
-	     "Content-Length: %d\r\n\r\n"
-	     "%s",
-	     fCurrentCSeq,
-	     dateHeader(),
-	     rtspURL,
-	     sdpDescriptionSize,
-	     sdpDescription);
-  } while (0);
-  
+  char urlTotalSuffix[RTSP_PARAM_STRING_MAX];
+  if (strlen(urlPreSuffix) + strlen(urlSuffix) + 2 > sizeof urlTotalSuffix) {
+    handleCmd_bad();
+    return;
+  }
+  urlTotalSuffix[0] = '\0';
+  if (urlPreSuffix[0] != '\0') {
+    strcat(urlTotalSuffix, urlPreSuffix);
+    strcat(urlTotalSuffix, "/");
+  }
+  strcat(urlTotalSuffix, urlSuffix);
+
+  if (!authenticationOK("DESCRIBE", urlTotalSuffix, fullRequestStr)) return;
+
+  // We should really check that the request contains an "Accept:" #####
+  // for "application/sdp", because that's what we're sending back #####
+
+  if (fClientInputSocket != fClientOutputSocket) {
+    // We're doing RTSP-over-HTTP tunneling.  Because any further (Base64-encoded) input can't be held until we've
+    // responded, we handle this "DESCRIBE" synchronously:
+    setDESCRIBEResponse(fOurServer.lookupServerMediaSession(urlTotalSuffix));
+    return;
+  }
+
+  // Begin by looking up the "ServerMediaSession" object for the specified "urlTotalSuffix".  This - and then preparing the
+  // session's SDP description - might not complete immediately (e.g., if a file first needs to be read).  If so, we return
+  // to the event loop, and respond to the "DESCRIBE" later:
+  fDESCRIBEIsPending = True;
+  fDESCRIBEResponseIsDeferred = False;
+  delete[] fPendingDESCRIBECSeq; fPendingDESCRIBECSeq = strDup(fCurrentCSeq);
+  fOurServer.lookupServerMediaSession(urlTotalSuffix, continueHandlingDESCRIBE, this);
+
+  if (fDESCRIBEIsPending) {
+    fDESCRIBEResponseIsDeferred = True;
+    fResponseBuffer[0] = '\0'; // we have nothing to send yet
+  }
+}
+
+void RTSPServer::RTSPClientConnection::continueHandlingDESCRIBE(void* clientData, ServerMediaSession* session) {
+  ((RTSPClientConnection*)clientData)->continueHandlingDESCRIBE1(session);
+}
+
+void RTSPServer::RTSPClientConnection::continueHandlingDESCRIBE1(ServerMediaSession* session) {
+  if (session == NULL) {
+    fCurrentCSeq = fPendingDESCRIBECSeq;
+    handleCmd_notFound();
+    afterHandlingDESCRIBE();
+    return;
+  }
+
+  // Hold a reference to the session, so that it doesn't go away while we're waiting for its SDP description:
+  session->incrementReferenceCount();
+  fPendingDESCRIBESession = session;
+  completeHandlingDESCRIBE1();
+}
+
+void RTSPServer::RTSPClientConnection::completeHandlingDESCRIBE(void* clientData) {
+  ((RTSPClientConnection*)clientData)->completeHandlingDESCRIBE1();
+}
+
+void RTSPServer::RTSPClientConnection::completeHandlingDESCRIBE1() {
+  if (!fPendingDESCRIBESession->prepareSDPDescription(completeHandlingDESCRIBE, this)) {
+    return; // (at least one of) the session's subsessions is not yet ready; we'll get called again when it is
+  }
+
+  fCurrentCSeq = fPendingDESCRIBECSeq;
+  setDESCRIBEResponse(fPendingDESCRIBESession);
+  releasePendingDESCRIBESession();
+  afterHandlingDESCRIBE();
+}
+
+void RTSPServer::RTSPClientConnection::setDESCRIBEResponse(ServerMediaSession* session) {
+  if (session == NULL) {
+    handleCmd_notFound();
+    return;
+  }
+
+  // Assemble a SDP description for this session:
+  char* sdpDescription = session->generateSDPDescription();
+  if (sdpDescription == NULL) {
+    // This usually means that a file name that was specified for a
+    // "ServerMediaSubsession" does not exist.
+    setRTSPResponse("404 File Not Found, Or In Incorrect Format");
+    return;
+  }
+  unsigned sdpDescriptionSize = strlen(sdpDescription);
+
+  // Also, generate our RTSP URL, for the "Content-Base:" header
+  // (which is necessary to ensure that the correct URL gets used in subsequent "SETUP" requests).
+  char* rtspURL = fOurServer.rtspURL(session, fClientInputSocket);
+
+  snprintf((char*)fResponseBuffer, sizeof fResponseBuffer,
+	   "RTSP/1.0 200 OK\r\nCSeq: %s\r\n"
+	   "%s"
+	   "Content-Base: %s/\r\n"
+	   "Content-Type: application/sdp\r\n"
+	   "Content-Length: %d\r\n\r\n"
+	   "%s",
+	   fCurrentCSeq,
+	   dateHeader(),
+	   rtspURL,
+	   sdpDescriptionSize,
+	   sdpDescription);
+
   delete[] sdpDescription;
   delete[] rtspURL;
 }
 
+void RTSPServer::RTSPClientConnection::afterHandlingDESCRIBE() {
+  fDESCRIBEIsPending = False;
+  if (!fDESCRIBEResponseIsDeferred) return; // we're still within "handleRequestBytes()", which will send the response
+
+  // Send the response now:
+  fDESCRIBEResponseIsDeferred = False;
+#ifdef DEBUG
+  fprintf(stderr, "sending (deferred) response: %s", fResponseBuffer);
+#endif
+  send(fClientOutputSocket, (char const*)fResponseBuffer, strlen((char*)fResponseBuffer), 0);
+
+  // Then handle any request data that arrived while we were waiting.  (This might delete us.)
+  unsigned numHeldBytes = fRequestBytesAlreadySeen;
+  resetRequestBuffer();
+  if (numHeldBytes > 0) handleRequestBytes(numHeldBytes);
+}
+
+void RTSPServer::RTSPClientConnection::releasePendingDESCRIBESession() {
+  ServerMediaSession* session = fPendingDESCRIBESession;
+  if (session == NULL) return;
+  fPendingDESCRIBESession = NULL;
+
+  session->decrementReferenceCount();
+  if (session->referenceCount() == 0 && session->deleteWhenUnreferenced()) {
+    fOurServer.removeServerMediaSession(session);
+  }
+}
+
 static void lookForHeader(char const* headerName, char const* source, unsigned sourceLen, char* resultStr, unsigned resultMaxSize) {
   resultStr[0] = '\0';  // by default, return an empty string
   unsigned headerNameLen = strlen(headerName);
@@ -735,7 +851,14 @@ Boolean RTSPServer::RTSPClientConnection
   RTSPServer::RTSPClientConnection* prevClientConnection
     = (RTSPServer::RTSPClientConnection*)(fOurServer.fClientConnectionsForHTTPTunneling->Lookup(sessionCookie));
   if (prevClientConnection == NULL) {
-    // There was no previous HTTP "GET" request; treat this "POST" request as bad:
+    // There was no previous HTTP "GET" request - at least, not to us.  If another server (sharing our port number) might
+    // have received it, then hand off this connection (and the request that we've read from it) to that server:
+    if (fOurServer.handOffHTTPTunnelingPOST(fClientInputSocket, fClientAddr,
+					    fRequestBuffer, fRequestBytesAlreadySeen, fNumHandOffs)) {
+      return True; // we go away (closing our copy of the socket) without responding
+    }
+
+    // Otherwise, treat this "POST" request as bad:
     handleHTTPCmd_notSupported();
     fIsActive = False; // triggers deletion of ourself
     return False;
@@ -851,6 +974,16 @@ static void parseTransportHeaderForREGISTER(char const* buf,
   delete[] field;
 }
 
+void RTSPServer::RTSPClientConnection
+::handleHandedOffRequestBytes(unsigned char const* requestBytes, unsigned numRequestBytes, unsigned numHandOffs) {
+  fNumHandOffs = numHandOffs;
+
+  // Handle these bytes as if we had just read them from our socket:
+  if (numRequestBytes >= fRequestBufferBytesLeft) numRequestBytes = fRequestBufferBytesLeft - 1; // shouldn't happen
+  memmove(&fRequestBuffer[fRequestBytesAlreadySeen], requestBytes, numRequestBytes);
+  handleRequestBytes(numRequestBytes);
+}
+
 void RTSPServer::RTSPClientConnection::handleRequestBytes(int newBytesRead) {
   int numBytesRemaining = 0;
   ++fRecursionCount;
@@ -868,6 +1001,13 @@ void RTSPServer::RTSPClientConnection::handleRequestBytes(int newBytesRead) {
       break;
     }
     
+    if (fDESCRIBEIsPending) {
+      // We haven't yet responded to a previous "DESCRIBE".  Until we do, just hold on to this new data (in our buffer):
+      fRequestBufferBytesLeft -= newBytesRead;
+      fRequestBytesAlreadySeen += newBytesRead;
+      break;
+    }
+    
     Boolean endOfMsg = False;
     unsigned char* ptr = &fRequestBuffer[fRequestBytesAlreadySeen];
 #ifdef DEBUG
@@ -878,43 +1018,25 @@ void RTSPServer::RTSPClientConnection::handleRequestBytes(int newBytesRead) {
     
     if (fClientOutputSocket != fClientInputSocket && numBytesRemaining == 0) {
       // We're doing RTSP-over-HTTP tunneling, and input commands are assumed to have been Base64-encoded.
-      // We therefore Base64-decode as much of this new data as we can (i.e., up to a multiple of 4 bytes).
-      
-      // But first, we remove any whitespace that may be in the input data:
-      unsigned toIndex = 0;
-      for (int fromIndex = 0; fromIndex < newBytesRead; ++fromIndex) {
-	char c = ptr[fromIndex];
-	if (!(c == ' ' || c == '\t' || c == '\r' || c == '\n')) { // not 'whitespace': space,tab,CR,NL
-	  ptr[toIndex++] = c;
-	}
-      }
-      newBytesRead = toIndex;
-      
-      unsigned numBytesToDecode = fBase64RemainderCount + newBytesRead;
-      unsigned newBase64RemainderCount = numBytesToDecode%4;
-      numBytesToDecode -= newBase64RemainderCount;
-      if (numBytesToDecode > 0) {
-	ptr[newBytesRead] = '\0';
-	unsigned decodedSize;
-	unsigned char* decodedBytes = base64Decode((char const*)(ptr-fBase64RemainderCount), numBytesToDecode, decodedSize);
+      // We therefore Base64-decode this new data - in place, skipping any whitespace - starting with any chars that were
+      // left over from last time (because they didn't make up a whole group of 4):
+      ptr -= fBase64RemainderCount;
+      fRequestBytesAlreadySeen -= fBase64RemainderCount;
+      fRequestBufferBytesLeft += fBase64RemainderCount;
+      newBytesRead = base64DecodeInPlace(ptr, fBase64RemainderCount + newBytesRead, fBase64RemainderCount);
 #ifdef DEBUG
-	fprintf(stderr, "Base64-decoded %d input bytes into %d new bytes:", numBytesToDecode, decodedSize);
-	for (unsigned k = 0; k < decodedSize; ++k) fprintf(stderr, "%c", decodedBytes[k]);
-	fprintf(stderr, "\n");
+      fprintf(stderr, "Base64-decoded into %d new bytes:", newBytesRead);
+      for (int k = 0; k < newBytesRead; ++k) fprintf(stderr, "%c", ptr[k]);
+      fprintf(stderr, "\n");
 #endif
-	
-	// Copy the new decoded bytes in place of the old ones (we can do this because there are fewer decoded bytes than original):
-	unsigned char* to = ptr-fBase64RemainderCount;
-	for (unsigned i = 0; i < decodedSize; ++i) *to++ = decodedBytes[i];
-	
-	// Then copy any remaining (undecoded) bytes to the end:
-	for (unsigned j = 0; j < newBase64RemainderCount; ++j) *to++ = (ptr-fBase64RemainderCount+numBytesToDecode)[j];
-	
-	newBytesRead = decodedSize + newBase64RemainderCount; // adjust to allow for the size of the new decoded data (+ remainder)
-	delete[] decodedBytes;
+      
+      if (fBase64RemainderCount > 0) {
+	// We know that we have more input bytes still to receive.  Keep the leftover chars (after the decoded bytes) until then:
+	newBytesRead += fBase64RemainderCount;
+	fRequestBufferBytesLeft -= newBytesRead;
+	fRequestBytesAlreadySeen += newBytesRead;
+	break;
       }
-      fBase64RemainderCount = newBase64RemainderCount;
-      if (fBase64RemainderCount > 0) break; // because we know that we have more input bytes still to receive
     }
     
     // Look for the end of the message: <CR><LF><CR><LF>
@@ -1093,7 +1215,7 @@ void RTSPServer::RTSPClientConnection::handleRequestBytes(int newBytesRead) {
 #ifdef DEBUG
     fprintf(stderr, "sending response: %s", fResponseBuffer);
 #endif
-    send(fClientOutputSocket, (char const*)fResponseBuffer, strlen((char*)fResponseBuffer), 0);
+    if (!fDESCRIBEIsPending) send(fClientOutputSocket, (char const*)fResponseBuffer, strlen((char*)fResponseBuffer), 0);
     
     if (playAfterSetup) {
       // The client has asked for streaming to commence now, rather than after a
@@ -1110,6 +1232,13 @@ void RTSPServer::RTSPClientConnection::handleRequestBytes(int newBytesRead) {
     if (numBytesRemaining > 0) {
       memmove(fRequestBuffer, &fRequestBuffer[requestSize], numBytesRemaining);
       newBytesRead = numBytesRemaining;
+
+      if (fDESCRIBEIsPending) {
+	// Don't handle this (pipelined) request until after we've responded to the "DESCRIBE"; just hold on to it for now:
+	fRequestBufferBytesLeft -= numBytesRemaining;
+	fRequestBytesAlreadySeen += numBytesRemaining;
+	break;
+      }
     }
   } while (numBytesRemaining > 0);
   
@@ -1122,53 +1251,71 @@ void RTSPServer::RTSPClientConnection::handleRequestBytes(int newBytesRead) {
   }
 }
 
+// A parameter value from an "Authorization:" header.  This points into the request string, so it's not '\0'-terminated:
+class AuthorizationParam {
+public:
+  AuthorizationParam(): str(NULL), size(0) {}
+  Boolean equals(char const* s) const { return str != NULL && strncmp(str, s, size) == 0 && s[size] == '\0'; }
+
+  char const* str; unsigned size;
+};
+
 static Boolean parseAuthorizationHeader(char const* buf,
-					char const*& username,
-					char const*& realm,
-					char const*& nonce, char const*& uri,
-					char const*& response) {
-  // Initialize the result parameters to default values:
-  username = realm = nonce = uri = response = NULL;
-  
+					AuthorizationParam& username,
+					AuthorizationParam& realm,
+					AuthorizationParam& nonce, AuthorizationParam& uri,
+					AuthorizationParam& response) {
   // First, find "Authorization:"
   while (1) {
     if (*buf == '\0') return False; // not found
-    if (_strncasecmp(buf, "Authorization: Digest ", 22) == 0) break;
+    if ((*buf == 'A' || *buf == 'a') && _strncasecmp(buf, "Authorization: Digest ", 22) == 0) break;
     ++buf;
   }
   
-  // Then, run through each of the fields, looking for ones we handle:
+  // Then, run through each of the fields - each of the form <parameter>="<value>" - looking for ones we handle.
+  // (We do this in place, rather than copying the fields, because we get called for each request.)
   char const* fields = buf + 22;
   while (*fields == ' ') ++fields;
-  char* parameter = strDupSize(fields);
-  char* value = strDupSize(fields);
   while (1) {
-    value[0] = '\0';
-    if (sscanf(fields, "%[^=]=\"%[^\"]\"", parameter, value) != 2 &&
-	sscanf(fields, "%[^=]=\"\"", parameter) != 1) {
-      break;
+    char const* parameter = fields;
+    while (*fields != '=' && *fields != '\0') ++fields;
+    unsigned const parameterSize = fields - parameter;
+    if (parameterSize == 0 || fields[0] != '=' || fields[1] != '"') break;
+
+    char const* value = fields += 2;
+    while (*fields != '"' && *fields != '\0') ++fields;
+    if (*fields != '"') break;
+    unsigned const valueSize = fields++ - value;
+
+    AuthorizationParam* result = NULL;
+    if (parameterSize == 8 && strncmp(parameter, "username", 8) == 0) {
+      result = &username;
+    } else if (parameterSize == 5 && strncmp(parameter, "realm", 5) == 0) {
+      result = &realm;
+    } else if (parameterSize == 5 && strncmp(parameter, "nonce", 5) == 0) {
+      result = &nonce;
+    } else if (parameterSize == 3 && strncmp(parameter, "uri", 3) == 0) {
+      result = &uri;
+    } else if (parameterSize == 8 && strncmp(parameter, "response", 8) == 0) {
+      result = &response;
     }
-    if (strcmp(parameter, "username") == 0) {
-      username = strDup(value);
-    } else if (strcmp(parameter, "realm") == 0) {
-      realm = strDup(value);
-    } else if (strcmp(parameter, "nonce") == 0) {
-      nonce = strDup(value);
-    } else if (strcmp(parameter, "uri") == 0) {
-      uri = strDup(value);
-    } else if (strcmp(parameter, "response") == 0) {
-      response = strDup(value);
+    if (result != NULL) {
+      result->str = value;
+      result->size = valueSize;
     }
     
-    fields += strlen(parameter) + 2 /*="*/ + strlen(value) + 1 /*"*/;
     while (*fields == ',' || *fields == ' ') ++fields;
         // skip over any separating ',' and ' ' chars
     if (*fields == '\0' || *fields == '\r' || *fields == '\n') break;
   }
-  delete[] parameter; delete[] value;
   return True;
 }
 
+// We reuse a nonce - rather than creating a new one - for each "401 Unauthorized" response that we send on a connection,
+// until it gets too old, or has been used too often without success:
+#define NONCE_LIFETIME_SECONDS 60
+#define MAX_FAILED_AUTHENTICATIONS_PER_NONCE 10
+
 Boolean RTSPServer::RTSPClientConnection
 ::authenticationOK(char const* cmdName, char const* urlSuffix, char const* fullRequestStr) {
   if (!fOurServer.specialClientAccessCheck(fClientInputSocket, fClientAddr, urlSuffix)) {
@@ -1180,8 +1327,7 @@ Boolean RTSPServer::RTSPClientConnection
   UserAuthenticationDatabase* authDB = fOurServer.getAuthenticationDatabaseForCommand(cmdName);
   if (authDB == NULL) return True;
   
-  char const* username = NULL; char const* realm = NULL; char const* nonce = NULL;
-  char const* uri = NULL; char const* response = NULL;
+  char username[RTSP_PARAM_STRING_MAX];
   Boolean success = False;
   
   do {
@@ -1192,34 +1338,42 @@ Boolean RTSPServer::RTSPClientConnection
     // Next, the request needs to contain an "Authorization:" header,
     // containing a username, (our) realm, (our) nonce, uri,
     // and response string:
+    AuthorizationParam usernameParam, realm, nonce, uri, response;
     if (!parseAuthorizationHeader(fullRequestStr,
-				  username, realm, nonce, uri, response)
-	|| username == NULL
-	|| realm == NULL || strcmp(realm, fCurrentAuthenticator.realm()) != 0
-	|| nonce == NULL || strcmp(nonce, fCurrentAuthenticator.nonce()) != 0
-	|| uri == NULL || response == NULL) {
+				  usernameParam, realm, nonce, uri, response)
+	|| usernameParam.str == NULL || usernameParam.size >= sizeof username
+	|| !realm.equals(fCurrentAuthenticator.realm())
+	|| !nonce.equals(fCurrentAuthenticator.nonce())
+	|| uri.str == NULL || response.str == NULL) {
       break;
     }
+    memcpy(username, usernameParam.str, usernameParam.size);
+    username[usernameParam.size] = '\0';
     
     // Next, the username has to be known to us:
-    char const* password = authDB->lookupPassword(username);
+    char const* ha1;
+    char ha1Buf[33];
+    if (strcmp(fCurrentAuthenticator.realm(), authDB->realm()) == 0) {
+      ha1 = authDB->lookupHA1(username); // usually, without computing anything
+    } else {
+      // Our nonce was sent for a different database (i.e., for a different command).  Use that database's realm:
+      ha1 = authDB->lookupPassword(username);
+      if (ha1 != NULL && !authDB->passwordsAreMD5()) {
+	Authenticator::computeHA1(username, fCurrentAuthenticator.realm(), ha1, ha1Buf);
+	ha1 = ha1Buf;
+      }
+    }
 #ifdef DEBUG
-    fprintf(stderr, "lookupPassword(%s) returned password %s\n", username, password);
+    fprintf(stderr, "lookupHA1(%s) returned %s\n", username, ha1);
 #endif
-    if (password == NULL) break;
-    fCurrentAuthenticator.setUsernameAndPassword(username, password, authDB->passwordsAreMD5());
+    if (ha1 == NULL) break;
     
     // Finally, compute a digest response from the information that we have,
     // and compare it to the one that we were given:
-    char const* ourResponse
-      = fCurrentAuthenticator.computeDigestResponse(cmdName, uri);
-    success = (strcmp(ourResponse, response) == 0);
-    fCurrentAuthenticator.reclaimDigestResponse(ourResponse);
+    success = Authenticator::responseIsValid(ha1, fCurrentAuthenticator.nonce(), cmdName,
+					     uri.str, uri.size, response.str, response.size);
   } while (0);
   
-  delete[] (char*)realm; delete[] (char*)nonce;
-  delete[] (char*)uri; delete[] (char*)response;
-  
   if (success) {
     // The user has been authenticated.
     // Now allow subclasses a chance to validate the user against the IP address and/or URL suffix.
@@ -1227,16 +1381,22 @@ Boolean RTSPServer::RTSPClientConnection
       // Note: We don't return a "WWW-Authenticate" header here, because the user is valid,
       // even though the server has decided that they should not have access.
       setRTSPResponse("401 Unauthorized");
-      delete[] (char*)username;
       return False;
     }
+    return True;
   }
-  delete[] (char*)username;
-  if (success) return True;
   
   // If we get here, we failed to authenticate the user.
-  // Send back a "401 Unauthorized" response, with a new random nonce:
-  fCurrentAuthenticator.setRealmAndRandomNonce(authDB->realm());
+  // Send back a "401 Unauthorized" response, with our current nonce - or a new random one, if need be:
+  struct timeval timeNow;
+  gettimeofday(&timeNow, NULL);
+  if (fCurrentAuthenticator.nonce() == NULL || strcmp(fCurrentAuthenticator.realm(), authDB->realm()) != 0
+      || timeNow.tv_sec - fNonceCreationTime.tv_sec >= NONCE_LIFETIME_SECONDS
+      || ++fNumFailedAuthenticationsWithNonce >= MAX_FAILED_AUTHENTICATIONS_PER_NONCE) {
+    fCurrentAuthenticator.setRealmAndRandomNonce(authDB->realm());
+    fNonceCreationTime = timeNow;
+    fNumFailedAuthenticationsWithNonce = 0;
+  }
   snprintf((char*)fResponseBuffer, sizeof fResponseBuffer,
 	   "RTSP/1.0 401 Unauthorized\r\n"
 	   "CSeq: %s\r\n"
@@ -1356,13 +1516,14 @@ void RTSPServer::RTSPClientConnection::continueHandlingREGISTER1(ParamsForREGIST
 RTSPServer::RTSPClientSession
 ::RTSPClientSession(RTSPServer& ourServer, u_int32_t sessionId)
   : fOurServer(ourServer), fOurSessionId(sessionId), fOurServerMediaSession(NULL), fIsMulticast(False), fStreamAfterSETUP(False),
-    fTCPStreamIdCount(0), fLivenessCheckTask(NULL), fNumStreamStates(0), fStreamStates(NULL) {
+    fTCPStreamIdCount(0), fPrevInLivenessList(NULL), fNextInLivenessList(NULL),
+    fPrevForSameServerMediaSession(NULL), fNextForSameServerMediaSession(NULL), fNumStreamStates(0), fStreamStates(NULL) {
   noteLiveness();
 }
 
 RTSPServer::RTSPClientSession::~RTSPClientSession() {
   // Turn off any liveness checking:
-  envir().taskScheduler().unscheduleDelayedTask(fLivenessCheckTask);
+  removeFromLivenessList();
   
   // Remove ourself from the server's 'client sessions' hash table before we go:
   char sessionIdStr[9];
@@ -1372,6 +1533,7 @@ RTSPServer::RTSPClientSession::~RTSPClientSession() {
   reclaimStreamStates();
   
   if (fOurServerMediaSession != NULL) {
+    unlinkFromServerMediaSession();
     fOurServerMediaSession->decrementReferenceCount();
     if (fOurServerMediaSession->referenceCount() == 0
 	&& fOurServerMediaSession->deleteWhenUnreferenced()) {
@@ -1381,6 +1543,38 @@ RTSPServer::RTSPClientSession::~RTSPClientSession() {
   }
 }
 
+void RTSPServer::RTSPClientSession::linkToServerMediaSession() {
+  // Add ourself to the start of our server's list of client sessions for "fOurServerMediaSession":
+  HashTable* table = fOurServer.fClientSessionsForServerMediaSession;
+  char const* key = (char const*)fOurServerMediaSession;
+
+  fPrevForSameServerMediaSession = NULL;
+  fNextForSameServerMediaSession = (RTSPClientSession*)(table->Lookup(key));
+  if (fNextForSameServerMediaSession != NULL) fNextForSameServerMediaSession->fPrevForSameServerMediaSession = this;
+  table->Add(key, this);
+}
+
+void RTSPServer::RTSPClientSession::unlinkFromServerMediaSession() {
+  HashTable* table = fOurServer.fClientSessionsForServerMediaSession;
+  char const* key = (char const*)fOurServerMediaSession;
+
+  if (fPrevForSameServerMediaSession != NULL) {
+    fPrevForSameServerMediaSession->fNextForSameServerMediaSession = fNextForSameServerMediaSession;
+  } else if (table->Lookup(key) == this) { // we're at the start of the list
+    if (fNextForSameServerMediaSession == NULL) {
+      table->Remove(key);
+    } else {
+      table->Add(key, fNextForSameServerMediaSession);
+    }
+  } else {
+    return; // we're not in the list
+  }
+  if (fNextForSameServerMediaSession != NULL) {
+    fNextForSameServerMediaSession->fPrevForSameServerMediaSession = fPrevForSameServerMediaSession;
+  }
+  fPrevForSameServerMediaSession = fNextForSameServerMediaSession = NULL;
+}
+
 void RTSPServer::RTSPClientSession::reclaimStreamStates() {
   for (unsigned i = 0; i < fNumStreamStates; ++i) {
     if (fStreamStates[i].subsession != NULL) {
@@ -1515,6 +1709,7 @@ void RTSPServer::RTSPClientSession
 	// We're accessing the "ServerMediaSession" for the first time.
 	fOurServerMediaSession = sms;
 	fOurServerMediaSession->incrementReferenceCount();
+	linkToServerMediaSession();
       } else if (sms != fOurServerMediaSession) {
 	// The client asked for a stream that's different from the one originally requested for this stream id.  Bad request:
 	ourClientConnection->handleCmd_bad();
@@ -2073,13 +2268,57 @@ RTSPServer::createNewClientSession(u_int32_t sessionId) {
   return new RTSPClientSession(*this, sessionId);
 }
 
+// The clock that we use to measure client sessions' liveness.  Like the one used by "DelayQueue" (for our delayed tasks),
+// this is a 'monotonic' clock where possible, so that changes to the system's 'wall clock' time (e.g., by NTP)
+// don't cause client sessions to be reclaimed too early (or too late):
+static void livenessClockNow(struct timeval& tvNow) {
+#if defined(CLOCK_MONOTONIC) && !defined(__WIN32__) && !defined(_WIN32)
+  struct timespec tsNow;
+  clock_gettime(CLOCK_MONOTONIC, &tsNow);
+  tvNow.tv_sec = tsNow.tv_sec;
+  tvNow.tv_usec = tsNow.tv_nsec/1000;
+#else
+  gettimeofday(&tvNow, NULL);
+#endif
+}
+
 void RTSPServer::RTSPClientSession::noteLiveness() {
-  if (fOurServer.fReclamationTestSeconds > 0) {
-    envir().taskScheduler()
-      .rescheduleDelayedTask(fLivenessCheckTask,
-			     fOurServer.fReclamationTestSeconds*1000000,
-			     (TaskFunc*)livenessTimeoutTask, this);
+  if (fOurServer.fReclamationTestSeconds == 0) return;
+
+  // Note the time, and move ourself to the end of our server's 'liveness list' (which is kept in order of this time).
+  // (We don't schedule a timeout for each client session; instead, our server's "livenessSweepTask()" - a single delayed
+  // task - checks the sessions at the head of this list.)
+  livenessClockNow(fLastLivenessTime);
+  removeFromLivenessList();
+
+  fPrevInLivenessList = fOurServer.fLivenessListTail;
+  if (fPrevInLivenessList == NULL) {
+    fOurServer.fLivenessListHead = this;
+  } else {
+    fPrevInLivenessList->fNextInLivenessList = this;
   }
+  fOurServer.fLivenessListTail = this;
+
+  if (fOurServer.fLivenessSweepTask == NULL) {
+    fOurServer.fLivenessSweepTask
+      = envir().taskScheduler().scheduleDelayedTask(fOurServer.fReclamationTestSeconds*1000000,
+						    (TaskFunc*)livenessSweepTask, &fOurServer);
+  }
+}
+
+void RTSPServer::RTSPClientSession::removeFromLivenessList() {
+  if (fPrevInLivenessList == NULL) {
+    if (fOurServer.fLivenessListHead != this) return; // we're not in the list
+    fOurServer.fLivenessListHead = fNextInLivenessList;
+  } else {
+    fPrevInLivenessList->fNextInLivenessList = fNextInLivenessList;
+  }
+  if (fNextInLivenessList == NULL) {
+    fOurServer.fLivenessListTail = fPrevInLivenessList;
+  } else {
+    fNextInLivenessList->fPrevInLivenessList = fPrevInLivenessList;
+  }
+  fPrevInLivenessList = fNextInLivenessList = NULL;
 }
 
 void RTSPServer::RTSPClientSession
@@ -2093,17 +2332,41 @@ void RTSPServer::RTSPClientSession
   clientSession->noteLiveness();
 }
 
-void RTSPServer::RTSPClientSession
-::livenessTimeoutTask(RTSPClientSession* clientSession) {
-  // If this gets called, the client session is assumed to have timed out,
-  // so delete it:
+void RTSPServer::livenessSweepTask(RTSPServer* server) {
+  server->livenessSweepTask1();
+}
+
+void RTSPServer::livenessSweepTask1() {
+  fLivenessSweepTask = NULL;
+
+  // Delete each client session (from the head of our 'liveness list') that has timed out.  Stop at the first one that
+  // hasn't, and check again when it will:
+  struct timeval timeNow;
+  livenessClockNow(timeNow);
+  int64_t const timeoutUSecs = (int64_t)fReclamationTestSeconds*1000000;
+  while (fLivenessListHead != NULL) {
+    RTSPClientSession* clientSession = fLivenessListHead;
+    int64_t uSecsSinceLiveness
+      = (int64_t)(timeNow.tv_sec - clientSession->fLastLivenessTime.tv_sec)*1000000
+      + (timeNow.tv_usec - clientSession->fLastLivenessTime.tv_usec);
+    if (uSecsSinceLiveness < 0) uSecsSinceLiveness = 0; // in case our clock ever went backwards
+    if (uSecsSinceLiveness < timeoutUSecs) {
+      // (Because "uSecsSinceLiveness" is >= 0, this delay is never more than "timeoutUSecs".)
+      fLivenessSweepTask = envir().taskScheduler().scheduleDelayedTask(timeoutUSecs - uSecsSinceLiveness,
+								      (TaskFunc*)livenessSweepTask, this);
+      return;
+    }
+
+    // This client session is assumed to have timed out, so delete it:
 #ifdef DEBUG
-  char const* streamName
-    = (clientSession->fOurServerMediaSession == NULL) ? "???" : clientSession->fOurServerMediaSession->streamName();
-  fprintf(stderr, "RTSP client session (id \"%08X\", stream name \"%s\") has timed out (due to inactivity)\n",
-	  clientSession->fOurSessionId, streamName);
+    char const* streamName
+      = (clientSession->fOurServerMediaSession == NULL) ? "???" : clientSession->fOurServerMediaSession->streamName();
+    fprintf(stderr, "RTSP client session (id \"%08X\", stream name \"%s\") has timed out (due to inactivity)\n",
+	    clientSession->fOurSessionId, streamName);
 #endif
-  delete clientSession;
+    ++fNumReclaimedClientSessions;
+    delete clientSession; // this also removes it from our 'liveness list'
+  }
 }
 
 
@@ -2129,11 +2392,26 @@ ServerMediaSession* RTSPServer::ServerMediaSessionIterator::next() {
 
 ////////// UserAuthenticationDatabase implementation //////////
 
+// A HA1 value that we've computed, along with the password that we computed it from:
+class HA1Record {
+public:
+  HA1Record(char const* password): fPassword(strDup(password)) {}
+  virtual ~HA1Record() {
+    // Don't leave the password lying around in memory:
+    for (char* p = fPassword; *p != '\0'; ++p) *p = '\0';
+    delete[] fPassword;
+  }
+
+  char* fPassword;
+  char fHA1[33];
+};
+
 UserAuthenticationDatabase::UserAuthenticationDatabase(char const* realm,
 						       Boolean passwordsAreMD5)
   : fTable(HashTable::create(STRING_HASH_KEYS)),
     fRealm(strDup(realm == NULL ? "LIVE555 Streaming Media" : realm)),
-    fPasswordsAreMD5(passwordsAreMD5) {
+    fPasswordsAreMD5(passwordsAreMD5),
+    fHA1Table(HashTable::create(STRING_HASH_KEYS)) {
 }
 
 UserAuthenticationDatabase::~UserAuthenticationDatabase() {
@@ -2145,14 +2423,22 @@ UserAuthenticationDatabase::~UserAuthenticationDatabase() {
     delete[] password;
   }
   delete fTable;
+
+  HA1Record* ha1Record;
+  while ((ha1Record = (HA1Record*)fHA1Table->RemoveNext()) != NULL) {
+    delete ha1Record;
+  }
+  delete fHA1Table;
 }
 
 void UserAuthenticationDatabase::addUserRecord(char const* username,
 					       char const* password) {
+  forgetHA1(username);
   fTable->Add(username, (void*)(strDup(password)));
 }
 
 void UserAuthenticationDatabase::removeUserRecord(char const* username) {
+  forgetHA1(username);
   char* password = (char*)(fTable->Lookup(username));
   fTable->Remove(username);
   delete[] password;
@@ -2162,6 +2448,30 @@ char const* UserAuthenticationDatabase::lookupPassword(char const* username) {
   return (char const*)(fTable->Lookup(username));
 }
 
+char const* UserAuthenticationDatabase::lookupHA1(char const* username) {
+  char const* password = lookupPassword(username);
+  if (password == NULL || fPasswordsAreMD5) return password;
+
+  // Use the HA1 value that we computed earlier, unless the password has changed since then:
+  HA1Record* ha1Record = (HA1Record*)(fHA1Table->Lookup(username));
+  if (ha1Record == NULL || strcmp(ha1Record->fPassword, password) != 0) {
+    forgetHA1(username);
+    ha1Record = new HA1Record(password);
+    Authenticator::computeHA1(username, fRealm, password, ha1Record->fHA1);
+    fHA1Table->Add(username, ha1Record);
+  }
+
+  return ha1Record->fHA1;
+}
+
+void UserAuthenticationDatabase::forgetHA1(char const* username) {
+  HA1Record* ha1Record = (HA1Record*)(fHA1Table->Lookup(username));
+  if (ha1Record != NULL) {
+    fHA1Table->Remove(username);
+    delete ha1Record;
+  }
+}
+
 
 ///////// RTSPServerWithREGISTERProxying implementation /////////
 
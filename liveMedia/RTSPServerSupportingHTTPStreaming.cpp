@@ -20,10 +20,86 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 
 #include "RTSPServerSupportingHTTPStreaming.hh"
 #include "RTSPCommon.hh"
+#include "GroupsockHelper.hh" // for "gettimeofday()"
+#include "InputFile.hh"
 #ifndef _WIN32_WCE
 #include <sys/stat.h>
 #endif
 #include <time.h>
+#if defined(__linux__) && !defined(NO_SENDFILE)
+#include <sys/sendfile.h>
+#define USE_SENDFILE 1
+#endif
+
+////////// SegmentByteRangeCache //////////
+
+// For each (bounded) stream, we remember the file byte range of each segment that's been requested, so that the stream's
+// index file needs to be consulted only once per segment (rather than once per request):
+
+#define MAX_NUM_CACHED_SEGMENT_BYTE_RANGES 1000 // per stream; we start afresh if a client asks for more distinct segments
+
+class SegmentByteRange {
+public:
+  SegmentByteRange(u_int64_t startByte, u_int64_t numBytes)
+    : fStartByte(startByte), fNumBytes(numBytes) {
+  }
+
+  u_int64_t fStartByte, fNumBytes; // "fNumBytes" == 0 means that the segment can't be sent directly from the file
+};
+
+class SegmentByteRangeCache {
+public:
+  SegmentByteRangeCache(ServerMediaSession* session);
+  virtual ~SegmentByteRangeCache();
+
+  ServerMediaSession* serverMediaSession() const { return fSession; }
+
+  SegmentByteRange* lookup(char const* segmentKey) { return (SegmentByteRange*)(fRanges->Lookup(segmentKey)); }
+  SegmentByteRange* add(char const* segmentKey, char const* fileName, u_int64_t startByte, u_int64_t numBytes);
+  char const* fileName() const { return fFileName; }
+
+private:
+  void clear();
+
+private:
+  ServerMediaSession* fSession;
+  char* fFileName;
+  HashTable* fRanges; // maps "<offset-in-seconds>,<duration-in-seconds>" strings to "SegmentByteRange"s
+};
+
+SegmentByteRangeCache::SegmentByteRangeCache(ServerMediaSession* session)
+  : fSession(session), fFileName(NULL), fRanges(HashTable::create(STRING_HASH_KEYS)) {
+}
+
+SegmentByteRangeCache::~SegmentByteRangeCache() {
+  clear();
+  delete fRanges;
+  delete[] fFileName;
+}
+
+SegmentByteRange* SegmentByteRangeCache
+::add(char const* segmentKey, char const* fileName, u_int64_t startByte, u_int64_t numBytes) {
+  if (fRanges->numEntries() >= MAX_NUM_CACHED_SEGMENT_BYTE_RANGES) clear();
+
+  if (fileName != NULL && (fFileName == NULL || strcmp(fileName, fFileName) != 0)) {
+    // (A stream's segments all come from the same file, so this should happen only once.)
+    clear();
+    delete[] fFileName; fFileName = strDup(fileName);
+  }
+
+  SegmentByteRange* range = new SegmentByteRange(startByte, numBytes);
+  delete (SegmentByteRange*)(fRanges->Add(segmentKey, range));
+  return range;
+}
+
+void SegmentByteRangeCache::clear() {
+  SegmentByteRange* range;
+  while ((range = (SegmentByteRange*)(fRanges->RemoveNext())) != NULL) {
+    delete range;
+  }
+}
+
+////////// RTSPServerSupportingHTTPStreaming //////////
 
 RTSPServerSupportingHTTPStreaming*
 RTSPServerSupportingHTTPStreaming::createNew(UsageEnvironment& env, Port rtspPort,
@@ -37,10 +113,153 @@ RTSPServerSupportingHTTPStreaming::createNew(UsageEnvironment& env, Port rtspPor
 RTSPServerSupportingHTTPStreaming
 ::RTSPServerSupportingHTTPStreaming(UsageEnvironment& env, int ourSocket, Port rtspPort,
 				    UserAuthenticationDatabase* authDatabase, unsigned reclamationTestSeconds)
-  : RTSPServer(env, ourSocket, rtspPort, authDatabase, reclamationTestSeconds) {
+  : RTSPServer(env, ourSocket, rtspPort, authDatabase, reclamationTestSeconds),
+    fLiveHLSSegmenters(HashTable::create(STRING_HASH_KEYS)),
+    fHLSTargetSegmentDuration(6), fHLSNumSegmentsInPlaylist(5), fHLSIdleTimeoutSeconds(60),
+    fLiveHLSIdleCheckTask(NULL), fSegmentByteRangeCaches(HashTable::create(STRING_HASH_KEYS)) {
 }
 
 RTSPServerSupportingHTTPStreaming::~RTSPServerSupportingHTTPStreaming() {
+  envir().taskScheduler().unscheduleDelayedTask(fLiveHLSIdleCheckTask);
+
+  HLSSegmenter* segmenter;
+  while ((segmenter = (HLSSegmenter*)fLiveHLSSegmenters->getFirst()) != NULL) {
+    closeLiveHLSSegmenter(segmenter);
+  }
+  delete fLiveHLSSegmenters;
+
+  SegmentByteRangeCache* cache;
+  while ((cache = (SegmentByteRangeCache*)(fSegmentByteRangeCaches->RemoveNext())) != NULL) {
+    delete cache;
+  }
+  delete fSegmentByteRangeCaches;
+}
+
+void RTSPServerSupportingHTTPStreaming
+::setLiveHLSParameters(unsigned targetSegmentDuration, unsigned numSegmentsInPlaylist, unsigned idleTimeoutSeconds) {
+  fHLSTargetSegmentDuration = targetSegmentDuration;
+  fHLSNumSegmentsInPlaylist = numSegmentsInPlaylist;
+  fHLSIdleTimeoutSeconds = idleTimeoutSeconds == 0 ? 1 : idleTimeoutSeconds;
+}
+
+HLSSegmenter* RTSPServerSupportingHTTPStreaming
+::lookupLiveHLSSegmenter(ServerMediaSession* session, Boolean createIfNotFound) {
+  char const* streamName = session->streamName();
+  HLSSegmenter* segmenter = (HLSSegmenter*)(fLiveHLSSegmenters->Lookup(streamName));
+
+  if (segmenter != NULL && &segmenter->serverMediaSession() != session) {
+    // The stream has since been replaced by a new "ServerMediaSession" with the same name:
+    closeLiveHLSSegmenter(segmenter);
+    segmenter = NULL;
+  }
+  if (segmenter != NULL && segmenter->hasEnded() && createIfNotFound) {
+    // The segmenter's input has ended (e.g., because a proxied 'back-end' stream failed).  Restart it:
+    closeLiveHLSSegmenter(segmenter);
+    segmenter = NULL;
+  }
+
+  if (segmenter == NULL && createIfNotFound) {
+    // Segment URLs are relative to the playlist's URL, so they use just the last component of the stream name:
+    char const* lastSlashPos = strrchr(streamName, '/');
+    char const* baseName = lastSlashPos == NULL ? streamName : lastSlashPos + 1;
+    char* segmentURLPrefix = new char[strlen(baseName) + 20];
+    sprintf(segmentURLPrefix, "%s?liveSegment=", baseName);
+
+    segmenter = HLSSegmenter::createNew(envir(), *session, segmentURLPrefix,
+					fHLSTargetSegmentDuration, fHLSNumSegmentsInPlaylist);
+    delete[] segmentURLPrefix;
+    if (segmenter != NULL) {
+      fLiveHLSSegmenters->Add(streamName, segmenter);
+      if (fLiveHLSIdleCheckTask == NULL) {
+	fLiveHLSIdleCheckTask
+	  = envir().taskScheduler().scheduleDelayedTask(fHLSIdleTimeoutSeconds*1000000, liveHLSIdleCheckTask, this);
+      }
+    }
+  }
+
+  return segmenter;
+}
+
+void RTSPServerSupportingHTTPStreaming::closeLiveHLSSegmenter(HLSSegmenter* segmenter) {
+  ServerMediaSession* session = &segmenter->serverMediaSession();
+  if (fLiveHLSSegmenters->Lookup(session->streamName()) == segmenter) {
+    fLiveHLSSegmenters->Remove(session->streamName());
+  }
+  Medium::close(segmenter);
+
+  if (session->referenceCount() == 0 && session->deleteWhenUnreferenced()) {
+    removeServerMediaSession(session);
+  }
+}
+
+Boolean RTSPServerSupportingHTTPStreaming
+::lookupSegmentByteRange(ServerMediaSession* session, ServerMediaSubsession* subsession,
+			 unsigned offsetInSeconds, unsigned durationInSeconds,
+			 char const*& fileName, u_int64_t& startByte, u_int64_t& numBytes) {
+  char const* streamName = session->streamName();
+  SegmentByteRangeCache* cache = (SegmentByteRangeCache*)(fSegmentByteRangeCaches->Lookup(streamName));
+  if (cache != NULL && cache->serverMediaSession() != session) {
+    // The stream has since been replaced by a new "ServerMediaSession" with the same name, so our cache is stale:
+    fSegmentByteRangeCaches->Remove(streamName);
+    delete cache;
+    cache = NULL;
+  }
+  if (cache == NULL) {
+    cache = new SegmentByteRangeCache(session);
+    fSegmentByteRangeCaches->Add(streamName, cache);
+  }
+
+  char segmentKey[30];
+  sprintf(segmentKey, "%u,%u", offsetInSeconds, durationInSeconds);
+  SegmentByteRange* range = cache->lookup(segmentKey);
+  if (range == NULL) {
+    // We haven't been asked for this segment before.  Ask the subsession where (if anywhere) its data lies:
+    if (!subsession->getFileByteRange((double)offsetInSeconds, (double)durationInSeconds, fileName, startByte, numBytes)) {
+      fileName = NULL;
+      numBytes = 0;
+    }
+    range = cache->add(segmentKey, fileName, startByte, numBytes);
+  }
+
+  fileName = cache->fileName();
+  startByte = range->fStartByte;
+  numBytes = range->fNumBytes;
+  return fileName != NULL && numBytes > 0;
+}
+
+void RTSPServerSupportingHTTPStreaming::liveHLSIdleCheckTask(void* clientData) {
+  RTSPServerSupportingHTTPStreaming* server = (RTSPServerSupportingHTTPStreaming*)clientData;
+  server->liveHLSIdleCheckTask1();
+}
+
+void RTSPServerSupportingHTTPStreaming::liveHLSIdleCheckTask1() {
+  fLiveHLSIdleCheckTask = NULL;
+
+  // Close each segmenter that no HTTP client has accessed recently.  (We first collect these, so that we don't
+  // modify our hash table while iterating over it.)
+  struct timeval timeNow;
+  gettimeofday(&timeNow, NULL);
+  unsigned const numSegmenters = fLiveHLSSegmenters->numEntries();
+  HLSSegmenter** idleSegmenters = new HLSSegmenter*[numSegmenters];
+  unsigned numIdleSegmenters = 0;
+
+  HashTable::Iterator* iter = HashTable::Iterator::create(*fLiveHLSSegmenters);
+  HLSSegmenter* segmenter;
+  char const* key; // dummy
+  while ((segmenter = (HLSSegmenter*)(iter->next(key))) != NULL) {
+    if (timeNow.tv_sec - segmenter->lastAccessTime() >= (time_t)fHLSIdleTimeoutSeconds) {
+      idleSegmenters[numIdleSegmenters++] = segmenter;
+    }
+  }
+  delete iter;
+
+  for (unsigned i = 0; i < numIdleSegmenters; ++i) closeLiveHLSSegmenter(idleSegmenters[i]);
+  delete[] idleSegmenters;
+
+  if (fLiveHLSSegmenters->numEntries() > 0) {
+    fLiveHLSIdleCheckTask
+      = envir().taskScheduler().scheduleDelayedTask(fHLSIdleTimeoutSeconds*1000000, liveHLSIdleCheckTask, this);
+  }
 }
 
 RTSPServer::RTSPClientConnection*
@@ -51,12 +270,15 @@ RTSPServerSupportingHTTPStreaming::createNewClientConnection(int clientSocket, s
 RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStreaming
 ::RTSPClientConnectionSupportingHTTPStreaming(RTSPServer& ourServer, int clientSocket, struct sockaddr_in clientAddr)
   : RTSPClientConnection(ourServer, clientSocket, clientAddr),
-    fClientSessionId(0), fPlaylistSource(NULL), fTCPSink(NULL) {
+    fClientSessionId(0), fPlaylistSource(NULL), fTCPSink(NULL), fLiveSegment(NULL),
+    fFileFid(NULL), fFileBytePosition(0), fFileBytesLeft(0), fKeepAlive(False) {
 }
 
 RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStreaming::~RTSPClientConnectionSupportingHTTPStreaming() {
+  closeFile();
   Medium::close(fPlaylistSource);
   Medium::close(fTCPSink);
+  if (fLiveSegment != NULL) fLiveSegment->decrementReferenceCount();
 }
 
 static char const* lastModifiedHeader(char const* fileName) {
@@ -74,8 +296,92 @@ static char const* lastModifiedHeader(char const* fileName) {
   return buf;
 }
 
+static char const* lookForHeaderValue(char const* headerName, char const* fullRequestStr) {
+  // Returns a pointer to the value of the named header (if present), within the request's headers.
+  // (Note that "fullRequestStr" may include the start of a subsequent, pipelined request, so we stop at the end of the headers.)
+  unsigned headerNameLen = strlen(headerName);
+  for (char const* s = fullRequestStr; *s != '\0'; ++s) {
+    if (s[0] == '\r' && s[1] == '\n' && s[2] == '\r') break; // end of the headers
+    if (s[0] == '\n' && _strncasecmp(&s[1], headerName, headerNameLen) == 0 && s[1+headerNameLen] == ':') {
+      char const* value = &s[2+headerNameLen];
+      while (*value == ' ' || *value == '\t') ++value;
+      return value;
+    }
+  }
+  return NULL;
+}
+
+static Boolean clientWantsKeepAlive(char const* fullRequestStr) {
+  char const* connectionValue = lookForHeaderValue("Connection", fullRequestStr);
+  if (connectionValue != NULL) {
+    if (_strncasecmp(connectionValue, "close", 5) == 0) return False;
+    if (_strncasecmp(connectionValue, "keep-alive", 10) == 0) return True;
+  }
+
+  // Otherwise, HTTP/1.1 connections are persistent by default, but HTTP/1.0 connections are not:
+  char const* endOfRequestLine = strstr(fullRequestStr, "\r\n");
+  if (endOfRequestLine == NULL || endOfRequestLine - fullRequestStr < 8) return False;
+  return strncmp(endOfRequestLine - 8, "HTTP/1.1", 8) == 0;
+}
+
+static int parseRangeHeader(char const* fullRequestStr, unsigned size, unsigned& firstByte, unsigned& lastByte) {
+  // Returns 1 if the request has a "Range:" header that specifies a (single) satisfiable byte range of a "size"-byte
+  // entity - setting "firstByte" and "lastByte" - or -1 if the specified range is unsatisfiable.
+  // Returns 0 if there's no such header (or we can't handle it), in which case the whole entity gets sent.
+  char const* rangeValue = lookForHeaderValue("Range", fullRequestStr);
+  if (rangeValue == NULL || _strncasecmp(rangeValue, "bytes=", 6) != 0) return 0;
+  char const* spec = &rangeValue[6];
+  for (char const* s = spec; *s != '\r' && *s != '\0'; ++s) {
+    if (*s == ',') return 0; // multiple ranges; we don't support these
+  }
+
+  if (size == 0) return -1;
+  if (*spec == '-') { // "bytes=-<suffix-length>"
+    unsigned suffixLength;
+    if (sscanf(spec, "-%u", &suffixLength) != 1) return 0;
+    if (suffixLength == 0) return -1;
+    firstByte = suffixLength >= size ? 0 : size - suffixLength;
+    lastByte = size - 1;
+  } else {
+    int numFields = sscanf(spec, "%u-%u", &firstByte, &lastByte);
+    if (numFields == 1) { // "bytes=<first>-"
+      lastByte = size - 1;
+    } else if (numFields != 2 || lastByte < firstByte) {
+      return 0;
+    }
+    if (firstByte >= size) return -1;
+    if (lastByte >= size) lastByte = size - 1;
+  }
+
+  return 1;
+}
+
 void RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStreaming
-::handleHTTPCmd_StreamingGET(char const* urlSuffix, char const* /*fullRequestStr*/) {
+::handleHTTPCmd_StreamingGET(char const* urlSuffix, char const* fullRequestStr) {
+  fKeepAlive = clientWantsKeepAlive(fullRequestStr);
+
+  // If "urlSuffix" ends with "?liveSegment=<sequence-number>", then strip this off, and send the specified segment
+  // of a live stream:
+  do {
+    char const* questionMarkPos = strrchr(urlSuffix, '?');
+    if (questionMarkPos == NULL) break;
+    unsigned sequenceNumber;
+    if (sscanf(questionMarkPos, "?liveSegment=%u", &sequenceNumber) != 1) break;
+
+    char* streamName = strDup(urlSuffix);
+    streamName[questionMarkPos-urlSuffix] = '\0';
+
+    ServerMediaSession* session = fOurServer.lookupServerMediaSession(streamName);
+    if (session == NULL) {
+      handleHTTPCmd_notFound();
+    } else {
+      handleHTTPCmd_LiveStreamingGET(session, (int)sequenceNumber);
+    }
+
+    delete[] streamName;
+    return;
+  } while (0);
+
   // If "urlSuffix" ends with "?segment=<offset-in-seconds>,<duration-in-seconds>", then strip this off, and send the
   // specified segment.  Otherwise, construct and send a playlist that consists of segments from the specified file.
   do {
@@ -104,7 +410,17 @@ void RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStream
 	break;
       }
 
-      // Call "getStreamParameters()" to create the stream's source.  (Because we're not actually streaming via RTP/RTCP, most
+      // If the segment is simply a range of bytes within a file (e.g., an indexed Transport Stream file), then send
+      // it directly from the file:
+      char const* fileName;
+      u_int64_t startByte, numBytes;
+      if (((RTSPServerSupportingHTTPStreaming&)fOurServer)
+	  .lookupSegmentByteRange(session, subsession, offsetInSeconds, durationInSeconds, fileName, startByte, numBytes)) {
+	handleHTTPCmd_FileSegmentGET(fileName, startByte, numBytes, streamName, fullRequestStr);
+	break;
+      }
+
+      // Otherwise, call "getStreamParameters()" to create the stream's source.  (Because we're not actually streaming via RTP/RTCP, most
       // of the parameters to the call are dummy.)
       ++fClientSessionId;
       Port clientRTPPort(0), clientRTCPPort(0), serverRTPPort(0), serverRTCPPort(0);
@@ -116,7 +432,6 @@ void RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStream
       
       // Seek the stream source to the desired place, with the desired duration, and (as a side effect) get the number of bytes:
       double dOffsetInSeconds = (double)offsetInSeconds;
-      u_int64_t numBytes;
       subsession->seekStream(fClientSessionId, streamToken, dOffsetInSeconds, (double)durationInSeconds, numBytes);
       unsigned numTSBytesToStream = (unsigned)numBytes;
       
@@ -132,12 +447,14 @@ void RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStream
 	       "%s"
 	       "Server: LIVE555 Streaming Media v%s\r\n"
 	       "%s"
+	       "%s"
 	       "Content-Length: %d\r\n"
 	       "Content-Type: text/plain; charset=ISO-8859-1\r\n"
 	       "\r\n",
 	       dateHeader(),
 	       LIVEMEDIA_LIBRARY_VERSION_STRING,
 	       lastModifiedHeader(streamName),
+	       connectionHeader(),
 	       numTSBytesToStream);
       // Send the response now, because we're about to add more data (from the source):
       send(fClientOutputSocket, (char const*)fResponseBuffer, strlen((char*)fResponseBuffer), 0);
@@ -146,7 +463,11 @@ void RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStream
       // Ask the media source to deliver - to the TCP sink - the desired data:
       FramedSource* mediaSource = subsession->getStreamSource(streamToken);
       if (mediaSource != NULL) {
-	if (fTCPSink == NULL) fTCPSink = TCPStreamSink::createNew(envir(), fClientOutputSocket);
+	if (fTCPSink == NULL) {
+	  fTCPSink = TCPStreamSink::createNew(envir(), fClientOutputSocket);
+	} else {
+	  fTCPSink->stopPlaying(); // in case it's still 'playing' a previous response's source
+	}
 	fTCPSink->startPlaying(*mediaSource, afterStreaming, this);
       }
     } while(0);
@@ -167,7 +488,12 @@ void RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStream
 
   // To be able to construct a playlist for the requested file, we need to know its duration:
   float duration = session->duration();
-  if (duration <= 0.0) {
+  if (duration == 0.0) {
+    // The stream is unbounded (i.e., live).  Send the playlist from the stream's (shared) segmenter instead:
+    handleHTTPCmd_LiveStreamingGET(session, -1);
+    return;
+  }
+  if (duration < 0.0) {
     // We can't handle this request:
     handleHTTPCmd_notSupported();
     return;
@@ -225,12 +551,14 @@ void RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStream
 	   "%s"
 	   "Server: LIVE555 Streaming Media v%s\r\n"
 	   "%s"
+	   "%s"
 	   "Content-Length: %d\r\n"
 	   "Content-Type: application/vnd.apple.mpegurl\r\n"
 	   "\r\n",
 	   dateHeader(),
 	   LIVEMEDIA_LIBRARY_VERSION_STRING,
 	   lastModifiedHeader(urlSuffix),
+	   connectionHeader(),
 	   playlistLen);
 
   // Send the response header now, because we're about to add more data (the playlist):
@@ -239,24 +567,235 @@ void RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStream
 
   // Then, send the playlist.  Because it's large, we don't do so using "send()", because that might not send it all at once.
   // Instead, we stream the playlist over the TCP socket:
+  sendMemoryBuffer((u_int8_t*)playlist, playlistLen, True);
+}
+
+void RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStreaming
+::handleHTTPCmd_LiveStreamingGET(ServerMediaSession* session, int liveSegmentNumber) {
+  // If "liveSegmentNumber" is >= 0, send the specified segment; otherwise, send the current playlist:
+  Boolean isPlaylistRequest = liveSegmentNumber < 0;
+  HLSSegmenter* segmenter
+    = ((RTSPServerSupportingHTTPStreaming&)fOurServer).lookupLiveHLSSegmenter(session, isPlaylistRequest);
+  if (segmenter == NULL) {
+    // We can't segment this stream (or, for a segment request, we're not currently segmenting it):
+    if (isPlaylistRequest) handleHTTPCmd_notSupported(); else handleHTTPCmd_notFound();
+    return;
+  }
+
+  if (isPlaylistRequest) {
+    unsigned playlistSize;
+    char const* playlist = segmenter->playlist(playlistSize);
+
+    // Construct our response.  (The playlist changes as the stream progresses, so it must not be cached.)
+    snprintf((char*)fResponseBuffer, sizeof fResponseBuffer,
+	     "HTTP/1.1 200 OK\r\n"
+	     "%s"
+	     "Server: LIVE555 Streaming Media v%s\r\n"
+	     "Cache-Control: no-cache\r\n"
+	     "%s"
+	     "Content-Length: %d\r\n"
+	     "Content-Type: application/vnd.apple.mpegurl\r\n"
+	     "\r\n",
+	     dateHeader(),
+	     LIVEMEDIA_LIBRARY_VERSION_STRING,
+	     connectionHeader(),
+	     playlistSize);
+    send(fClientOutputSocket, (char const*)fResponseBuffer, strlen((char*)fResponseBuffer), 0);
+    fResponseBuffer[0] = '\0'; // We've already sent the response.  This tells the calling code not to send it again.
+
+    // Send a copy of the playlist, because the segmenter replaces it whenever a new segment is completed:
+    u_int8_t* playlistCopy = new u_int8_t[playlistSize];
+    memmove(playlistCopy, playlist, playlistSize);
+    sendMemoryBuffer(playlistCopy, playlistSize, True);
+    return;
+  }
+
+  HLSSegment* segment = segmenter->lookupSegment((unsigned)liveSegmentNumber);
+  if (segment == NULL) {
+    // The segment has already slid out of the playlist window (or does not yet exist):
+    handleHTTPCmd_notFound();
+    return;
+  }
+
+  // Construct our response:
+  snprintf((char*)fResponseBuffer, sizeof fResponseBuffer,
+	   "HTTP/1.1 200 OK\r\n"
+	   "%s"
+	   "Server: LIVE555 Streaming Media v%s\r\n"
+	   "%s"
+	   "Content-Length: %d\r\n"
+	   "Content-Type: video/MP2T\r\n"
+	   "\r\n",
+	   dateHeader(),
+	   LIVEMEDIA_LIBRARY_VERSION_STRING,
+	   connectionHeader(),
+	   segment->size());
+  send(fClientOutputSocket, (char const*)fResponseBuffer, strlen((char*)fResponseBuffer), 0);
+  fResponseBuffer[0] = '\0'; // We've already sent the response.  This tells the calling code not to send it again.
+
+  // Send the segment's data directly from the segmenter's memory.  (Our reference keeps the segment alive, even if it
+  // slides out of the playlist window while we're still sending it.)
+  if (fLiveSegment != NULL) fLiveSegment->decrementReferenceCount();
+  fLiveSegment = segment;
+  fLiveSegment->incrementReferenceCount();
+  sendMemoryBuffer(segment->data(), segment->size(), False);
+}
+
+void RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStreaming
+::sendMemoryBuffer(u_int8_t* buffer, unsigned bufferSize, Boolean deleteBufferOnClose) {
   if (fPlaylistSource != NULL) { // sanity check
     if (fTCPSink != NULL) fTCPSink->stopPlaying();
     Medium::close(fPlaylistSource);
   }
-  fPlaylistSource = ByteStreamMemoryBufferSource::createNew(envir(), (u_int8_t*)playlist, playlistLen);
+  fPlaylistSource = ByteStreamMemoryBufferSource::createNew(envir(), buffer, bufferSize, deleteBufferOnClose);
   if (fTCPSink == NULL) fTCPSink = TCPStreamSink::createNew(envir(), fClientOutputSocket);
   fTCPSink->startPlaying(*fPlaylistSource, afterStreaming, this);
 }
 
+void RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStreaming
+::handleHTTPCmd_FileSegmentGET(char const* fileName, u_int64_t startByte, u_int64_t numBytes,
+			       char const* streamName, char const* fullRequestStr) {
+  unsigned segmentSize = (unsigned)numBytes;
+
+  // Check whether the client asked for only part of the segment:
+  unsigned firstByte = 0, lastByte = segmentSize - 1;
+  int rangeResult = parseRangeHeader(fullRequestStr, segmentSize, firstByte, lastByte);
+  if (rangeResult < 0) {
+    snprintf((char*)fResponseBuffer, sizeof fResponseBuffer,
+	     "HTTP/1.1 416 Requested Range Not Satisfiable\r\n"
+	     "%s"
+	     "Server: LIVE555 Streaming Media v%s\r\n"
+	     "%s"
+	     "Content-Range: bytes */%u\r\n"
+	     "Content-Length: 0\r\n"
+	     "\r\n",
+	     dateHeader(),
+	     LIVEMEDIA_LIBRARY_VERSION_STRING,
+	     connectionHeader(),
+	     segmentSize);
+    return;
+  }
+
+  closeFile(); // sanity check
+  fFileFid = OpenInputFile(envir(), fileName);
+  if (fFileFid == NULL) {
+    handleHTTPCmd_notFound();
+    return;
+  }
+
+  // Construct our response:
+  char contentRangeHeader[100];
+  if (rangeResult > 0) {
+    sprintf(contentRangeHeader, "Content-Range: bytes %u-%u/%u\r\n", firstByte, lastByte, segmentSize);
+  } else {
+    contentRangeHeader[0] = '\0';
+  }
+  snprintf((char*)fResponseBuffer, sizeof fResponseBuffer,
+	   "HTTP/1.1 %s\r\n"
+	   "%s"
+	   "Server: LIVE555 Streaming Media v%s\r\n"
+	   "%s"
+	   "%s"
+	   "Accept-Ranges: bytes\r\n"
+	   "%s"
+	   "Content-Length: %u\r\n"
+	   "Content-Type: video/MP2T\r\n"
+	   "\r\n",
+	   rangeResult > 0 ? "206 Partial Content" : "200 OK",
+	   dateHeader(),
+	   LIVEMEDIA_LIBRARY_VERSION_STRING,
+	   lastModifiedHeader(streamName),
+	   connectionHeader(),
+	   contentRangeHeader,
+	   lastByte - firstByte + 1);
+  send(fClientOutputSocket, (char const*)fResponseBuffer, strlen((char*)fResponseBuffer), 0);
+  fResponseBuffer[0] = '\0'; // We've already sent the response.  This tells the calling code not to send it again.
+
+  // Then send the data, directly from the file:
+  ignoreSigPipeOnSocket(fClientOutputSocket);
+  fFileBytePosition = startByte + firstByte;
+  fFileBytesLeft = lastByte - firstByte + 1;
+  sendFileData();
+}
+
+#define FILE_SEND_CHUNK_SIZE (256*1024)
+
+void RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStreaming::sendFileData() {
+  // Send (at most) one chunk of the remaining data now.  If there's more, we send the next chunk once our socket is
+  // writable again.  (Sending large ranges one chunk at a time like this lets us service other clients in the meantime.)
+  Boolean sendFailed = False;
+  if (fFileBytesLeft > 0) {
+    unsigned numBytesToSend = fFileBytesLeft < FILE_SEND_CHUNK_SIZE ? (unsigned)fFileBytesLeft : FILE_SEND_CHUNK_SIZE;
+    int numBytesSent;
+#ifdef USE_SENDFILE
+    // Have the kernel copy the data from the file to the socket, without it passing through our address space:
+    off_t offset = (off_t)fFileBytePosition;
+    numBytesSent = (int)sendfile(fClientOutputSocket, fileno(fFileFid), &offset, numBytesToSend);
+#else
+    static u_int8_t buffer[FILE_SEND_CHUNK_SIZE];
+    numBytesSent = 0; // means: the file has ended prematurely
+    if (SeekFile64(fFileFid, (int64_t)fFileBytePosition, SEEK_SET) >= 0) {
+      size_t numBytesRead = fread(buffer, 1, numBytesToSend, fFileFid);
+      if (numBytesRead > 0) numBytesSent = send(fClientOutputSocket, (char const*)buffer, numBytesRead, 0);
+    }
+#endif
+    if (numBytesSent > 0) {
+      fFileBytePosition += numBytesSent;
+      fFileBytesLeft -= numBytesSent;
+    } else if (numBytesSent == 0 || envir().getErrno() != EAGAIN) {
+      sendFailed = True;
+    }
+
+    if (fFileBytesLeft > 0 && !sendFailed) {
+      envir().taskScheduler().setBackgroundHandling(fClientOutputSocket, SOCKET_WRITABLE, fileSocketWritableHandler, this);
+      return;
+    }
+  }
+
+  // We're done (or we failed):
+  closeFile();
+  afterResponse(!sendFailed);
+}
+
+void RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStreaming
+::fileSocketWritableHandler(void* clientData, int /*mask*/) {
+  RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStreaming* clientConnection
+    = (RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStreaming*)clientData;
+  clientConnection->sendFileData();
+}
+
+void RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStreaming::closeFile() {
+  if (fFileFid != NULL) {
+    CloseInputFile(fFileFid);
+    fFileFid = NULL;
+  }
+  fFileBytesLeft = 0;
+}
+
+char const* RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStreaming::connectionHeader() const {
+  return fKeepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+}
+
 void RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStreaming::afterStreaming(void* clientData) {
-   RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStreaming* clientConnection
+  RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStreaming* clientConnection
     = (RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStreaming*)clientData;
-   // Arrange to delete the 'client connection' object:
-   if (clientConnection->fRecursionCount > 0) {
-     // We're still in the midst of handling a request
-     clientConnection->fIsActive = False; // will cause the object to get deleted at the end of handling the request
-   } else {
-     // We're no longer handling a request; delete the object now:
-     delete clientConnection;
-   }
+  clientConnection->afterResponse(True);
+}
+
+void RTSPServerSupportingHTTPStreaming::RTSPClientConnectionSupportingHTTPStreaming::afterResponse(Boolean connectionIsUsable) {
+  if (connectionIsUsable && fKeepAlive && fIsActive) {
+    // Take back control of our socket (from whatever was sending the response), to handle the client's next request:
+    envir().taskScheduler().setBackgroundHandling(fClientInputSocket, SOCKET_READABLE|SOCKET_EXCEPTION,
+						  (TaskScheduler::BackgroundHandlerProc*)&incomingRequestHandler, this);
+    return;
+  }
+
+  // Arrange to delete the 'client connection' object:
+  if (fRecursionCount > 0) {
+    // We're still in the midst of handling a request
+    fIsActive = False; // will cause the object to get deleted at the end of handling the request
+  } else {
+    // We're no longer handling a request; delete the object now:
+    delete this;
+  }
 }
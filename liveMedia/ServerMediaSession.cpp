@@ -311,6 +311,25 @@ char* ServerMediaSession::generateSDPDescription() {
   return sdp;
 }
 
+Boolean ServerMediaSession
+::prepareSDPDescription(sdpDescriptionReadyFunc* readyFunc, void* readyClientData) {
+  // Prepare all subsessions (not just the first one that's not yet ready), so that any that need to read data do so in parallel:
+  Boolean allAreReady = True;
+  for (ServerMediaSubsession* subsession = fSubsessionsHead; subsession != NULL;
+       subsession = subsession->fNext) {
+    if (!subsession->prepareSDPLines(readyFunc, readyClientData)) allAreReady = False;
+  }
+
+  return allAreReady;
+}
+
+void ServerMediaSession::cancelPrepareSDPDescription(void* readyClientData) {
+  for (ServerMediaSubsession* subsession = fSubsessionsHead; subsession != NULL;
+       subsession = subsession->fNext) {
+    subsession->cancelPrepareSDPLines(readyClientData);
+  }
+}
+
 
 ////////// ServerMediaSessionIterator //////////
 
@@ -360,6 +379,19 @@ char const* ServerMediaSubsession::trackId() {
   return fTrackId;
 }
 
+Boolean ServerMediaSubsession::prepareSDPLines(sdpLinesReadyFunc* /*readyFunc*/, void* /*readyClientData*/) {
+  // default implementation: "sdpLines()" is always ready
+  return True;
+}
+
+void ServerMediaSubsession::cancelPrepareSDPLines(void* /*readyClientData*/) {
+  // default implementation: do nothing
+}
+
+void ServerMediaSubsession::setSDPLines(char const* /*sdpLines*/) {
+  // default implementation: do nothing
+}
+
 void ServerMediaSubsession::pauseStream(unsigned /*clientSessionId*/,
 					void* /*streamToken*/) {
   // default implementation: do nothing
@@ -412,6 +444,14 @@ void ServerMediaSubsession::getAbsoluteTimeRange(char*& absStartTime, char*& abs
   absStartTime = absEndTime = NULL;
 }
 
+Boolean ServerMediaSubsession::getFileByteRange(double /*seekNPT*/, double /*streamDuration*/,
+						char const*& fileName, u_int64_t& startByte, u_int64_t& numBytes) {
+  // default implementation: We don't know how our data is laid out in a file (if at all):
+  fileName = NULL;
+  startByte = numBytes = 0;
+  return False;
+}
+
 void ServerMediaSubsession::setServerAddressAndPortForSDP(netAddressBits addressBits,
 							  portNumBits portBits) {
   fServerAddressForSDP = addressBits;
@@ -161,6 +161,23 @@ void StreamParser::ensureValidBytes1(unsigned numBytesNeeded) {
   throw NO_MORE_BUFFERED_INPUT;
 }
 
+unsigned StreamParser::numAvailableBytes(unsigned maxNumBytes) {
+  if (maxNumBytes == 0) return 0;
+
+  if (fCurParserIndex >= fTotNumValidBytes) {
+    // We need to read more data.  If our bank is nearly full, then ask for enough data to make us start using the other bank
+    // now, so that the read can be a large one.  (Because our caller has saved the parser state at the current position,
+    // no data needs to be moved to the other bank.)
+    unsigned const minReadSize = BANK_SIZE/4;
+    Boolean const startNewBank
+      = fCurParserIndex + minReadSize > BANK_SIZE && fCurParserIndex - fSavedParserIndex + minReadSize <= BANK_SIZE;
+    ensureValidBytes1(startNewBank ? minReadSize : 1);
+  }
+
+  unsigned numBytes = fTotNumValidBytes - fCurParserIndex;
+  return numBytes < maxNumBytes ? numBytes : maxNumBytes;
+}
+
 void StreamParser::afterGettingBytes(void* clientData,
 				     unsigned numBytesRead,
 				     unsigned /*numTruncatedBytes*/,
@@ -93,6 +93,25 @@ protected: // we're a virtual base class
     fCurParserIndex += numBytes;
   }
 
+  // Versions of "getBytes()" and "skipBytes()" for (possibly large) runs of data that don't need to be parsed, such as the
+  // contents of a frame.  These get or skip only as many bytes (up to "maxNumBytes") as are already in our bank - reading
+  // more only if there are none - and return the number of bytes gotten or skipped.  The caller should save the parser
+  // state (at the new position) after each call, and call again until it's gotten or skipped all the bytes that it wants.
+  // (This avoids having to move large amounts of unparsed data from one bank to the other.)
+  unsigned getAvailableBytes(u_int8_t* to, unsigned maxNumBytes) {
+    unsigned numBytes = numAvailableBytes(maxNumBytes);
+    memmove(to, nextToParse(), numBytes);
+    fCurParserIndex += numBytes;
+    fRemainingUnparsedBits = 0;
+    return numBytes;
+  }
+  unsigned skipAvailableBytes(unsigned maxNumBytes) {
+    unsigned numBytes = numAvailableBytes(maxNumBytes);
+    fCurParserIndex += numBytes;
+    fRemainingUnparsedBits = 0;
+    return numBytes;
+  }
+
   void skipBits(unsigned numBits);
   unsigned getBits(unsigned numBits);
       // numBits <= 32; returns data into low-order bits of result
@@ -119,6 +138,8 @@ private:
   }
   void ensureValidBytes1(unsigned numBytesNeeded);
 
+  unsigned numAvailableBytes(unsigned maxNumBytes); // used to implement "getAvailableBytes()" and "skipAvailableBytes()"
+
   static void afterGettingBytes(void* clientData, unsigned numBytesRead,
 				unsigned numTruncatedBytes,
 				struct timeval presentationTime,
@@ -19,173 +19,162 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 // Implementation.
 
 #include "StreamReplicator.hh"
+#include "GOPCache.hh"
 
 ////////// Definition of "StreamReplica": The class that implements each stream replica //////////
 
 class StreamReplica: public FramedSource {
 protected:
   friend class StreamReplicator;
-  StreamReplica(StreamReplicator& ourReplicator); // called only by "StreamReplicator::createStreamReplica()"
+  StreamReplica(StreamReplicator& ourReplicator, StreamReplicator::LagPolicy lagPolicy);
+      // called only by "StreamReplicator::createStreamReplica()"
   virtual ~StreamReplica();
 
 private: // redefined virtual functions:
   virtual void doGetNextFrame();
   virtual void doStopGettingFrames();
 
-private:
-  static void copyReceivedFrame(StreamReplica* toReplica, StreamReplica* fromReplica);
-
 private:
   StreamReplicator& fOurReplicator;
-  int fFrameIndex; // 0 or 1, depending upon which frame we're currently requesting; could also be -1 if we've stopped playing
-  Boolean fDeliveryInProgress;
+  StreamReplicator::LagPolicy fLagPolicy;
+  Boolean fIsActive; // i.e., we're reading from the replicator's queue
+  unsigned fNextFrameNum; // the number of the next queued frame that we'll read
+  Boolean fIsAwaitingKeyFrame; // if True, we skip queued frames until one that begins a GOP
+
+  // State used while delivering frames from our replicator's GOP cache, before we start reading its queue:
+  Boolean fIsReceivingCachedFrames;
+  unsigned fNextCachedFrame, fCacheGeneration;
 
   // Replicas that are currently awaiting data are kept in a (singly-linked) list:
   StreamReplica* fNext;
+  // Each replicator also keeps a (singly-linked) list of all of its replicas:
+  StreamReplica* fNextReplica;
 };
 
 
 ////////// StreamReplicator implementation //////////
 
-StreamReplicator* StreamReplicator::createNew(UsageEnvironment& env, FramedSource* inputSource, Boolean deleteWhenLastReplicaDies) {
-  return new StreamReplicator(env, inputSource, deleteWhenLastReplicaDies);
+StreamReplicator* StreamReplicator::createNew(UsageEnvironment& env, FramedSource* inputSource, Boolean deleteWhenLastReplicaDies,
+					      unsigned maxQueuedFrames) {
+  return new StreamReplicator(env, inputSource, deleteWhenLastReplicaDies, maxQueuedFrames);
+}
+
+static unsigned roundUpToPowerOf2(unsigned n) {
+  unsigned result = 1;
+  while (result < n && result < 0x80000000) result <<= 1;
+  return result;
 }
 
-StreamReplicator::StreamReplicator(UsageEnvironment& env, FramedSource* inputSource, Boolean deleteWhenLastReplicaDies)
+StreamReplicator::StreamReplicator(UsageEnvironment& env, FramedSource* inputSource, Boolean deleteWhenLastReplicaDies,
+				   unsigned maxQueuedFrames)
   : Medium(env),
     fInputSource(inputSource), fDeleteWhenLastReplicaDies(deleteWhenLastReplicaDies), fInputSourceHasClosed(False),
-    fNumReplicas(0), fNumActiveReplicas(0), fNumDeliveriesMadeSoFar(0),
-    fFrameIndex(0), fMasterReplica(NULL), fReplicasAwaitingCurrentFrame(NULL), fReplicasAwaitingNextFrame(NULL) {
+    fNumReplicas(0), fNumActiveReplicas(0), fReplicas(NULL),
+    fMaxQueuedFrames(roundUpToPowerOf2(maxQueuedFrames)), fQueueHead(0), fQueueTail(0), fMaxFrameSize(0),
+    fReplicasAwaitingNextFrame(NULL), fReplicasBeingDelivered(NULL), fIsDeliveringNewFrame(False),
+    fGOPCache(NULL) {
+  fQueue = new QueuedFrame[fMaxQueuedFrames];
+  for (unsigned i = 0; i < fMaxQueuedFrames; ++i) {
+    fQueue[i].buffer = NULL;
+    fQueue[i].bufferSize = 0;
+  }
 }
 
 StreamReplicator::~StreamReplicator() {
+  for (unsigned i = 0; i < fMaxQueuedFrames; ++i) delete[] fQueue[i].buffer;
+  delete[] fQueue;
+  delete fGOPCache;
   Medium::close(fInputSource);
 }
 
-FramedSource* StreamReplicator::createStreamReplica() {
+FramedSource* StreamReplicator::createStreamReplica(LagPolicy lagPolicy) {
   ++fNumReplicas;
-  return new StreamReplica(*this);
+  StreamReplica* replica = new StreamReplica(*this, lagPolicy);
+  replica->fNextReplica = fReplicas;
+  fReplicas = replica;
+  return replica;
+}
+
+Boolean StreamReplicator::useGOPCache(char const* codecName, unsigned maxCacheSize) {
+  GOPCache* gopCache = GOPCache::createNew(codecName, maxCacheSize);
+  if (gopCache == NULL) return False;
+
+  delete fGOPCache; fGOPCache = gopCache;
+  return True;
 }
 
 void StreamReplicator::getNextFrame(StreamReplica* replica) {
-  if (fInputSourceHasClosed) { // handle closure instead
-    replica->handleClosure();
-    return;
-  }
+  if (!replica->fIsActive) {
+    if (fInputSourceHasClosed) { // handle closure instead
+      replica->handleClosure();
+      return;
+    }
 
-  if (replica->fFrameIndex == -1) {
-    // This replica had stopped playing (or had just been created), but is now actively reading.  Note this:
-    replica->fFrameIndex = fFrameIndex;
+    // This replica had stopped playing (or had just been created).  If we have a GOP cache, first deliver the cached frames
+    // to it (without counting it as 'active', so that it doesn't hold up the queue for the other replicas):
+    if (fGOPCache != NULL && deliverCachedFrame(replica)) return;
+
+    // The replica is now actively reading, beginning with the next frame that we'll read from our input source:
+    replica->fIsActive = True;
+    replica->fNextFrameNum = fQueueTail;
+    replica->fIsAwaitingKeyFrame = False;
     ++fNumActiveReplicas;
   }
+  if (replica->fMaxSize > fMaxFrameSize) fMaxFrameSize = replica->fMaxSize;
 
-  if (fMasterReplica == NULL) {
-    // This is the first replica to request the next unread frame.  Make it the 'master' replica - meaning that we read the frame
-    // into its buffer, and then copy from this into the other replicas' buffers.
-    fMasterReplica = replica;
-
-    // Arrange to read the next frame into this replica's buffer:
-    if (fInputSource != NULL) fInputSource->getNextFrame(fMasterReplica->fTo, fMasterReplica->fMaxSize,
-							 afterGettingFrame, this, onSourceClosure, this);
-  } else if (replica->fFrameIndex != fFrameIndex) {
-    // This replica is already asking for the next frame (because it has already received the current frame).  Enqueue it:
+  if (replica->fNextFrameNum != fQueueTail) {
+    // There's at least one queued frame that this replica has yet to read.  Deliver it - but to avoid possible (deep)
+    // recursion, do this via the event loop:
+    replica->nextTask() = envir().taskScheduler().scheduleDelayedTask(0, deliverQueuedFrame, replica);
+  } else if (fInputSourceHasClosed) {
+    replica->handleClosure();
+  } else {
+    // This replica wants the next frame that we'll read:
     replica->fNext = fReplicasAwaitingNextFrame;
     fReplicasAwaitingNextFrame = replica;
-  } else {
-    // This replica is asking for the current frame.  Enqueue it:
-    replica->fNext = fReplicasAwaitingCurrentFrame;
-    fReplicasAwaitingCurrentFrame = replica;
+    readNextFrameIfNeeded();
+  }
+}
 
-    if (fInputSource != NULL && !fInputSource->isCurrentlyAwaitingData()) {
-      // The current frame has already arrived, so deliver it to this replica now:
-      deliverReceivedFrame();
+static Boolean removeFromList(StreamReplica*& list, StreamReplica* replica, StreamReplica* StreamReplica::* nextField) {
+  for (StreamReplica** rPtr = &list; *rPtr != NULL; rPtr = &((*rPtr)->*nextField)) {
+    if (*rPtr == replica) {
+      *rPtr = replica->*nextField;
+      replica->*nextField = NULL;
+      return True;
     }
   }
+  return False;
 }
 
 void StreamReplicator::deactivateStreamReplica(StreamReplica* replicaBeingDeactivated) {
   // Assert: fNumActiveReplicas > 0
-  if (fNumReplicas == 0) fprintf(stderr, "StreamReplicator::deactivateStreamReplica() Internal Error!\n"); // should not happen
+  if (fNumActiveReplicas == 0) fprintf(stderr, "StreamReplicator::deactivateStreamReplica() Internal Error!\n"); // should not happen
   --fNumActiveReplicas;
+  replicaBeingDeactivated->fIsActive = False;
 
-  if (replicaBeingDeactivated->fDeliveryInProgress) --fNumDeliveriesMadeSoFar;
-    // hack in case we're called while in the middle of a frame delivery to us
-
-  // Check whether the replica being deactivated is the 'master' replica, or is enqueued awaiting a frame:
-  if (replicaBeingDeactivated == fMasterReplica) {
-    // We need to replace the 'master replica', if we can:
-    if (fReplicasAwaitingCurrentFrame == NULL) {
-      // There's currently no replacement 'master replica'
-      fMasterReplica = NULL;
-    } else {
-      // There's another replica that we can use as a replacement 'master replica':
-      fMasterReplica = fReplicasAwaitingCurrentFrame;
-      fReplicasAwaitingCurrentFrame = fReplicasAwaitingCurrentFrame->fNext;
-      fMasterReplica->fNext = NULL;
-    }
+  // Make sure that the replica isn't on either of our 'awaiting data' lists:
+  if (!removeFromList(fReplicasAwaitingNextFrame, replicaBeingDeactivated, &StreamReplica::fNext)) {
+    removeFromList(fReplicasBeingDelivered, replicaBeingDeactivated, &StreamReplica::fNext);
+  }
 
-    // Check whether the read into the old master replica's buffer is still pending, or has completed:
-    if (fInputSource != NULL) {
-      if (fInputSource->isCurrentlyAwaitingData()) {
-	// We have a pending read into the old master replica's buffer.
-	// We need to stop it, and retry the read with a new master (if available)
-	fInputSource->stopGettingFrames();
-
-	if (fMasterReplica != NULL) {
-	  fInputSource->getNextFrame(fMasterReplica->fTo, fMasterReplica->fMaxSize,
-				     afterGettingFrame, this, onSourceClosure, this);
-	}
-      } else {
-	// The read into the old master replica's buffer has already completed.  Copy the data to the new master replica (if any):
-	if (fMasterReplica != NULL) {
-	  StreamReplica::copyReceivedFrame(fMasterReplica, replicaBeingDeactivated);
-	} else {
-	  // We don't have a new master replica, so we can't copy the received frame to any new replica that might ask for it.
-	  // Fortunately this should be a very rare occurrence.
-	}
-      }
-    }
+  // Release the queued frames that the replica had yet to read:
+  while (replicaBeingDeactivated->fNextFrameNum != fQueueTail) releaseQueuedFrame(replicaBeingDeactivated->fNextFrameNum++);
+
+  if (fNumActiveReplicas == 0) {
+    if (fInputSource != NULL) fInputSource->stopGettingFrames(); // tell our source to stop too
+    if (fGOPCache != NULL) fGOPCache->reset(); // because the input stream will have a gap in it
   } else {
-    // The replica that's being removed was not our 'master replica', but make sure it's not on either of our queues:
-    if (fReplicasAwaitingCurrentFrame != NULL) {
-      if (replicaBeingDeactivated == fReplicasAwaitingCurrentFrame) {
-	fReplicasAwaitingCurrentFrame = replicaBeingDeactivated->fNext;
-	replicaBeingDeactivated->fNext = NULL;
-      }
-      else {
-	for (StreamReplica* r1 = fReplicasAwaitingCurrentFrame; r1->fNext != NULL; r1 = r1->fNext) {
-	  if (r1->fNext == replicaBeingDeactivated) {
-	    r1->fNext = replicaBeingDeactivated->fNext;
-	    replicaBeingDeactivated->fNext = NULL;
-	    break;
-	  }
-	}
-      }
-    }
-    if (fReplicasAwaitingNextFrame != NULL) {
-      if (replicaBeingDeactivated == fReplicasAwaitingNextFrame) {
-	fReplicasAwaitingNextFrame = replicaBeingDeactivated->fNext;
-	replicaBeingDeactivated->fNext = NULL;
-      }
-      else {
-	for (StreamReplica* r2 = fReplicasAwaitingNextFrame; r2->fNext != NULL; r2 = r2->fNext) {
-	  if (r2->fNext == replicaBeingDeactivated) {
-	    r2->fNext = replicaBeingDeactivated->fNext;
-	    replicaBeingDeactivated->fNext = NULL;
-	    break;
-	  }
-	}
-      }
-    }
+    // The replica that we've just deactivated might have been stalling our input, so check whether we can read more now:
+    readNextFrameIfNeeded();
   }
-
-  if (fNumActiveReplicas == 0 && fInputSource != NULL) fInputSource->stopGettingFrames(); // tell our source to stop too
 }
 
 void StreamReplicator::removeStreamReplica(StreamReplica* replicaBeingRemoved) {
   // Assert: fNumReplicas > 0
   if (fNumReplicas == 0) fprintf(stderr, "StreamReplicator::removeStreamReplica() Internal Error!\n"); // should not happen
   --fNumReplicas;
+  removeFromList(fReplicas, replicaBeingRemoved, &StreamReplica::fNextReplica);
 
   // If this was the last replica, then delete ourselves (if we were set up to do so):
   if (fNumReplicas == 0 && fDeleteWhenLastReplicaDies) {
@@ -194,11 +183,69 @@ void StreamReplicator::removeStreamReplica(StreamReplica* replicaBeingRemoved) {
   }
 
   // Now handle the replica that's being removed the same way that we would if it were merely being deactivated:
-  if (replicaBeingRemoved->fFrameIndex != -1) { // i.e., we haven't already done this
+  if (replicaBeingRemoved->fIsActive) { // i.e., we haven't already done this
     deactivateStreamReplica(replicaBeingRemoved);
   }
 }
 
+void StreamReplicator::readNextFrameIfNeeded() {
+  if (fInputSource == NULL || fInputSourceHasClosed || fInputSource->isCurrentlyAwaitingData()) return; // nothing to do
+  if (fIsDeliveringNewFrame) return; // we'll get called again, once we're done
+  if (fReplicasAwaitingNextFrame == NULL) return; // no one wants a new frame yet
+  if (fQueueTail - fQueueHead == fMaxQueuedFrames && !makeRoomInQueue()) return; // we'll try again once a lagging replica reads
+
+  // Read the next frame into the next slot in our queue, making sure that its buffer is large enough:
+  QueuedFrame& frame = queuedFrame(fQueueTail);
+  if (frame.bufferSize < fMaxFrameSize) {
+    delete[] frame.buffer;
+    frame.buffer = new unsigned char[fMaxFrameSize];
+    frame.bufferSize = fMaxFrameSize;
+  }
+
+  fInputSource->getNextFrame(frame.buffer, frame.bufferSize, afterGettingFrame, this, onSourceClosure, this);
+}
+
+Boolean StreamReplicator::makeRoomInQueue() {
+  // Our queue is full, because at least one replica has yet to read the oldest queued frame.  Apply each such replica's
+  // 'lag policy'.  Return True iff this frees the oldest queued frame:
+  unsigned const oldestFrameNum = fQueueHead; // note: skipping replicas might change "fQueueHead"
+  for (StreamReplica* replica = fReplicas; replica != NULL; replica = replica->fNextReplica) {
+    if (replica->fIsActive && replica->fNextFrameNum == oldestFrameNum && replica->fLagPolicy != LAG_STALLS_INPUT) {
+      skipLaggingReplica(replica);
+    }
+  }
+
+  return fQueueTail - fQueueHead < fMaxQueuedFrames;
+}
+
+void StreamReplicator::skipLaggingReplica(StreamReplica* replica) {
+  if (replica->fLagPolicy == LAG_SKIPS_TO_KEY_FRAME && fGOPCache != NULL) {
+    // Skip ahead to the most recent queued frame that begins a GOP - or, if there's none, past every queued frame:
+    unsigned newNextFrameNum = fQueueTail;
+    for (unsigned n = fQueueTail; n != replica->fNextFrameNum + 1; --n) {
+      if (queuedFrame(n-1).beginsGOP) {
+	newNextFrameNum = n-1;
+	break;
+      }
+    }
+    if (newNextFrameNum == replica->fNextFrameNum) ++newNextFrameNum; // we must skip at least one frame
+    replica->fIsAwaitingKeyFrame = True; // until we get to a frame that begins a GOP
+
+    while (replica->fNextFrameNum != newNextFrameNum) releaseQueuedFrame(replica->fNextFrameNum++);
+  } else {
+    // Drop just the oldest queued frame:
+    releaseQueuedFrame(replica->fNextFrameNum++);
+  }
+}
+
+void StreamReplicator::releaseQueuedFrame(unsigned frameNum) {
+  QueuedFrame& frame = queuedFrame(frameNum);
+  if (frame.refCount > 0) --frame.refCount;
+
+  // Remove, from the head of our queue, any frames that no longer have any readers:
+  while (fQueueHead != fQueueTail && queuedFrame(fQueueHead).refCount == 0) ++fQueueHead;
+}
+
 void StreamReplicator::afterGettingFrame(void* clientData, unsigned frameSize, unsigned numTruncatedBytes,
 					 struct timeval presentationTime, unsigned durationInMicroseconds) {
   ((StreamReplicator*)clientData)->afterGettingFrame(frameSize, numTruncatedBytes, presentationTime, durationInMicroseconds);
@@ -206,14 +253,33 @@ void StreamReplicator::afterGettingFrame(void* clientData, unsigned frameSize, u
 
 void StreamReplicator::afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes,
 					 struct timeval presentationTime, unsigned durationInMicroseconds) {
-  // The frame was read into our master replica's buffer.  Update the master replica's state, but don't complete delivery to it
-  // just yet.  We do that later, after we're sure that we've delivered it to all other replicas.
-  fMasterReplica->fFrameSize = frameSize;
-  fMasterReplica->fNumTruncatedBytes = numTruncatedBytes;
-  fMasterReplica->fPresentationTime = presentationTime;
-  fMasterReplica->fDurationInMicroseconds = durationInMicroseconds;
-
-  deliverReceivedFrame();
+  // The frame was read into the next slot in our queue.  Add it to the queue (for each currently active replica to read):
+  unsigned const frameNum = fQueueTail++;
+  QueuedFrame& frame = queuedFrame(frameNum);
+  frame.frameSize = frameSize;
+  frame.numTruncatedBytes = numTruncatedBytes;
+  frame.presentationTime = presentationTime;
+  frame.durationInMicroseconds = durationInMicroseconds;
+  frame.refCount = fNumActiveReplicas;
+  frame.beginsGOP = fGOPCache != NULL && fGOPCache->addFrame(frame.buffer, frameSize, presentationTime);
+
+  // Deliver the frame to each replica that's waiting for it.  (Any of these replicas might request - and then wait for -
+  // the next frame before we're done, so we first move them all to a separate list.)
+  fReplicasBeingDelivered = fReplicasAwaitingNextFrame;
+  fReplicasAwaitingNextFrame = NULL;
+  fIsDeliveringNewFrame = True; // so that we don't start reading another frame until we're done
+
+  StreamReplica* replica;
+  while ((replica = fReplicasBeingDelivered) != NULL) {
+    fReplicasBeingDelivered = replica->fNext;
+    replica->fNext = NULL;
+
+    deliverQueuedFrame(replica);
+  }
+  fIsDeliveringNewFrame = False;
+
+  // If any replica wants another frame already, then read it:
+  readNextFrameIfNeeded();
 }
 
 void StreamReplicator::onSourceClosure(void* clientData) {
@@ -223,86 +289,86 @@ void StreamReplicator::onSourceClosure(void* clientData) {
 void StreamReplicator::onSourceClosure() {
   fInputSourceHasClosed = True;
 
-  // Signal the closure to each replica that is currently awaiting a frame:
+  // Signal the closure to each replica that is currently awaiting a frame.  (Other replicas will be told of the closure
+  // once they've read their remaining queued frames.)
   StreamReplica* replica;
-  while ((replica = fReplicasAwaitingCurrentFrame) != NULL) {
-    fReplicasAwaitingCurrentFrame = replica->fNext;
-    replica->fNext = NULL;
-    replica->handleClosure();
-  }
   while ((replica = fReplicasAwaitingNextFrame) != NULL) {
     fReplicasAwaitingNextFrame = replica->fNext;
     replica->fNext = NULL;
     replica->handleClosure();
   }
-  if ((replica = fMasterReplica) != NULL) {
-    fMasterReplica = NULL;
-    replica->handleClosure();
-  }
 }
 
-void StreamReplicator::deliverReceivedFrame() {
-  // The 'master replica' has received its copy of the current frame.
-  // Copy it (and complete delivery) to any other replica that has requested this frame.
-  // Then, if no more requests for this frame are expected, complete delivery to the 'master replica' itself.
-  StreamReplica* replica;
-  while ((replica = fReplicasAwaitingCurrentFrame) != NULL) {
-    fReplicasAwaitingCurrentFrame = replica->fNext;
-    replica->fNext = NULL;
-    
-    replica->fDeliveryInProgress = True;
-
-    // Assert: fMasterReplica != NULL
-    if (fMasterReplica == NULL) fprintf(stderr, "StreamReplicator::deliverReceivedFrame() Internal Error 1!\n"); // shouldn't happen
-    StreamReplica::copyReceivedFrame(replica, fMasterReplica);
-    replica->fFrameIndex = 1 - replica->fFrameIndex; // toggle it (0<->1), because this replica no longer awaits the current frame
-    ++fNumDeliveriesMadeSoFar;
-
-    // Assert: fNumDeliveriesMadeSoFar < fNumActiveReplicas; // because we still have the 'master replica' to deliver to
-    if (!(fNumDeliveriesMadeSoFar < fNumActiveReplicas)) fprintf(stderr, "StreamReplicator::deliverReceivedFrame() Internal Error 2(%d,%d)!\n", fNumDeliveriesMadeSoFar, fNumActiveReplicas); // should not happen
+void StreamReplicator::deliverQueuedFrame(void* clientData) {
+  StreamReplica* replica = (StreamReplica*)clientData;
+  replica->nextTask() = NULL;
+  replica->fOurReplicator.deliverQueuedFrame(replica);
+}
 
-    // Complete delivery to this replica:
-    FramedSource::afterGetting(replica);
+void StreamReplicator::deliverQueuedFrame(StreamReplica* replica) {
+  // Deliver - to "replica" - the next queued frame that it has yet to read.  First, skip over any frames that it doesn't want:
+  while (replica->fIsAwaitingKeyFrame && replica->fNextFrameNum != fQueueTail
+	 && !queuedFrame(replica->fNextFrameNum).beginsGOP) {
+    releaseQueuedFrame(replica->fNextFrameNum++);
+  }
+  if (replica->fNextFrameNum == fQueueTail) {
+    // We skipped every queued frame, so wait for a new one:
+    getNextFrame(replica);
+    return;
+  }
+  replica->fIsAwaitingKeyFrame = False;
+
+  // Copy the frame into the replica's buffer.  (The replica might have a smaller buffer than the one we read into.)
+  unsigned const frameNum = replica->fNextFrameNum++;
+  QueuedFrame& frame = queuedFrame(frameNum);
+  unsigned numNewBytesToTruncate = replica->fMaxSize < frame.frameSize ? frame.frameSize - replica->fMaxSize : 0;
+  replica->fFrameSize = frame.frameSize - numNewBytesToTruncate;
+  replica->fNumTruncatedBytes = frame.numTruncatedBytes + numNewBytesToTruncate;
+  memmove(replica->fTo, frame.buffer, replica->fFrameSize);
+  replica->fPresentationTime = frame.presentationTime;
+  replica->fDurationInMicroseconds = frame.durationInMicroseconds;
+
+  releaseQueuedFrame(frameNum);
+  readNextFrameIfNeeded(); // in case we had been stalled (waiting for this replica to read the oldest queued frame)
+
+  // Complete delivery to the replica:
+  FramedSource::afterGetting(replica);
+}
 
-    replica->fDeliveryInProgress = False;
+Boolean StreamReplicator::deliverCachedFrame(StreamReplica* replica) {
+  // Returns True iff we delivered a cached frame to "replica".  (If we return False, then the replica has caught up with
+  // the live stream.)
+  if (!replica->fIsReceivingCachedFrames || replica->fCacheGeneration != fGOPCache->generation()) {
+    // We're starting a burst of cached frames - or a new GOP began in the middle of our burst, in which case we start again
+    // from its key frame:
+    replica->fIsReceivingCachedFrames = True;
+    replica->fNextCachedFrame = 0;
+    replica->fCacheGeneration = fGOPCache->generation();
   }
 
-  if (fNumDeliveriesMadeSoFar == fNumActiveReplicas - 1 && fMasterReplica != NULL) {
-    // No more requests for this frame are expected, so complete delivery to the 'master replica':
-    replica = fMasterReplica;
-    fMasterReplica = NULL;
-    replica->fFrameIndex = 1 - replica->fFrameIndex; // toggle it (0<->1), because this replica no longer awaits the current frame
-    fFrameIndex = 1 - fFrameIndex; // toggle it (0<->1) for the next frame
-    fNumDeliveriesMadeSoFar = 0; // reset for the next frame
-
-    if (fReplicasAwaitingNextFrame != NULL) {
-      // One of the other replicas has already requested the next frame, so make it the next 'master replica':
-      fMasterReplica = fReplicasAwaitingNextFrame;
-      fReplicasAwaitingNextFrame = fReplicasAwaitingNextFrame->fNext;
-      fMasterReplica->fNext = NULL;
-
-      // Arrange to read the next frame into this replica's buffer:
-      if (fInputSource != NULL) fInputSource->getNextFrame(fMasterReplica->fTo, fMasterReplica->fMaxSize,
-							   afterGettingFrame, this, onSourceClosure, this);
-    }      
-
-    // Move any other replicas that had already requested the next frame to the 'requesting current frame' list:
-    // Assert: fReplicasAwaitingCurrentFrame == NULL;
-    if (!(fReplicasAwaitingCurrentFrame == NULL)) fprintf(stderr, "StreamReplicator::deliverReceivedFrame() Internal Error 3!\n"); // should not happen
-    fReplicasAwaitingCurrentFrame = fReplicasAwaitingNextFrame;
-    fReplicasAwaitingNextFrame = NULL;
-    
-    FramedSource::afterGetting(replica);
+  if (replica->fNextCachedFrame >= fGOPCache->numFrames()) {
+    // There are no (more) cached frames to deliver:
+    replica->fIsReceivingCachedFrames = False;
+    return False;
   }
+
+  replica->fFrameSize = fGOPCache->getFrame(replica->fNextCachedFrame++, replica->fTo, replica->fMaxSize,
+					    replica->fNumTruncatedBytes, replica->fPresentationTime,
+					    replica->fDurationInMicroseconds);
+
+  // Complete delivery to the replica - but to avoid possible infinite recursion, do this via the event loop:
+  replica->nextTask() = envir().taskScheduler().scheduleDelayedTask(0, (TaskFunc*)FramedSource::afterGetting, replica);
+  return True;
 }
 
 
 ////////// StreamReplica implementation //////////
 
-StreamReplica::StreamReplica(StreamReplicator& ourReplicator)
+StreamReplica::StreamReplica(StreamReplicator& ourReplicator, StreamReplicator::LagPolicy lagPolicy)
   : FramedSource(ourReplicator.envir()),
-    fOurReplicator(ourReplicator),
-    fFrameIndex(-1/*we haven't started playing yet*/), fDeliveryInProgress(False), fNext(NULL) {
+    fOurReplicator(ourReplicator), fLagPolicy(lagPolicy),
+    fIsActive(False/*we haven't started playing yet*/), fNextFrameNum(0), fIsAwaitingKeyFrame(False),
+    fIsReceivingCachedFrames(False), fNextCachedFrame(0), fCacheGeneration(0), fNext(NULL), fNextReplica(NULL) {
 }
 
 StreamReplica::~StreamReplica() {
@@ -314,20 +380,11 @@ void StreamReplica::doGetNextFrame() {
 }
 
 void StreamReplica::doStopGettingFrames() {
-  if (fFrameIndex != -1) { // we had been activated
-    fFrameIndex = -1; // When we start reading again, this will tell the replicator that we were previously inactive.
-    fOurReplicator.deactivateStreamReplica(this);
-  }
-}
+  // Cancel any pending delivery of a queued (or cached) frame:
+  envir().taskScheduler().unscheduleDelayedTask(nextTask());
+  fIsReceivingCachedFrames = False;
 
-void StreamReplica::copyReceivedFrame(StreamReplica* toReplica, StreamReplica* fromReplica) {
-  // First, figure out how much data to copy.  ("toReplica" might have a smaller buffer than "fromReplica".)
-  unsigned numNewBytesToTruncate
-    = toReplica->fMaxSize < fromReplica->fFrameSize ? fromReplica->fFrameSize - toReplica->fMaxSize : 0;
-  toReplica->fFrameSize = fromReplica->fFrameSize - numNewBytesToTruncate;
-  toReplica->fNumTruncatedBytes = fromReplica->fNumTruncatedBytes + numNewBytesToTruncate;
-
-  memmove(toReplica->fTo, fromReplica->fTo, toReplica->fFrameSize);
-  toReplica->fPresentationTime = fromReplica->fPresentationTime;
-  toReplica->fDurationInMicroseconds = fromReplica->fDurationInMicroseconds;
+  if (fIsActive) { // we had been activated
+    fOurReplicator.deactivateStreamReplica(this); // When we start reading again, we'll be reactivated.
+  }
 }
@@ -20,6 +20,34 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 
 #include "TCPStreamSink.hh"
 #include "RTSPCommon.hh" // for "ignoreSigPipeOnSocket()"
+#include "GroupsockHelper.hh" // for "gettimeofday()"
+#if !defined(__WIN32__) && !defined(_WIN32)
+#include <sys/uio.h> // for "writev()"
+#endif
+
+////////// TCPStreamSinkChunk //////////
+
+class TCPStreamSinkChunk {
+public:
+  TCPStreamSinkChunk() : fNext(NULL), fStart(0), fEnd(0) {}
+
+  unsigned numUnwrittenBytes() const { return fEnd - fStart; }
+  unsigned freeSpace() const { return TCP_STREAM_SINK_BUFFER_SIZE - fEnd; }
+
+  TCPStreamSinkChunk* fNext;
+  unsigned fStart, fEnd; // the unwritten data is fData[fStart..fEnd)
+  unsigned char fData[TCP_STREAM_SINK_BUFFER_SIZE];
+};
+
+static void deleteChunks(TCPStreamSinkChunk* chunk) {
+  while (chunk != NULL) {
+    TCPStreamSinkChunk* next = chunk->fNext;
+    delete chunk;
+    chunk = next;
+  }
+}
+
+////////// TCPStreamSink //////////
 
 TCPStreamSink* TCPStreamSink::createNew(UsageEnvironment& env, int socketNum) {
   return new TCPStreamSink(env, socketNum);
@@ -27,15 +55,30 @@ TCPStreamSink* TCPStreamSink::createNew(UsageEnvironment& env, int socketNum) {
 
 TCPStreamSink::TCPStreamSink(UsageEnvironment& env, int socketNum)
   : MediaSink(env),
-    fUnwrittenBytesStart(0), fUnwrittenBytesEnd(0),
+    fHeadChunk(NULL), fTailChunk(NULL), fSpareChunks(NULL),
+    fNumBufferedBytes(0), fReadAheadBudget(TCP_STREAM_SINK_DEFAULT_READ_AHEAD_BUDGET),
     fInputSourceIsOpen(False), fOutputSocketIsWritable(True),
-    fOutputSocketNum(socketNum) {
+    fOutputSocketNum(socketNum),
+    fNumBytesWritten(0), fMaxNumBufferedBytes(0), fNumWriteStalls(0) {
   ignoreSigPipeOnSocket(socketNum);
+  gettimeofday(&fCreationTime, NULL);
 }
 
 TCPStreamSink::~TCPStreamSink() {
   // Turn off any pending background handling of our output socket:
   envir().taskScheduler().disableBackgroundHandling(fOutputSocketNum);
+
+  discardBufferedData();
+}
+
+unsigned TCPStreamSink::averageThroughputKbps() const {
+  struct timeval timeNow;
+  gettimeofday(&timeNow, NULL);
+  int64_t uSecondsElapsed
+    = (int64_t)(timeNow.tv_sec - fCreationTime.tv_sec)*1000000 + (timeNow.tv_usec - fCreationTime.tv_usec);
+  if (uSecondsElapsed <= 0) return 0;
+
+  return (unsigned)((fNumBytesWritten*8000)/uSecondsElapsed);
 }
 
 Boolean TCPStreamSink::continuePlaying() {
@@ -45,39 +88,124 @@ Boolean TCPStreamSink::continuePlaying() {
   return True;
 }
 
+void TCPStreamSink::stopPlaying() {
+  MediaSink::stopPlaying();
+
+  // Any data that we haven't yet written came from the old source, so discard it:
+  fInputSourceIsOpen = False;
+  discardBufferedData();
+  if (!fOutputSocketIsWritable) {
+    envir().taskScheduler().disableBackgroundHandling(fOutputSocketNum);
+    fOutputSocketIsWritable = True;
+  }
+}
+
 #define TCP_STREAM_SINK_MIN_READ_SIZE 1000
 
 void TCPStreamSink::processBuffer() {
   // First, try writing data to our output socket, if we can:
-  if (fOutputSocketIsWritable && numUnwrittenBytes() > 0) {
-    int numBytesWritten
-      = send(fOutputSocketNum, (const char*)&fBuffer[fUnwrittenBytesStart], numUnwrittenBytes(), 0);
-    if (numBytesWritten < (int)numUnwrittenBytes()) {
-      // The output socket is no longer writable.  Set a handler to be called when it becomes writable again.
-      fOutputSocketIsWritable = False;
-      if (envir().getErrno() != EPIPE) { // on this error, the socket might still be writable, but no longer usable
-	envir().taskScheduler().setBackgroundHandling(fOutputSocketNum, SOCKET_WRITABLE, socketWritableHandler, this);
+  if (fOutputSocketIsWritable && fNumBufferedBytes > 0) writeBufferedData();
+
+  // Then, read from our input source, if we can (& we're not already reading from it).  We keep reading - even while
+  // the socket is unwritable - until we've buffered as much data as our 'read ahead budget' allows:
+  if (fInputSourceIsOpen && fNumBufferedBytes < fReadAheadBudget && !fSource->isCurrentlyAwaitingData()) {
+    if (fTailChunk == NULL || fTailChunk->freeSpace() < TCP_STREAM_SINK_MIN_READ_SIZE) {
+      // Add a new chunk to the end of our buffer:
+      TCPStreamSinkChunk* chunk;
+      if (fSpareChunks != NULL) {
+	chunk = fSpareChunks;
+	fSpareChunks = chunk->fNext;
+	chunk->fNext = NULL;
+	chunk->fStart = chunk->fEnd = 0;
+      } else {
+	chunk = new TCPStreamSinkChunk;
       }
+      if (fTailChunk == NULL) fHeadChunk = chunk; else fTailChunk->fNext = chunk;
+      fTailChunk = chunk;
+    }
+    fSource->getNextFrame(&fTailChunk->fData[fTailChunk->fEnd], fTailChunk->freeSpace(),
+			  afterGettingFrame, this, ourOnSourceClosure, this);
+  } else if (!fInputSourceIsOpen && fNumBufferedBytes == 0) {
+    // We're now done:
+    discardBufferedData(); // to free our (now empty) chunks
+    onSourceClosure();
+  }
+}
+
+#define TCP_STREAM_SINK_MAX_CHUNKS_PER_WRITE 16
+
+void TCPStreamSink::writeBufferedData() {
+  // Write as much of our buffered data as the socket will accept, gathering several chunks into each write (if we can):
+  while (fNumBufferedBytes > 0) {
+    unsigned numBytesToWrite = 0;
+    int numBytesWritten;
+#if defined(__WIN32__) || defined(_WIN32)
+    TCPStreamSinkChunk* chunk = fHeadChunk;
+    while (chunk->numUnwrittenBytes() == 0) chunk = chunk->fNext;
+    numBytesToWrite = chunk->numUnwrittenBytes();
+    numBytesWritten = send(fOutputSocketNum, (const char*)&chunk->fData[chunk->fStart], numBytesToWrite, 0);
+#else
+    struct iovec iov[TCP_STREAM_SINK_MAX_CHUNKS_PER_WRITE];
+    int numIovecs = 0;
+    for (TCPStreamSinkChunk* chunk = fHeadChunk; chunk != NULL && numIovecs < TCP_STREAM_SINK_MAX_CHUNKS_PER_WRITE;
+	 chunk = chunk->fNext) {
+      if (chunk->numUnwrittenBytes() == 0) continue;
+      iov[numIovecs].iov_base = &chunk->fData[chunk->fStart];
+      iov[numIovecs].iov_len = chunk->numUnwrittenBytes();
+      numBytesToWrite += chunk->numUnwrittenBytes();
+      ++numIovecs;
     }
+    numBytesWritten = writev(fOutputSocketNum, iov, numIovecs);
+#endif
+
     if (numBytesWritten > 0) {
-      // We wrote at least some of our data.  Update our buffer pointers:
-      fUnwrittenBytesStart += numBytesWritten;
-      if (fUnwrittenBytesStart > fUnwrittenBytesEnd) fUnwrittenBytesStart = fUnwrittenBytesEnd; // sanity check
-      if (fUnwrittenBytesStart == fUnwrittenBytesEnd && (!fInputSourceIsOpen || !fSource->isCurrentlyAwaitingData())) {
-	fUnwrittenBytesStart = fUnwrittenBytesEnd = 0; // reset the buffer to empty
+      // We wrote at least some of our data.  Update our buffer pointers, recycling any chunks that we've finished with:
+      fNumBytesWritten += numBytesWritten;
+      fNumBufferedBytes -= numBytesWritten;
+      unsigned numBytesToConsume = numBytesWritten;
+      while (fHeadChunk != NULL) {
+	unsigned numChunkBytesConsumed = fHeadChunk->numUnwrittenBytes();
+	if (numChunkBytesConsumed > numBytesToConsume) numChunkBytesConsumed = numBytesToConsume;
+	fHeadChunk->fStart += numChunkBytesConsumed;
+	numBytesToConsume -= numChunkBytesConsumed;
+	if (fHeadChunk->numUnwrittenBytes() > 0) break;
+
+	if (fHeadChunk == fTailChunk) {
+	  // Don't recycle the chunk that we're currently reading into; but reset it if we're not reading into it now:
+	  if (!fInputSourceIsOpen || !fSource->isCurrentlyAwaitingData()) fHeadChunk->fStart = fHeadChunk->fEnd = 0;
+	  break;
+	}
+	TCPStreamSinkChunk* chunk = fHeadChunk;
+	fHeadChunk = chunk->fNext;
+	chunk->fNext = fSpareChunks;
+	fSpareChunks = chunk;
       }
     }
-  }
 
-  // Then, read from our input source, if we can (& we're not already reading from it):
-  if (fInputSourceIsOpen && freeBufferSpace() >= TCP_STREAM_SINK_MIN_READ_SIZE && !fSource->isCurrentlyAwaitingData()) {
-    fSource->getNextFrame(&fBuffer[fUnwrittenBytesEnd], freeBufferSpace(), afterGettingFrame, this, ourOnSourceClosure, this);
-  } else if (!fInputSourceIsOpen && numUnwrittenBytes() == 0) {
-    // We're now done:
-    onSourceClosure();
+    if (numBytesWritten < 0 && envir().getErrno() != EAGAIN) {
+      // The socket is no longer usable (e.g., because the client has gone away).  Stop reading from our source,
+      // and discard our buffered data.  (Our caller will find out about the failure when it next uses the socket.)
+      if (fInputSourceIsOpen) fSource->stopGettingFrames();
+      fInputSourceIsOpen = False;
+      discardBufferedData();
+      return;
+    }
+    if (numBytesWritten < (int)numBytesToWrite) {
+      // The output socket is no longer writable.  Set a handler to be called when it becomes writable again.
+      fOutputSocketIsWritable = False;
+      ++fNumWriteStalls;
+      envir().taskScheduler().setBackgroundHandling(fOutputSocketNum, SOCKET_WRITABLE, socketWritableHandler, this);
+      return;
+    }
   }
 }
 
+void TCPStreamSink::discardBufferedData() {
+  deleteChunks(fHeadChunk); fHeadChunk = fTailChunk = NULL;
+  deleteChunks(fSpareChunks); fSpareChunks = NULL;
+  fNumBufferedBytes = 0;
+}
+
 void TCPStreamSink::socketWritableHandler(void* clientData, int /*mask*/) {
   TCPStreamSink* sink = (TCPStreamSink*)clientData;
   sink->socketWritableHandler1();
@@ -102,7 +230,9 @@ void TCPStreamSink::afterGettingFrame(unsigned frameSize, unsigned numTruncatedB
 	    << numTruncatedBytes
 	    << " bytes of trailing data was dropped!  Correct this by increasing the definition of \"TCP_STREAM_SINK_BUFFER_SIZE\" in \"include/TCPStreamSink.hh\".\n";
   }
-  fUnwrittenBytesEnd += frameSize;
+  fTailChunk->fEnd += frameSize;
+  fNumBufferedBytes += frameSize;
+  if (fNumBufferedBytes > fMaxNumBufferedBytes) fMaxNumBufferedBytes = fNumBufferedBytes;
   processBuffer();
 }
 
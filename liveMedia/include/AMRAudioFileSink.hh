@@ -43,6 +43,7 @@ protected: // redefined virtual functions:
   virtual void afterGettingFrame(unsigned frameSize,
 				 unsigned numTruncatedBytes,
 				 struct timeval presentationTime);
+  virtual void segmentHasBegun();
 
 protected:
   Boolean fHaveWrittenHeader;
@@ -24,6 +24,9 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #ifndef _MEDIA_SESSION_HH
 #include "MediaSession.hh"
 #endif
+#ifndef _BUFFERED_FILE_WRITER_HH
+#include "BufferedFileWriter.hh"
+#endif
 
 class AVIFileSink: public Medium {
 public:
@@ -76,6 +79,7 @@ private:
   unsigned fNumBytesWritten;
   struct timeval fStartTime;
   Boolean fHaveCompletedOutputFile;
+  BufferedFileWriter* fWriter;
 
 private:
   ///// Definitions specific to the AVI file format:
@@ -83,7 +87,7 @@ private:
   unsigned addWord(unsigned word); // outputs "word" in little-endian order
   unsigned addHalfWord(unsigned short halfWord);
   unsigned addByte(unsigned char byte) {
-    putc(byte, fOutFid);
+    fWriter->writeByte(byte);
     return 1;
   }
   unsigned addZeroWords(unsigned numWords);
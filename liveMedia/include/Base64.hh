@@ -36,6 +36,13 @@ unsigned char* base64Decode(char const* in, unsigned inSize,
     // As above, but includes the size of the input string (i.e., the number of bytes to decode) as a parameter.
     // This saves an extra call to "strlen()" if we already know the length of the input string.
 
+unsigned base64DecodeInPlace(unsigned char* data, unsigned dataSize, unsigned& numUndecodedChars);
+    // Decodes "data" in place - i.e., the decoded bytes (whose number is returned) replace the start of "data" - skipping
+    // any whitespace.  A group of 4 chars that ends with "=" or "==" is decoded to just 2 or 1 bytes.
+    // If the (non-whitespace) chars don't make up whole groups of 4, then the last "numUndecodedChars" (1-3) of them
+    // are left - still undecoded - immediately after the decoded bytes.  (This lets Base64 data that arrives in pieces
+    // be decoded as it arrives.)
+
 char* base64Encode(char const* orig, unsigned origLength);
     // returns a 0-terminated string that
     // the caller is responsible for delete[]ing.
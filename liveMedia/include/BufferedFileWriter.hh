@@ -0,0 +1,110 @@
+/**********
+This library is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the
+Free Software Foundation; either version 2.1 of the License, or (at your
+option) any later version. (See <http://www.gnu.org/copyleft/lesser.html>.)
+
+This library is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this library; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+**********/
+// "liveMedia"
+// Copyright (c) 1996-2014 Live Networks, Inc.  All rights reserved.
+// A 'write-behind' buffer for output files, used by our file sinks.  Data is collected into large blocks, which are
+// then written from the event loop - one block at a time - rather than with a (small) write for each frame.
+// Changes to data that was written earlier (e.g., to fill in header fields) can be made in memory, or deferred until
+// the end.
+// C++ header
+
+#ifndef _BUFFERED_FILE_WRITER_HH
+#define _BUFFERED_FILE_WRITER_HH
+
+#include <UsageEnvironment.hh>
+#include <stdio.h>
+
+class BufferedFileWriter {
+public:
+  BufferedFileWriter(UsageEnvironment& env, FILE* fid,
+		     unsigned blockSize = 256*1024,
+		     unsigned maxBacklogSize = 16*1024*1024,
+		     unsigned maxFlushDelayMS = 500);
+      // "fid" must already be open for writing.  (It is not closed by us.)
+      // Each full block (of "blockSize" bytes) gets written - one per pass through the event loop - by a background task.
+      // If "maxBacklogSize" bytes are already waiting to be written, then we write the oldest block immediately instead.
+      // Data in a partially-filled block is written no more than "maxFlushDelayMS" ms after it arrived.
+  virtual ~BufferedFileWriter(); // writes any remaining data (and deferred changes)
+
+  void write(unsigned char const* data, unsigned dataSize);
+  void writeByte(unsigned char byte) {
+    if (fFlushTask != NULL && fTail != NULL && fTail->size + 1 < fBlockSize) {
+      // Common case: Add the byte to the current block:
+      fTail->data[fTail->size++] = byte;
+      ++fFileSize; ++fNumBufferedBytes;
+    } else {
+      write(&byte, 1);
+    }
+  }
+
+  int64_t position() const { return fFileSize; } // the file offset at which the next data will be written
+
+  void patch(int64_t filePosn, unsigned char const* data, unsigned dataSize);
+      // Overwrites previously-written data.  If (some of) this data is still in memory, it's changed there; otherwise
+      // the change is remembered, and made (by seeking) only when we're flushed or deleted.
+
+  Boolean flush();
+      // Writes all remaining data (and deferred changes) now.  Returns False if a write or seek failed.
+  Boolean hasFailed() const { return fHasFailed; }
+
+  // Statistics:
+  u_int64_t numBytesWritten() const { return fNumBytesWritten; }
+  unsigned numWriteCalls() const { return fNumWriteCalls; }
+  unsigned numBacklogStalls() const { return fNumBacklogStalls; }
+      // the number of times that we had to write data immediately, because "maxBacklogSize" had been reached
+  unsigned maxBacklog() const { return fMaxBacklog; } // the largest number of bytes that were waiting to be written
+  unsigned numDeferredPatches() const { return fNumDeferredPatches; }
+
+private:
+  struct Block {
+    Block* next;
+    int64_t filePosn; // of "data[0]"
+    unsigned size; // bytes of "data" that are in use
+    unsigned numWritten; // bytes of "data" that have already been written to the file
+    unsigned char* data;
+  };
+  struct Patch {
+    Patch* next;
+    int64_t filePosn;
+    unsigned size;
+    unsigned char* data;
+  };
+
+  void addBlock();
+  void writeHeadBlock();
+  void scheduleFlush();
+  static void flushTask(void* clientData);
+  void flushTask1();
+  void addDeferredPatch(int64_t filePosn, unsigned char const* data, unsigned dataSize);
+
+private:
+  UsageEnvironment& fEnv;
+  FILE* fFid;
+  unsigned fBlockSize, fMaxBacklogSize, fMaxFlushDelayMS;
+  Block* fHead; // the oldest block that has data to be written (or NULL)
+  Block* fTail; // the block that's currently being filled (or NULL)
+  Block* fFreeBlocks; // for reuse
+  Patch* fPatches;
+  int64_t fFileSize;
+  unsigned fNumBufferedBytes;
+  TaskToken fFlushTask;
+  Boolean fFlushTaskIsImmediate;
+  Boolean fHasFailed;
+  u_int64_t fNumBytesWritten;
+  unsigned fNumWriteCalls, fNumBacklogStalls, fMaxBacklog, fNumDeferredPatches;
+};
+
+#endif
@@ -57,6 +57,14 @@ public:
       // The returned string from this function must later be freed by calling:
   void reclaimDigestResponse(char const* responseStr) const;
 
+  // Functions used by servers, to check a "response" without allocating memory:
+  static void computeHA1(char const* username, char const* realm, char const* password, char* resultHA1);
+      // Sets "resultHA1" - which must point to a (>=)33-byte buffer - to md5(<username>:<realm>:<password>)
+  static Boolean responseIsValid(char const* ha1, char const* nonce, char const* cmd,
+				 char const* url, unsigned urlSize, char const* response, unsigned responseSize);
+      // Returns True iff "response" (of "responseSize" chars) is md5(<ha1>:<nonce>:md5(<cmd>:<url>)).
+      // ("url" need not be '\0'-terminated.)  The comparison takes the same time however many chars of "response" match.
+
 private:
   void resetRealmAndNonce();
   void resetUsernameAndPassword();
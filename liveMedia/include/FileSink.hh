@@ -24,6 +24,9 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #ifndef _MEDIA_SINK_HH
 #include "MediaSink.hh"
 #endif
+#ifndef _BUFFERED_FILE_WRITER_HH
+#include "BufferedFileWriter.hh"
+#endif
 
 class FileSink: public MediaSink {
 public:
@@ -41,6 +44,14 @@ public:
 		       struct timeval presentationTime);
   // (Available in case a client wants to add extra data to the output file)
 
+  Boolean setSegmentation(unsigned segmentDuration, unsigned maxSegmentSize = 0);
+  // For a sink that was created with "oneFilePerFrame" == True: Rather than writing each frame to a separate file,
+  //   write a new file - named "<fileName>-<segment number>" - at the first frame (that can begin a segment; e.g.,
+  //   a H.264 or H.265 key frame) after "segmentDuration" seconds, or (if "maxSegmentSize" is non-zero)
+  //   "maxSegmentSize" bytes.  Each segment's file name, start (presentation) time, duration, and size is
+  //   appended to an index file named "<fileName>.index".
+  //   This must be called before the sink starts playing.  Returns False (and sets the result message) on failure.
+
 protected:
   FileSink(UsageEnvironment& env, FILE* fid, unsigned bufferSize,
 	   char const* perFrameFileNamePrefix);
@@ -50,6 +61,12 @@ protected:
 protected: // redefined virtual functions:
   virtual Boolean continuePlaying();
 
+protected: // new virtual functions, used for segmented output:
+  virtual Boolean frameCanBeginSegment(unsigned char const* frame, unsigned frameSize);
+      // by default, returns True
+  virtual void segmentHasBegun();
+      // called before the first data is added to a new segment's file; by default, does nothing
+
 protected:
   static void afterGettingFrame(void* clientData, unsigned frameSize,
 				unsigned numTruncatedBytes,
@@ -59,13 +76,39 @@ protected:
 				 unsigned numTruncatedBytes,
 				 struct timeval presentationTime);
 
+private:
+  Boolean isSegmenting() const { return fIndexFid != NULL; }
+  char* segmentFileName(unsigned segmentNumber) const;
+  void checkForNewSegment(unsigned frameSize, struct timeval presentationTime);
+  void beginSegment(struct timeval presentationTime);
+  void endSegment();
+  static void openNextSegmentFileTask(void* clientData);
+  void openNextSegmentFile();
+  static void closeOldSegmentFileTask(void* clientData);
+  void closeOldSegmentFile();
+
+protected:
   FILE* fOutFid;
+  BufferedFileWriter* fWriter; // used unless "oneFilePerFrame" is True
   unsigned char* fBuffer;
   unsigned fBufferSize;
   char* fPerFrameFileNamePrefix; // used if "oneFilePerFrame" is True
-  char* fPerFrameFileNameBuffer; // used if "oneFilePerFrame" is True
+  char* fPerFrameFileNameBuffer; // used if "oneFilePerFrame" is True (and we're not segmenting)
   struct timeval fPrevPresentationTime;
   unsigned fSamePresentationTimeCounter;
+
+private:
+  // Used only for segmented output:
+  unsigned fSegmentDuration, fMaxSegmentSize;
+  FILE* fIndexFid;
+  char* fSegmentFileName; // of the current segment
+  struct timeval fSegmentStartTime, fLastPresentationTime;
+  double fSegmentElapsedTime; // seconds
+  unsigned fNumSegmentFiles; // opened so far
+  FILE* fNextOutFid; // opened ahead of time, so that starting a new segment doesn't wait for the file system
+  TaskToken fNextSegmentFileTask;
+  BufferedFileWriter* fOldWriter; FILE* fOldOutFid; // the previous segment, until it gets closed
+  TaskToken fOldSegmentFileTask;
 };
 
 #endif
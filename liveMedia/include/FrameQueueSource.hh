@@ -0,0 +1,73 @@
+/**********
+This library is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the
+Free Software Foundation; either version 2.1 of the License, or (at your
+option) any later version. (See <http://www.gnu.org/copyleft/lesser.html>.)
+
+This library is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this library; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+**********/
+// "liveMedia"
+// Copyright (c) 1996-2014 Live Networks, Inc.  All rights reserved.
+// A source that delivers frames that are 'pushed' into it - from any thread - e.g., by an encoder or capture thread.
+// (Unlike the "DeviceSource" template, this can be used as is, and any number of these can exist at once, even though
+//  there is a limit on the number of 'event triggers'.)
+// C++ header
+
+#ifndef _FRAME_QUEUE_SOURCE_HH
+#define _FRAME_QUEUE_SOURCE_HH
+
+#ifndef _FRAMED_SOURCE_HH
+#include "FramedSource.hh"
+#endif
+
+class FrameQueueSource: public FramedSource {
+public:
+  static FrameQueueSource* createNew(UsageEnvironment& env, unsigned maxNumQueuedFrames = 30);
+      // Up to "maxNumQueuedFrames" frames can be waiting to be delivered; any more get dropped.
+
+  Boolean pushFrame(unsigned char const* frame, unsigned frameSize,
+		    struct timeval const& presentationTime, unsigned durationInMicroseconds = 0);
+      // Copies a new frame into our queue, to be delivered (from the event loop) as soon as our reader asks for it.
+      // This function (unlike other library functions) may be called from any thread - including from several threads at
+      // once - and does not block.  Returns False (dropping the frame) if the queue was already full.
+      // Note: All calls to "pushFrame()" must have returned before this object is closed.
+
+  unsigned numDroppedFrames() const { return fNumDroppedFrames; }
+
+protected:
+  FrameQueueSource(UsageEnvironment& env, class FrameQueueReadyList* readyList, unsigned maxNumQueuedFrames);
+      // called only by createNew(), or by subclass constructors
+  virtual ~FrameQueueSource();
+
+private:
+  // redefined virtual functions:
+  virtual void doGetNextFrame();
+
+private:
+  friend class FrameQueueReadyList;
+  void deliverFrame();
+
+private:
+  struct QueuedFrame; // defined in the implementation
+
+  class FrameQueueReadyList* fReadyList; // shared by all "FrameQueueSource"s in the same environment
+  unsigned fMaxNumQueuedFrames;
+
+  // Accessed from any thread (atomically):
+  QueuedFrame* volatile fIncomingFrames; // a stack (most recently pushed first)
+  unsigned volatile fNumQueuedFrames, fNumDroppedFrames;
+  unsigned volatile fIsReady; // whether we're in (or about to be added to) our ready list
+  FrameQueueSource* fNextReady;
+
+  // Accessed only from the event loop:
+  QueuedFrame* fOutgoingFrames; // a queue (oldest first)
+};
+
+#endif
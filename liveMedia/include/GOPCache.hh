@@ -0,0 +1,91 @@
+/**********
+This library is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the
+Free Software Foundation; either version 2.1 of the License, or (at your
+option) any later version. (See <http://www.gnu.org/copyleft/lesser.html>.)
+
+This library is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this library; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+**********/
+// "liveMedia"
+// Copyright (c) 1996-2014 Live Networks, Inc.  All rights reserved.
+// A cache of the video frames since (and including) the most recent key frame ("GOP cache"), so that a
+// new consumer of a live stream can be given something that it can decode immediately, rather than having
+// to wait for the next key frame.
+// C++ header
+
+#ifndef _GOP_CACHE_HH
+#define _GOP_CACHE_HH
+
+#ifndef _BOOLEAN_HH
+#include "Boolean.hh"
+#endif
+#ifndef _NET_COMMON_H
+#include "NetCommon.h"
+#endif
+
+#ifndef GOP_CACHE_BURST_FRAME_INTERVAL
+#define GOP_CACHE_BURST_FRAME_INTERVAL 1000 /* microseconds */
+#endif
+
+class GOPCache {
+public:
+  static GOPCache* createNew(char const* codecName, unsigned maxCacheSize = 4000000);
+      // "codecName" must be "H264", "H265", or "MP4V-ES" (the codecs whose key frames we can recognize);
+      // otherwise we return NULL.  Frames are expected to be those delivered by the corresponding
+      // "*DiscreteFramer" (or "*StreamFramer") class - i.e., NAL units (with or without a start code) for
+      // H.264/H.265, or VOPs (possibly preceded by configuration headers) for MPEG-4.
+      // If a GOP grows larger than "maxCacheSize" bytes, it is discarded (and we resume caching at the next key frame).
+  virtual ~GOPCache();
+
+  Boolean addFrame(unsigned char const* frame, unsigned frameSize, struct timeval presentationTime);
+      // Call this for each frame of the stream, in order.  Returns True iff this frame begins a new GOP.
+      // (This is so even if "maxCacheSize" is 0 - i.e., if we're being used only to recognize key frames.)
+  void reset();
+      // Discards the cached frames (e.g., because the stream has been paused or restarted).
+
+  unsigned numFrames() const { return fNumFrames; }
+  unsigned generation() const { return fGeneration; } // changes each time the cached frames are discarded
+
+  unsigned getFrame(unsigned index, unsigned char* to, unsigned maxSize, unsigned& numTruncatedBytes,
+		    struct timeval& presentationTime, unsigned& durationInMicroseconds) const;
+      // Copies cached frame #"index" (which must be < "numFrames()") into "to", returning its size.
+      // The returned "presentationTime" is rewritten so that the cached frames - when delivered in a burst - are
+      // spaced only GOP_CACHE_BURST_FRAME_INTERVAL microseconds apart, ending at the presentation time of the most
+      // recently cached frame.  (Consecutive frames that shared a presentation time still do so.)  Therefore, a
+      // receiver will decode (and quickly play through) the cached GOP, and then continue seamlessly with the live stream.
+      // The returned "durationInMicroseconds" matches this spacing, so that a downstream "RTPSink" paces the burst,
+      // rather than overflowing its socket's buffer.
+
+protected:
+  GOPCache(int codecType, unsigned maxCacheSize); // called only by "createNew()"
+
+private:
+  Boolean isKeyFrame(unsigned char const* frame, unsigned frameSize) const;
+  Boolean isNeutralFrame(unsigned char const* frame, unsigned frameSize) const;
+  int nalUnitType(unsigned char const* frame, unsigned frameSize) const; // H.264 or H.265 only; -1 if none
+
+private:
+  int fCodecType;
+  unsigned fMaxCacheSize;
+  unsigned char* fBuffer;
+  unsigned fBufferSize, fNumBytesUsed;
+  struct CachedFrame {
+    unsigned offset, size;
+    struct timeval presentationTime;
+    unsigned presentationTimeIndex; // counts distinct presentation times within the GOP
+  };
+  CachedFrame* fFrames;
+  unsigned fNumFrames, fMaxNumFrames;
+  unsigned fNumPresentationTimes;
+  unsigned fGeneration;
+  Boolean fPrevFrameWasKeyFrame, fIsCaching;
+};
+
+#endif
@@ -42,6 +42,9 @@ protected:
 		    unsigned bufferSize, char const* perFrameFileNamePrefix);
       // called only by createNew()
   virtual ~H264VideoFileSink();
+
+protected: // redefined virtual functions:
+  virtual Boolean frameCanBeginSegment(unsigned char const* frame, unsigned frameSize);
 };
 
 #endif
@@ -37,6 +37,7 @@ protected:
 
 protected: // redefined virtual functions:
   virtual void afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes, struct timeval presentationTime);
+  virtual void segmentHasBegun();
 
 private:
   char const* fSPropParameterSetsStr[3];
@@ -46,6 +46,9 @@ protected:
 		    unsigned bufferSize, char const* perFrameFileNamePrefix);
       // called only by createNew()
   virtual ~H265VideoFileSink();
+
+protected: // redefined virtual functions:
+  virtual Boolean frameCanBeginSegment(unsigned char const* frame, unsigned frameSize);
 };
 
 #endif
@@ -0,0 +1,144 @@
+/**********
+This library is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the
+Free Software Foundation; either version 2.1 of the License, or (at your
+option) any later version. (See <http://www.gnu.org/copyleft/lesser.html>.)
+
+This library is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this library; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+**********/
+// "liveMedia"
+// Copyright (c) 1996-2014 Live Networks, Inc.  All rights reserved.
+// A sink that segments a live "ServerMediaSession" into in-memory Transport Stream segments,
+// described by a sliding-window playlist (for Apple's "HTTP Live Streaming" protocol).
+// C++ header
+
+#ifndef _HLS_SEGMENTER_HH
+#define _HLS_SEGMENTER_HH
+
+#ifndef _MEDIA_SINK_HH
+#include "MediaSink.hh"
+#endif
+#ifndef _SERVER_MEDIA_SESSION_HH
+#include "ServerMediaSession.hh"
+#endif
+
+// A single (complete) Transport Stream segment.  Segments are reference-counted, so that a segment that has
+// slid out of the playlist window remains valid until every HTTP client that is still sending it has finished.
+class HLSSegment {
+public:
+  unsigned sequenceNumber() const { return fSequenceNumber; }
+  double duration() const { return fDuration; }
+  u_int8_t* data() const { return fData; }
+  unsigned size() const { return fSize; }
+
+  void incrementReferenceCount() { ++fReferenceCount; }
+  void decrementReferenceCount(); // deletes the segment when its reference count becomes 0
+
+private:
+  friend class HLSSegmenter;
+  HLSSegment(unsigned sequenceNumber, u_int8_t* data, unsigned size, double duration);
+      // takes ownership of "data" (which must have been allocated using new[])
+  virtual ~HLSSegment();
+
+private:
+  HLSSegment* fNext; // used only while the segment is within the segmenter's window
+  unsigned fSequenceNumber;
+  u_int8_t* fData;
+  unsigned fSize;
+  double fDuration;
+  unsigned fReferenceCount;
+};
+
+class HLSSegmenter: public MediaSink {
+public:
+  static HLSSegmenter* createNew(UsageEnvironment& env, ServerMediaSession& session,
+				 char const* segmentURLPrefix,
+				 unsigned targetSegmentDuration = 6, unsigned numSegmentsInPlaylist = 5);
+      // Starts streaming from each subsession of "session" (using "getStreamParameters()"), multiplexing the
+      // subsessions (if they're not already a Transport Stream) into a single Transport Stream, which is then cut
+      // (at Program Association Table packets) into segments of approximately "targetSegmentDuration" seconds.
+      // The playlist lists the most recent "numSegmentsInPlaylist" segments; each segment's URL is
+      // "segmentURLPrefix" followed by the segment's sequence number.
+      // Returns NULL if none of the session's subsessions can be segmented.
+
+  ServerMediaSession& serverMediaSession() const { return fOurSession; }
+
+  char const* playlist(unsigned& playlistSize);
+      // Returns the current playlist (which remains valid only until we next return to the event loop).
+  HLSSegment* lookupSegment(unsigned sequenceNumber);
+      // Returns NULL if the segment is no longer (or not yet) in our window.
+      // Callers that continue to use the segment later must call "incrementReferenceCount()" on it.
+
+  Boolean hasEnded() const { return fHaveEnded; }
+  time_t lastAccessTime() const { return fLastAccessTime; }
+
+protected:
+  HLSSegmenter(UsageEnvironment& env, ServerMediaSession& session, char const* segmentURLPrefix,
+	       unsigned targetSegmentDuration, unsigned numSegmentsInPlaylist);
+      // called only by createNew()
+  virtual ~HLSSegmenter();
+
+  Boolean setUpInputSource();
+  void noteAccess();
+
+protected: // redefined virtual functions:
+  virtual Boolean continuePlaying();
+
+private:
+  static void afterGettingFrame(void* clientData, unsigned frameSize,
+				unsigned numTruncatedBytes,
+				struct timeval presentationTime,
+				unsigned durationInMicroseconds);
+  void afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes,
+			 struct timeval presentationTime, unsigned durationInMicroseconds);
+  static void continuePlayingTask(void* clientData);
+
+  static void ourOnSourceClosure(void* clientData);
+  void ourOnSourceClosure();
+
+  void ensureBufferSpace();
+  void completeCurrentSegment(unsigned segmentSize);
+  void generatePlaylist();
+
+private:
+  ServerMediaSession& fOurSession;
+  char* fSegmentURLPrefix;
+  unsigned fTargetSegmentDuration, fNumSegmentsInPlaylist;
+  u_int32_t fClientSessionId; // used for our "getStreamParameters()" calls
+  unsigned fNumStreams;
+  struct streamState {
+    ServerMediaSubsession* subsession;
+    void* streamToken;
+  } * fStreams;
+  FramedSource* fMultiplexor; // non-NULL iff the input is multiplexed from Elementary Streams
+  Boolean fHaveEnded;
+  time_t fLastAccessTime;
+
+  // The segment that's currently being filled in:
+  u_int8_t* fBuffer;
+  unsigned fBufferSize, fBufferBytesUsed;
+  unsigned fNextPacketOffsetToCheck; // the offset (within "fBuffer") of the next Transport packet whose header we'll check
+  Boolean fHaveSeenPAT;
+  double fMediaTime; // seconds of media that we've read (measured using frame durations or presentation times)
+  double fMediaClockBase; // the 'wall clock' time corresponding to "fMediaTime" == 0 (used to pace our reading)
+  double fLastPresentationTime;
+  double fSegmentStartMediaTime;
+
+  // The window of complete segments (oldest first):
+  HLSSegment* fFirstSegment;
+  HLSSegment* fLastSegment;
+  unsigned fNumSegments;
+  unsigned fNextSequenceNumber;
+
+  char* fPlaylist;
+  unsigned fPlaylistSize;
+};
+
+#endif
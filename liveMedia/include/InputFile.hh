@@ -53,6 +53,9 @@ void CloseInputFile(FILE* fid);
 u_int64_t GetFileSize(char const* fileName, FILE* fid);
     // 0 means zero-length, unbounded, or unknown
 
+time_t GetFileModificationTime(char const* fileName);
+    // 0 means unknown
+
 int64_t SeekFile64(FILE *fid, int64_t offset, int whence);
     // A platform-independent routine for seeking within (possibly) large files
 
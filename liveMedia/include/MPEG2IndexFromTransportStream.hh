@@ -40,6 +40,19 @@ public:
   static MPEG2IFrameIndexFromTransportStream*
   createNew(UsageEnvironment& env, FramedSource* inputSource);
 
+  // Functions that allow a file to be indexed in pieces (e.g., in parallel, or as it grows):
+  void setInputRange(unsigned long firstTransportPacketNumber,
+		     unsigned long indexFromTransportPacketNumber, unsigned long indexToTransportPacketNumber = 0);
+      // Our input source begins with Transport packet "firstTransportPacketNumber" of the file (rather than at its start).
+      // Index records are delivered only for frames that begin at or after "indexFromTransportPacketNumber", and
+      // (if "indexToTransportPacketNumber" is non-zero) before "indexToTransportPacketNumber", at which point we close.
+      // (Because the input should begin somewhat before "indexFromTransportPacketNumber", the resulting records are the
+      // same as those that we'd deliver if we indexed the whole file.)
+  Boolean primeFromTransportPackets(unsigned char* packets, unsigned numPackets);
+      // Analyzes Transport packets from the start of the file (only), to find the video stream, and the PCR that
+      // delivered index records are relative to.  This must be called before we start reading from a source that
+      // doesn't begin at the start of the file.  Returns True iff we've now found both.
+
 protected:
   MPEG2IFrameIndexFromTransportStream(UsageEnvironment& env,
 				      FramedSource* inputSource);
@@ -63,8 +76,9 @@ private:
   static void handleInputClosure(void* clientData);
   void handleInputClosure1();
 
+  void analyzePCR(unsigned char* pkt, u_int8_t totalHeaderSize);
   void analyzePAT(unsigned char* pkt, unsigned size);
-  void analyzePMT(unsigned char* pkt, unsigned size);
+  Boolean analyzePMT(unsigned char* pkt, unsigned size); // returns True iff it found the video stream
 
   Boolean deliverIndexRecord();
   Boolean parseFrame();
@@ -82,12 +96,16 @@ private:
   Boolean fHaveSeenFirstPCR;
   u_int16_t fPMT_PID, fVideo_PID;
       // Note: We assume: 1 program per Transport Stream; 1 video stream per program
+  Boolean fHaveSeenVideoStream;
+  unsigned long fIndexFromTransportPacketNumber, fIndexToTransportPacketNumber;
+  unsigned long fCurrentFrameTransportPacketNumber; // of the frame whose index records we're currently delivering
   unsigned char fInputBuffer[TRANSPORT_PACKET_SIZE];
   unsigned char* fParseBuffer;
   unsigned fParseBufferSize;
   unsigned fParseBufferFrameStart;
   unsigned fParseBufferParseEnd;
   unsigned fParseBufferDataEnd;
+  unsigned fNumInitialBadBytes; // before the frame that we're currently parsing
   IndexRecord* fHeadIndexRecord;
   IndexRecord* fTailIndexRecord;
 };
@@ -83,6 +83,8 @@ private: // redefined virtual functions
 
   virtual void testScaleFactor(float& scale);
   virtual float duration() const;
+  virtual Boolean getFileByteRange(double seekNPT, double streamDuration,
+				   char const*& fileName, u_int64_t& startByte, u_int64_t& numBytes);
 
 private:
   ClientTrickPlayState* lookupClient(unsigned clientSessionId);
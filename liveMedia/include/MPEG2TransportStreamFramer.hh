@@ -27,9 +27,7 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #include "FramedFilter.hh"
 #endif
 
-#ifndef _HASH_TABLE_HH
-#include "HashTable.hh"
-#endif
+class PIDStatus; // forward
 
 class MPEG2TransportStreamFramer: public FramedFilter {
 public:
@@ -63,11 +61,12 @@ private:
 			  struct timeval presentationTime);
 
   Boolean updateTSPacketDurationEstimate(unsigned char* pkt, double timeNow);
+      // called only for packets that contain a PCR
 
 private:
   u_int64_t fTSPacketCount;
   double fTSPacketDurationEstimate;
-  HashTable* fPIDStatusTable;
+  PIDStatus** fPIDStatusTable; // indexed by PID
   u_int64_t fTSPCRCount;
   Boolean fLimitNumTSPacketsToStream;
   unsigned long fNumTSPacketsToStream; // used iff "fLimitNumTSPacketsToStream" is True
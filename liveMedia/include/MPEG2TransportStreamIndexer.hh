@@ -0,0 +1,98 @@
+/**********
+This library is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the
+Free Software Foundation; either version 2.1 of the License, or (at your
+option) any later version. (See <http://www.gnu.org/copyleft/lesser.html>.)
+
+This library is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this library; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+**********/
+// "liveMedia"
+// Copyright (c) 1996-2014 Live Networks, Inc.  All rights reserved.
+// A class that generates (or extends) the index file for a MPEG-2 Transport Stream file - either as a whole,
+// in separately-indexed pieces (that can later be merged), or incrementally, as the Transport Stream file grows.
+// C++ header
+
+#ifndef _MPEG2_TRANSPORT_STREAM_INDEXER_HH
+#define _MPEG2_TRANSPORT_STREAM_INDEXER_HH
+
+#ifndef _MEDIA_SINK_HH
+#include "MediaSink.hh"
+#endif
+#ifndef _MPEG2_IFRAME_INDEX_FROM_TRANSPORT_STREAM_HH
+#include "MPEG2IndexFromTransportStream.hh"
+#endif
+#ifndef _MPEG2_TRANSPORT_STREAM_INDEX_FILE_HH
+#include "MPEG2TransportStreamIndexFile.hh"
+#endif
+
+class MPEG2TransportStreamIndexer: public MediaSink {
+public:
+  static MPEG2TransportStreamIndexer* createNew(UsageEnvironment& env, char const* transportStreamFileName,
+						char const* indexFileName = NULL);
+      // If "indexFileName" is NULL, we use "transportStreamFileName" with "x" appended (i.e., "foo.ts" -> "foo.tsx").
+
+  Boolean indexFile(afterPlayingFunc* afterFunc, void* afterClientData,
+		    unsigned long fromTransportPacketNumber = 0, unsigned long toTransportPacketNumber = 0);
+      // (Re)writes the index file, with records for the frames that begin within the specified range of Transport
+      // packets (by default, the whole file).  Several ranges can be indexed in parallel (into separate index files),
+      // and then merged using "mergeIndexFiles()".
+  Boolean resumeIndexing(afterPlayingFunc* afterFunc, void* afterClientData,
+			 Boolean followFileGrowth = False, unsigned pollIntervalMS = 1000);
+      // Extends an existing (possibly incomplete) index file, by indexing the Transport Stream file from where the
+      // index file left off.  If "followFileGrowth" is True, we then keep checking (every "pollIntervalMS" ms) whether
+      // the Transport Stream file has grown, and if so, index the new data (and "afterFunc" will not get called).
+
+  static Boolean mergeIndexFiles(UsageEnvironment& env, char const* outputIndexFileName,
+				 char const* const* inputIndexFileNames, unsigned numInputIndexFiles);
+      // Concatenates index files that were generated for consecutive ranges of the same Transport Stream file.
+
+  unsigned long numTransportPackets() const; // in the Transport Stream file (at present)
+  unsigned long numIndexRecords() const { return fNumIndexRecords; } // written so far
+
+protected:
+  MPEG2TransportStreamIndexer(UsageEnvironment& env, char const* transportStreamFileName,
+			      char const* indexFileName); // called only by createNew()
+  virtual ~MPEG2TransportStreamIndexer();
+
+protected: // redefined virtual functions
+  virtual Boolean continuePlaying();
+
+private:
+  Boolean startIndexing(unsigned long fromTransportPacketNumber, unsigned long toTransportPacketNumber);
+  void findResumptionPoint(unsigned long& fromTransportPacketNumber);
+  Boolean primeIndexer();
+
+  static void afterGettingFrame(void* clientData, unsigned frameSize, unsigned numTruncatedBytes,
+				struct timeval presentationTime, unsigned durationInMicroseconds);
+  void afterGettingFrame(unsigned frameSize);
+
+  static void afterIndexing(void* clientData);
+  static void afterIndexingTask(void* clientData);
+  void afterIndexing1();
+  static void pollForFileGrowth(void* clientData);
+  void pollForFileGrowth1();
+
+private:
+  char* fTransportStreamFileName;
+  char* fIndexFileName;
+  FILE* fIndexFid;
+  MPEG2IFrameIndexFromTransportStream* fIndexer;
+  unsigned long fNumIndexRecords;
+  unsigned char fRecord[INDEX_RECORD_SIZE];
+  u_int32_t fLastPCR, fPCRAdjustment; // (in units of 1/256 seconds, as stored in index records)
+  afterPlayingFunc* fUserAfterFunc;
+  void* fUserAfterClientData;
+  Boolean fFollowFileGrowth;
+  unsigned fPollIntervalMS;
+  unsigned long fNumTransportPacketsIndexed;
+  TaskToken fPollTask;
+};
+
+#endif
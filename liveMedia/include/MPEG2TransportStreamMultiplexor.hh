@@ -32,6 +32,12 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #define PID_TABLE_SIZE 256
 
 class MPEG2TransportStreamMultiplexor: public FramedSource {
+public:
+  void setMaxPacketsPerDelivery(unsigned maxPacketsPerDelivery) { fMaxPacketsPerDelivery = maxPacketsPerDelivery; }
+      // By default (0), each delivery contains as many Transport packets as fit in the client's buffer.  Set a limit if each
+      // delivery must fit in a single network packet - e.g., when the output is fed directly to a "SimpleRTPSink" (as in RTSP
+      // 'trick play'), which must not split Transport packets across RTP packets.
+
 protected:
   MPEG2TransportStreamMultiplexor(UsageEnvironment& env);
   virtual ~MPEG2TransportStreamMultiplexor();
@@ -62,6 +68,8 @@ protected:
 
 private:
   unsigned fOutgoingPacketCounter;
+  unsigned fNumDeliveries;
+  unsigned fMaxPacketsPerDelivery; // 0 means no limit
   unsigned fProgramMapVersion;
   u_int8_t fPreviousInputProgramMapVersion, fCurrentInputProgramMapVersion;
       // These two fields are used if we see "program_stream_map"s in the input.
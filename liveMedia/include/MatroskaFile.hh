@@ -39,6 +39,12 @@ public:
     // Note: Unlike most "createNew()" functions, this one doesn't return a new object immediately.  Instead, because this class
     // requires file reading (to parse the Matroska 'Track' headers) before a new object can be initialized, the creation of a new
     // object is signalled by calling - from the event loop - an 'onCreationFunc' that is passed as a parameter to "createNew()".
+    // The result of this parsing is cached (for each "UsageEnvironment"), so later "MatroskaFile"s for the same (unchanged)
+    // file get created without reading the file again.  (If the file has no 'Cues', we build our own index - for seeking -
+    // from its 'Cluster' headers; this is also cached.)
+
+  static void flushMetadataCache(UsageEnvironment& env);
+    // Deletes the cached results of parsing files that are not currently open (as "MatroskaFile"s).
 
   MatroskaTrack* lookup(unsigned trackNumber) const;
 
@@ -75,6 +81,7 @@ private:
 
   static void handleEndOfTrackHeaderParsing(void* clientData);
   void handleEndOfTrackHeaderParsing();
+  void addToMetadataCache();
 
   void addTrack(MatroskaTrack* newTrack, unsigned trackNumber);
   void addCuePoint(double cueTime, u_int64_t clusterOffsetInFile, unsigned blockNumWithinCluster);
@@ -100,6 +107,8 @@ private:
   class CuePoint* fCuePoints;
   unsigned fChosenVideoTrackNumber, fChosenAudioTrackNumber, fChosenSubtitleTrackNumber;
   class MatroskaFileParser* fParserForInitialization;
+  class MatroskaMetadata* fMetadata; // if non-NULL, our track table and cue points are shared, via the metadata cache
+  TaskToken fCreationTask; // used if we were created from the metadata cache
 };
 
 // We define our own track type codes as bits (powers of 2), so we can use the set of track types as a bitmap, representing a set:
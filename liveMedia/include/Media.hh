@@ -126,6 +126,9 @@ public:
 
   MediaLookupTable* mediaTable;
   void* socketTable;
+  void* proxyTimerWheel; // used by "ProxyServerMediaSession"
+  void* matroskaMetadataCache; // used by "MatroskaFile"
+  void* frameQueueReadyList; // used by "FrameQueueSource"
 
 protected:
   _Tables(UsageEnvironment& env);
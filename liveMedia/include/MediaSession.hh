@@ -205,6 +205,9 @@ public:
       // called after initiate().
   void receiveRawMP3ADUs() { fReceiveRawMP3ADUs = True; } // optional hack for audio/MPA-ROBUST; must not be called after initiate()
   void receiveRawJPEGFrames() { fReceiveRawJPEGFrames = True; } // optional hack for video/JPEG; must not be called after initiate()
+  void receiveRawRTPPayloads() { fReceiveRawRTPPayloads = True; }
+      // optional hack (used when proxying): Deliver each incoming RTP packet's payload - unchanged - as a separate frame,
+      // regardless of the codec.  Must not be called after initiate()
   char*& connectionEndpointName() { return fConnectionEndpointName; }
   char const* connectionEndpointName() const {
     return fConnectionEndpointName;
@@ -323,7 +326,7 @@ protected:
   Groupsock* fRTPSocket; Groupsock* fRTCPSocket; // works even for unicast
   RTPSource* fRTPSource; RTCPInstance* fRTCPInstance;
   FramedSource* fReadSource;
-  Boolean fReceiveRawMP3ADUs, fReceiveRawJPEGFrames;
+  Boolean fReceiveRawMP3ADUs, fReceiveRawJPEGFrames, fReceiveRawRTPPayloads;
 
   // Other fields:
   char* fSessionId; // used by RTSP
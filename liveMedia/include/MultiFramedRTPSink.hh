@@ -26,10 +26,51 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #include "RTPSink.hh"
 #endif
 
+class FrameLatencyHistogram {
+public:
+  // A histogram of frame latencies (in microseconds), with exponentially-sized buckets:
+  //     bucket 0: < 64 us; bucket i (0 < i < NUM_BUCKETS-1): [64<<(i-1), 64<<i) us; bucket NUM_BUCKETS-1: >= 64<<(NUM_BUCKETS-2) us
+  enum { NUM_BUCKETS = 16 };
+
+  FrameLatencyHistogram() { reset(); }
+  void reset();
+  void addSample(unsigned latencyInMicroseconds);
+
+  unsigned numSamples() const { return fNumSamples; }
+  unsigned count(unsigned bucket) const { return bucket < NUM_BUCKETS ? fCounts[bucket] : 0; }
+  static unsigned bucketLimit(unsigned bucket) { return 64<<bucket; } // the (exclusive) upper limit of "bucket"
+  unsigned minLatency() const { return fMin; }
+  unsigned maxLatency() const { return fMax; }
+  unsigned meanLatency() const { return fNumSamples == 0 ? 0 : (unsigned)(fTotal/fNumSamples); }
+  unsigned percentileLimit(unsigned percentile) const;
+      // returns the upper limit of the bucket that contains the given percentile (e.g., 99) of samples
+
+  void print(UsageEnvironment& env) const;
+
+private:
+  unsigned fCounts[NUM_BUCKETS];
+  unsigned fNumSamples, fMin, fMax;
+  u_int64_t fTotal;
+};
+
 class MultiFramedRTPSink: public RTPSink {
 public:
   void setPacketSizes(unsigned preferredPacketSize, unsigned maxPacketSize);
 
+  void setLowLatencyMode(Boolean lowLatencyMode = True, unsigned maxFrameLatencyMS = 0);
+      // Intended for live sources (whose presentation times are aligned with 'wall clock' time).  In 'low latency' mode:
+      // - each packet is sent as soon as it has been built - even if earlier frames' "durationInMicroseconds" would
+      //   otherwise have had us wait, and without returning to the event loop between the packets of a fragmented frame;
+      // - if "maxFrameLatencyMS" > 0, then any frame that's already older than this (according to its presentation time)
+      //   when we get it from our source is dropped.  (All frames with the same presentation time - e.g., all NAL units of
+      //   the same H.264 access unit - are either sent or dropped together.)
+      // - we record the latency of each frame (from its presentation time until we sent the packet containing its end)
+      //   in "frameLatencyHistogram()".
+  Boolean isInLowLatencyMode() const { return fLowLatencyMode; }
+  FrameLatencyHistogram& frameLatencyHistogram() { return fFrameLatencyHistogram; }
+  unsigned numFramesDroppedForLatency() const { return fNumFramesDroppedForLatency; }
+      // (counted as delivered by our source - e.g., for H.264, each NAL unit fragment)
+
   typedef void (onSendErrorFunc)(void* clientData);
   void setOnSendErrorFunc(onSendErrorFunc* onSendErrorFunc, void* onSendErrorFuncData) {
     // Can be used to set a callback function to be called if there's an error sending RTP packets on our socket.
@@ -78,6 +119,7 @@ protected:
   Boolean isFirstFrameInPacket() const { return fNumFramesUsedSoFar == 0; }
   unsigned curFragmentationOffset() const { return fCurFragmentationOffset; }
   void setMarkerBit();
+  void setSequenceNumber(u_int16_t seqNo); // of the current packet (and, implicitly, of subsequent packets)
   void setTimestamp(struct timeval framePresentationTime);
   void setSpecialHeaderWord(unsigned word, /* 32 bits, in host order */
 			    unsigned wordPosition = 0);
@@ -112,6 +154,8 @@ private:
 			  struct timeval presentationTime,
 			  unsigned durationInMicroseconds);
   Boolean isTooBigForAPacket(unsigned numBytes) const;
+  Boolean frameIsTooLate(struct timeval const& presentationTime);
+  static void getNextFrameInstead(void* firstArg);
 
   static void ourHandleClosure(void* clientData);
 
@@ -135,6 +179,17 @@ private:
 
   onSendErrorFunc* fOnSendErrorFunc;
   void* fOnSendErrorData;
+
+  // 'Low latency' mode:
+  Boolean fLowLatencyMode;
+  unsigned fMaxFrameLatencyUS;
+  unsigned fNumPacketsSentImmediately;
+  Boolean fPacketEndsFrame; // whether the current packet contains the end of a frame:
+  struct timeval fEndingFramePresentationTime; // if so, the presentation time of that frame
+  struct timeval fLastCheckedPresentationTime;
+  Boolean fDroppingFramesForLatency; // whether we're dropping frames with presentation time "fLastCheckedPresentationTime"
+  unsigned fNumFramesDroppedForLatency;
+  FrameLatencyHistogram fFrameLatencyHistogram;
 };
 
 #endif
@@ -43,6 +43,9 @@ protected: // we're a virtual base class
 
 protected: // redefined virtual functions
   virtual char const* sdpLines();
+  virtual Boolean prepareSDPLines(sdpLinesReadyFunc* readyFunc, void* readyClientData);
+  virtual void cancelPrepareSDPLines(void* readyClientData);
+  virtual void setSDPLines(char const* sdpLines);
   virtual void getStreamParameters(unsigned clientSessionId,
 				   netAddressBits clientAddress,
                                    Port const& clientRTPPort,
@@ -76,6 +79,11 @@ protected: // redefined virtual functions
 protected: // new virtual functions, possibly redefined by subclasses
   virtual char const* getAuxSDPLine(RTPSink* rtpSink,
 				    FramedSource* inputSource);
+  virtual Boolean sdpLinesNeedStreamData();
+    // Returns True iff our "RTPSink"s "auxSDPLine()" becomes known only after some data has been streamed to it
+    // (e.g., for a H.264 video file, where it's formed from the SPS and PPS NAL units).  In this case, we set up our SDP lines
+    // by streaming from a (dummy) source until "auxSDPLine()" is known - without blocking, if "prepareSDPLines()" is used.
+    // (The default implementation returns False.)
   virtual void seekStreamSource(FramedSource* inputSource, double& seekNPT, double streamDuration, u_int64_t& numBytes);
     // This routine is used to seek by relative (i.e., NPT) time.
     // "streamDuration", if >0.0, specifies how much data to stream, past "seekNPT".  (If <=0.0, all remaining data is streamed.)
@@ -100,7 +108,7 @@ protected: // new virtual functions, defined by all subclasses
 private:
   void setSDPLinesFromRTPSink(RTPSink* rtpSink, FramedSource* inputSource,
 			      unsigned estBitrate);
-      // used to implement "sdpLines()"
+      // used to implement "sdpLines()" (and "prepareSDPLines()")
 
 protected:
   char* fSDPLines;
@@ -111,7 +119,9 @@ private:
   portNumBits fInitialPortNum;
   void* fLastStreamToken;
   char fCNAME[100]; // for RTCP
+  class SDPLinesPreparer* fSDPLinesPreparer; // non-NULL while we're streaming from a dummy source to set "fSDPLines"
   friend class StreamState;
+  friend class SDPLinesPreparer;
 };
 
 
@@ -45,7 +45,8 @@ public:
 
   void continueAfterDESCRIBE(char const* sdpDescription);
   void continueAfterLivenessCommand(int resultCode, Boolean serverSupportsGetParameter);
-  void continueAfterSETUP();
+  void continueAfterSETUP(int resultCode = 0);
+  void continueAfterIdleTEARDOWN();
 
 private:
   void reset();
@@ -55,9 +56,15 @@ private:
   void scheduleLivenessCommand();
   static void sendLivenessCommand(void* clientData);
 
-  void scheduleDESCRIBECommand();
+  void scheduleDESCRIBECommand(Boolean afterFailure = True);
   static void sendDESCRIBE(void* clientData);
 
+  void scheduleIdleDisconnect();
+  static void idleDisconnect(void* clientData);
+  void disconnectWhileIdle();
+  void closeConnectionWhileIdle();
+  void reconnectIfIdle();
+
   static void subsessionTimeout(void* clientData);
   void handleSubsessionTimeout();
 
@@ -71,8 +78,9 @@ private:
   class ProxyServerMediaSubsession *fSetupQueueHead, *fSetupQueueTail;
   unsigned fNumSetupsDone;
   unsigned fNextDESCRIBEDelay; // in seconds
-  Boolean fServerSupportsGetParameter, fLastCommandWasPLAY;
-  TaskToken fLivenessCommandTask, fDESCRIBECommandTask, fSubsessionTimerTask;
+  unsigned fNumDESCRIBEFailures;
+  Boolean fServerSupportsGetParameter, fLastCommandWasPLAY, fIsDisconnectedWhileIdle;
+  TaskToken fLivenessCommandTask, fDESCRIBECommandTask, fSubsessionTimerTask, fIdleDisconnectTask;
 };
 
 
@@ -99,11 +107,16 @@ public:
 					    portNumBits tunnelOverHTTPPortNum = 0,
 					        // for streaming the *proxied* (i.e., back-end) stream
 					    int verbosityLevel = 0,
-					    int socketNumToServer = -1);
+					    int socketNumToServer = -1,
+					    unsigned idleDisconnectSeconds = 0);
       // Hack: "tunnelOverHTTPPortNum" == 0xFFFF (i.e., all-ones) means: Stream RTP/RTCP-over-TCP, but *not* using HTTP
       // "verbosityLevel" == 1 means display basic proxy setup info; "verbosityLevel" == 2 means display RTSP client protocol also.
       // If "socketNumToServer" is >= 0, then it is the socket number of an already-existing TCP connection to the server.
       //      (In this case, "inputStreamURL" must point to the socket's endpoint, so that it can be accessed via the socket.)
+      // If "idleDisconnectSeconds" is > 0, then we operate in 'capacity mode' (for proxying many - mostly idle - streams):
+      //      Our initial "DESCRIBE" is staggered (along with those of other proxies), and - once we have the stream's SDP
+      //      description - we keep our connection to the back-end server only while front-end clients are accessing the
+      //      stream, closing it "idleDisconnectSeconds" after the last client goes away, and reopening it for the next client.
 
   virtual ~ProxyServerMediaSession();
 
@@ -115,6 +128,31 @@ public:
   Boolean describeCompletedSuccessfully() const { return fClientMediaSession != NULL; }
     // This can be used - along with "describeCompletdFlag" - to check whether the back-end "DESCRIBE" completed *successfully*.
 
+  enum BackEndState { BACK_END_DESCRIBING, BACK_END_AWAITING_DESCRIBE_RETRY, BACK_END_IDLE, BACK_END_IDLE_DISCONNECTED,
+		      BACK_END_STREAMING };
+  BackEndState backEndState() const;
+  static char const* backEndStateName(BackEndState state);
+  unsigned numBackEndDESCRIBEFailures() const; // since the last successful "DESCRIBE"
+    // These can be used to monitor the state of our connection to the back-end server.
+
+  Boolean& relayRTPPayloadsDirectly() { return fRelayRTPPayloadsDirectly; }
+    // initialized to True.  If True, then streams whose RTP payload format does not depend upon the surrounding RTP header
+    // (e.g., H.264, H.265, MPEG-4, VP8) are proxied by relaying each incoming RTP packet's payload - unchanged - in its own
+    // outgoing RTP packet (with only the SSRC, and the sequence number and timestamp bases, being changed), rather than by
+    // reassembling and then repacketizing frames.  (JPEG/RTP streams are always proxied this way.)
+    // (This is done only if the back-end stream is received via UDP, and only while its payloads fit in our usual packets;
+    //  if one does not, it is still relayed - in a larger packet - but the stream's frames are reassembled instead the next
+    //  time it is set up.)
+    // Set this to False - before any front-end client connects - if you want each frame to be reassembled (e.g., for transcoding).
+
+  unsigned& gopCacheSize() { return fGOPCacheSize; }
+    // initialized to 0 (meaning: no GOP cache).  If set (to a maximum size, in bytes) before the back-end "DESCRIBE" completes
+    // (e.g., just after "createNew()"), then each H.264, H.265 or MPEG-4 video track keeps a cache of the frames since the most
+    // recent key frame (see "GOPCache.hh"), and delivers these - in a burst - to each new front-end client, so that it can start
+    // decoding immediately, rather than waiting for the back-end stream's next key frame.  To do this, each front-end client of
+    // such a track is given its own 'replica' of the stream (see "StreamReplicator.hh") - and its own "RTPSink" - so frames are
+    // reassembled (rather than being relayed as RTP payloads), and delivery costs somewhat more per client.
+
 protected:
   ProxyServerMediaSession(UsageEnvironment& env, RTSPServer* ourRTSPServer,
 			  char const* inputStreamURL, char const* streamName,
@@ -122,7 +160,8 @@ protected:
 			  portNumBits tunnelOverHTTPPortNum, int verbosityLevel,
 			  int socketNumToServer,
 			  createNewProxyRTSPClientFunc* ourCreateNewProxyRTSPClientFunc
-			  = defaultCreateNewProxyRTSPClientFunc);
+			  = defaultCreateNewProxyRTSPClientFunc,
+			  unsigned idleDisconnectSeconds = 0);
 
   // If you subclass "ProxyRTSPClient", then you will also need to define your own function
   // - with signature "createNewProxyRTSPClientFunc" (see above) - that creates a new object
@@ -144,6 +183,9 @@ private:
 
 private:
   int fVerbosityLevel;
+  unsigned fIdleDisconnectSeconds;
+  Boolean fRelayRTPPayloadsDirectly;
+  unsigned fGOPCacheSize;
   class PresentationTimeSessionNormalizer* fPresentationTimeSessionNormalizer;
   createNewProxyRTSPClientFunc* fCreateNewProxyRTSPClientFunc;
 };
@@ -158,7 +200,14 @@ private:
 
 class PresentationTimeSubsessionNormalizer: public FramedFilter {
 public:
-  void setRTPSink(RTPSink* rtpSink) { fRTPSink = rtpSink; }
+  void setRTPSink(RTPSink* rtpSink, Boolean relaysRTPPayloadsDirectly = False) {
+    fNumRTPSinks = 0; addRTPSink(rtpSink); fRelaysRTPPayloadsDirectly = relaysRTPPayloadsDirectly;
+  }
+  void addRTPSink(RTPSink* rtpSink);
+  void removeRTPSink(RTPSink* rtpSink);
+    // Use these (instead of "setRTPSink()") if our frames are fed - e.g., via a "StreamReplicator" - to more than one "RTPSink"
+  unsigned numOversizePayloadsRelayed() const { return fNumOversizePayloadsRelayed; }
+    // the number of relayed RTP payloads that were too large for our usual front-end packets
 
 private:
   friend class PresentationTimeSessionNormalizer;
@@ -182,7 +231,10 @@ private: // redefined virtual functions:
 private:
   PresentationTimeSessionNormalizer& fParent;
   RTPSource* fRTPSource;
-  RTPSink* fRTPSink;
+  RTPSink** fRTPSinks;
+  unsigned fNumRTPSinks, fMaxNumRTPSinks;
+  Boolean fRelaysRTPPayloadsDirectly;
+  unsigned fNumOversizePayloadsRelayed;
   char const* fCodecName;
   PresentationTimeSubsessionNormalizer* fNext;
 };
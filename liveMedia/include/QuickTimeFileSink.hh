@@ -24,6 +24,9 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #ifndef _MEDIA_SESSION_HH
 #include "MediaSession.hh"
 #endif
+#ifndef _BUFFERED_FILE_WRITER_HH
+#include "BufferedFileWriter.hh"
+#endif
 
 class QuickTimeFileSink: public Medium {
 public:
@@ -37,7 +40,13 @@ public:
 				      Boolean packetLossCompensate = False,
 				      Boolean syncStreams = False,
 				      Boolean generateHintTracks = False,
-				      Boolean generateMP4Format = False);
+				      Boolean generateMP4Format = False,
+				      unsigned fragmentDuration = 0);
+      // If "fragmentDuration" (in seconds) is non-zero, then we write a 'fragmented' MP4 file: The file metadata ("moov")
+      // comes first, followed by a "moof"+"mdat" pair for (approximately) each "fragmentDuration" seconds of media.
+      // Each fragment (if there's H.264 video) begins with a key frame.  Only one fragment is kept in memory at a time,
+      // and the file is playable - up to the last complete fragment - even if we don't get to close it.
+      // (Hint tracks are not generated for fragmented files.)
 
   typedef void (afterPlayingFunc)(void* clientData);
   Boolean startPlaying(afterPlayingFunc* afterFunc,
@@ -51,7 +60,7 @@ private:
 		    unsigned short movieWidth, unsigned short movieHeight,
 		    unsigned movieFPS, Boolean packetLossCompensate,
 		    Boolean syncStreams, Boolean generateHintTracks,
-		    Boolean generateMP4Format);
+		    Boolean generateMP4Format, unsigned fragmentDuration);
       // called only by createNew()
   virtual ~QuickTimeFileSink();
 
@@ -64,6 +73,9 @@ private:
   void onSourceClosure1();
   static void onRTCPBye(void* clientData);
   void completeOutputFile();
+  // Used only for fragmented files:
+  void noteNewSample(struct timeval const& presentationTime, Boolean canBeginFragment);
+  void writeFragment();
 
 private:
   friend class SubsessionIOState;
@@ -81,6 +93,15 @@ private:
   unsigned fNumSubsessions, fNumSyncedSubsessions;
   struct timeval fStartTime;
   Boolean fHaveCompletedOutputFile;
+  BufferedFileWriter* fWriter;
+
+  // Used only for fragmented files:
+  unsigned fFragmentDuration; // seconds
+  Boolean fFragmentsBeginWithKeyFrames;
+  Boolean fHaveWrittenInitialMetadata;
+  Boolean fFragmentHasSamples;
+  struct timeval fFragmentStartTime;
+  unsigned fFragmentSequenceNumber;
 
 private:
   ///// Definitions specific to the QuickTime file format:
@@ -89,7 +110,7 @@ private:
   unsigned addWord(unsigned word);
   unsigned addHalfWord(unsigned short halfWord);
   unsigned addByte(unsigned char byte) {
-    putc(byte, fOutFid);
+    fWriter->writeByte(byte);
     return 1;
   }
   unsigned addZeroWords(unsigned numWords);
@@ -155,6 +176,14 @@ private:
                       _atom(stsc);
                       _atom(stsz);
                       _atom(co64);
+      _atom(mvex); // for fragmented files
+          _atom(trex);
+  _atom(moof); // for fragmented files
+      _atom(mfhd);
+      _atom(traf);
+          _atom(tfhd);
+          _atom(tfdt);
+          _atom(trun);
           _atom(udta);
               _atom(name);
               _atom(hnti);
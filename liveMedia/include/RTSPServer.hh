@@ -48,6 +48,11 @@ public:
   virtual char const* lookupPassword(char const* username);
       // returns NULL if the user name was not present
 
+  char const* lookupHA1(char const* username);
+      // returns md5(<username>:<realm>:<password>) - the value that's used to check digest authentication - or NULL
+      // if the user name was not present.  (Unless "passwordsAreMD5", this is computed from the password returned by
+      // "lookupPassword()" just once, then remembered - until that password changes.)
+
   char const* realm() { return fRealm; }
   Boolean passwordsAreMD5() { return fPasswordsAreMD5; }
 
@@ -55,6 +60,12 @@ protected:
   HashTable* fTable;
   char* fRealm;
   Boolean fPasswordsAreMD5;
+
+private:
+  void forgetHA1(char const* username);
+
+private:
+  HashTable* fHA1Table; // maps user names to "HA1Record"s
 };
 
 #ifndef RTSP_BUFFER_SIZE
@@ -80,6 +91,16 @@ public:
 
   virtual ServerMediaSession* lookupServerMediaSession(char const* streamName);
 
+  typedef void (lookupServerMediaSessionCompletionFunc)(void* clientData, ServerMediaSession* sessionLookedUp);
+  virtual void lookupServerMediaSession(char const* streamName,
+					lookupServerMediaSessionCompletionFunc* completionFunc, void* completionClientData);
+      // An asynchronous version of "lookupServerMediaSession()" - used when handling "DESCRIBE" - for servers that might
+      // have to do some work (e.g., read a file) before the "ServerMediaSession" is available.  "completionFunc" gets called
+      // with the result, either from the event loop, or before this function returns.
+      // (The default implementation just calls the synchronous version.)
+  virtual void cancelLookupServerMediaSession(void* completionClientData);
+      // Cancels any pending "completionFunc" call for "completionClientData"
+
   void removeServerMediaSession(ServerMediaSession* serverMediaSession);
       // Removes the "ServerMediaSession" object from our lookup table, so it will no longer be accessible by new RTSP clients.
       // (However, any *existing* RTSP client sessions that use this "ServerMediaSession" object will continue streaming.
@@ -142,6 +163,16 @@ public:
       // Note: RTSP-over-HTTP tunneling is described in http://developer.apple.com/quicktime/icefloe/dispatch028.html
   portNumBits httpServerPortNum() const; // in host byte order.  (Returns 0 if not present.)
 
+  unsigned numReclaimedClientSessions() const { return fNumReclaimedClientSessions; }
+      // the number of client sessions that we've deleted because no liveness indication was received for them
+      // within "reclamationTestSeconds"
+
+  void adoptClientConnection(int clientSocket, struct sockaddr_in const& clientAddr,
+			     unsigned char const* requestBytes, unsigned numRequestBytes, unsigned numHandOffs);
+      // Handles a TCP connection that was accepted by another server - e.g., one in another process, sharing our port
+      // number - which has already read "requestBytes" from it.  (See "handOffHTTPTunnelingPOST()" below.)
+      // "numHandOffs" is the number of times that the connection has been handed off (including this time).
+
 protected:
   RTSPServer(UsageEnvironment& env,
 	     int ourSocket, Port ourPort,
@@ -170,6 +201,14 @@ protected:
       // another hook that allows subclassed servers to do server-specific access checking
       // - this time after normal digest authentication has already taken place (and would otherwise allow access).
       // (This test can only be used to further restrict access, not to grant additional access.)
+  virtual Boolean handOffHTTPTunnelingPOST(int clientSocket, struct sockaddr_in const& clientAddr,
+					   unsigned char const* requestBytes, unsigned numRequestBytes, unsigned numHandOffs);
+      // Called when a HTTP "POST" (for RTSP-over-HTTP tunneling) has a 'session cookie' that doesn't match that of any
+      // HTTP "GET" that we've seen - e.g., because the "GET" went to another server (in another process) that shares our
+      // port number.  A subclass can redefine this to hand off the connection (and the bytes that we've read from it) to
+      // such a server, which would then call "adoptClientConnection()".  Returns True iff it did so (in which case we
+      // close our copy of "clientSocket").  "numHandOffs" is the number of times that the connection has already been
+      // handed off.  (By default, we return False, and the "POST" is treated as bad.)
 
 private: // redefined virtual functions
   virtual Boolean isRTSPServer() const;
@@ -224,6 +263,7 @@ public: // should be protected, but some old compilers complain otherwise
     virtual Boolean handleHTTPCmd_TunnelingPOST(char const* sessionCookie, unsigned char const* extraData, unsigned extraDataSize);
     virtual void handleHTTPCmd_StreamingGET(char const* urlSuffix, char const* fullRequestStr);
   protected:
+    friend class RTSPServer;
     UsageEnvironment& envir() { return fOurServer.envir(); }
     void resetRequestBuffer();
     void closeSockets();
@@ -232,11 +272,20 @@ public: // should be protected, but some old compilers complain otherwise
     static void handleAlternativeRequestByte(void*, u_int8_t requestByte);
     void handleAlternativeRequestByte1(u_int8_t requestByte);
     void handleRequestBytes(int newBytesRead);
+    void handleHandedOffRequestBytes(unsigned char const* requestBytes, unsigned numRequestBytes, unsigned numHandOffs);
     Boolean authenticationOK(char const* cmdName, char const* urlSuffix, char const* fullRequestStr);
     void changeClientInputSocket(int newSocketNum, unsigned char const* extraData, unsigned extraDataSize);
       // used to implement RTSP-over-HTTP tunneling
     static void continueHandlingREGISTER(ParamsForREGISTER* params);
     virtual void continueHandlingREGISTER1(ParamsForREGISTER* params);
+    // Used to implement "DESCRIBE" without blocking (i.e., while waiting for a session to be looked up, or for its SDP description):
+    static void continueHandlingDESCRIBE(void* clientData, ServerMediaSession* session);
+    virtual void continueHandlingDESCRIBE1(ServerMediaSession* session);
+    static void completeHandlingDESCRIBE(void* clientData);
+    virtual void completeHandlingDESCRIBE1();
+    void setDESCRIBEResponse(ServerMediaSession* session);
+    void afterHandlingDESCRIBE();
+    void releasePendingDESCRIBESession();
 
     // Shortcuts for setting up a RTSP response (prior to sending it):
     void setRTSPResponse(char const* responseStr);
@@ -255,8 +304,15 @@ public: // should be protected, but some old compilers complain otherwise
     unsigned fRecursionCount;
     char const* fCurrentCSeq;
     Authenticator fCurrentAuthenticator; // used if access control is needed
+    struct timeval fNonceCreationTime; // of "fCurrentAuthenticator.nonce()"
+    unsigned fNumFailedAuthenticationsWithNonce;
     char* fOurSessionCookie; // used for optional RTSP-over-HTTP tunneling
     unsigned fBase64RemainderCount; // used for optional RTSP-over-HTTP tunneling (possible values: 0,1,2,3)
+    unsigned fNumHandOffs; // the number of times that this connection was handed off to us (by another server)
+    Boolean fDESCRIBEIsPending; // True while we're waiting for a session (or its SDP description) before responding to "DESCRIBE"
+    Boolean fDESCRIBEResponseIsDeferred; // True if we returned (to the event loop) before responding to the "DESCRIBE"
+    char* fPendingDESCRIBECSeq;
+    ServerMediaSession* fPendingDESCRIBESession; // we hold a reference to this, until we've responded
   };
 
   // The state of an individual client session (using one or more sequential TCP connections) handled by a RTSP server:
@@ -290,7 +346,9 @@ public: // should be protected, but some old compilers complain otherwise
     Boolean isMulticast() const { return fIsMulticast; }
     void noteLiveness();
     static void noteClientLiveness(RTSPClientSession* clientSession);
-    static void livenessTimeoutTask(RTSPClientSession* clientSession);
+    void removeFromLivenessList();
+    void linkToServerMediaSession();
+    void unlinkFromServerMediaSession();
 
     // Shortcuts for setting up a RTSP response (prior to sending it):
     void setRTSPResponse(RTSPClientConnection* ourClientConnection, char const* responseStr) { ourClientConnection->setRTSPResponse(responseStr); }
@@ -305,7 +363,11 @@ public: // should be protected, but some old compilers complain otherwise
     Boolean fIsMulticast, fStreamAfterSETUP;
     unsigned char fTCPStreamIdCount; // used for (optional) RTP/TCP
     Boolean usesTCPTransport() const { return fTCPStreamIdCount > 0; }
-    TaskToken fLivenessCheckTask;
+    struct timeval fLastLivenessTime; // (measured using a 'monotonic' clock, where possible)
+    RTSPClientSession* fPrevInLivenessList; // our server's client sessions are kept in a list, in order of "fLastLivenessTime"
+    RTSPClientSession* fNextInLivenessList;
+    RTSPClientSession* fPrevForSameServerMediaSession; // our server's client sessions for each "ServerMediaSession" are
+    RTSPClientSession* fNextForSameServerMediaSession; // kept in a list (see "fClientSessionsForServerMediaSession")
     unsigned fNumStreamStates;
     struct streamState {
       ServerMediaSubsession* subsession;
@@ -343,6 +405,9 @@ private:
 
   void incomingConnectionHandler(int serverSocket);
 
+  static void livenessSweepTask(RTSPServer* server);
+  void livenessSweepTask1();
+
 protected:
   Port fRTSPServerPort;
 
@@ -359,10 +424,16 @@ private:
   HashTable* fClientConnectionsForHTTPTunneling; // maps client-supplied 'session cookie' strings to "RTSPClientConnection"s
     // (used only for optional RTSP-over-HTTP tunneling)
   HashTable* fClientSessions; // maps 'session id' strings to "RTSPClientSession" objects
+  HashTable* fClientSessionsForServerMediaSession; // maps each "ServerMediaSession" (that's in use) to the first of a list
+    // of the "RTSPClientSession" objects that use it
   HashTable* fPendingRegisterRequests;
   unsigned fRegisterRequestCounter;
   UserAuthenticationDatabase* fAuthDB;
   unsigned fReclamationTestSeconds;
+  RTSPClientSession* fLivenessListHead; // the client session with the oldest liveness indication
+  RTSPClientSession* fLivenessListTail; // the client session with the most recent liveness indication
+  TaskToken fLivenessSweepTask;
+  unsigned fNumReclaimedClientSessions;
 };
 
 
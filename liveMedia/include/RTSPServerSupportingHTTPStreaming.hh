@@ -30,6 +30,11 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #ifndef _TCP_STREAM_SINK_HH
 #include "TCPStreamSink.hh"
 #endif
+#ifndef _HLS_SEGMENTER_HH
+#include "HLSSegmenter.hh"
+#endif
+
+class SegmentByteRangeCache; // forward
 
 class RTSPServerSupportingHTTPStreaming: public RTSPServer {
 public:
@@ -39,6 +44,12 @@ public:
 
   Boolean setHTTPPort(Port httpPort) { return setUpTunnelingOverHTTP(httpPort); }
 
+  void setLiveHLSParameters(unsigned targetSegmentDuration, unsigned numSegmentsInPlaylist,
+			    unsigned idleTimeoutSeconds = 60);
+      // Live (i.e., unbounded) streams are served over HTTP by a single "HLSSegmenter" per stream, shared by all
+      // HTTP clients.  These parameters control the segmenters that get created from now on.  A segmenter - and
+      // the stream that it's reading from - is closed once no HTTP client has accessed it for "idleTimeoutSeconds".
+
 protected:
   RTSPServerSupportingHTTPStreaming(UsageEnvironment& env,
 				    int ourSocket, Port ourPort,
@@ -50,6 +61,26 @@ protected:
 protected: // redefined virtual functions
   virtual RTSPClientConnection* createNewClientConnection(int clientSocket, struct sockaddr_in clientAddr);
 
+protected:
+  HLSSegmenter* lookupLiveHLSSegmenter(ServerMediaSession* session, Boolean createIfNotFound);
+  void closeLiveHLSSegmenter(HLSSegmenter* segmenter);
+
+  Boolean lookupSegmentByteRange(ServerMediaSession* session, ServerMediaSubsession* subsession,
+				 unsigned offsetInSeconds, unsigned durationInSeconds,
+				 char const*& fileName, u_int64_t& startByte, u_int64_t& numBytes);
+      // Returns True iff the specified segment of a (bounded) stream is a contiguous range of bytes within a file.
+      // The result is cached (per stream), so that the index file needs to be consulted only once for each segment.
+
+private:
+  static void liveHLSIdleCheckTask(void* clientData);
+  void liveHLSIdleCheckTask1();
+
+private:
+  HashTable* fLiveHLSSegmenters; // maps stream names to "HLSSegmenter"s
+  unsigned fHLSTargetSegmentDuration, fHLSNumSegmentsInPlaylist, fHLSIdleTimeoutSeconds;
+  TaskToken fLiveHLSIdleCheckTask;
+  HashTable* fSegmentByteRangeCaches; // maps stream names to "SegmentByteRangeCache"s
+
 public: // should be protected, but some old compilers complain otherwise
   class RTSPClientConnectionSupportingHTTPStreaming: public RTSPServer::RTSPClientConnection {
   public:
@@ -61,11 +92,28 @@ public: // should be protected, but some old compilers complain otherwise
 
   protected:
     static void afterStreaming(void* clientData);
+    void afterResponse(Boolean connectionIsUsable);
+        // Called once the body of a response has been sent (or has failed).  If the client asked for a persistent
+        // ('keep-alive') connection, we then wait for its next request; otherwise, we delete ourself.
+
+  private:
+    void handleHTTPCmd_LiveStreamingGET(ServerMediaSession* session, int liveSegmentNumber);
+    void handleHTTPCmd_FileSegmentGET(char const* fileName, u_int64_t startByte, u_int64_t numBytes,
+				      char const* streamName, char const* fullRequestStr);
+    void sendMemoryBuffer(u_int8_t* buffer, unsigned bufferSize, Boolean deleteBufferOnClose);
+    void sendFileData();
+    static void fileSocketWritableHandler(void* clientData, int mask);
+    void closeFile();
+    char const* connectionHeader() const;
 
   private:
     u_int32_t fClientSessionId;
     ByteStreamMemoryBufferSource* fPlaylistSource;
     TCPStreamSink* fTCPSink;
+    HLSSegment* fLiveSegment; // the live HLS segment (if any) that we're currently sending
+    FILE* fFileFid; // the file (if any) that we're currently sending a byte range from
+    u_int64_t fFileBytePosition, fFileBytesLeft;
+    Boolean fKeepAlive; // whether the client wants to reuse this connection for its next request
   };
 };
 
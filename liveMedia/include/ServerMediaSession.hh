@@ -55,6 +55,15 @@ public:
   char* generateSDPDescription(); // based on the entire session
       // Note: The caller is responsible for freeing the returned string
 
+  typedef void (sdpDescriptionReadyFunc)(void* clientData);
+  Boolean prepareSDPDescription(sdpDescriptionReadyFunc* readyFunc, void* readyClientData);
+      // Calls "prepareSDPLines()" on each subsession, so that a subsequent call to "generateSDPDescription()" won't have to
+      // wait (e.g., for data to be read from a file).  Returns True if this is already the case.  Otherwise, returns False,
+      // and "(*readyFunc)(readyClientData)" will be called later, from the event loop, once any one of the subsessions has
+      // become ready.  (In that case, this function should then be called again.)
+  void cancelPrepareSDPDescription(void* readyClientData);
+      // Cancels any pending "readyFunc" call(s) for "readyClientData"
+
   char const* streamName() const { return fStreamName; }
 
   Boolean addSubsession(ServerMediaSubsession* subsession);
@@ -126,6 +135,17 @@ public:
   unsigned trackNumber() const { return fTrackNumber; }
   char const* trackId();
   virtual char const* sdpLines() = 0;
+  typedef void (sdpLinesReadyFunc)(void* clientData);
+  virtual Boolean prepareSDPLines(sdpLinesReadyFunc* readyFunc, void* readyClientData);
+      // Ensures that a subsequent call to "sdpLines()" won't have to wait (e.g., for data to be read from a file).
+      // Returns True if this is already the case (in which case "readyFunc" is not called).  Otherwise, returns False,
+      // and "(*readyFunc)(readyClientData)" will be called - once - later, from the event loop, when "sdpLines()" is ready.
+      // (The default implementation returns True.)
+  virtual void cancelPrepareSDPLines(void* readyClientData);
+      // Cancels any pending "readyFunc" call for "readyClientData"
+  virtual void setSDPLines(char const* sdpLines);
+      // Sets the result of "sdpLines()" to a previously-computed value (e.g., one that was saved by an earlier call to
+      // "sdpLines()" for the same file), so that it need not be computed again.  (The default implementation does nothing.)
   virtual void getStreamParameters(unsigned clientSessionId, // in
 				   netAddressBits clientAddress, // in
 				   Port const& clientRTPPort, // in
@@ -172,6 +192,11 @@ public:
     // returns > 0 for a bounded session
   virtual void getAbsoluteTimeRange(char*& absStartTime, char*& absEndTime) const;
     // Subclasses can reimplement this iff they support seeking by 'absolute' time.
+  virtual Boolean getFileByteRange(double seekNPT, double streamDuration,
+				   char const*& fileName, u_int64_t& startByte, u_int64_t& numBytes);
+    // If the data that would be streamed from "seekNPT" (for "streamDuration" seconds) is a contiguous range of bytes
+    // within a file - that can be delivered as is, without creating a source - returns True, and sets the other parameters.
+    // Subclasses can reimplement this iff they can determine this range (the default implementation returns False).
 
   // The following may be called by (e.g.) SIP servers, for which the
   // address and port number fields in SDP descriptions need to be non-zero:
@@ -26,18 +26,31 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #endif
 
 class StreamReplica; // forward
+class GOPCache; // forward
 
 class StreamReplicator: public Medium {
 public:
-  static StreamReplicator* createNew(UsageEnvironment& env, FramedSource* inputSource, Boolean deleteWhenLastReplicaDies = True);
+  static StreamReplicator* createNew(UsageEnvironment& env, FramedSource* inputSource, Boolean deleteWhenLastReplicaDies = True,
+				     unsigned maxQueuedFrames = 32);
+    // "maxQueuedFrames" is rounded up to a power of 2 (if it isn't one already).
     // If "deleteWhenLastReplicaDies" is True (the default), then the "StreamReplicator" object is deleted when (and only when)
     //   all replicas have been deleted.  (In this case, you must *not* call "Medium::close()" on the "StreamReplicator" object,
     //   unless you never created any replicas from it to begin with.)
     // If "deleteWhenLastReplicaDies" is False, then the "StreamReplicator" object remains in existence, even when all replicas
     //   have been deleted.  (This allows you to create new replicas later, if you wish.)  In this case, you delete the
     //   "StreamReplicator" object by calling "Medium::close()" on it - but you must do so only when "numReplicas()" returns 0.
-
-  FramedSource* createStreamReplica();
+    // Each incoming frame is read once, into a (reference-counted) buffer in a queue of up to "maxQueuedFrames" frames, from
+    //   which each replica reads - independently - at its own pace.  A replica that falls "maxQueuedFrames" behind the fastest
+    //   replica is handled according to its "LagPolicy" (see below).
+
+  enum LagPolicy {
+    LAG_STALLS_INPUT,       // stop reading new frames until the lagging replica catches up (so no replica ever loses frames)
+    LAG_DROPS_OLDEST_FRAMES, // the lagging replica loses its oldest unread frame(s), so the other replicas are not held up
+    LAG_SKIPS_TO_KEY_FRAME  // like "LAG_DROPS_OLDEST_FRAMES", except that the lagging replica skips ahead to the most recent
+                            //   key frame (or else waits for the next one).  This requires "useGOPCache()" to have been called
+                            //   (otherwise it's treated like "LAG_DROPS_OLDEST_FRAMES").
+  };
+  FramedSource* createStreamReplica(LagPolicy lagPolicy = LAG_STALLS_INPUT);
 
   unsigned numReplicas() const { return fNumReplicas; }
 
@@ -46,8 +59,16 @@ public:
   // Call before destruction if you want to prevent the destructor from closing the input source
   void detachInputSource() { fInputSource = NULL; }
 
+  Boolean useGOPCache(char const* codecName, unsigned maxCacheSize = 4000000);
+    // Keeps a cache of the input frames since the most recent key frame (see "GOPCache.hh"), and delivers these - in a
+    // burst - to each replica when it starts (or restarts) reading, so that its consumer can begin decoding immediately,
+    // rather than having to wait for the next key frame.  Returns False (and does nothing) if we don't know how to
+    // recognize key frames for "codecName".
+    // ("maxCacheSize" may be 0, if you want only to recognize key frames - for "LAG_SKIPS_TO_KEY_FRAME" - without caching.)
+
 protected:
-  StreamReplicator(UsageEnvironment& env, FramedSource* inputSource, Boolean deleteWhenLastReplicaDies);
+  StreamReplicator(UsageEnvironment& env, FramedSource* inputSource, Boolean deleteWhenLastReplicaDies,
+		   unsigned maxQueuedFrames);
     // called only by "createNew()"
   virtual ~StreamReplicator();
 
@@ -69,16 +90,42 @@ private:
   static void onSourceClosure(void* clientData);
   void onSourceClosure();
 
-  void deliverReceivedFrame();
+  static void deliverQueuedFrame(void* clientData);
+  void deliverQueuedFrame(StreamReplica* replica);
+  Boolean deliverCachedFrame(StreamReplica* replica);
+
+  void readNextFrameIfNeeded();
+  Boolean makeRoomInQueue();
+  void skipLaggingReplica(StreamReplica* replica);
+  void releaseQueuedFrame(unsigned frameNum);
 
 private:
   FramedSource* fInputSource;
   Boolean fDeleteWhenLastReplicaDies, fInputSourceHasClosed; 
-  unsigned fNumReplicas, fNumActiveReplicas, fNumDeliveriesMadeSoFar;
-  int fFrameIndex; // 0 or 1; used to figure out if a replica is requesting the current frame, or the next frame
-
-  StreamReplica* fMasterReplica; // the first replica that requests each frame.  We use its buffer when copying to the others.
-  StreamReplica* fReplicasAwaitingCurrentFrame; // other than the 'master' replica
-  StreamReplica* fReplicasAwaitingNextFrame; // replicas that have already received the current frame, and have asked for the next
+  unsigned fNumReplicas, fNumActiveReplicas;
+  StreamReplica* fReplicas; // a list of all of our replicas
+
+  // The queue of incoming frames.  Frames are numbered consecutively (modulo 2^32); frame #n is kept in
+  // "fQueue[n%fMaxQueuedFrames]" while it remains in the queue (i.e., while some active replica has yet to read it).
+  // "fMaxQueuedFrames" is a power of 2 (dividing 2^32), so that this slot doesn't change when frame numbers wrap around:
+  struct QueuedFrame {
+    unsigned char* buffer;
+    unsigned bufferSize;
+    unsigned frameSize, numTruncatedBytes;
+    struct timeval presentationTime;
+    unsigned durationInMicroseconds;
+    unsigned refCount; // the number of active replicas that have yet to read (or skip) this frame
+    Boolean beginsGOP;
+  };
+  QueuedFrame* fQueue;
+  unsigned fMaxQueuedFrames;
+  QueuedFrame& queuedFrame(unsigned frameNum) const { return fQueue[frameNum&(fMaxQueuedFrames-1)]; }
+  unsigned fQueueHead, fQueueTail; // the numbers of the oldest queued frame, and of the next frame to be read
+  unsigned fMaxFrameSize; // the largest buffer size of any replica that has read from us
+  StreamReplica* fReplicasAwaitingNextFrame; // active replicas that have read every queued frame, and now want frame #"fQueueTail"
+  StreamReplica* fReplicasBeingDelivered; // replicas to which a newly-arrived frame is currently being delivered
+  Boolean fIsDeliveringNewFrame;
+
+  GOPCache* fGOPCache; // optional
 };
 #endif
@@ -25,7 +25,10 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #include "MediaSink.hh"
 #endif
 
-#define TCP_STREAM_SINK_BUFFER_SIZE 10000
+#define TCP_STREAM_SINK_BUFFER_SIZE 10000 // the size of each of our buffer 'chunks'
+#define TCP_STREAM_SINK_DEFAULT_READ_AHEAD_BUDGET 100000
+
+class TCPStreamSinkChunk; // forward
 
 class TCPStreamSink: public MediaSink {
 public:
@@ -33,6 +36,19 @@ public:
   // "socketNum" is the socket number of an existing, writable TCP socket (which should be non-blocking).
   // The caller is responsible for closing this socket later (when this object no longer exists).
 
+  void setReadAheadBudget(unsigned readAheadBudget) { fReadAheadBudget = readAheadBudget; }
+      // The maximum number of bytes that we'll read (ahead) from our source while they're waiting to be written
+      // to the socket.  (The default is TCP_STREAM_SINK_DEFAULT_READ_AHEAD_BUDGET.)
+
+  virtual void stopPlaying(); // redefined virtual function; discards any data that we haven't yet written
+
+  // Statistics:
+  u_int64_t numBytesWritten() const { return fNumBytesWritten; }
+  unsigned backlogSize() const { return fNumBufferedBytes; } // bytes read from our source, but not yet written
+  unsigned maxBacklogSize() const { return fMaxNumBufferedBytes; }
+  unsigned numWriteStalls() const { return fNumWriteStalls; } // the number of times that the socket has been full
+  unsigned averageThroughputKbps() const; // since we were created
+
 protected:
   TCPStreamSink(UsageEnvironment& env, int socketNum); // called only by "createNew()"
   virtual ~TCPStreamSink();
@@ -43,6 +59,8 @@ protected:
 
 private:
   void processBuffer(); // common routine, called from both the 'socket writable' and 'incoming data' handlers below
+  void writeBufferedData();
+  void discardBufferedData();
 
   static void socketWritableHandler(void* clientData, int mask);
   void socketWritableHandler1();
@@ -54,14 +72,16 @@ private:
   static void ourOnSourceClosure(void* clientData);
   void ourOnSourceClosure1();
 
-  unsigned numUnwrittenBytes() const { return fUnwrittenBytesEnd - fUnwrittenBytesStart; }
-  unsigned freeBufferSpace() const { return TCP_STREAM_SINK_BUFFER_SIZE - fUnwrittenBytesEnd; }
-
 private:
-  unsigned char fBuffer[TCP_STREAM_SINK_BUFFER_SIZE];
-  unsigned fUnwrittenBytesStart, fUnwrittenBytesEnd;
+  TCPStreamSinkChunk* fHeadChunk; // the oldest unwritten data
+  TCPStreamSinkChunk* fTailChunk; // the chunk that we're currently reading into
+  TCPStreamSinkChunk* fSpareChunks; // chunks that have been written, for reuse
+  unsigned fNumBufferedBytes, fReadAheadBudget;
   Boolean fInputSourceIsOpen, fOutputSocketIsWritable;
   int fOutputSocketNum;
+  u_int64_t fNumBytesWritten;
+  unsigned fMaxNumBufferedBytes, fNumWriteStalls;
+  struct timeval fCreationTime;
 };
 
 #endif
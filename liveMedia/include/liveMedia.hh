@@ -48,6 +48,7 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #include "SimpleRTPSink.hh"
 #include "uLawAudioFilter.hh"
 #include "MPEG2IndexFromTransportStream.hh"
+#include "MPEG2TransportStreamIndexer.hh"
 #include "MPEG2TransportStreamTrickModeFilter.hh"
 #include "ByteStreamMultiFileSource.hh"
 #include "ByteStreamMemoryBufferSource.hh"
@@ -92,9 +93,11 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #include "MPEG1or2VideoStreamDiscreteFramer.hh"
 #include "MPEG4VideoStreamDiscreteFramer.hh"
 #include "DeviceSource.hh"
+#include "FrameQueueSource.hh"
 #include "AudioInputDevice.hh"
 #include "WAVAudioFileSource.hh"
 #include "StreamReplicator.hh"
+#include "GOPCache.hh"
 #include "RTSPRegisterSender.hh"
 #include "RTSPServerSupportingHTTPStreaming.hh"
 #include "RTSPClient.hh"
@@ -112,6 +115,7 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #include "AMRAudioRTPSink.hh"
 #include "T140TextRTPSink.hh"
 #include "TCPStreamSink.hh"
+#include "HLSSegmenter.hh"
 #include "MP3AudioFileServerMediaSubsession.hh"
 #include "MPEG1or2VideoFileServerMediaSubsession.hh"
 #include "MPEG1or2FileServerDemux.hh"
@@ -20,36 +20,12 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 // Implementation
 
 #include "ourMD5.hh"
-#include <NetCommon.h> // for u_int32_t, u_int64_t
 #include <string.h>
 
 #define DIGEST_SIZE_IN_BYTES 16
 #define DIGEST_SIZE_IN_HEX_DIGITS (2*DIGEST_SIZE_IN_BYTES)
 #define DIGEST_SIZE_AS_STRING (DIGEST_SIZE_IN_HEX_DIGITS+1)
 
-// The state of a MD5 computation in progress:
-
-class MD5Context {
-public:
-  MD5Context();
-  ~MD5Context();
-
-  void addData(unsigned char const* inputData, unsigned inputDataSize);
-  void end(char* outputDigest /*must point to an array of size DIGEST_SIZE_AS_STRING*/);
-
-private:
-  void finalize(unsigned char* outputDigestInBytes);
-      // Like "end()", except that the argument is a byte array, of size DIGEST_SIZE_IN_BYTES.
-      // This function is used to implement "end()".
-  void zeroize(); // to remove potentially sensitive information
-  void transform64Bytes(unsigned char const block[64]); // does the actual MD5 transform
-
-private:
-  u_int32_t fState[4]; // ABCD
-  u_int64_t fBitCount; // number of bits, modulo 2^64
-  unsigned char fWorkingBuffer[64];
-};
-
 char* our_MD5Data(unsigned char const* data, unsigned dataSize, char* outputDigest) {
   MD5Context ctx;
 
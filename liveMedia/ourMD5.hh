@@ -22,8 +22,36 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #ifndef _OUR_MD5_HH
 #define _OUR_MD5_HH
 
+#include <NetCommon.h> // for u_int32_t, u_int64_t
+
 extern char* our_MD5Data(unsigned char const* data, unsigned dataSize, char* outputDigest);
     // "outputDigest" must be either NULL (in which case this function returns a heap-allocated
     // buffer, which should be later delete[]d by the caller), or else it must point to
     // a (>=)33-byte buffer (which this function will also return).
+
+// The state of a MD5 computation in progress.  (This can be used - instead of "our_MD5Data()" - to compute the digest of
+// data that's in several pieces, without first copying it into one buffer.)
+
+class MD5Context {
+public:
+  MD5Context();
+  ~MD5Context();
+
+  void addData(unsigned char const* inputData, unsigned inputDataSize);
+  void addData(char const* inputStr, unsigned inputStrSize) { addData((unsigned char const*)inputStr, inputStrSize); }
+  void end(char* outputDigest /*must point to an array of size (>=)33*/);
+
+private:
+  void finalize(unsigned char* outputDigestInBytes);
+      // Like "end()", except that the argument is a byte array, of size 16.
+      // This function is used to implement "end()".
+  void zeroize(); // to remove potentially sensitive information
+  void transform64Bytes(unsigned char const block[64]); // does the actual MD5 transform
+
+private:
+  u_int32_t fState[4]; // ABCD
+  u_int64_t fBitCount; // number of bits, modulo 2^64
+  unsigned char fWorkingBuffer[64];
+};
+
 #endif
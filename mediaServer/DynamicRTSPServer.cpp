@@ -19,34 +19,153 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 // Implementation
 
 #include "DynamicRTSPServer.hh"
+#include "MediaCatalog.hh"
 #include <liveMedia.hh>
+#include <GroupsockHelper.hh>
 #include <string.h>
+#if !defined(__WIN32__) && !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define HAVE_CONNECTION_HAND_OFF 1
+#endif
 
 DynamicRTSPServer*
 DynamicRTSPServer::createNew(UsageEnvironment& env, Port ourPort,
 			     UserAuthenticationDatabase* authDatabase,
-			     unsigned reclamationTestSeconds) {
+			     unsigned reclamationTestSeconds, char const* catalogFileName, Boolean catalogIsReadOnly) {
   int ourSocket = setUpOurSocket(env, ourPort);
   if (ourSocket == -1) return NULL;
 
-  return new DynamicRTSPServer(env, ourSocket, ourPort, authDatabase, reclamationTestSeconds);
+  return new DynamicRTSPServer(env, ourSocket, ourPort, authDatabase, reclamationTestSeconds,
+			       catalogFileName, catalogIsReadOnly);
 }
 
 DynamicRTSPServer::DynamicRTSPServer(UsageEnvironment& env, int ourSocket,
 				     Port ourPort,
-				     UserAuthenticationDatabase* authDatabase, unsigned reclamationTestSeconds)
-  : RTSPServerSupportingHTTPStreaming(env, ourSocket, ourPort, authDatabase, reclamationTestSeconds) {
-}
-
-DynamicRTSPServer::~DynamicRTSPServer() {
+				     UserAuthenticationDatabase* authDatabase, unsigned reclamationTestSeconds,
+				     char const* catalogFileName, Boolean catalogIsReadOnly)
+  : RTSPServerSupportingHTTPStreaming(env, ourSocket, ourPort, authDatabase, reclamationTestSeconds),
+    fSMSCreationRecords(NULL), fCatalog(NULL), fOurHandOffSocket(-1), fNextWorkerHandOffSocket(-1), fNumWorkers(1) {
+  if (catalogFileName != NULL) fCatalog = MediaCatalog::createNew(*this, catalogFileName, catalogIsReadOnly);
 }
 
 static ServerMediaSession* createNewSMS(UsageEnvironment& env,
 					char const* fileName, FILE* fid); // forward
+static Boolean isMatroskaFileName(char const* fileName); // forward
+static Boolean isOggFileName(char const* fileName); // forward
+static ServerMediaSession* createNewMatroskaSMS(UsageEnvironment& env,
+						char const* fileName, MatroskaFileServerDemux* demux); // forward
+static ServerMediaSession* createNewOggSMS(UsageEnvironment& env,
+					   char const* fileName, OggFileServerDemux* demux); // forward
+
+// A record of a (Matroska or Ogg) file that we're currently parsing - from the event loop - in order to create a
+// "ServerMediaSession" for it, and of the clients who are waiting for the result:
+class SMSCreationRecord {
+public:
+  SMSCreationRecord(DynamicRTSPServer* ourServer, char const* fileName)
+    : fOurServer(ourServer), fFileName(strDup(fileName)), fNext(NULL), fWaiters(NULL) {
+  }
+  virtual ~SMSCreationRecord() {
+    removeWaiter(NULL);
+    delete[] fFileName;
+  }
+
+  void addWaiter(RTSPServer::lookupServerMediaSessionCompletionFunc* completionFunc, void* completionClientData) {
+    // Add the new waiter to the end of our list, so that waiters get called in the order that they arrived:
+    Waiter* waiter = new Waiter;
+    waiter->next = NULL;
+    waiter->completionFunc = completionFunc;
+    waiter->completionClientData = completionClientData;
+    Waiter** ptr = &fWaiters;
+    while (*ptr != NULL) ptr = &(*ptr)->next;
+    *ptr = waiter;
+  }
+  void removeWaiter(void* completionClientData) { // if "completionClientData" is NULL, removes all waiters
+    Waiter** ptr = &fWaiters;
+    while (*ptr != NULL) {
+      Waiter* waiter = *ptr;
+      if (completionClientData == NULL || waiter->completionClientData == completionClientData) {
+	*ptr = waiter->next;
+	delete waiter;
+      } else {
+	ptr = &waiter->next;
+      }
+    }
+  }
+  static void onMatroskaDemuxCreation(MatroskaFileServerDemux* newDemux, void* clientData) {
+    SMSCreationRecord* record = (SMSCreationRecord*)clientData;
+    if (record->fOurServer == NULL) { // the server has since been deleted
+      Medium::close(newDemux);
+      delete record;
+      return;
+    }
+
+    record->fOurServer->completeSMSCreation(record, createNewMatroskaSMS(newDemux->envir(), record->fFileName, newDemux));
+  }
+  static void onOggDemuxCreation(OggFileServerDemux* newDemux, void* clientData) {
+    SMSCreationRecord* record = (SMSCreationRecord*)clientData;
+    if (record->fOurServer == NULL) { // the server has since been deleted
+      Medium::close(newDemux);
+      delete record;
+      return;
+    }
+
+    record->fOurServer->completeSMSCreation(record, createNewOggSMS(newDemux->envir(), record->fFileName, newDemux));
+  }
+
+  void callWaiters(ServerMediaSession* sms) {
+    while (fWaiters != NULL) {
+      Waiter* waiter = fWaiters; fWaiters = waiter->next;
+      (*waiter->completionFunc)(waiter->completionClientData, sms);
+      delete waiter;
+    }
+  }
+
+public:
+  DynamicRTSPServer* fOurServer; // NULL if the server has since been deleted
+  char* fFileName;
+  SMSCreationRecord* fNext;
+
+private:
+  struct Waiter {
+    Waiter* next;
+    RTSPServer::lookupServerMediaSessionCompletionFunc* completionFunc;
+    void* completionClientData;
+  } * fWaiters;
+};
+
+DynamicRTSPServer::~DynamicRTSPServer() {
+  if (fOurHandOffSocket >= 0) {
+    envir().taskScheduler().turnOffBackgroundReadHandling(fOurHandOffSocket);
+    ::closeSocket(fOurHandOffSocket);
+  }
+  if (fNextWorkerHandOffSocket >= 0) ::closeSocket(fNextWorkerHandOffSocket);
+
+  delete fCatalog;
+
+  // Any files that we're still parsing will be closed (without creating a "ServerMediaSession") once parsing completes:
+  for (SMSCreationRecord* record = fSMSCreationRecords; record != NULL; record = record->fNext) {
+    record->fOurServer = NULL;
+    record->removeWaiter(NULL);
+  }
+}
 
 ServerMediaSession*
 DynamicRTSPServer::lookupServerMediaSession(char const* streamName) {
-  // First, check whether the specified "streamName" exists as a local file:
+  if (fCatalog != NULL && fCatalog->isComplete() && fCatalog->lookup(streamName) != NULL) {
+    // Our catalog lists this file (and would have noticed if it had since been removed), so we don't need to check for it:
+    ServerMediaSession* sms = RTSPServer::lookupServerMediaSession(streamName);
+    if (sms == NULL) {
+      sms = createNewSMS(envir(), streamName, NULL);
+      fCatalog->presetSDPLines(sms);
+      addServerMediaSession(sms);
+    }
+    return sms;
+  }
+
+  // First, check whether the specified "streamName" exists as a local file.  (We do this even if we have a complete catalog,
+  // because that doesn't list files within symbolically-linked directories.)
   FILE* fid = fopen(streamName, "rb");
   Boolean fileExists = fid != NULL;
 
@@ -65,6 +184,7 @@ DynamicRTSPServer::lookupServerMediaSession(char const* streamName) {
     if (!smsExists) {
       // Create a new "ServerMediaSession" object for streaming from the named file.
       sms = createNewSMS(envir(), streamName, fid);
+      if (fCatalog != NULL) fCatalog->presetSDPLines(sms);
       addServerMediaSession(sms);
     }
     fclose(fid);
@@ -72,6 +192,204 @@ DynamicRTSPServer::lookupServerMediaSession(char const* streamName) {
   }
 }
 
+void DynamicRTSPServer
+::lookupServerMediaSession(char const* streamName,
+			   lookupServerMediaSessionCompletionFunc* completionFunc, void* completionClientData) {
+  // Matroska and Ogg files have to be parsed before we can create a "ServerMediaSession" for them.  For these files (unless we
+  // already have a "ServerMediaSession"), we do this from the event loop, rather than waiting (in "createNewSMS()") for it.
+  // Everything else is handled by the synchronous version of this function:
+  if ((!isMatroskaFileName(streamName) && !isOggFileName(streamName))
+      || RTSPServer::lookupServerMediaSession(streamName) != NULL) {
+    (*completionFunc)(completionClientData, lookupServerMediaSession(streamName));
+    return;
+  }
+
+  Boolean fileExists;
+  if (fCatalog != NULL && fCatalog->isComplete() && fCatalog->lookup(streamName) != NULL) {
+    fileExists = True;
+  } else {
+    FILE* fid = fopen(streamName, "rb");
+    fileExists = fid != NULL;
+    if (fid != NULL) fclose(fid);
+  }
+  if (!fileExists) {
+    (*completionFunc)(completionClientData, NULL);
+    return;
+  }
+
+  // If we're already parsing this file (for another client), then just wait for that to complete:
+  SMSCreationRecord* record;
+  for (record = fSMSCreationRecords; record != NULL; record = record->fNext) {
+    if (strcmp(record->fFileName, streamName) == 0) break;
+  }
+  if (record != NULL) {
+    record->addWaiter(completionFunc, completionClientData);
+    return;
+  }
+
+  record = new SMSCreationRecord(this, streamName);
+  record->fNext = fSMSCreationRecords;
+  fSMSCreationRecords = record;
+  record->addWaiter(completionFunc, completionClientData);
+
+  // Note: The following calls might complete (and delete "record") before they return:
+  if (isMatroskaFileName(streamName)) {
+    MatroskaFileServerDemux::createNew(envir(), record->fFileName, SMSCreationRecord::onMatroskaDemuxCreation, record);
+  } else {
+    OggFileServerDemux::createNew(envir(), record->fFileName, SMSCreationRecord::onOggDemuxCreation, record);
+  }
+}
+
+void DynamicRTSPServer::cancelLookupServerMediaSession(void* completionClientData) {
+  for (SMSCreationRecord* record = fSMSCreationRecords; record != NULL; record = record->fNext) {
+    record->removeWaiter(completionClientData);
+  }
+}
+
+void DynamicRTSPServer::completeSMSCreation(SMSCreationRecord* record, ServerMediaSession* sms) {
+  SMSCreationRecord** ptr = &fSMSCreationRecords;
+  while (*ptr != NULL && *ptr != record) ptr = &(*ptr)->fNext;
+  if (*ptr != NULL) *ptr = record->fNext;
+
+  if (fCatalog != NULL) fCatalog->presetSDPLines(sms);
+  addServerMediaSession(sms);
+  record->callWaiters(sms);
+  delete record;
+}
+
+// Each connection that's handed off to another worker is sent as a single datagram - this header, followed by the bytes that
+// have already been read from the connection - with the connection's socket passed (as 'ancillary data') alongside:
+struct HandOffHeader {
+  struct sockaddr_in clientAddr;
+  unsigned numHandOffs; // including this one
+};
+
+void DynamicRTSPServer::setUpHandOffToOtherWorkers(int ourHandOffSocket, int nextWorkerHandOffSocket, unsigned numWorkers) {
+#ifdef HAVE_CONNECTION_HAND_OFF
+  fOurHandOffSocket = ourHandOffSocket;
+  fNextWorkerHandOffSocket = nextWorkerHandOffSocket;
+  fNumWorkers = numWorkers;
+
+  makeSocketNonBlocking(fOurHandOffSocket);
+  envir().taskScheduler().turnOnBackgroundReadHandling(fOurHandOffSocket,
+						       (TaskScheduler::BackgroundHandlerProc*)&incomingHandOffHandler, this);
+#endif
+}
+
+Boolean DynamicRTSPServer::handOffHTTPTunnelingPOST(int clientSocket, struct sockaddr_in const& clientAddr,
+						    unsigned char const* requestBytes, unsigned numRequestBytes,
+						    unsigned numHandOffs) {
+#ifdef HAVE_CONNECTION_HAND_OFF
+  // If the connection has already been to every other worker, then none of us saw the "GET":
+  if (fNextWorkerHandOffSocket < 0 || numHandOffs + 1 >= fNumWorkers) return False;
+
+  HandOffHeader header;
+  header.clientAddr = clientAddr;
+  header.numHandOffs = numHandOffs + 1;
+
+  struct iovec iov[2];
+  iov[0].iov_base = (char*)&header; iov[0].iov_len = sizeof header;
+  iov[1].iov_base = (char*)requestBytes; iov[1].iov_len = numRequestBytes;
+
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof (int))];
+  } control;
+  memset(&control, 0, sizeof control);
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof msg);
+  msg.msg_iov = iov; msg.msg_iovlen = 2;
+  msg.msg_control = control.buf; msg.msg_controllen = sizeof control.buf;
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof (int));
+  memmove(CMSG_DATA(cmsg), &clientSocket, sizeof (int));
+
+  // Don't wait if the next worker is too busy to keep up; instead, just fail the "POST":
+  int result = sendmsg(fNextWorkerHandOffSocket, &msg, MSG_DONTWAIT);
+  if (result != (int)(sizeof header + numRequestBytes)) {
+    envir() << "DynamicRTSPServer: Failed to hand off a connection to another worker (errno " << envir().getErrno() << ")\n";
+    return False;
+  }
+  return True;
+#else
+  return False;
+#endif
+}
+
+void DynamicRTSPServer::incomingHandOffHandler(void* instance, int /*mask*/) {
+  ((DynamicRTSPServer*)instance)->incomingHandOffHandler1();
+}
+
+void DynamicRTSPServer::incomingHandOffHandler1() {
+#ifdef HAVE_CONNECTION_HAND_OFF
+  HandOffHeader header;
+  unsigned char requestBytes[RTSP_BUFFER_SIZE];
+  struct iovec iov[2];
+  iov[0].iov_base = (char*)&header; iov[0].iov_len = sizeof header;
+  iov[1].iov_base = (char*)requestBytes; iov[1].iov_len = sizeof requestBytes;
+
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof (int))];
+  } control;
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof msg);
+  msg.msg_iov = iov; msg.msg_iovlen = 2;
+  msg.msg_control = control.buf; msg.msg_controllen = sizeof control.buf;
+
+  int result = recvmsg(fOurHandOffSocket, &msg, MSG_DONTWAIT);
+  if (result < 0) return;
+
+  int clientSocket = -1;
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len == CMSG_LEN(sizeof (int))) {
+      memmove(&clientSocket, CMSG_DATA(cmsg), sizeof (int));
+    }
+  }
+  if (clientSocket < 0) return;
+  if ((unsigned)result < sizeof header || (msg.msg_flags&(MSG_TRUNC|MSG_CTRUNC)) != 0) {
+    // A bad message (which shouldn't happen):
+    ::closeSocket(clientSocket);
+    return;
+  }
+
+  adoptClientConnection(clientSocket, header.clientAddr, requestBytes, result - sizeof header, header.numHandOffs);
+#endif
+}
+
+Boolean DynamicRTSPServer::isMediaFileName(char const* fileName) {
+  // Note: This must be kept consistent with "createNewSMS()" (below)
+  static char const* const extensions[] = {
+    ".aac", ".amr", ".ac3", ".m4e", ".264", ".265", ".mp3", ".mpg", ".vob", ".ts", ".wav", ".dv", NULL
+  };
+
+  char const* extension = strrchr(fileName, '.');
+  if (extension == NULL) return False;
+
+  for (char const* const* ext = extensions; *ext != NULL; ++ext) {
+    if (strcmp(extension, *ext) == 0) return True;
+  }
+  return isMatroskaFileName(fileName) || isOggFileName(fileName);
+}
+
+static Boolean isMatroskaFileName(char const* fileName) {
+  char const* extension = strrchr(fileName, '.');
+  if (extension == NULL) return False;
+
+  return strcmp(extension, ".mkv") == 0 || strcmp(extension, ".webm") == 0;
+}
+
+static Boolean isOggFileName(char const* fileName) {
+  char const* extension = strrchr(fileName, '.');
+  if (extension == NULL) return False;
+
+  return strcmp(extension, ".ogg") == 0 || strcmp(extension, ".ogv") == 0 || strcmp(extension, ".opus") == 0;
+}
+
 // Special code for handling Matroska files:
 struct MatroskaDemuxCreationState {
   MatroskaFileServerDemux* demux;
@@ -96,6 +414,7 @@ static void onOggDemuxCreation(OggFileServerDemux* newDemux, void* clientData) {
 }
 // END Special code for handling Ogg files:
 
+
 #define NEW_SMS(description) do {\
 char const* descStr = description\
     ", streamed by the LIVE555 Media Server";\
@@ -194,10 +513,8 @@ static ServerMediaSession* createNewSMS(UsageEnvironment& env,
 
     NEW_SMS("DV Video");
     sms->addSubsession(DVVideoFileServerMediaSubsession::createNew(env, fileName, reuseSource));
-  } else if (strcmp(extension, ".mkv") == 0 || strcmp(extension, ".webm") == 0) {
+  } else if (isMatroskaFileName(fileName)) {
     // Assumed to be a Matroska file (note that WebM ('.webm') files are also Matroska files)
-    NEW_SMS("Matroska video+audio+(optional)subtitles");
-
     // Create a Matroska file server demultiplexor for the specified file.
     // (We enter the event loop to wait for this to complete.)
     MatroskaDemuxCreationState creationState;
@@ -205,14 +522,9 @@ static ServerMediaSession* createNewSMS(UsageEnvironment& env,
     MatroskaFileServerDemux::createNew(env, fileName, onMatroskaDemuxCreation, &creationState);
     env.taskScheduler().doEventLoop(&creationState.watchVariable);
 
-    ServerMediaSubsession* smss;
-    while ((smss = creationState.demux->newServerMediaSubsession()) != NULL) {
-      sms->addSubsession(smss);
-    }
-  } else if (strcmp(extension, ".ogg") == 0 || strcmp(extension, ".ogv") == 0 || strcmp(extension, ".opus") == 0) {
+    sms = createNewMatroskaSMS(env, fileName, creationState.demux);
+  } else if (isOggFileName(fileName)) {
     // Assumed to be an Ogg file
-    NEW_SMS("Ogg video and/or audio");
-
     // Create a Ogg file server demultiplexor for the specified file.
     // (We enter the event loop to wait for this to complete.)
     OggDemuxCreationState creationState;
@@ -220,10 +532,33 @@ static ServerMediaSession* createNewSMS(UsageEnvironment& env,
     OggFileServerDemux::createNew(env, fileName, onOggDemuxCreation, &creationState);
     env.taskScheduler().doEventLoop(&creationState.watchVariable);
 
-    ServerMediaSubsession* smss;
-    while ((smss = creationState.demux->newServerMediaSubsession()) != NULL) {
-      sms->addSubsession(smss);
-    }
+    sms = createNewOggSMS(env, fileName, creationState.demux);
+  }
+
+  return sms;
+}
+
+static ServerMediaSession* createNewMatroskaSMS(UsageEnvironment& env,
+						char const* fileName, MatroskaFileServerDemux* demux) {
+  ServerMediaSession* sms = NULL;
+  NEW_SMS("Matroska video+audio+(optional)subtitles");
+
+  ServerMediaSubsession* smss;
+  while ((smss = demux->newServerMediaSubsession()) != NULL) {
+    sms->addSubsession(smss);
+  }
+
+  return sms;
+}
+
+static ServerMediaSession* createNewOggSMS(UsageEnvironment& env,
+					   char const* fileName, OggFileServerDemux* demux) {
+  ServerMediaSession* sms = NULL;
+  NEW_SMS("Ogg video and/or audio");
+
+  ServerMediaSubsession* smss;
+  while ((smss = demux->newServerMediaSubsession()) != NULL) {
+    sms->addSubsession(smss);
   }
 
   return sms;
@@ -29,16 +29,46 @@ class DynamicRTSPServer: public RTSPServerSupportingHTTPStreaming {
 public:
   static DynamicRTSPServer* createNew(UsageEnvironment& env, Port ourPort,
 				      UserAuthenticationDatabase* authDatabase,
-				      unsigned reclamationTestSeconds = 65);
+				      unsigned reclamationTestSeconds = 65,
+				      char const* catalogFileName = NULL, Boolean catalogIsReadOnly = False);
+      // If "catalogFileName" is non-NULL, we keep a catalog (in this file) of the media files in the current directory
+      // (and its subdirectories), probing them in the background, so that "DESCRIBE" can be handled without probing.
+      // If "catalogIsReadOnly", we only read this catalog (which is kept by another server - e.g., in another process).
+
+  void setUpHandOffToOtherWorkers(int ourHandOffSocket, int nextWorkerHandOffSocket, unsigned numWorkers);
+      // Used when we are one of "numWorkers" server processes that share our port number(s), with the kernel spreading
+      // incoming connections over them.  An RTSP-over-HTTP tunneling "POST" whose "GET" we didn't see gets handed off (with
+      // the bytes that we read from it) on "nextWorkerHandOffSocket" (a local datagram socket), to the next server in a ring.
+      // We receive such connections on "ourHandOffSocket".
+
+  static Boolean isMediaFileName(char const* fileName); // i.e., if its name suffix is one that we know how to stream
 
 protected:
   DynamicRTSPServer(UsageEnvironment& env, int ourSocket, Port ourPort,
-		    UserAuthenticationDatabase* authDatabase, unsigned reclamationTestSeconds);
+		    UserAuthenticationDatabase* authDatabase, unsigned reclamationTestSeconds,
+		    char const* catalogFileName, Boolean catalogIsReadOnly);
   // called only by createNew();
   virtual ~DynamicRTSPServer();
 
 protected: // redefined virtual functions
   virtual ServerMediaSession* lookupServerMediaSession(char const* streamName);
+  virtual void lookupServerMediaSession(char const* streamName,
+					lookupServerMediaSessionCompletionFunc* completionFunc, void* completionClientData);
+  virtual void cancelLookupServerMediaSession(void* completionClientData);
+  virtual Boolean handOffHTTPTunnelingPOST(int clientSocket, struct sockaddr_in const& clientAddr,
+					   unsigned char const* requestBytes, unsigned numRequestBytes, unsigned numHandOffs);
+
+private:
+  friend class SMSCreationRecord;
+  void completeSMSCreation(class SMSCreationRecord* record, ServerMediaSession* sms);
+  static void incomingHandOffHandler(void* instance, int /*mask*/);
+  void incomingHandOffHandler1();
+
+private:
+  SMSCreationRecord* fSMSCreationRecords; // for (Matroska or Ogg) files that we're currently parsing, to create a "ServerMediaSession"
+  class MediaCatalog* fCatalog; // NULL unless we're keeping a catalog
+  int fOurHandOffSocket, fNextWorkerHandOffSocket; // -1 unless we're one of several worker processes
+  unsigned fNumWorkers;
 };
 
 #endif
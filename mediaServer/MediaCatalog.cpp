@@ -0,0 +1,825 @@
+/**********
+This library is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the
+Free Software Foundation; either version 2.1 of the License, or (at your
+option) any later version. (See <http://www.gnu.org/copyleft/lesser.html>.)
+
+This library is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this library; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+**********/
+// Copyright (c) 1996-2014, Live Networks, Inc.  All rights reserved
+// A catalog of the media files that a "DynamicRTSPServer" can stream, with metadata (including SDP lines) for each file,
+// found by probing the file in the background.
+// Implementation
+
+#include "MediaCatalog.hh"
+#include "DynamicRTSPServer.hh"
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(__WIN32__) || defined(_WIN32)
+#define NO_DIRECTORY_SCANNING 1
+#else
+#include <dirent.h>
+#include <unistd.h>
+#if defined(__linux__) && !defined(NO_INOTIFY)
+#include <sys/inotify.h>
+#define USE_INOTIFY 1
+#endif
+#endif
+
+#define MAX_DIRECTORY_ENTRIES_PER_SCAN_STEP 256
+#define RESCAN_INTERVAL_SECONDS 60 // used only if we can't watch for changes
+#define PROBE_INTERVAL_MS 10 // between probes of successive files
+#define SAVE_DELAY_SECONDS 10 // after a change
+#define RELOAD_CHECK_INTERVAL_SECONDS 5 // for read-only catalogs
+
+static char const* const catalogHeader = "LIVE555 Media Server catalog, version 1";
+
+static Boolean getFileInfo(char const* path, u_int64_t& fileSize, long& modificationTime, Boolean& isDirectory) {
+  struct stat sb;
+  if (stat(path, &sb) != 0) return False;
+
+  fileSize = (u_int64_t)sb.st_size;
+  modificationTime = (long)sb.st_mtime;
+  isDirectory = (sb.st_mode & S_IFMT) == S_IFDIR;
+  return True;
+}
+
+static Boolean isSymbolicLink(char const* path) {
+#ifdef NO_DIRECTORY_SCANNING
+  return False;
+#else
+  struct stat sb;
+  return lstat(path, &sb) == 0 && S_ISLNK(sb.st_mode);
+#endif
+}
+
+static Boolean hasExtension(char const* fileName, char const* extension) {
+  char const* fileNameExtension = strrchr(fileName, '.');
+  return fileNameExtension != NULL && strcmp(fileNameExtension, extension) == 0;
+}
+
+static Boolean indexFileExists(char const* tsFileName) {
+  // The index file for "foo.ts" is "foo.tsx":
+  char* indexFileName = new char[strlen(tsFileName) + 2];
+  sprintf(indexFileName, "%sx", tsFileName);
+
+  u_int64_t fileSize; long modificationTime; Boolean isDirectory;
+  Boolean result = getFileInfo(indexFileName, fileSize, modificationTime, isDirectory) && !isDirectory;
+  delete[] indexFileName;
+  return result;
+}
+
+static char* joinPath(char const* dirPath, char const* name) {
+  // Note: The current directory is denoted by "", so that the names of files within it don't begin with "./"
+  if (dirPath[0] == '\0') return strDup(name);
+
+  char* result = new char[strlen(dirPath) + 1 + strlen(name) + 1];
+  sprintf(result, "%s/%s", dirPath, name);
+  return result;
+}
+
+// Each catalog entry is written as a single line, with tab-separated fields, so we escape any tab or line-end characters
+// (and backslashes) in file names and SDP lines:
+static void writeEscaped(FILE* fid, char const* str) {
+  for (; *str != '\0'; ++str) {
+    switch (*str) {
+      case '\\': { fputs("\\\\", fid); break; }
+      case '\t': { fputs("\\t", fid); break; }
+      case '\r': { fputs("\\r", fid); break; }
+      case '\n': { fputs("\\n", fid); break; }
+      default: { fputc(*str, fid); break; }
+    }
+  }
+}
+
+static void unescapeInPlace(char* str) {
+  char* to = str;
+  for (char const* from = str; *from != '\0'; ++from) {
+    if (*from == '\\' && from[1] != '\0') {
+      ++from;
+      switch (*from) {
+        case 't': { *to++ = '\t'; break; }
+        case 'r': { *to++ = '\r'; break; }
+        case 'n': { *to++ = '\n'; break; }
+        default: { *to++ = *from; break; }
+      }
+    } else {
+      *to++ = *from;
+    }
+  }
+  *to = '\0';
+}
+
+static char* nextField(char*& ptr) {
+  // Returns the next tab-separated field (unescaped), or NULL if there are no more:
+  if (ptr == NULL) return NULL;
+
+  char* field = ptr;
+  ptr = strchr(ptr, '\t');
+  if (ptr != NULL) *ptr++ = '\0';
+  unescapeInPlace(field);
+  return field;
+}
+
+static Boolean readLine(FILE* fid, char*& buffer, unsigned& bufferSize) {
+  // Reads a line (without its trailing '\n') into "buffer", enlarging it if necessary.  Returns False at the end of the file.
+  unsigned length = 0;
+  while (fgets(&buffer[length], bufferSize - length, fid) != NULL) {
+    length += strlen(&buffer[length]);
+    if (length > 0 && buffer[length-1] == '\n') {
+      buffer[length-1] = '\0';
+      return True;
+    }
+    if (length + 1 < bufferSize) break; // the last line of the file doesn't end with '\n'
+
+    // The line didn't fit, so enlarge "buffer" and continue:
+    char* newBuffer = new char[2*bufferSize];
+    memmove(newBuffer, buffer, length + 1);
+    delete[] buffer;
+    buffer = newBuffer;
+    bufferSize *= 2;
+  }
+
+  return length > 0;
+}
+
+
+////////// MediaCatalog::Entry implementation //////////
+
+MediaCatalog::Entry::Entry(char const* fileName)
+  : fileName(strDup(fileName)), fileSize(0), modificationTime(0), hasIndex(False),
+    isProbed(False), duration(0.0), numSubsessions(0), sdpLines(NULL), scanNumber(0) {
+}
+
+MediaCatalog::Entry::~Entry() {
+  setSubsessionSDPLines(0, NULL);
+  delete[] fileName;
+}
+
+void MediaCatalog::Entry::setSubsessionSDPLines(unsigned newNumSubsessions, char** newSDPLines) {
+  for (unsigned i = 0; i < numSubsessions; ++i) delete[] sdpLines[i];
+  delete[] sdpLines;
+
+  numSubsessions = newNumSubsessions;
+  sdpLines = newSDPLines;
+}
+
+
+////////// MediaCatalog implementation //////////
+
+MediaCatalog* MediaCatalog::createNew(DynamicRTSPServer& server, char const* catalogFileName, Boolean isReadOnly) {
+  return new MediaCatalog(server, catalogFileName, isReadOnly);
+}
+
+MediaCatalog::MediaCatalog(DynamicRTSPServer& server, char const* catalogFileName, Boolean isReadOnly)
+  : fEnv(server.envir()), fServer(server), fCatalogFileName(strDup(catalogFileName)),
+    fIsReadOnly(isReadOnly), fIsComplete(False), fHasChanged(False), fSaveTask(NULL),
+    fLoadedFileSize(0), fLoadedModificationTime(0), fReloadTask(NULL),
+    fScanNumber(0), fScanIsFull(False), fDirsToScanHead(NULL), fDirsToScanTail(NULL),
+    fCurrentDir(NULL), fCurrentDirPath(NULL), fScanTask(NULL), fRescanTask(NULL),
+    fFilesToProbeHead(NULL), fFilesToProbeTail(NULL), fProbeState(PROBE_IDLE), fProbeFileName(NULL),
+    fProbeFileSize(0), fProbeModificationTime(0), fProbeSession(NULL), fProbeSessionExisted(False), fProbeTask(NULL),
+    fWatchFd(-1) {
+  fEntries = HashTable::create(STRING_HASH_KEYS);
+  fWatchedDirs = HashTable::create(ONE_WORD_HASH_KEYS);
+
+  if (fIsReadOnly) {
+    // We never become 'complete' (because our file might be out-of-date), so our entries get checked against the files
+    // before they're used:
+    reloadTask1();
+    return;
+  }
+
+  load();
+
+#ifdef USE_INOTIFY
+  fWatchFd = inotify_init();
+  if (fWatchFd >= 0) {
+    fEnv.taskScheduler().setBackgroundHandling(fWatchFd, SOCKET_READABLE,
+					       (TaskScheduler::BackgroundHandlerProc*)&incomingWatchEventHandler, this);
+  }
+#endif
+
+  startFullScan();
+}
+
+MediaCatalog::~MediaCatalog() {
+  fEnv.taskScheduler().unscheduleDelayedTask(fSaveTask);
+  fEnv.taskScheduler().unscheduleDelayedTask(fReloadTask);
+  fEnv.taskScheduler().unscheduleDelayedTask(fScanTask);
+  fEnv.taskScheduler().unscheduleDelayedTask(fRescanTask);
+  fEnv.taskScheduler().unscheduleDelayedTask(fProbeTask);
+
+  // Stop any probe that's in progress:
+  if (fProbeState == PROBE_LOOKING_UP) {
+    RTSPServer& server = fServer;
+    server.cancelLookupServerMediaSession(this);
+  } else if (fProbeState == PROBE_PREPARING) {
+    fProbeSession->cancelPrepareSDPDescription(this);
+  }
+  if (fProbeSession != NULL) fProbeSession->decrementReferenceCount();
+  delete[] fProbeFileName;
+
+  stopWatching();
+  delete fWatchedDirs;
+
+#ifndef NO_DIRECTORY_SCANNING
+  if (fCurrentDir != NULL) closedir((DIR*)fCurrentDir);
+#endif
+  delete[] fCurrentDirPath;
+  char* path;
+  while ((path = removeFirstPath(fDirsToScanHead, fDirsToScanTail)) != NULL) delete[] path;
+  while ((path = removeFirstPath(fFilesToProbeHead, fFilesToProbeTail)) != NULL) delete[] path;
+
+  if (fHasChanged) save();
+
+  Entry* entry;
+  while ((entry = (Entry*)fEntries->RemoveNext()) != NULL) delete entry;
+  delete fEntries;
+  delete[] fCatalogFileName;
+}
+
+MediaCatalog::Entry const* MediaCatalog::lookup(char const* fileName) const {
+  return (Entry const*)fEntries->Lookup(fileName);
+}
+
+void MediaCatalog::presetSDPLines(ServerMediaSession* sms) const {
+  if (sms == NULL) return;
+
+  Entry const* entry = lookup(sms->streamName());
+  if (entry == NULL || !entry->isProbed || entry->numSubsessions == 0) return;
+
+  if (!fIsComplete) {
+    // Our entry might be out-of-date, so check it against the file first:
+    u_int64_t fileSize; long modificationTime; Boolean isDirectory;
+    if (!getFileInfo(entry->fileName, fileSize, modificationTime, isDirectory)
+	|| fileSize != entry->fileSize || modificationTime != entry->modificationTime
+	|| (hasExtension(entry->fileName, ".ts") && indexFileExists(entry->fileName) != entry->hasIndex)) return;
+  }
+
+  // Check that "sms" has the same subsessions as when we probed the file:
+  ServerMediaSubsessionIterator iter(*sms);
+  unsigned numSubsessions = 0;
+  while (iter.next() != NULL) ++numSubsessions;
+  if (numSubsessions != entry->numSubsessions) return;
+
+  iter.reset();
+  for (unsigned i = 0; i < numSubsessions; ++i) {
+    ServerMediaSubsession* subsession = iter.next();
+    if (entry->sdpLines[i] != NULL) subsession->setSDPLines(entry->sdpLines[i]);
+  }
+}
+
+Boolean MediaCatalog::load() {
+  FILE* fid = fopen(fCatalogFileName, "rb");
+  if (fid == NULL) return False;
+
+  unsigned bufferSize = 1000;
+  char* buffer = new char[bufferSize];
+  Boolean isOK = readLine(fid, buffer, bufferSize) && strcmp(buffer, catalogHeader) == 0;
+  while (isOK && readLine(fid, buffer, bufferSize)) {
+    // Each line is: <file name> <tab> <numeric fields> (<tab> <SDP lines>) for each subsession:
+    char* next = buffer;
+    char const* fileName = nextField(next);
+    char const* numericFields = nextField(next);
+    unsigned long long fileSize; long modificationTime; unsigned hasIndex, isProbed, numSubsessions; float duration;
+    if (numericFields == NULL
+	|| sscanf(numericFields, "%llu %ld %u %u %f %u",
+		  &fileSize, &modificationTime, &hasIndex, &isProbed, &duration, &numSubsessions) != 6) continue;
+
+    Entry* entry = new Entry(fileName);
+    entry->fileSize = (u_int64_t)fileSize;
+    entry->modificationTime = modificationTime;
+    entry->hasIndex = hasIndex != 0;
+    entry->isProbed = isProbed != 0;
+    entry->duration = duration;
+    if (numSubsessions > 0) {
+      char** sdpLines = new char*[numSubsessions];
+      for (unsigned i = 0; i < numSubsessions; ++i) {
+	char const* field = nextField(next);
+	sdpLines[i] = field == NULL || field[0] == '\0' ? NULL : strDup(field);
+      }
+      entry->setSubsessionSDPLines(numSubsessions, sdpLines);
+    }
+    delete (Entry*)fEntries->Add(entry->fileName, entry);
+  }
+
+  delete[] buffer;
+  fclose(fid);
+  if (!isOK) fEnv << "MediaCatalog: Ignoring \"" << fCatalogFileName << "\", because it's not a catalog file\n";
+  return isOK;
+}
+
+Boolean MediaCatalog::save() {
+  fEnv.taskScheduler().unscheduleDelayedTask(fSaveTask);
+  fHasChanged = False;
+
+  // Write to a temporary file first, then rename it, so that the catalog file is always complete:
+  char* tmpFileName = new char[strlen(fCatalogFileName) + 5];
+  sprintf(tmpFileName, "%s.tmp", fCatalogFileName);
+  FILE* fid = fopen(tmpFileName, "wb");
+  if (fid == NULL) {
+    fEnv << "MediaCatalog: Failed to open \"" << tmpFileName << "\" for writing\n";
+    delete[] tmpFileName;
+    return False;
+  }
+
+  fprintf(fid, "%s\n", catalogHeader);
+  HashTable::Iterator* iter = HashTable::Iterator::create(*fEntries);
+  char const* key;
+  Entry const* entry;
+  while ((entry = (Entry const*)iter->next(key)) != NULL) {
+    writeEscaped(fid, entry->fileName);
+    fprintf(fid, "\t%llu %ld %u %u %f %u", (unsigned long long)entry->fileSize, entry->modificationTime,
+	    entry->hasIndex ? 1 : 0, entry->isProbed ? 1 : 0, entry->duration, entry->numSubsessions);
+    for (unsigned i = 0; i < entry->numSubsessions; ++i) {
+      fputc('\t', fid);
+      if (entry->sdpLines[i] != NULL) writeEscaped(fid, entry->sdpLines[i]);
+    }
+    fputc('\n', fid);
+  }
+  delete iter;
+
+  Boolean isOK = !ferror(fid);
+  if (fclose(fid) != 0) isOK = False;
+#if defined(__WIN32__) || defined(_WIN32)
+  if (isOK) remove(fCatalogFileName); // because "rename()" won't replace an existing file
+#endif
+  if (isOK && rename(tmpFileName, fCatalogFileName) != 0) isOK = False;
+  if (!isOK) {
+    fEnv << "MediaCatalog: Failed to write \"" << fCatalogFileName << "\"\n";
+    remove(tmpFileName);
+  }
+
+  delete[] tmpFileName;
+  return isOK;
+}
+
+void MediaCatalog::noteChange() {
+  fHasChanged = True;
+
+  // Save the catalog a while from now (so that many changes can be saved together):
+  if (fSaveTask == NULL) {
+    fSaveTask = fEnv.taskScheduler().scheduleDelayedTask(SAVE_DELAY_SECONDS*1000000, (TaskFunc*)saveTask, this);
+  }
+}
+
+void MediaCatalog::saveTask(void* clientData) {
+  MediaCatalog* catalog = (MediaCatalog*)clientData;
+  catalog->fSaveTask = NULL;
+  catalog->save();
+}
+
+void MediaCatalog::reloadTask(void* clientData) {
+  ((MediaCatalog*)clientData)->reloadTask1();
+}
+
+void MediaCatalog::reloadTask1() {
+  fReloadTask = NULL;
+
+  // If the catalog file has changed (or appeared) since we last loaded it, then load it again:
+  u_int64_t fileSize; long modificationTime; Boolean isDirectory;
+  if (getFileInfo(fCatalogFileName, fileSize, modificationTime, isDirectory) && !isDirectory
+      && (fileSize != fLoadedFileSize || modificationTime != fLoadedModificationTime)) {
+    Entry* entry;
+    while ((entry = (Entry*)fEntries->RemoveNext()) != NULL) delete entry;
+    load();
+
+    fLoadedFileSize = fileSize;
+    fLoadedModificationTime = modificationTime;
+  }
+
+  fReloadTask = fEnv.taskScheduler().scheduleDelayedTask(RELOAD_CHECK_INTERVAL_SECONDS*1000000, (TaskFunc*)reloadTask, this);
+}
+
+void MediaCatalog::startFullScan() {
+  // Abandon any scan that's already in progress:
+#ifndef NO_DIRECTORY_SCANNING
+  if (fCurrentDir != NULL) {
+    closedir((DIR*)fCurrentDir);
+    fCurrentDir = NULL;
+  }
+#endif
+  delete[] fCurrentDirPath; fCurrentDirPath = NULL;
+  char* path;
+  while ((path = removeFirstPath(fDirsToScanHead, fDirsToScanTail)) != NULL) delete[] path;
+
+  ++fScanNumber;
+  fScanIsFull = True;
+  fIsComplete = False;
+  addDirectoryToScan(""); // the current directory
+}
+
+void MediaCatalog::addDirectoryToScan(char const* dirPath) {
+  addPath(fDirsToScanHead, fDirsToScanTail, dirPath);
+  if (fScanTask == NULL) fScanTask = fEnv.taskScheduler().scheduleDelayedTask(0, (TaskFunc*)scanTask, this);
+}
+
+void MediaCatalog::scanTask(void* clientData) {
+  ((MediaCatalog*)clientData)->scanTask1();
+}
+
+void MediaCatalog::scanTask1() {
+  fScanTask = NULL;
+
+#ifndef NO_DIRECTORY_SCANNING
+  // Look at only a limited number of directory entries each time, so that we don't hold up the event loop:
+  for (unsigned i = 0; i < MAX_DIRECTORY_ENTRIES_PER_SCAN_STEP; ++i) {
+    if (fCurrentDir == NULL) {
+      // Begin scanning the next directory:
+      fCurrentDirPath = removeFirstPath(fDirsToScanHead, fDirsToScanTail);
+      if (fCurrentDirPath == NULL) break; // there are no more directories to scan
+
+      // (Start watching the directory first, so that we don't miss any changes that happen during the scan.)
+      watchDirectory(fCurrentDirPath);
+      fCurrentDir = opendir(fCurrentDirPath[0] == '\0' ? "." : fCurrentDirPath);
+      if (fCurrentDir == NULL) {
+	delete[] fCurrentDirPath; fCurrentDirPath = NULL;
+      }
+      continue;
+    }
+
+    struct dirent* dirEntry = readdir((DIR*)fCurrentDir);
+    if (dirEntry == NULL) {
+      // We've finished scanning this directory:
+      closedir((DIR*)fCurrentDir); fCurrentDir = NULL;
+      delete[] fCurrentDirPath; fCurrentDirPath = NULL;
+      continue;
+    }
+    if (strcmp(dirEntry->d_name, ".") == 0 || strcmp(dirEntry->d_name, "..") == 0) continue;
+
+    char* filePath = joinPath(fCurrentDirPath, dirEntry->d_name);
+    noteFile(filePath, True);
+    delete[] filePath;
+  }
+
+  if (fCurrentDir != NULL || fDirsToScanHead != NULL) {
+    // There's more to do, so continue after handling any other pending events:
+    fScanTask = fEnv.taskScheduler().scheduleDelayedTask(0, (TaskFunc*)scanTask, this);
+    return;
+  }
+#endif
+
+  endScan();
+}
+
+void MediaCatalog::endScan() {
+  if (!fScanIsFull) return;
+  fScanIsFull = False;
+
+  // Remove the entries for any files that weren't found during this scan (because they no longer exist):
+  PathList* head = NULL; PathList* tail = NULL;
+  HashTable::Iterator* iter = HashTable::Iterator::create(*fEntries);
+  char const* key;
+  Entry const* entry;
+  while ((entry = (Entry const*)iter->next(key)) != NULL) {
+    if (entry->scanNumber != fScanNumber) addPath(head, tail, entry->fileName);
+  }
+  delete iter;
+  char* filePath;
+  while ((filePath = removeFirstPath(head, tail)) != NULL) {
+    removeEntry(filePath);
+    delete[] filePath;
+  }
+
+  // If we've been watching for changes since the scan started, then we now list exactly the files that exist.
+  // Otherwise, we'll need to rescan (from time to time) to notice changes:
+  fIsComplete = fWatchFd >= 0;
+  if (!fIsComplete) {
+    fRescanTask = fEnv.taskScheduler().scheduleDelayedTask(RESCAN_INTERVAL_SECONDS*1000000, (TaskFunc*)rescanTask, this);
+  }
+
+  if (fHasChanged) save();
+}
+
+void MediaCatalog::rescanTask(void* clientData) {
+  MediaCatalog* catalog = (MediaCatalog*)clientData;
+  catalog->fRescanTask = NULL;
+  catalog->startFullScan();
+}
+
+void MediaCatalog::noteFile(char const* filePath, Boolean isFromFullScan) {
+  if (hasExtension(filePath, ".tsx")) {
+    // An index file has been added or removed.  If we list the corresponding Transport Stream file, then check it again:
+    char* tsFilePath = strDup(filePath);
+    tsFilePath[strlen(tsFilePath)-1] = '\0';
+    if (lookup(tsFilePath) != NULL) noteFile(tsFilePath, False);
+    delete[] tsFilePath;
+    return;
+  }
+
+  u_int64_t fileSize; long modificationTime; Boolean isDirectory;
+  if (!getFileInfo(filePath, fileSize, modificationTime, isDirectory)) {
+    // The file no longer exists:
+    removeEntry(filePath);
+    return;
+  }
+
+  if (isDirectory) {
+    // Scan this directory also.  (But don't follow symbolic links to directories, in case they form a loop.)
+    if (!isSymbolicLink(filePath)) addDirectoryToScan(filePath);
+    return;
+  }
+  if (!DynamicRTSPServer::isMediaFileName(filePath)) return;
+
+  Boolean hasIndex = hasExtension(filePath, ".ts") && indexFileExists(filePath);
+  Entry* entry = (Entry*)fEntries->Lookup(filePath);
+  if (entry != NULL
+      && entry->fileSize == fileSize && entry->modificationTime == modificationTime && entry->hasIndex == hasIndex) {
+    // The file hasn't changed:
+    entry->scanNumber = fScanNumber;
+    if (!entry->isProbed && isFromFullScan) addFileToProbe(filePath);
+    return;
+  }
+
+  if (entry == NULL) {
+    entry = new Entry(filePath);
+    fEntries->Add(entry->fileName, entry);
+  } else {
+    // The file has changed, so forget what we knew about it, and any "ServerMediaSession" that was created for it.
+    // (Any clients that are currently streaming the file will continue to do so.)
+    entry->isProbed = False;
+    entry->duration = 0.0;
+    entry->setSubsessionSDPLines(0, NULL);
+    fServer.removeServerMediaSession(filePath);
+  }
+  entry->fileSize = fileSize;
+  entry->modificationTime = modificationTime;
+  entry->hasIndex = hasIndex;
+  entry->scanNumber = fScanNumber;
+
+  addFileToProbe(filePath);
+  noteChange();
+}
+
+void MediaCatalog::removeEntry(char const* filePath) {
+  Entry* entry = (Entry*)fEntries->Lookup(filePath);
+  if (entry == NULL) return;
+
+  fEntries->Remove(filePath);
+  delete entry;
+  fServer.removeServerMediaSession(filePath);
+  noteChange();
+}
+
+void MediaCatalog::removeEntriesInDirectory(char const* dirPath) {
+  unsigned const dirPathLen = strlen(dirPath);
+  PathList* head = NULL; PathList* tail = NULL;
+
+  // Stop watching this directory, and any of its subdirectories:
+  HashTable::Iterator* iter = HashTable::Iterator::create(*fWatchedDirs);
+  char const* key;
+  char const* path;
+  while ((path = (char const*)iter->next(key)) != NULL) {
+    if (strncmp(path, dirPath, dirPathLen) == 0 && (path[dirPathLen] == '\0' || path[dirPathLen] == '/')) {
+#ifdef USE_INOTIFY
+      inotify_rm_watch(fWatchFd, (int)(long)key); // we'll forget "path" when we get the resulting "IN_IGNORED" event
+#endif
+    }
+  }
+  delete iter;
+
+  // Then remove the entries for all files in this directory (or its subdirectories):
+  iter = HashTable::Iterator::create(*fEntries);
+  Entry const* entry;
+  while ((entry = (Entry const*)iter->next(key)) != NULL) {
+    if (strncmp(entry->fileName, dirPath, dirPathLen) == 0 && entry->fileName[dirPathLen] == '/') {
+      addPath(head, tail, entry->fileName);
+    }
+  }
+  delete iter;
+  char* filePath;
+  while ((filePath = removeFirstPath(head, tail)) != NULL) {
+    removeEntry(filePath);
+    delete[] filePath;
+  }
+}
+
+void MediaCatalog::addFileToProbe(char const* filePath) {
+  addPath(fFilesToProbeHead, fFilesToProbeTail, filePath);
+  if (fProbeState == PROBE_IDLE) scheduleProbeTask(PROBE_INTERVAL_MS);
+}
+
+void MediaCatalog::scheduleProbeTask(unsigned delayMS) {
+  if (fProbeTask == NULL) {
+    fProbeTask = fEnv.taskScheduler().scheduleDelayedTask(delayMS*1000, (TaskFunc*)probeTask, this);
+  }
+}
+
+void MediaCatalog::probeTask(void* clientData) {
+  ((MediaCatalog*)clientData)->probeTask1();
+}
+
+void MediaCatalog::probeTask1() {
+  fProbeTask = NULL;
+
+  switch (fProbeState) {
+    case PROBE_IDLE: {
+      startNextProbe();
+      break;
+    }
+    case PROBE_CONTINUING: {
+      // Our "ServerMediaSession" has been looked up (or one of its subsessions has become ready).  Make sure that all of its
+      // SDP lines are ready:
+      if (fProbeSession != NULL) {
+	fProbeState = PROBE_PREPARING;
+	if (!fProbeSession->prepareSDPDescription(afterProbePreparation, this)) break; // we'll get called back later
+      }
+      finishProbe();
+      break;
+    }
+    default: { // We're waiting to be called back
+      break;
+    }
+  }
+}
+
+void MediaCatalog::startNextProbe() {
+  // Find the next file that still needs to be probed:
+  Entry const* entry = NULL;
+  char* filePath;
+  while ((filePath = removeFirstPath(fFilesToProbeHead, fFilesToProbeTail)) != NULL) {
+    entry = lookup(filePath);
+    if (entry != NULL && !entry->isProbed) break;
+    delete[] filePath; // the file no longer exists, or was probed already
+  }
+  if (filePath == NULL) return;
+
+  fProbeFileName = filePath;
+  fProbeFileSize = entry->fileSize;
+  fProbeModificationTime = entry->modificationTime;
+
+  // Probe the file by having our server look up (i.e., create) a "ServerMediaSession" for it, and prepare its SDP lines,
+  // just as it would when handling "DESCRIBE":
+  RTSPServer& server = fServer;
+  fProbeSessionExisted = server.RTSPServer::lookupServerMediaSession(fProbeFileName) != NULL;
+  fProbeState = PROBE_LOOKING_UP;
+  server.lookupServerMediaSession(fProbeFileName, afterProbeLookup, this);
+}
+
+void MediaCatalog::afterProbeLookup(void* clientData, ServerMediaSession* sms) {
+  MediaCatalog* catalog = (MediaCatalog*)clientData;
+
+  catalog->fProbeSession = sms;
+  if (sms != NULL) sms->incrementReferenceCount(); // so that it doesn't get deleted while we're using it
+  catalog->fProbeState = PROBE_CONTINUING;
+  catalog->scheduleProbeTask(0); // continue from the event loop
+}
+
+void MediaCatalog::afterProbePreparation(void* clientData) {
+  MediaCatalog* catalog = (MediaCatalog*)clientData;
+
+  catalog->fProbeState = PROBE_CONTINUING;
+  catalog->scheduleProbeTask(0); // continue from the event loop
+}
+
+void MediaCatalog::finishProbe() {
+  Entry* entry = (Entry*)fEntries->Lookup(fProbeFileName);
+  if (entry != NULL && entry->fileSize == fProbeFileSize && entry->modificationTime == fProbeModificationTime) {
+    // Record what we found (unless the file changed while we were probing it):
+    entry->isProbed = True;
+    if (fProbeSession != NULL) {
+      entry->duration = fProbeSession->duration();
+
+      ServerMediaSubsessionIterator iter(*fProbeSession);
+      unsigned numSubsessions = 0;
+      while (iter.next() != NULL) ++numSubsessions;
+      char** sdpLines = numSubsessions == 0 ? NULL : new char*[numSubsessions];
+      iter.reset();
+      for (unsigned i = 0; i < numSubsessions; ++i) sdpLines[i] = strDup(iter.next()->sdpLines());
+      entry->setSubsessionSDPLines(numSubsessions, sdpLines);
+    }
+    noteChange();
+  }
+
+  if (fProbeSession != NULL) {
+    RTSPServer& server = fServer;
+    Boolean isOurServersSession = server.RTSPServer::lookupServerMediaSession(fProbeFileName) == fProbeSession;
+
+    fProbeSession->decrementReferenceCount();
+    if (fProbeSession->referenceCount() == 0) {
+      if (isOurServersSession && !fProbeSessionExisted) {
+	// We created this "ServerMediaSession" only to probe the file, so remove it now.  (If a client later asks for it,
+	// it will be created again, using the SDP lines that we just recorded.)
+	server.removeServerMediaSession(fProbeSession);
+      } else if (!isOurServersSession && fProbeSession->deleteWhenUnreferenced()) {
+	Medium::close(fProbeSession);
+      }
+    }
+    fProbeSession = NULL;
+  }
+
+  delete[] fProbeFileName; fProbeFileName = NULL;
+  fProbeState = PROBE_IDLE;
+  if (fFilesToProbeHead != NULL) scheduleProbeTask(PROBE_INTERVAL_MS);
+}
+
+void MediaCatalog::watchDirectory(char const* dirPath) {
+#ifdef USE_INOTIFY
+  if (fWatchFd < 0) return;
+
+  int wd = inotify_add_watch(fWatchFd, dirPath[0] == '\0' ? "." : dirPath,
+			     IN_CREATE|IN_CLOSE_WRITE|IN_MOVED_TO|IN_MOVED_FROM|IN_DELETE|IN_ONLYDIR);
+  if (wd < 0) {
+    // Perhaps we've reached the system's limit on the number of watches.  We can no longer be sure of being notified of
+    // every change, so stop watching altogether (and instead rescan from time to time):
+    fEnv << "MediaCatalog: Failed to watch directory \"" << dirPath << "\" for changes (errno " << fEnv.getErrno()
+	 << "); will rescan every " << RESCAN_INTERVAL_SECONDS << " seconds instead\n";
+    stopWatching();
+    return;
+  }
+
+  delete[] (char*)fWatchedDirs->Add((char const*)(long)wd, strDup(dirPath));
+#endif
+}
+
+void MediaCatalog::stopWatching() {
+#ifdef USE_INOTIFY
+  if (fWatchFd >= 0) {
+    fEnv.taskScheduler().turnOffBackgroundReadHandling(fWatchFd);
+    close(fWatchFd);
+    fWatchFd = -1;
+  }
+#endif
+  fIsComplete = False;
+
+  char* dirPath;
+  while ((dirPath = (char*)fWatchedDirs->RemoveNext()) != NULL) delete[] dirPath;
+}
+
+void MediaCatalog::incomingWatchEventHandler(void* clientData, int /*mask*/) {
+  ((MediaCatalog*)clientData)->incomingWatchEventHandler1();
+}
+
+void MediaCatalog::incomingWatchEventHandler1() {
+#ifdef USE_INOTIFY
+  union {
+    struct inotify_event event; // for alignment
+    char bytes[4096];
+  } buffer;
+  int numBytesRead = read(fWatchFd, buffer.bytes, sizeof buffer.bytes);
+  if (numBytesRead <= 0) return;
+
+  for (char* ptr = buffer.bytes; ptr < &buffer.bytes[numBytesRead]; ) {
+    struct inotify_event const* event = (struct inotify_event const*)ptr;
+    ptr += sizeof (struct inotify_event) + event->len;
+
+    if (event->mask & IN_Q_OVERFLOW) {
+      // Some changes were lost, so we need to rescan everything:
+      startFullScan();
+      continue;
+    }
+
+    char const* key = (char const*)(long)event->wd;
+    char* dirPath = (char*)fWatchedDirs->Lookup(key);
+    if (dirPath == NULL) continue;
+    if (event->mask & IN_IGNORED) {
+      // The directory is no longer being watched (e.g., because it was removed):
+      fWatchedDirs->Remove(key);
+      delete[] dirPath;
+      continue;
+    }
+    if (event->len == 0) continue;
+
+    char* filePath = joinPath(dirPath, event->name);
+    if ((event->mask & IN_ISDIR) && (event->mask & (IN_DELETE|IN_MOVED_FROM))) {
+      removeEntriesInDirectory(filePath);
+    } else {
+      noteFile(filePath, False);
+    }
+    delete[] filePath;
+  }
+#endif
+}
+
+void MediaCatalog::addPath(PathList*& head, PathList*& tail, char const* path) {
+  PathList* item = new PathList;
+  item->next = NULL;
+  item->path = strDup(path);
+
+  if (tail == NULL) {
+    head = tail = item;
+  } else {
+    tail->next = item;
+    tail = item;
+  }
+}
+
+char* MediaCatalog::removeFirstPath(PathList*& head, PathList*& tail) {
+  PathList* item = head;
+  if (item == NULL) return NULL;
+
+  head = item->next;
+  if (head == NULL) tail = NULL;
+  char* path = item->path;
+  delete item;
+  return path;
+}
@@ -0,0 +1,147 @@
+/**********
+This library is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the
+Free Software Foundation; either version 2.1 of the License, or (at your
+option) any later version. (See <http://www.gnu.org/copyleft/lesser.html>.)
+
+This library is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this library; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+**********/
+// Copyright (c) 1996-2014, Live Networks, Inc.  All rights reserved
+// A catalog of the media files that a "DynamicRTSPServer" can stream, with metadata (including SDP lines) for each file,
+// found by probing the file in the background.  The catalog is saved in a file, so that it survives restarts, and is kept
+// up-to-date by scanning the current directory (and its subdirectories), and - where supported - by watching for changes.
+// Header file
+
+#ifndef _MEDIA_CATALOG_HH
+#define _MEDIA_CATALOG_HH
+
+#ifndef _LIVEMEDIA_HH
+#include <liveMedia.hh>
+#endif
+
+class DynamicRTSPServer;
+
+class MediaCatalog {
+public:
+  static MediaCatalog* createNew(DynamicRTSPServer& server, char const* catalogFileName, Boolean isReadOnly = False);
+      // Loads the catalog from "catalogFileName" (if it exists), then starts (re)scanning in the background.
+      // If "isReadOnly", then we instead just reload the catalog whenever the file changes - i.e., when it's saved by
+      // another "MediaCatalog" (e.g., in another server process) - but never scan, probe or save.
+  virtual ~MediaCatalog(); // saves the catalog, if it has changed
+
+  class Entry {
+  public:
+    Entry(char const* fileName);
+    virtual ~Entry();
+
+    void setSubsessionSDPLines(unsigned numSubsessions, char** sdpLines); // takes ownership of "sdpLines" (if non-NULL)
+
+  public:
+    char* fileName; // relative to the current directory
+    u_int64_t fileSize;
+    long modificationTime; // of the file (seconds since the epoch)
+    Boolean hasIndex; // for Transport Stream files: whether a ".tsx" index file exists
+    Boolean isProbed; // whether the following fields are valid:
+    float duration; // as returned by "ServerMediaSession::duration()"
+    unsigned numSubsessions;
+    char** sdpLines; // for each subsession
+    unsigned scanNumber; // the most recent scan that found this file
+  };
+
+  Entry const* lookup(char const* fileName) const;
+      // Returns NULL if the file is not listed.  (If "isComplete()", this means that the file doesn't exist - unless it's
+      // within a symbolically-linked directory, because we don't scan those.)
+  Boolean isComplete() const { return fIsComplete; }
+      // True iff we list exactly the media files that exist - i.e., a complete scan has been done, and since then
+      // we've been notified of each change.  (If False, then "lookup()" might return out-of-date information.)
+  unsigned numEntries() const { return fEntries->numEntries(); }
+
+  void presetSDPLines(ServerMediaSession* sms) const;
+      // If "sms"s file has been probed, sets the SDP lines of each of its subsessions, so that they won't need to be
+      // computed when handling "DESCRIBE".
+
+protected:
+  MediaCatalog(DynamicRTSPServer& server, char const* catalogFileName, Boolean isReadOnly); // called only by createNew()
+
+private:
+  Boolean load();
+  Boolean save();
+  void noteChange();
+  static void saveTask(void* clientData);
+  static void reloadTask(void* clientData);
+  void reloadTask1();
+
+  // Scanning:
+  void startFullScan();
+  void addDirectoryToScan(char const* dirPath);
+  static void scanTask(void* clientData);
+  void scanTask1();
+  void endScan();
+  void noteFile(char const* filePath, Boolean isFromFullScan);
+  void removeEntry(char const* filePath);
+  void removeEntriesInDirectory(char const* dirPath);
+  static void rescanTask(void* clientData);
+
+  // Probing:
+  void addFileToProbe(char const* filePath);
+  void scheduleProbeTask(unsigned delayMS);
+  static void probeTask(void* clientData);
+  void probeTask1();
+  void startNextProbe();
+  static void afterProbeLookup(void* clientData, ServerMediaSession* sms);
+  static void afterProbePreparation(void* clientData);
+  void finishProbe();
+
+  // Watching for changes:
+  void watchDirectory(char const* dirPath);
+  void stopWatching();
+  static void incomingWatchEventHandler(void* clientData, int mask);
+  void incomingWatchEventHandler1();
+
+private:
+  UsageEnvironment& fEnv;
+  DynamicRTSPServer& fServer;
+  char* fCatalogFileName;
+  HashTable* fEntries; // maps file names to "Entry"s
+  Boolean fIsReadOnly, fIsComplete, fHasChanged;
+  TaskToken fSaveTask;
+  u_int64_t fLoadedFileSize; long fLoadedModificationTime; // of the catalog file, when we last loaded it (if "fIsReadOnly")
+  TaskToken fReloadTask; // used only if "fIsReadOnly"
+
+  struct PathList {
+    PathList* next;
+    char* path;
+  };
+  static void addPath(PathList*& head, PathList*& tail, char const* path);
+  static char* removeFirstPath(PathList*& head, PathList*& tail); // the caller should "delete[]" the result
+
+  // Scanning state:
+  unsigned fScanNumber;
+  Boolean fScanIsFull; // i.e., we'll remove any entries not found during the scan
+  PathList* fDirsToScanHead; PathList* fDirsToScanTail;
+  void* fCurrentDir; // a "DIR*"
+  char* fCurrentDirPath;
+  TaskToken fScanTask, fRescanTask;
+
+  // Probing state:
+  PathList* fFilesToProbeHead; PathList* fFilesToProbeTail;
+  enum { PROBE_IDLE, PROBE_LOOKING_UP, PROBE_PREPARING, PROBE_CONTINUING } fProbeState;
+  char* fProbeFileName;
+  u_int64_t fProbeFileSize; long fProbeModificationTime; // so we can tell whether the file changed while we probed it
+  ServerMediaSession* fProbeSession;
+  Boolean fProbeSessionExisted;
+  TaskToken fProbeTask;
+
+  // Watching state:
+  int fWatchFd; // -1 if we can't watch for changes
+  HashTable* fWatchedDirs; // maps watch descriptors to directory paths
+};
+
+#endif
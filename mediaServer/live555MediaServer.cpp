@@ -18,14 +18,62 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 // main program
 
 #include <BasicUsageEnvironment.hh>
+#include <GroupsockHelper.hh>
 #include "DynamicRTSPServer.hh"
 #include "version.hh"
+#include <string.h>
+#if !defined(__WIN32__) && !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#define HAVE_WORKER_PROCESSES 1
+static unsigned startWorkers(TaskScheduler*& scheduler, UsageEnvironment*& env, unsigned numWorkers,
+			     int& ourHandOffSocket, int& nextWorkerHandOffSocket); // forward
+#endif
 
 int main(int argc, char** argv) {
   // Begin by setting up our usage environment:
   TaskScheduler* scheduler = BasicTaskScheduler::createNew();
   UsageEnvironment* env = BasicUsageEnvironment::createNew(*scheduler);
 
+  // An optional "-c <catalog-file-name>" argument tells us to keep a catalog of our media files (in that file), so that
+  // each file need be probed only once (rather than when it's first requested by a client, after each restart).
+  // An optional "-w <number-of-worker-processes>" argument tells us to serve clients from this many processes (to make use
+  // of several CPU cores), each with its own sockets bound to the same port numbers, so that the OS spreads incoming
+  // connections over them:
+  char const* catalogFileName = NULL;
+  unsigned numWorkers = 1;
+  Boolean argsAreOK = True;
+  for (int i = 1; i < argc && argsAreOK; i += 2) {
+    if (i+1 < argc && strcmp(argv[i], "-c") == 0) {
+      catalogFileName = argv[i+1];
+#ifdef HAVE_WORKER_PROCESSES
+    } else if (i+1 < argc && strcmp(argv[i], "-w") == 0) {
+      argsAreOK = sscanf(argv[i+1], "%u", &numWorkers) == 1 && numWorkers > 0;
+#endif
+    } else {
+      argsAreOK = False;
+    }
+  }
+  if (!argsAreOK) {
+    *env << "Usage: " << argv[0] << " [-c <catalog-file-name>]"
+#ifdef HAVE_WORKER_PROCESSES
+	 << " [-w <number-of-worker-processes>]"
+#endif
+	 << "\n";
+    exit(1);
+  }
+
+  unsigned workerNum = 0;
+  int ourHandOffSocket = -1, nextWorkerHandOffSocket = -1;
+#ifdef HAVE_WORKER_PROCESSES
+  if (numWorkers > 1) {
+    // Note: This returns only in each worker process (with a new "scheduler" and "env"):
+    workerNum = startWorkers(scheduler, env, numWorkers, ourHandOffSocket, nextWorkerHandOffSocket);
+  }
+#endif
+
   UserAuthenticationDatabase* authDB = NULL;
 #ifdef ACCESS_CONTROL
   // To implement client access control to the RTSP server, do the following:
@@ -35,19 +83,37 @@ int main(int argc, char** argv) {
   // access to the server.
 #endif
 
+  // If we're one of several worker processes, then each of us binds its own sockets to the same port numbers:
+  ReusePortForTCP* reusePort = numWorkers > 1 ? new ReusePortForTCP(*env) : NULL;
+
   // Create the RTSP server.  Try first with the default port number (554),
   // and then with the alternative port number (8554):
-  RTSPServer* rtspServer;
+  // (If we're one of several worker processes, then only the first keeps the catalog up-to-date; the others just read it.)
+  DynamicRTSPServer* rtspServer;
+  Boolean const catalogIsReadOnly = workerNum > 0;
   portNumBits rtspServerPortNum = 554;
-  rtspServer = DynamicRTSPServer::createNew(*env, rtspServerPortNum, authDB);
+  rtspServer = DynamicRTSPServer::createNew(*env, rtspServerPortNum, authDB, 65, catalogFileName, catalogIsReadOnly);
   if (rtspServer == NULL) {
     rtspServerPortNum = 8554;
-    rtspServer = DynamicRTSPServer::createNew(*env, rtspServerPortNum, authDB);
+    rtspServer = DynamicRTSPServer::createNew(*env, rtspServerPortNum, authDB, 65, catalogFileName, catalogIsReadOnly);
   }
   if (rtspServer == NULL) {
     *env << "Failed to create RTSP server: " << env->getResultMsg() << "\n";
     exit(1);
   }
+  if (numWorkers > 1) rtspServer->setUpHandOffToOtherWorkers(ourHandOffSocket, nextWorkerHandOffSocket, numWorkers);
+
+  // Also, attempt to create a HTTP server for RTSP-over-HTTP tunneling.
+  // Try first with the default HTTP port (80), and then with the alternative HTTP
+  // port numbers (8000 and 8080).
+  Boolean const haveHTTPServer
+    = rtspServer->setUpTunnelingOverHTTP(80) || rtspServer->setUpTunnelingOverHTTP(8000) || rtspServer->setUpTunnelingOverHTTP(8080);
+  delete reusePort;
+
+  if (workerNum > 0) {
+    // Only the first worker process describes the server:
+    env->taskScheduler().doEventLoop(); // does not return
+  }
 
   *env << "LIVE555 Media Server\n";
   *env << "\tversion " << MEDIA_SERVER_VERSION_STRING
@@ -75,13 +141,15 @@ int main(int argc, char** argv) {
   *env << "\t\".wav\" => a WAV Audio file\n";
   *env << "\t\".webm\" => a WebM audio(Vorbis)+video(VP8) file\n";
   *env << "See http://www.live555.com/mediaServer/ for additional documentation.\n";
+  if (catalogFileName != NULL) {
+    *env << "(We keep a catalog of these files - updated in the background - in \"" << catalogFileName << "\".)\n";
+  }
+  if (numWorkers > 1) {
+    *env << "(We serve clients from " << numWorkers << " worker processes.)\n";
+  }
 
-  // Also, attempt to create a HTTP server for RTSP-over-HTTP tunneling.
-  // Try first with the default HTTP port (80), and then with the alternative HTTP
-  // port numbers (8000 and 8080).
-
-  if (rtspServer->setUpTunnelingOverHTTP(80) || rtspServer->setUpTunnelingOverHTTP(8000) || rtspServer->setUpTunnelingOverHTTP(8080)) {
-    *env << "(We use port " << rtspServer->httpServerPortNum() << " for optional RTSP-over-HTTP tunneling, or for HTTP live streaming (for indexed Transport Stream files only).)\n";
+  if (haveHTTPServer) {
+    *env << "(We use port " << rtspServer->httpServerPortNum() << " for optional RTSP-over-HTTP tunneling, or for HTTP live streaming (for indexed Transport Stream files, and for unbounded streams).)\n";
   } else {
     *env << "(RTSP-over-HTTP tunneling is not available.)\n";
   }
@@ -90,3 +158,98 @@ int main(int argc, char** argv) {
 
   return 0; // only to prevent compiler warning
 }
+
+#ifdef HAVE_WORKER_PROCESSES
+static pid_t* workerPids = NULL;
+static unsigned numWorkerPids = 0;
+
+static void stopWorkers() {
+  for (unsigned i = 0; i < numWorkerPids; ++i) {
+    if (workerPids[i] > 0) kill(workerPids[i], SIGTERM);
+  }
+}
+
+static void signalHandlerStopWorkers(int sig) {
+  // Our worker processes go away with us:
+  stopWorkers();
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+static unsigned startWorkers(TaskScheduler*& scheduler, UsageEnvironment*& env, unsigned numWorkers,
+			     int& ourHandOffSocket, int& nextWorkerHandOffSocket) {
+  // Each worker receives connections - handed off by the previous worker (in a ring) - on its own local datagram socket.
+  // We keep each of these sockets open ourself, so that connections handed off to a worker that we're restarting wait for it:
+  int* handOffSockets = new int[2*numWorkers];
+  for (unsigned i = 0; i < numWorkers; ++i) {
+    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, &handOffSockets[2*i]) < 0) {
+      *env << "socketpair() failed\n";
+      exit(1);
+    }
+  }
+
+  numWorkerPids = numWorkers;
+  workerPids = new pid_t[numWorkers];
+  for (unsigned i = 0; i < numWorkers; ++i) workerPids[i] = 0;
+  signal(SIGINT, signalHandlerStopWorkers);
+  signal(SIGTERM, signalHandlerStopWorkers);
+
+  unsigned workerNum = 0;
+  int status = 0;
+  while (1) {
+    // Start (or restart) any worker that's not running:
+    for (workerNum = 0; workerNum < numWorkers; ++workerNum) {
+      if (workerPids[workerNum] > 0) continue;
+
+      workerPids[workerNum] = fork();
+      if (workerPids[workerNum] < 0) {
+	*env << "fork() failed\n";
+	stopWorkers();
+	exit(1);
+      } else if (workerPids[workerNum] == 0) {
+	break; // we're the new worker process
+      }
+    }
+    if (workerNum < numWorkers) break;
+
+    // We're the parent process.  Wait for any worker to go away.  If it was killed (e.g., it crashed), then restart it
+    // (after a delay, in case it keeps crashing).  If, instead, it exited (e.g., because it couldn't set up its server),
+    // then stop the others, and exit ourself:
+    pid_t pid = wait(&status);
+    if (pid < 0) continue;
+    for (workerNum = 0; workerNum < numWorkers; ++workerNum) {
+      if (workerPids[workerNum] == pid) break;
+    }
+    if (workerNum == numWorkers) continue;
+    workerPids[workerNum] = 0;
+
+    if (WIFSIGNALED(status)) {
+      *env << "Worker process " << workerNum << " was killed (signal " << WTERMSIG(status) << "); restarting it\n";
+      sleep(1);
+    } else {
+      stopWorkers();
+      exit(WIFEXITED(status) ? WEXITSTATUS(status) : 1);
+    }
+  }
+
+  // We're worker process "workerNum".  Replace our parent's scheduler with our own (because it has its own descriptors):
+  signal(SIGINT, SIG_DFL);
+  signal(SIGTERM, SIG_DFL);
+  env->reclaim(); env = NULL;
+  delete scheduler;
+  scheduler = BasicTaskScheduler::createNew();
+  env = BasicUsageEnvironment::createNew(*scheduler);
+
+  // Keep just our own end of our hand-off socket, and the sending end of the next worker's:
+  unsigned const nextWorkerNum = (workerNum+1)%numWorkers;
+  ourHandOffSocket = handOffSockets[2*workerNum];
+  nextWorkerHandOffSocket = handOffSockets[2*nextWorkerNum + 1];
+  for (unsigned i = 0; i < 2*numWorkers; ++i) {
+    if (handOffSockets[i] != ourHandOffSocket && handOffSockets[i] != nextWorkerHandOffSocket) close(handOffSockets[i]);
+  }
+  delete[] handOffSockets;
+  delete[] workerPids; workerPids = NULL; numWorkerPids = 0;
+
+  return workerNum;
+}
+#endif
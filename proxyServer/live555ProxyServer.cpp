@@ -34,12 +34,21 @@ char* password = NULL;
 Boolean proxyREGISTERRequests = False;
 char* usernameForREGISTER = NULL;
 char* passwordForREGISTER = NULL;
+unsigned idleDisconnectSeconds = 0; // if > 0, we operate in 'capacity mode'
+unsigned gopCacheSize = 0; // if > 0, new clients of video streams are given the cached frames since the last key frame
+char const* urlListFileName = NULL;
+
+// The streams that we're proxying (so that - in 'capacity mode' - we can periodically report their back-end state):
+ProxyServerMediaSession** proxySessions = NULL;
+unsigned numProxySessions = 0;
+#define BACK_END_STATE_REPORT_INTERVAL 60 // seconds
 
 static RTSPServer* createRTSPServer(Port port) {
   if (proxyREGISTERRequests) {
     return RTSPServerWithREGISTERProxying::createNew(*env, port, authDB, authDBForREGISTER, 65, streamRTPOverTCP, verbosityLevel);
   } else {
-    return RTSPServer::createNew(*env, port, authDB);
+    // Use a server that also supports HTTP Live Streaming, so that each proxied stream can also be played via HTTP:
+    return RTSPServerSupportingHTTPStreaming::createNew(*env, port, authDB);
   }
 }
 
@@ -49,10 +58,58 @@ void usage() {
        << " [-t|-T <http-port>]"
        << " [-u <username> <password>]"
        << " [-R] [-U <username-for-REGISTER> <password-for-REGISTER>]"
+       << " [-i <idle-disconnect-seconds>] [-f <file-of-rtsp-urls>]"
+       << " [-g <gop-cache-size-in-bytes>]"
        << " <rtsp-url-1> ... <rtsp-url-n>\n";
   exit(1);
 }
 
+static void addProxySession(RTSPServer* rtspServer, char const* proxiedStreamURL, char const* streamName) {
+  ProxyServerMediaSession* sms
+    = ProxyServerMediaSession::createNew(*env, rtspServer,
+					 proxiedStreamURL, streamName,
+					 username, password, tunnelOverHTTPPortNum, verbosityLevel,
+					 -1, idleDisconnectSeconds);
+  sms->gopCacheSize() = gopCacheSize;
+  rtspServer->addServerMediaSession(sms);
+  proxySessions[numProxySessions++] = sms;
+
+  char* proxyStreamURL = rtspServer->rtspURL(sms);
+  *env << "RTSP stream, proxying the stream \"" << proxiedStreamURL << "\"\n";
+  *env << "\tPlay this stream using the URL: " << proxyStreamURL << "\n";
+  delete[] proxyStreamURL;
+}
+
+static void reportBackEndStates(void* /*clientData*/) {
+  // Report (a summary of) the state of each of our back-end streams:
+  unsigned const numStates = ProxyServerMediaSession::BACK_END_STREAMING+1;
+  unsigned stateCounts[numStates];
+  unsigned i;
+  for (i = 0; i < numStates; ++i) stateCounts[i] = 0;
+
+  for (i = 0; i < numProxySessions; ++i) {
+    ProxyServerMediaSession::BackEndState state = proxySessions[i]->backEndState();
+    ++stateCounts[state];
+    if (verbosityLevel > 0) {
+      *env << "\"" << proxySessions[i]->streamName() << "\" (" << proxySessions[i]->url() << "): "
+	   << ProxyServerMediaSession::backEndStateName(state);
+      if (proxySessions[i]->numBackEndDESCRIBEFailures() > 0) {
+	*env << " (" << proxySessions[i]->numBackEndDESCRIBEFailures() << " failed \"DESCRIBE\"s)";
+      }
+      *env << "\n";
+    }
+  }
+
+  *env << "Back-end streams:";
+  for (i = 0; i < numStates; ++i) {
+    *env << (i == 0 ? " " : ", ") << stateCounts[i] << " "
+	 << ProxyServerMediaSession::backEndStateName((ProxyServerMediaSession::BackEndState)i);
+  }
+  *env << "\n";
+
+  env->taskScheduler().scheduleDelayedTask(BACK_END_STATE_REPORT_INTERVAL*1000000, reportBackEndStates, NULL);
+}
+
 int main(int argc, char** argv) {
   // Increase the maximum size of video frames that we can 'proxy' without truncation.
   // (Such frames are unreasonably large; the back-end servers should really not be sending frames this large!)
@@ -132,6 +189,25 @@ int main(int argc, char** argv) {
       break;
     }
 
+    case 'i': { // 'capacity mode': disconnect from each back-end server when its stream has had no clients for this many seconds
+      if (argc < 3 || sscanf(argv[2], "%u", &idleDisconnectSeconds) != 1 || idleDisconnectSeconds == 0) usage();
+      ++argv; --argc;
+      break;
+    }
+
+    case 'g': { // give each new client of a H.264, H.265 or MPEG-4 video stream the frames since the most recent key frame
+      if (argc < 3 || sscanf(argv[2], "%u", &gopCacheSize) != 1 || gopCacheSize == 0) usage();
+      ++argv; --argc;
+      break;
+    }
+
+    case 'f': { // read (more) "rtsp://" URLs - one per line - from a file
+      if (argc < 3) usage();
+      urlListFileName = argv[2];
+      ++argv; --argc;
+      break;
+    }
+
     default: {
       usage();
       break;
@@ -140,12 +216,40 @@ int main(int argc, char** argv) {
 
     ++argv; --argc;
   }
-  if (argc < 2 && !proxyREGISTERRequests) usage(); // there must be at least one "rtsp://" URL at the end 
+  if (argc < 2 && !proxyREGISTERRequests && urlListFileName == NULL) usage(); // there must be at least one "rtsp://" URL at the end 
   // Make sure that the remaining arguments appear to be "rtsp://" URLs:
   int i;
   for (i = 1; i < argc; ++i) {
     if (strncmp(argv[i], "rtsp://", 7) != 0) usage();
   }
+  // Read the URLs (if any) from the "-f" file:
+  char** urlsFromFile = NULL;
+  unsigned numURLsFromFile = 0;
+  if (urlListFileName != NULL) {
+    FILE* fid = fopen(urlListFileName, "r");
+    if (fid == NULL) {
+      *env << "Failed to open \"" << urlListFileName << "\"\n";
+      usage();
+    }
+
+    unsigned maxNumURLs = 0;
+    char line[1000];
+    while (fgets(line, sizeof line, fid) != NULL) {
+      char url[1000];
+      if (sscanf(line, "%999s", url) != 1 || url[0] == '#') continue; // skip blank lines and comments
+      if (strncmp(url, "rtsp://", 7) != 0) usage();
+
+      if (numURLsFromFile == maxNumURLs) {
+	maxNumURLs = maxNumURLs == 0 ? 100 : 2*maxNumURLs;
+	char** newURLs = new char*[maxNumURLs];
+	for (unsigned j = 0; j < numURLsFromFile; ++j) newURLs[j] = urlsFromFile[j];
+	delete[] urlsFromFile; urlsFromFile = newURLs;
+      }
+      urlsFromFile[numURLsFromFile++] = strDup(url);
+    }
+    fclose(fid);
+  }
+
   // Do some additional checking for invalid command-line argument combinations:
   if (authDBForREGISTER != NULL && !proxyREGISTERRequests) {
     *env << "The '-U <username> <password>' option can be used only with -R\n";
@@ -181,25 +285,26 @@ int main(int argc, char** argv) {
     exit(1);
   }
 
-  // Create a proxy for each "rtsp://" URL specified on the command line:
-  for (i = 1; i < argc; ++i) {
-    char const* proxiedStreamURL = argv[i];
+  // Create a proxy for each "rtsp://" URL specified on the command line (or in the "-f" file):
+  unsigned const totalNumURLs = (argc-1) + numURLsFromFile;
+  proxySessions = new ProxyServerMediaSession*[totalNumURLs];
+  for (unsigned j = 0; j < totalNumURLs; ++j) {
+    char const* proxiedStreamURL = j < (unsigned)(argc-1) ? argv[j+1] : urlsFromFile[j-(argc-1)];
     char streamName[30];
-    if (argc == 2) {
+    if (totalNumURLs == 1) {
       sprintf(streamName, "%s", "proxyStream"); // there's just one stream; give it this name
     } else {
-      sprintf(streamName, "proxyStream-%d", i); // there's more than one stream; distinguish them by name
-    }
-    ServerMediaSession* sms
-      = ProxyServerMediaSession::createNew(*env, rtspServer,
-					   proxiedStreamURL, streamName,
-					   username, password, tunnelOverHTTPPortNum, verbosityLevel);
-    rtspServer->addServerMediaSession(sms);
-
-    char* proxyStreamURL = rtspServer->rtspURL(sms);
-    *env << "RTSP stream, proxying the stream \"" << proxiedStreamURL << "\"\n";
-    *env << "\tPlay this stream using the URL: " << proxyStreamURL << "\n";
-    delete[] proxyStreamURL;
+      sprintf(streamName, "proxyStream-%u", j+1); // there's more than one stream; distinguish them by name
+    }
+    addProxySession(rtspServer, proxiedStreamURL, streamName);
+  }
+  for (unsigned k = 0; k < numURLsFromFile; ++k) delete[] urlsFromFile[k];
+  delete[] urlsFromFile;
+
+  if (idleDisconnectSeconds > 0 && numProxySessions > 0) {
+    *env << "(Capacity mode: we connect to each back-end server only while its stream has clients, disconnecting "
+	 << idleDisconnectSeconds << " seconds after its last client leaves.)\n";
+    env->taskScheduler().scheduleDelayedTask(BACK_END_STATE_REPORT_INTERVAL*1000000, reportBackEndStates, NULL);
   }
 
   if (proxyREGISTERRequests) {
@@ -211,7 +316,8 @@ int main(int argc, char** argv) {
   // port numbers (8000 and 8080).
 
   if (rtspServer->setUpTunnelingOverHTTP(80) || rtspServer->setUpTunnelingOverHTTP(8000) || rtspServer->setUpTunnelingOverHTTP(8080)) {
-    *env << "\n(We use port " << rtspServer->httpServerPortNum() << " for optional RTSP-over-HTTP tunneling.)\n";
+    *env << "\n(We use port " << rtspServer->httpServerPortNum() << " for optional RTSP-over-HTTP tunneling"
+	 << (proxyREGISTERRequests ? "" : ", or for HTTP live streaming") << ".)\n";
   } else {
     *env << "\n(RTSP-over-HTTP tunneling is not available.)\n";
   }
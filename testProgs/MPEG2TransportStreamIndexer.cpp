@@ -17,11 +17,18 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 // A program that reads an existing MPEG-2 Transport Stream file,
 // and generates a separate index file that can be used - by our RTSP server
 // implementation - to support 'trick play' operations when streaming the
-// Transport Stream file.
+// Transport Stream file.  The file can be indexed in several pieces, in
+// parallel (using separate processes); an existing index file can be extended
+// ("-r"); or a Transport Stream file that's still being written can be
+// indexed continually, as it grows ("-t").
 // main program
 
 #include <liveMedia.hh>
 #include <BasicUsageEnvironment.hh>
+#if !defined(__WIN32__) && !defined(_WIN32)
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
 
 void afterPlaying(void* clientData); // forward
 
@@ -29,11 +36,21 @@ UsageEnvironment* env;
 char const* programName;
 
 void usage() {
-  *env << "usage: " << programName << " <transport-stream-file-name>\n";
+  *env << "usage: " << programName << " [-r | -t] [-j <num-processes>] <transport-stream-file-name>\n";
   *env << "\twhere <transport-stream-file-name> ends with \".ts\"\n";
+  *env << "\t-r: resume indexing, from the end of an existing (possibly incomplete) index file\n";
+  *env << "\t-t: like -r, but then continue indexing, as the transport stream file grows (never exits)\n";
+#if !defined(__WIN32__) && !defined(_WIN32)
+  *env << "\t-j <num-processes>: index separate pieces of the file in parallel, then merge the results\n";
+#endif
   exit(1);
 }
 
+#if !defined(__WIN32__) && !defined(_WIN32)
+static void indexInParallel(char const* inputFileName, char const* outputFileName, unsigned numProcesses); // forward
+static void pieceIndexed(void* clientData); // forward
+#endif
+
 int main(int argc, char const** argv) {
   // Begin by setting up our usage environment:
   TaskScheduler* scheduler = BasicTaskScheduler::createNew();
@@ -41,7 +58,26 @@ int main(int argc, char const** argv) {
 
   // Parse the command line:
   programName = argv[0];
+  Boolean resume = False, followFileGrowth = False;
+  unsigned numProcesses = 1;
+  while (argc > 2) {
+    char const* opt = argv[1];
+    if (strcmp(opt, "-r") == 0) {
+      resume = True;
+    } else if (strcmp(opt, "-t") == 0) {
+      resume = followFileGrowth = True;
+#if !defined(__WIN32__) && !defined(_WIN32)
+    } else if (strcmp(opt, "-j") == 0 && argc > 3) {
+      if (sscanf(argv[2], "%u", &numProcesses) != 1 || numProcesses == 0) usage();
+      ++argv; --argc;
+#endif
+    } else {
+      usage();
+    }
+    ++argv; --argc;
+  }
   if (argc != 2) usage();
+  if (resume && numProcesses > 1) usage();
 
   char const* inputFileName = argv[1];
   // Check whether the input file name ends with ".ts":
@@ -52,32 +88,34 @@ int main(int argc, char const** argv) {
     usage();
   }
 
-  // Open the input file (as a 'byte stream file source'):
-  FramedSource* input
-    = ByteStreamFileSource::createNew(*env, inputFileName, TRANSPORT_PACKET_SIZE);
-  if (input == NULL) {
-    *env << "Failed to open input file \"" << inputFileName << "\" (does it exist?)\n";
-    exit(1);
-  }
-
-  // Create a filter that indexes the input Transport Stream data:
-  FramedSource* indexer
-    = MPEG2IFrameIndexFromTransportStream::createNew(*env, input);
-
   // The output file name is the same as the input file name, except with suffix ".tsx":
   char* outputFileName = new char[len+2]; // allow for trailing x\0
   sprintf(outputFileName, "%sx", inputFileName);
 
-  // Open the output file (for writing), as a 'file sink':
-  MediaSink* output = FileSink::createNew(*env, outputFileName);
-  if (output == NULL) {
-    *env << "Failed to open output file \"" << outputFileName << "\"\n";
+#if !defined(__WIN32__) && !defined(_WIN32)
+  if (numProcesses > 1) {
+    indexInParallel(inputFileName, outputFileName, numProcesses);
+    return 0;
+  }
+#endif
+
+  // Create an object that indexes the input file (into the output file):
+  MPEG2TransportStreamIndexer* indexer
+    = MPEG2TransportStreamIndexer::createNew(*env, inputFileName, outputFileName);
+  if (indexer == NULL) {
+    *env << "Failed to open input file \"" << inputFileName << "\" (does it exist?)\n";
     exit(1);
   }
 
   // Start playing, to generate the output index file:
   *env << "Writing index file \"" << outputFileName << "\"...";
-  output->startPlaying(*indexer, afterPlaying, NULL);
+  Boolean started = resume
+    ? indexer->resumeIndexing(afterPlaying, NULL, followFileGrowth)
+    : indexer->indexFile(afterPlaying, NULL);
+  if (!started) {
+    *env << "Failed to write index file \"" << outputFileName << "\": " << env->getResultMsg() << "\n";
+    exit(1);
+  }
 
   env->taskScheduler().doEventLoop(); // does not return
 
@@ -88,3 +126,67 @@ void afterPlaying(void* /*clientData*/) {
   *env << "...done\n";
   exit(0);
 }
+
+#if !defined(__WIN32__) && !defined(_WIN32)
+static void indexInParallel(char const* inputFileName, char const* outputFileName, unsigned numProcesses) {
+  MPEG2TransportStreamIndexer* indexer
+    = MPEG2TransportStreamIndexer::createNew(*env, inputFileName, outputFileName);
+  if (indexer == NULL) {
+    *env << "Failed to open input file \"" << inputFileName << "\" (does it exist?)\n";
+    exit(1);
+  }
+  unsigned long numTransportPackets = indexer->numTransportPackets();
+  Medium::close(indexer);
+
+  *env << "Writing index file \"" << outputFileName << "\" (using " << numProcesses << " processes)...";
+
+  // Index each piece of the file (into its own, temporary index file) in a separate child process:
+  unsigned outputFileNameLen = strlen(outputFileName);
+  char** pieceFileNames = new char*[numProcesses];
+  pid_t* pids = new pid_t[numProcesses];
+  for (unsigned i = 0; i < numProcesses; ++i) {
+    pieceFileNames[i] = new char[outputFileNameLen + 20];
+    sprintf(pieceFileNames[i], "%s.%u", outputFileName, i);
+    unsigned long from = (numTransportPackets*i)/numProcesses;
+    unsigned long to = i == numProcesses-1 ? 0 : (numTransportPackets*(i+1))/numProcesses;
+
+    pids[i] = fork();
+    if (pids[i] < 0) {
+      *env << "fork() failed\n";
+      exit(1);
+    } else if (pids[i] == 0) {
+      // We're the child process.  Index our piece, then exit:
+      indexer = MPEG2TransportStreamIndexer::createNew(*env, inputFileName, pieceFileNames[i]);
+      char indexingIsDone = 0;
+      if (indexer == NULL || !indexer->indexFile(pieceIndexed, &indexingIsDone, from, to)) _exit(1);
+      env->taskScheduler().doEventLoop(&indexingIsDone);
+      _exit(0);
+    }
+  }
+
+  // Wait for each child process to finish:
+  Boolean success = True;
+  for (unsigned i = 0; i < numProcesses; ++i) {
+    int status;
+    if (waitpid(pids[i], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) success = False;
+  }
+
+  // Then merge the pieces' index files:
+  if (!success || !MPEG2TransportStreamIndexer::mergeIndexFiles(*env, outputFileName, pieceFileNames, numProcesses)) {
+    *env << "Failed to write index file \"" << outputFileName << "\"\n";
+    success = False;
+  }
+  for (unsigned i = 0; i < numProcesses; ++i) {
+    unlink(pieceFileNames[i]);
+    delete[] pieceFileNames[i];
+  }
+  delete[] pieceFileNames; delete[] pids;
+
+  if (!success) exit(1);
+  *env << "...done\n";
+}
+
+static void pieceIndexed(void* clientData) {
+  *(char*)clientData = ~0; // causes the child's event loop to exit
+}
+#endif
@@ -70,6 +70,7 @@ TaskToken periodicFileOutputTask = NULL;
 Boolean createReceivers = True;
 Boolean outputQuickTimeFile = False;
 Boolean generateMP4Format = False;
+unsigned fragmentDuration = 0; // if non-zero, output a 'fragmented' 'mp4'-format file
 QuickTimeFileSink* qtOut = NULL;
 Boolean outputAVIFile = False;
 AVIFileSink* aviOut = NULL;
@@ -90,6 +91,7 @@ int simpleRTPoffsetArg = -1;
 Boolean sendOptionsRequest = True;
 Boolean sendOptionsRequestOnly = False;
 Boolean oneFilePerFrame = False;
+unsigned segmentDuration = 0; // if non-zero, output each stream as a series of segment files, with an index file
 Boolean notifyOnPacketArrival = False;
 Boolean streamUsingTCP = False;
 Boolean forceMulticastOnUnspecified = False;
@@ -129,7 +131,7 @@ struct timeval startTime;
 
 void usage() {
   *env << "Usage: " << progName
-       << " [-p <startPortNum>] [-r|-q|-4|-i] [-a|-v] [-V] [-d <duration>] [-D <max-inter-packet-gap-time> [-c] [-S <offset>] [-n] [-O]"
+       << " [-p <startPortNum>] [-r|-q|-4|-G <fragment-duration>|-i|-E <segment-duration>] [-a|-v] [-V] [-d <duration>] [-D <max-inter-packet-gap-time> [-c] [-S <offset>] [-n] [-O]"
 	   << (controlConnectionUsesTCP ? " [-t|-T <http-port>]" : "")
        << " [-u <username> <password>"
 	   << (allowProxyServers ? " [<proxy-server> [<proxy-server-port>]]" : "")
@@ -196,6 +198,16 @@ int main(int argc, char** argv) {
       break;
     }
 
+    case 'G': { // output a 'fragmented' 'mp4'-format file (to stdout), with the specified fragment duration (in seconds)
+      if (sscanf(argv[2], "%u", &fragmentDuration) != 1 || fragmentDuration == 0) {
+	usage();
+      }
+      outputQuickTimeFile = True;
+      generateMP4Format = True;
+      ++argv; --argc;
+      break;
+    }
+
     case 'i': { // output an AVI file (to stdout)
       outputAVIFile = True;
       break;
@@ -271,6 +283,14 @@ int main(int argc, char** argv) {
       break;
     }
 
+    case 'E': { // output each stream as a series of segment files, each (approximately) of the specified duration (in seconds)
+      if (sscanf(argv[2], "%u", &segmentDuration) != 1 || segmentDuration == 0) {
+	usage();
+      }
+      ++argv; --argc;
+      break;
+    }
+
     case 'm': { // output multiple files - one for each frame
       oneFilePerFrame = True;
       break;
@@ -533,6 +553,10 @@ int main(int argc, char** argv) {
     *env << "The -r option cannot be used with -q, -4, -i, -m, or -P!\n";
     usage();
   }
+  if (segmentDuration > 0 && (outputCompositeFile || oneFilePerFrame || fileOutputInterval > 0 || !createReceivers)) {
+    *env << "The -E option cannot be used with -r, -q, -4, -G, -i, -m, or -P!\n";
+    usage();
+  }
   if (oneFilePerFrame && fileOutputInterval > 0) {
     *env << "The -m and -P options cannot both be used!\n";
     usage();
@@ -796,7 +820,8 @@ void createOutputFiles(char const* periodicFilenameSuffix) {
 					   packetLossCompensate,
 					   syncStreams,
 					   generateHintTracks,
-					   generateMP4Format);
+					   generateMP4Format,
+					   fragmentDuration);
       if (qtOut == NULL) {
 	*env << "Failed to create a \"QuickTimeFileSink\" for outputting to \""
 	     << outFileName << "\": " << env->getResultMsg() << "\n";
@@ -851,7 +876,7 @@ void createOutputFiles(char const* periodicFilenameSuffix) {
 	  // and (at the start) the SPS and PPS NAL units:
 	  fileSink = H264VideoFileSink::createNew(*env, outFileName,
 						  subsession->fmtp_spropparametersets(),
-						  fileSinkBufferSize, oneFilePerFrame);
+						  fileSinkBufferSize, oneFilePerFrame || segmentDuration > 0);
 	} else if (strcmp(subsession->codecName(), "H265") == 0) {
 	  // For H.265 video stream, we use a special sink that adds 'start codes',
 	  // and (at the start) the VPS, SPS, and PPS NAL units:
@@ -859,7 +884,7 @@ void createOutputFiles(char const* periodicFilenameSuffix) {
 						  subsession->fmtp_spropvps(),
 						  subsession->fmtp_spropsps(),
 						  subsession->fmtp_sproppps(),
-						  fileSinkBufferSize, oneFilePerFrame);
+						  fileSinkBufferSize, oneFilePerFrame || segmentDuration > 0);
 	} else if (strcmp(subsession->codecName(), "THEORA") == 0) {
 	  createOggFileSink = True;
 	}
@@ -868,7 +893,7 @@ void createOutputFiles(char const* periodicFilenameSuffix) {
 	    strcmp(subsession->codecName(), "AMR-WB") == 0) {
 	  // For AMR audio streams, we use a special sink that inserts AMR frame hdrs:
 	  fileSink = AMRAudioFileSink::createNew(*env, outFileName,
-						 fileSinkBufferSize, oneFilePerFrame);
+						 fileSinkBufferSize, oneFilePerFrame || segmentDuration > 0);
 	} else if (strcmp(subsession->codecName(), "VORBIS") == 0 ||
 		   strcmp(subsession->codecName(), "OPUS") == 0) {
 	  createOggFileSink = True;
@@ -881,7 +906,15 @@ void createOutputFiles(char const* periodicFilenameSuffix) {
       } else if (fileSink == NULL) {
 	// Normal case:
 	fileSink = FileSink::createNew(*env, outFileName,
-				       fileSinkBufferSize, oneFilePerFrame);
+				       fileSinkBufferSize, oneFilePerFrame || segmentDuration > 0);
+      }
+      if (segmentDuration > 0 && fileSink != NULL) {
+	if (createOggFileSink) {
+	  *env << "Warning: \"" << outFileName << "\" (an Ogg file) can't be written in segments\n";
+	} else if (!fileSink->setSegmentation(segmentDuration)) {
+	  *env << "Failed to set up segmented output for \"" << outFileName << "\": " << env->getResultMsg() << "\n";
+	  Medium::close(fileSink); fileSink = NULL;
+	}
       }
       subsession->sink = fileSink;
 